@@ -0,0 +1,512 @@
+// Codec and RX-path benchmarks on Google Benchmark, reporting ns/op,
+// bytes/s or packets/s, and heap allocations per operation.
+// Usage: codec_bench [--benchmark_filter=<regex>] [--benchmark_out=<file>
+//        --benchmark_out_format=json]; the CMake "bench" target writes
+//        bench.json for comparing commits with Google Benchmark's compare.py.
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <new>
+#include <numeric>
+#include <random>
+#include <vector>
+#include "ethernet/ethernet_frame.h"
+#include "ethernet/ethernet_view.h"
+#include "ip/checksum.h"
+#include "ip/ipv4_packet.h"
+#include "ip/ipv4_view.h"
+#include "tcp/tcp_receive_buffer.h"
+#include "tcp/tcp_segment.h"
+#include "tcp/tcp_segmenter.h"
+#include "tcp/tcp_state_machine.h"
+#include "tcp/tcp_view.h"
+#include "core/timer_wheel.h"
+#include "stack.h"
+
+// Every heap allocation in the process goes through these
+static std::atomic<uint64_t> allocations{0};
+
+static void* counted_alloc(size_t size, size_t alignment) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    size = size == 0 ? 1 : size;
+    void* memory = alignment > alignof(std::max_align_t)
+        ? std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment)
+        : std::malloc(size);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void* operator new(size_t size) { return counted_alloc(size, 0); }
+void* operator new[](size_t size) { return counted_alloc(size, 0); }
+void* operator new(size_t size, std::align_val_t alignment) { return counted_alloc(size, static_cast<size_t>(alignment)); }
+void* operator new[](size_t size, std::align_val_t alignment) { return counted_alloc(size, static_cast<size_t>(alignment)); }
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, size_t) noexcept { std::free(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept { std::free(memory); }
+
+// Counts allocations made by the timed loop it spans
+class AllocationCounter {
+public:
+    explicit AllocationCounter(benchmark::State& state)
+        : state_(state), start_(allocations.load(std::memory_order_relaxed)) {}
+    ~AllocationCounter() {
+        double count = static_cast<double>(allocations.load(std::memory_order_relaxed) - start_);
+        state_.counters["allocs/op"] = benchmark::Counter(count, benchmark::Counter::kAvgIterations);
+    }
+
+private:
+    benchmark::State& state_;
+    uint64_t start_;
+};
+
+static void set_packet_rate(benchmark::State& state, uint64_t packets_per_iteration) {
+    state.counters["packets/s"] = benchmark::Counter(
+        static_cast<double>(state.iterations() * packets_per_iteration), benchmark::Counter::kIsRate);
+}
+
+static const std::array<uint8_t, 4> SOURCE_IP = {10, 0, 0, 1};
+static const std::array<uint8_t, 4> DEST_IP = {10, 0, 0, 2};
+
+static std::vector<uint8_t> make_payload(size_t size) {
+    std::vector<uint8_t> payload(size);
+    for (size_t i = 0; i < size; ++i) {
+        payload[i] = static_cast<uint8_t>(i * 7);
+    }
+    return payload;
+}
+
+static TCPSegment make_segment(size_t payload_size) {
+    TCPSegment segment;
+    segment.set_source_port(40000);
+    segment.set_dest_port(80);
+    segment.set_sequence_number(1000);
+    segment.set_ack_number(2000);
+    segment.set_flags(TCPSegment::ACK | TCPSegment::PSH);
+    segment.set_window_size(65535);
+    segment.set_payload(make_payload(payload_size));
+    return segment;
+}
+
+static IPv4Packet make_packet(size_t payload_size) {
+    IPv4Packet packet;
+    packet.set_protocol(IPv4Packet::PROTOCOL_TCP);
+    packet.set_ttl(64);
+    packet.set_source_ip(SOURCE_IP);
+    packet.set_destination_ip(DEST_IP);
+    packet.set_payload(make_segment(payload_size).serialize(SOURCE_IP, DEST_IP));
+    return packet;
+}
+
+static std::vector<uint8_t> make_frame(size_t payload_size) {
+    EthernetFrame frame;
+    frame.set_source_mac({0x02, 0, 0, 0, 0, 1});
+    frame.set_destination_mac({0x02, 0, 0, 0, 0, 2});
+    frame.set_ethertype(EthernetFrame::ETHERTYPE_IPV4);
+    frame.set_payload(make_packet(payload_size).serialize());
+    return frame.serialize();
+}
+
+// TCP payload sizes: bare ACK, typical request, full MSS
+#define PAYLOAD_SIZES ->Arg(0)->Arg(512)->Arg(1460)
+
+static void BM_Checksum(benchmark::State& state) {
+    auto data = make_payload(static_cast<size_t>(state.range(0)));
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(calculate_checksum(std::span<const uint8_t>(data)));
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Checksum)->Arg(20)->Arg(64)->Arg(576)->Arg(1500)->Arg(9000)->Arg(65536);
+
+static void BM_EthernetSerialize(benchmark::State& state) {
+    EthernetFrame frame;
+    frame.set_ethertype(EthernetFrame::ETHERTYPE_IPV4);
+    frame.set_payload(make_packet(static_cast<size_t>(state.range(0))).serialize());
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(frame.serialize());
+    }
+    set_packet_rate(state, 1);
+}
+BENCHMARK(BM_EthernetSerialize) PAYLOAD_SIZES;
+
+static void BM_EthernetDeserialize(benchmark::State& state) {
+    auto bytes = make_frame(static_cast<size_t>(state.range(0)));
+    EthernetFrame frame;
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(frame.deserialize(bytes));
+    }
+    set_packet_rate(state, 1);
+}
+BENCHMARK(BM_EthernetDeserialize) PAYLOAD_SIZES;
+
+static void BM_IPv4Serialize(benchmark::State& state) {
+    IPv4Packet packet = make_packet(static_cast<size_t>(state.range(0)));
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(packet.serialize());
+    }
+    set_packet_rate(state, 1);
+}
+BENCHMARK(BM_IPv4Serialize) PAYLOAD_SIZES;
+
+static void BM_IPv4Deserialize(benchmark::State& state) {
+    auto bytes = make_packet(static_cast<size_t>(state.range(0))).serialize();
+    IPv4Packet packet;
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(packet.deserialize(bytes));
+    }
+    set_packet_rate(state, 1);
+}
+BENCHMARK(BM_IPv4Deserialize) PAYLOAD_SIZES;
+
+// Includes the pseudo-header checksum over the payload
+static void BM_TCPSerialize(benchmark::State& state) {
+    TCPSegment segment = make_segment(static_cast<size_t>(state.range(0)));
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(segment.serialize(SOURCE_IP, DEST_IP));
+    }
+    set_packet_rate(state, 1);
+}
+BENCHMARK(BM_TCPSerialize) PAYLOAD_SIZES;
+
+static void BM_TCPDeserialize(benchmark::State& state) {
+    auto bytes = make_segment(static_cast<size_t>(state.range(0))).serialize(SOURCE_IP, DEST_IP);
+    TCPSegment segment;
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(segment.deserialize(bytes));
+    }
+    set_packet_rate(state, 1);
+}
+BENCHMARK(BM_TCPDeserialize) PAYLOAD_SIZES;
+
+// Whole frame through the copying API: serialize, set_payload, serialize...
+static void BM_BuildFrameCopying(benchmark::State& state) {
+    auto payload = make_payload(static_cast<size_t>(state.range(0)));
+    TCPSegment segment = make_segment(0);
+    IPv4Packet packet = make_packet(0);
+    EthernetFrame frame;
+    frame.set_ethertype(EthernetFrame::ETHERTYPE_IPV4);
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        segment.set_payload(payload);
+        packet.set_payload(segment.serialize(SOURCE_IP, DEST_IP));
+        frame.set_payload(packet.serialize());
+        benchmark::DoNotOptimize(frame.serialize());
+    }
+    set_packet_rate(state, 1);
+}
+BENCHMARK(BM_BuildFrameCopying) PAYLOAD_SIZES;
+
+// The same frame written once into a pooled buffer, headers prepended
+static void BM_BuildFrameInPlace(benchmark::State& state) {
+    auto payload = make_payload(static_cast<size_t>(state.range(0)));
+    TCPSegment segment = make_segment(0);
+    IPv4Packet packet = make_packet(0);
+    EthernetFrame frame;
+    frame.set_ethertype(EthernetFrame::ETHERTYPE_IPV4);
+    PacketPool pool;
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        PacketHandle buffer = pool.alloc();
+        uint32_t sum = checksum_partial_copy(buffer.append(payload.size()), payload);
+        segment.prepend_to(buffer, SOURCE_IP, DEST_IP, sum);
+        packet.prepend_to(buffer);
+        frame.prepend_to(buffer);
+        benchmark::DoNotOptimize(buffer.data());
+    }
+    set_packet_rate(state, 1);
+}
+BENCHMARK(BM_BuildFrameInPlace) PAYLOAD_SIZES;
+
+// A large send cut into 1460-byte segments, each serialized on its own
+static constexpr uint16_t SEND_MSS = 1460;
+
+static void set_send_rate(benchmark::State& state, size_t bytes) {
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+    set_packet_rate(state, (bytes + SEND_MSS - 1) / SEND_MSS);
+}
+
+static void BM_LargeSendCopying(benchmark::State& state) {
+    auto payload = make_payload(static_cast<size_t>(state.range(0)));
+    TCPSegment segment = make_segment(0);
+    IPv4Packet packet = make_packet(0);
+    EthernetFrame frame;
+    frame.set_ethertype(EthernetFrame::ETHERTYPE_IPV4);
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        for (size_t offset = 0; offset < payload.size(); offset += SEND_MSS) {
+            size_t length = std::min<size_t>(SEND_MSS, payload.size() - offset);
+            segment.set_sequence_number(1000 + static_cast<uint32_t>(offset));
+            segment.set_payload({payload.begin() + offset, payload.begin() + offset + length});
+            packet.set_payload(segment.serialize(SOURCE_IP, DEST_IP));
+            frame.set_payload(packet.serialize());
+            benchmark::DoNotOptimize(frame.serialize());
+        }
+    }
+    set_send_rate(state, payload.size());
+}
+BENCHMARK(BM_LargeSendCopying)->Arg(64 << 10)->Arg(1 << 20);
+
+// The same, each segment built in place with prepend_to(). Frames are
+// held until the send is done, as they would be until transmitted.
+static void BM_LargeSendInPlace(benchmark::State& state) {
+    auto payload = make_payload(static_cast<size_t>(state.range(0)));
+    TCPSegment segment = make_segment(0);
+    IPv4Packet packet = make_packet(0);
+    EthernetFrame frame;
+    frame.set_ethertype(EthernetFrame::ETHERTYPE_IPV4);
+    PacketPool pool;
+    std::vector<PacketHandle> frames;
+    frames.reserve(payload.size() / SEND_MSS + 1);
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        for (size_t offset = 0; offset < payload.size(); offset += SEND_MSS) {
+            size_t length = std::min<size_t>(SEND_MSS, payload.size() - offset);
+            PacketHandle& buffer = frames.emplace_back(pool.alloc());
+            uint32_t sum = checksum_partial_copy(buffer.append(length), {payload.data() + offset, length});
+            segment.set_sequence_number(1000 + static_cast<uint32_t>(offset));
+            segment.prepend_to(buffer, SOURCE_IP, DEST_IP, sum);
+            packet.prepend_to(buffer);
+            frame.prepend_to(buffer);
+        }
+        benchmark::DoNotOptimize(frames.data());
+        frames.clear();
+    }
+    set_send_rate(state, payload.size());
+}
+BENCHMARK(BM_LargeSendInPlace)->Arg(64 << 10)->Arg(1 << 20);
+
+// The same through TCPSegmenter: headers summed once, fields patched per frame
+static void BM_LargeSendSegmenter(benchmark::State& state) {
+    auto payload = make_payload(static_cast<size_t>(state.range(0)));
+    TCPSegment segment = make_segment(0);
+    IPv4Packet packet = make_packet(0);
+    EthernetFrame frame;
+    frame.set_ethertype(EthernetFrame::ETHERTYPE_IPV4);
+    PacketPool pool;
+    std::vector<PacketHandle> frames;
+    frames.reserve(payload.size() / SEND_MSS + 1);
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        TCPSegmenter segmenter(frame, packet, segment, SEND_MSS);
+        benchmark::DoNotOptimize(segmenter.segment(payload, pool, frames));
+        frames.clear();
+    }
+    set_send_rate(state, payload.size());
+}
+BENCHMARK(BM_LargeSendSegmenter)->Arg(64 << 10)->Arg(1 << 20);
+
+// A passive open and close: six table transitions per iteration
+static void BM_StateMachineLifecycle(benchmark::State& state) {
+    const std::vector<TCPEvent> sequence = {
+        TCPEvent::OPEN_PASSIVE, TCPEvent::RECV_SYN, TCPEvent::RECV_ACK,
+        TCPEvent::RECV_FIN, TCPEvent::SEND_FIN, TCPEvent::RECV_ACK};
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        TCPStateMachine machine;
+        for (TCPEvent event : sequence) {
+            benchmark::DoNotOptimize(machine.apply(event));
+        }
+        benchmark::DoNotOptimize(machine);
+    }
+    state.counters["transitions/s"] = benchmark::Counter(
+        static_cast<double>(state.iterations() * sequence.size()), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_StateMachineLifecycle);
+
+// A 64-segment flight of full-MSS data into one receive buffer, read out
+// after each flight. The argument is the percentage of segments delayed
+// behind the one after them, which puts them in the out-of-order ranges.
+static void BM_ReceiveReordered(benchmark::State& state) {
+    constexpr size_t SEGMENTS = 64;
+    constexpr size_t MSS = 1460;
+    auto payload = make_payload(MSS);
+    std::vector<size_t> order(SEGMENTS);
+    std::iota(order.begin(), order.end(), 0);
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> percent(0, 99);
+    for (size_t i = 0; i + 1 < SEGMENTS; ++i) {
+        if (percent(rng) < state.range(0)) {
+            std::swap(order[i], order[i + 1]);
+            ++i;
+        }
+    }
+
+    TCPReceiveBuffer buffer;
+    uint32_t sequence = 0xFFF00000;  // crosses the sequence wrap within the run
+    buffer.open(sequence, SEGMENTS * MSS);
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        for (size_t segment : order) {
+            benchmark::DoNotOptimize(buffer.receive(sequence + static_cast<uint32_t>(segment * MSS), payload));
+        }
+        sequence += SEGMENTS * MSS;
+        benchmark::DoNotOptimize(buffer.peek().data());
+        buffer.consume(buffer.get_readable());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * SEGMENTS * MSS));
+    set_packet_rate(state, SEGMENTS);
+}
+BENCHMARK(BM_ReceiveReordered)->Arg(0)->Arg(1)->Arg(10)->Arg(50);
+
+// Re-arming one of N armed timers 200 ms out, as each ACK does to the RTO
+// timer, with the clock ticking forward 1 ms per 1000 re-arms
+static void BM_TimerRearm(benchmark::State& state) {
+    size_t count = static_cast<size_t>(state.range(0));
+    auto timers = std::make_unique<Timer[]>(count);
+    TimerWheel wheel;
+    for (size_t i = 0; i < count; ++i) {
+        wheel.arm(timers[i], 200'000'000 + i % 1000 * 1'000'000);
+    }
+    uint64_t now = 0;
+    size_t next = 0;
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        wheel.arm(timers[next], now + 200'000'000);
+        if (++next == count) {
+            next = 0;
+        }
+        if (next % 1000 == 0) {
+            now += 1'000'000;
+            wheel.advance(now, [](Timer&) {});
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_TimerRearm)->Arg(1 << 10)->Arg(1 << 20);
+
+// Zero-copy parse of every layer as the stack's RX path does it, with the
+// IPv4 header checksum and, for the second argument, the TCP checksum
+static void BM_ParseFrame(benchmark::State& state) {
+    auto bytes = make_frame(static_cast<size_t>(state.range(0)));
+    bool verify_tcp = state.range(1) != 0;
+    std::span<const uint8_t> frame(bytes);
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        EthernetView eth;
+        IPv4View ip;
+        TCPView tcp;
+        bool valid = eth.parse(frame) && ip.parse(eth.get_payload()) && ip.has_valid_checksum() &&
+                     tcp.parse(ip.get_payload()) &&
+                     (!verify_tcp || tcp.has_valid_checksum(ip.get_source_address(), ip.get_destination_address()));
+        benchmark::DoNotOptimize(valid);
+    }
+    set_packet_rate(state, 1);
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(bytes.size()));
+}
+BENCHMARK(BM_ParseFrame)->ArgsProduct({{0, 512, 1460}, {0, 1}});
+
+static void put32(std::vector<uint8_t>& out, uint32_t value) {
+    out.insert(out.end(), {static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8),
+                           static_cast<uint8_t>(value >> 16), static_cast<uint8_t>(value >> 24)});
+}
+
+// Classic little-endian pcap of the frames
+static std::string write_capture(const std::vector<std::vector<uint8_t>>& frames) {
+    std::vector<uint8_t> file;
+    put32(file, 0xA1B2C3D4);
+    put32(file, 0x00040002);
+    put32(file, 0);
+    put32(file, 0);
+    put32(file, 65535);
+    put32(file, 1);
+    for (size_t i = 0; i < frames.size(); ++i) {
+        put32(file, 0);
+        put32(file, static_cast<uint32_t>(i));
+        put32(file, static_cast<uint32_t>(frames[i].size()));
+        put32(file, static_cast<uint32_t>(frames[i].size()));
+        file.insert(file.end(), frames[i].begin(), frames[i].end());
+    }
+
+    std::string path = (std::filesystem::temp_directory_path() / "codec_bench.pcap").string();
+    FILE* out = std::fopen(path.c_str(), "wb");
+    std::fwrite(file.data(), 1, file.size(), out);
+    std::fclose(out);
+    return path;
+}
+
+// Whole RX path from a memory-mapped capture: steering, parsing and
+// connection demultiplexing, on the calling thread
+static void BM_StackReplay(benchmark::State& state) {
+    constexpr size_t PACKETS = 4096;
+    std::string path = write_capture(std::vector<std::vector<uint8_t>>(PACKETS, make_frame(static_cast<size_t>(state.range(0)))));
+    TCPIPStack stack("replay");
+    stack.listen(80);
+    ReplayReport report;
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        stack.replay(path, ReplayConfig(), report);
+    }
+    set_packet_rate(state, PACKETS);
+    std::remove(path.c_str());
+}
+BENCHMARK(BM_StackReplay) PAYLOAD_SIZES ->Unit(benchmark::kMicrosecond);
+
+// One frame of a bulk transfer from client port 40000 + flow
+static std::vector<uint8_t> make_stream_frame(uint16_t flow, uint32_t sequence, uint8_t flags, size_t payload_size) {
+    TCPSegment segment = make_segment(payload_size);
+    segment.set_source_port(static_cast<uint16_t>(40000 + flow));
+    segment.set_sequence_number(sequence);
+    segment.set_flags(flags);
+
+    IPv4Packet packet = make_packet(0);
+    packet.set_payload(segment.serialize(SOURCE_IP, DEST_IP));
+    EthernetFrame frame;
+    frame.set_ethertype(EthernetFrame::ETHERTYPE_IPV4);
+    frame.set_payload(packet.serialize());
+    return frame.serialize();
+}
+
+// Bulk transfers of MSS-sized segments, the flows interleaved
+// round-robin, with GRO off and on. Each TCP input is where a receiver
+// would send an ACK, so inputs/op is the ACKs GRO saves.
+static void BM_StackReplayGro(benchmark::State& state) {
+    constexpr size_t SEGMENTS = 4096;
+    uint16_t flows = static_cast<uint16_t>(state.range(0));
+    std::vector<std::vector<uint8_t>> frames;
+    for (uint16_t flow = 0; flow < flows; ++flow) {
+        frames.push_back(make_stream_frame(flow, 999, TCPSegment::SYN, 0));
+    }
+    for (size_t i = 0; i < SEGMENTS; ++i) {
+        uint32_t sequence = 1000 + static_cast<uint32_t>(i / flows * SEND_MSS);
+        frames.push_back(make_stream_frame(static_cast<uint16_t>(i % flows), sequence, TCPSegment::ACK, SEND_MSS));
+    }
+    std::string path = write_capture(frames);
+
+    StackConfig config;
+    config.gro.enabled = state.range(1) != 0;
+    uint64_t inputs = 0;
+    for (auto _ : state) {
+        // A fresh stack, so every iteration receives new data
+        state.PauseTiming();
+        auto stack = std::make_unique<TCPIPStack>("replay", config);
+        stack->listen(80);
+        ReplayReport report;
+        state.ResumeTiming();
+        stack->replay(path, ReplayConfig(), report);
+        inputs += report.metrics.get(Metric::TCP_SEGMENTS) - report.metrics.get(Metric::TCP_GRO_MERGED);
+    }
+    set_packet_rate(state, frames.size());
+    state.counters["inputs/op"] = benchmark::Counter(static_cast<double>(inputs), benchmark::Counter::kAvgIterations);
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(SEGMENTS * SEND_MSS));
+    std::remove(path.c_str());
+}
+BENCHMARK(BM_StackReplayGro)->ArgsProduct({{1, 4, 16}, {0, 1}})->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
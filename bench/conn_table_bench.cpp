@@ -0,0 +1,94 @@
+// Connection table lookup throughput at increasing flow counts.
+// Usage: conn_table_bench [max flows] (default 10000000)
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "tcp/connection_table.h"
+#include "tcp/tcp_connection.h"
+
+using Clock = std::chrono::steady_clock;
+
+// Keeps lookup results observable so the loops are not optimized away
+static volatile uint64_t sink;
+
+static std::vector<FlowKey> make_keys(size_t count, uint32_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<FlowKey> keys(count);
+    for (auto& key : keys) {
+        uint64_t bits = rng();
+        key.local_address = 0x0A000001;
+        key.remote_address = static_cast<uint32_t>(bits);
+        key.local_port = 443;
+        key.remote_port = static_cast<uint16_t>(bits >> 32);
+    }
+    return keys;
+}
+
+template <typename Fn>
+static double rate(size_t operations, Fn&& fn) {
+    Clock::time_point start = Clock::now();
+    fn();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return operations / seconds;
+}
+
+static void run(size_t flows) {
+    constexpr size_t LOOKUPS = 5000000;
+    constexpr size_t SAME_FLOW_RUN = 8;
+    
+    std::vector<FlowKey> keys = make_keys(flows, 1);
+    std::vector<FlowKey> misses = make_keys(LOOKUPS, 2);
+    std::vector<FlowKey> order(LOOKUPS);
+    std::mt19937_64 rng(3);
+    for (auto& key : order) {
+        key = keys[rng() % flows];
+    }
+    
+    ConnectionTable<TCPConnection> table;
+    double inserts = rate(flows, [&] {
+        for (const auto& key : keys) {
+            table.emplace(key);
+        }
+    });
+    table.finish_resize();
+    
+    uint64_t found = 0;
+    double hits = rate(LOOKUPS, [&] {
+        for (const auto& key : order) {
+            found += table.find(key) != nullptr;
+        }
+    });
+    double miss_rate = rate(LOOKUPS, [&] {
+        for (const auto& key : misses) {
+            found += table.find(key) != nullptr;
+        }
+    });
+    // Back-to-back segments of one flow, as in a burst
+    double same_flow = rate(LOOKUPS, [&] {
+        for (size_t i = 0; i < LOOKUPS; ++i) {
+            found += table.find(order[i / SAME_FLOW_RUN]) != nullptr;
+        }
+    });
+    
+    sink = found;
+    
+    ConnectionTableStats stats = table.get_stats();
+    std::printf("%10zu %12.0f %14.0f %14.0f %14.0f %10.1f\n", flows, inserts, hits, miss_rate, same_flow,
+                stats.memory_bytes / (1024.0 * 1024.0));
+}
+
+int main(int argc, char* argv[]) {
+    size_t max_flows = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+    
+    std::printf("%10s %12s %14s %14s %14s %10s\n",
+                "flows", "inserts/s", "hit lookups/s", "miss lookups/s", "same-flow/s", "MiB");
+    for (size_t flows : {size_t(10000), size_t(1000000), size_t(10000000)}) {
+        if (flows <= max_flows) {
+            run(flows);
+        }
+    }
+    return 0;
+}
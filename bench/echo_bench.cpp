@@ -0,0 +1,291 @@
+// Echo over the stack's loopback, one thread: clients send a message and
+// wait for it to come back, round after round. The same protocol runs once
+// as coroutines on EventLoop and once written directly against
+// wait_events(), so the difference per resume is what the coroutine layer
+// costs. Before that, the bare cost of suspending and resuming a Task and
+// of starting one from the frame pool.
+// Each figure is the fastest of three runs.
+// Usage: echo_bench [round trips per run] (default 200000)
+#include <algorithm>
+#include <chrono>
+#include <coroutine>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "coro/event_loop.h"
+#include "coro/task.h"
+#include "stack.h"
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr uint32_t HOST = 0x0A000001;
+static constexpr uint16_t PORT = 7;
+
+static double elapsed_ns(Clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+static StackConfig bench_config() {
+    StackConfig config;
+    config.address = HOST;
+    config.pool.buffer_count = 16384;
+    return config;
+}
+
+// Parks the coroutine where the driver can resume it
+struct Park {
+    std::coroutine_handle<>& slot;
+    bool await_ready() const { return false; }
+    void await_suspend(std::coroutine_handle<> handle) { slot = handle; }
+    void await_resume() const {}
+};
+
+static Task park_forever(std::coroutine_handle<>& slot, size_t& count) {
+    while (true) {
+        co_await Park{slot};
+        count++;
+    }
+}
+
+static void bench_suspend_resume() {
+    constexpr size_t ROUNDS = 10'000'000;
+    std::coroutine_handle<> slot;
+    size_t count = 0;
+    park_forever(slot, count);
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < ROUNDS; ++i) {
+        slot.resume();
+    }
+    double ns = elapsed_ns(start);
+    slot.destroy();
+    std::printf("suspend + resume:        %6.1f ns\n", ns / static_cast<double>(count));
+}
+
+static Task short_lived(size_t& count) {
+    count++;
+    co_return;
+}
+
+static void bench_spawn() {
+    constexpr size_t TASKS = 10'000'000;
+    size_t count = 0;
+    FramePoolStats before = FramePool::get_stats();
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < TASKS; ++i) {
+        short_lived(count);
+    }
+    double ns = elapsed_ns(start);
+    FramePoolStats after = FramePool::get_stats();
+    std::printf("start + finish a Task:   %6.1f ns (%.4f%% of frames from the heap)\n", ns / static_cast<double>(count),
+                100.0 * static_cast<double>((after.allocations - after.reused) - (before.allocations - before.reused)) /
+                    static_cast<double>(after.allocations - before.allocations));
+}
+
+struct EchoResult {
+    double seconds = 0;
+    uint64_t round_trips = 0;
+    uint64_t resumes = 0;
+};
+
+// Coroutines
+
+static Task coro_echo(AsyncConnection connection, size_t message) {
+    std::vector<uint8_t> buffer(message);
+    while (true) {
+        IoResult read = co_await connection.read(buffer);
+        if (read.bytes == 0) {
+            co_return;
+        }
+        std::span<const uint8_t> pending(buffer.data(), read.bytes);
+        while (!pending.empty()) {
+            IoResult written = co_await connection.write(pending);
+            if (written.error != SocketError::NONE) {
+                co_return;
+            }
+            pending = pending.subspan(written.bytes);
+        }
+    }
+}
+
+static Task coro_serve(AsyncListener& listener, size_t message) {
+    while (true) {
+        AsyncConnection connection = co_await listener.accept();
+        if (!connection.is_open()) {
+            co_return;
+        }
+        coro_echo(std::move(connection), message);
+    }
+}
+
+static Task coro_client(EventLoop& loop, size_t message, size_t rounds, uint64_t& round_trips, size_t& done) {
+    AsyncConnection connection = co_await loop.connect(HOST, PORT);
+    std::vector<uint8_t> out(message, 0x5A);
+    std::vector<uint8_t> in(message);
+    for (size_t round = 0; round < rounds && connection.is_open(); ++round) {
+        std::span<const uint8_t> pending(out);
+        while (!pending.empty()) {
+            IoResult written = co_await connection.write(pending);
+            if (written.error != SocketError::NONE) {
+                connection.close();
+                break;
+            }
+            pending = pending.subspan(written.bytes);
+        }
+        size_t received = 0;
+        while (connection.is_open() && received < message) {
+            IoResult read = co_await connection.read(std::span<uint8_t>(in).subspan(received));
+            if (read.bytes == 0) {
+                connection.close();
+                break;
+            }
+            received += read.bytes;
+        }
+        round_trips += received == message ? 1 : 0;
+    }
+    done++;
+}
+
+static EchoResult run_coroutines(size_t connections, size_t message, size_t rounds) {
+    TCPIPStack stack("echo", bench_config());
+    EventLoop loop(stack);
+    AsyncListener listener = loop.listen(PORT, connections);
+    coro_serve(listener, message);
+
+    EchoResult result;
+    size_t done = 0;
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < connections; ++i) {
+        coro_client(loop, message, rounds, result.round_trips, done);
+    }
+    while (done < connections) {
+        loop.run_once();
+    }
+    result.seconds = elapsed_ns(start) / 1e9;
+    result.resumes = loop.get_stats().resumed;
+    return result;
+}
+
+// The same against wait_events(), no coroutines
+
+struct RawConnection {
+    SocketId socket = 0;
+    bool client = false;
+    bool started = false;
+    size_t received = 0;
+    size_t rounds = 0;
+};
+
+static EchoResult run_raw(size_t connections, size_t message, size_t rounds) {
+    TCPIPStack stack("echo", bench_config());
+    SocketId listener = stack.listen_socket(PORT, connections);
+    constexpr uint64_t LISTENER = UINT64_MAX;
+    stack.watch(listener, SocketEvent::READABLE, LISTENER);
+
+    EchoResult result;
+    std::vector<RawConnection> sockets;
+    sockets.reserve(2 * connections);
+    std::vector<uint8_t> out(message, 0x5A);
+    std::vector<uint8_t> buffer(message);
+    std::vector<SocketEvent> events(EventLoop::EVENT_BATCH);
+    size_t done = 0;
+
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < connections; ++i) {
+        RawConnection connection;
+        connection.socket = stack.connect(HOST, PORT);
+        connection.client = true;
+        stack.watch(connection.socket, SocketEvent::WRITABLE | SocketEvent::READABLE, sockets.size());
+        sockets.push_back(connection);
+    }
+    while (done < connections) {
+        stack.poll();
+        size_t count = stack.wait_events(events);
+        for (size_t i = 0; i < count; ++i) {
+            if (events[i].data == LISTENER) {
+                SocketId accepted;
+                while ((accepted = stack.accept(listener)) != 0) {
+                    stack.watch(accepted, SocketEvent::READABLE, sockets.size());
+                    sockets.push_back(RawConnection{accepted});
+                }
+                continue;
+            }
+            RawConnection& connection = sockets[events[i].data];
+            if (connection.client && !connection.started && (events[i].events & SocketEvent::WRITABLE)) {
+                connection.started = true;
+                stack.send(connection.socket, out);
+                stack.watch(connection.socket, SocketEvent::READABLE, events[i].data);
+                continue;
+            }
+            IoResult read = stack.recv(connection.socket, buffer);
+            if (read.error == SocketError::WOULD_BLOCK) {
+                continue;
+            }
+            if (read.bytes == 0) {
+                stack.close(connection.socket);
+                continue;
+            }
+            if (!connection.client) {
+                stack.send(connection.socket, std::span<const uint8_t>(buffer.data(), read.bytes));
+                continue;
+            }
+            connection.received += read.bytes;
+            if (connection.received == message) {
+                connection.received = 0;
+                result.round_trips++;
+                if (++connection.rounds == rounds) {
+                    stack.close(connection.socket);
+                    done++;
+                } else {
+                    stack.send(connection.socket, out);
+                }
+            }
+        }
+    }
+    result.seconds = elapsed_ns(start) / 1e9;
+    return result;
+}
+
+// Fastest of a few runs, the others being mostly scheduler noise
+template <typename Run>
+static EchoResult best_of(Run run, size_t connections, size_t message, size_t rounds) {
+    constexpr int REPEATS = 3;
+    EchoResult best;
+    for (int i = 0; i < REPEATS; ++i) {
+        EchoResult result = run(connections, message, rounds);
+        if (i == 0 || result.seconds < best.seconds) {
+            best = result;
+        }
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    size_t total = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200'000;
+
+    bench_suspend_resume();
+    bench_spawn();
+    std::printf("\n%-6s %6s %11s %13s %9s %14s\n", "conns", "bytes", "mode", "round trips/s", "us each",
+                "ns per resume");
+    for (size_t connections : {1, 16, 256}) {
+        for (size_t message : {64, 1024}) {
+            size_t rounds = std::max<size_t>(1, total / connections);
+            EchoResult raw = best_of(run_raw, connections, message, rounds);
+            EchoResult coro = best_of(run_coroutines, connections, message, rounds);
+            for (const EchoResult* result : {&raw, &coro}) {
+                double per_second = static_cast<double>(result->round_trips) / result->seconds;
+                std::printf("%-6zu %6zu %11s %13.0f %9.2f", connections, message,
+                            result == &raw ? "wait_events" : "coroutines", per_second,
+                            1e6 * result->seconds * static_cast<double>(connections) /
+                                static_cast<double>(result->round_trips));
+                if (result == &coro && coro.resumes > 0) {
+                    // What the coroutine layer added, spread over its resumes
+                    double extra_ns = (coro.seconds - raw.seconds * static_cast<double>(coro.round_trips) /
+                                                          static_cast<double>(raw.round_trips)) * 1e9;
+                    std::printf(" %14.0f", extra_ns / static_cast<double>(coro.resumes));
+                }
+                std::printf("\n");
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,97 @@
+// Bulk transfer goodput over a simulated lossy link, per congestion control
+// algorithm, loss rate and SACK on or off, then with and without window
+// scaling on a long fat link. Time is simulated, so results are exact and
+// repeatable; the wall time column is what the simulation itself cost.
+// Usage: goodput_bench [megabytes] (default 16)
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "tcp/transfer_simulator.h"
+
+using Clock = std::chrono::steady_clock;
+
+static void print_heading(const char* varied) {
+    std::printf("%-8s %-5s %6s %10s %9s %8s %6s %8s %9s\n", "cc", "sack", varied, "Mbit/s", "retrans",
+                "fast", "rto", "cwnd", "wall ms");
+}
+
+static void run(const TransferConfig& config, const char* label) {
+    Clock::time_point start = Clock::now();
+    TransferResult result = simulate_transfer(config);
+    double wall_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    const char* name = config.sender.congestion == CongestionAlgorithm::CUBIC ? "cubic" : "newreno";
+    const char* sack = config.sender.sack ? "on" : "off";
+    if (!result.completed || !result.intact) {
+        std::printf("%-8s %-5s %6s %s\n", name, sack, label, result.completed ? "corrupted" : "did not complete");
+        return;
+    }
+    std::printf("%-8s %-5s %6s %10.2f %9llu %8llu %6llu %8u %9.1f\n", name, sack, label,
+                result.goodput_bps / 1e6,
+                static_cast<unsigned long long>(result.sender.retransmits),
+                static_cast<unsigned long long>(result.sender.fast_retransmits),
+                static_cast<unsigned long long>(result.sender.timeouts),
+                result.final_cwnd, wall_ms);
+}
+
+int main(int argc, char* argv[]) {
+    size_t megabytes = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 16;
+
+    TransferConfig base;
+    base.bytes = megabytes << 20;
+    base.forward.rate_bps = 20'000'000;
+    base.forward.delay_ns = 10'000'000;
+    base.reverse = base.forward;
+    base.reverse.seed = 2;
+    std::printf("%zu MB over %.0f Mbit/s, %.0f ms RTT, %zu KB queue; loss on data and ACKs\n",
+                megabytes, base.forward.rate_bps / 1e6, 2 * base.forward.delay_ns / 1e6,
+                base.forward.queue_bytes / 1024);
+    print_heading("loss");
+
+    for (CongestionAlgorithm algorithm : {CongestionAlgorithm::NEW_RENO, CongestionAlgorithm::CUBIC}) {
+        for (bool sack : {false, true}) {
+            for (double loss : {0.0, 0.005, 0.01, 0.02, 0.03, 0.05}) {
+                TransferConfig config = base;
+                config.sender.congestion = algorithm;
+                config.sender.sack = sack;
+                config.sender.timestamps = sack;
+                config.forward.loss = loss;
+                config.reverse.loss = loss;
+
+                char label[16];
+                std::snprintf(label, sizeof(label), "%.1f%%", loss * 100);
+                run(config, label);
+            }
+        }
+    }
+
+    // 100 Mbit/s and 80 ms RTT need about 1 MB in flight; an unscaled
+    // 16-bit window allows 64 KB of it. With the window scaled, slow start
+    // overshoots the queue and loses a burst, which only SACK recovers
+    // from in reasonable time.
+    TransferConfig fat = base;
+    fat.sender.congestion = CongestionAlgorithm::CUBIC;
+    fat.sender.send_buffer_size = 4 << 20;
+    fat.forward.rate_bps = 100'000'000;
+    fat.forward.delay_ns = 40'000'000;
+    fat.forward.queue_bytes = 1 << 20;
+    fat.reverse = fat.forward;
+    fat.reverse.seed = 2;
+    std::printf("\n%zu MB over %.0f Mbit/s, %.0f ms RTT, %zu KB queue, no loss\n", megabytes,
+                fat.forward.rate_bps / 1e6, 2 * fat.forward.delay_ns / 1e6, fat.forward.queue_bytes / 1024);
+    print_heading("window");
+    for (uint8_t scale : {0, 5}) {
+        for (bool sack : {false, true}) {
+            TransferConfig config = fat;
+            config.window_scale = scale;
+            config.receive_window = scale == 0 ? 65535 : 2 << 20;
+            config.sender.sack = sack;
+            config.sender.timestamps = sack;
+
+            char label[16];
+            std::snprintf(label, sizeof(label), "%zuK", config.receive_window / 1024);
+            run(config, label);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,119 @@
+// Throughput and latency of the packet rings under contention.
+// Usage: ring_bench [items per run]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include "core/ring.h"
+#include "core/backoff.h"
+
+using Clock = std::chrono::steady_clock;
+
+static uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+struct RunResult {
+    double ops_per_second = 0;
+    uint64_t p50_ns = 0;
+    uint64_t p99_ns = 0;
+    uint64_t p999_ns = 0;
+    uint64_t full = 0;
+};
+
+// Each item carries its enqueue time; the consumer records how long it sat
+// in the ring. Producers retry refused items, so full counts backpressure.
+template <typename Ring>
+static RunResult run(Ring& ring, size_t producers, size_t burst, uint64_t items) {
+    uint64_t per_producer = items / producers;
+    uint64_t total = per_producer * producers;
+    std::vector<uint64_t> latencies;
+    latencies.reserve(total);
+    
+    Clock::time_point start = Clock::now();
+    std::vector<std::thread> threads;
+    for (size_t p = 0; p < producers; ++p) {
+        threads.emplace_back([&ring, burst, per_producer] {
+            std::vector<uint64_t> stamps(burst);
+            Backoff backoff;
+            uint64_t sent = 0;
+            while (sent < per_producer) {
+                size_t n = std::min<uint64_t>(burst, per_producer - sent);
+                uint64_t stamp = now_ns();
+                std::fill(stamps.begin(), stamps.begin() + n, stamp);
+                size_t done = 0;
+                while (done < n) {
+                    size_t accepted = ring.enqueue_burst(stamps.data() + done, n - done);
+                    done += accepted;
+                    if (accepted == 0) {
+                        backoff.idle();
+                    } else {
+                        backoff.reset();
+                    }
+                }
+                sent += n;
+            }
+        });
+    }
+    
+    std::vector<uint64_t> out(std::max<size_t>(burst, 32));
+    Backoff backoff;
+    while (latencies.size() < total) {
+        size_t n = ring.dequeue_burst(out.data(), out.size());
+        if (n == 0) {
+            backoff.idle();
+            continue;
+        }
+        backoff.reset();
+        uint64_t now = now_ns();
+        for (size_t i = 0; i < n; ++i) {
+            latencies.push_back(now - out[i]);
+        }
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    std::sort(latencies.begin(), latencies.end());
+    RunResult result;
+    result.ops_per_second = total / seconds;
+    result.p50_ns = latencies[total / 2];
+    result.p99_ns = latencies[total * 99 / 100];
+    result.p999_ns = latencies[total * 999 / 1000];
+    result.full = ring.get_stats().full;
+    return result;
+}
+
+static void print(const char* ring, size_t producers, size_t burst, const RunResult& result) {
+    std::printf("%-5s %9zu %6zu %14.0f %10llu %10llu %10llu %12llu\n", ring, producers, burst,
+                result.ops_per_second,
+                static_cast<unsigned long long>(result.p50_ns),
+                static_cast<unsigned long long>(result.p99_ns),
+                static_cast<unsigned long long>(result.p999_ns),
+                static_cast<unsigned long long>(result.full));
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t items = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 5000000;
+    constexpr size_t RING_SIZE = 1024;
+    
+    std::printf("%u hardware threads, %llu items per run, ring size %zu\n",
+                std::thread::hardware_concurrency(), static_cast<unsigned long long>(items), RING_SIZE);
+    std::printf("%-5s %9s %6s %14s %10s %10s %10s %12s\n",
+                "ring", "producers", "burst", "ops/s", "p50 ns", "p99 ns", "p99.9 ns", "full");
+    
+    for (size_t burst : {1, 8, 32}) {
+        SpscRing<uint64_t> ring(RING_SIZE);
+        print("spsc", 1, burst, run(ring, 1, burst, items));
+    }
+    for (size_t producers : {1, 2, 4}) {
+        for (size_t burst : {1, 32}) {
+            MpscRing<uint64_t> ring(RING_SIZE);
+            print("mpsc", producers, burst, run(ring, producers, burst, items));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,214 @@
+// Two stacks joined by a VirtualWire in one thread. With nothing on the
+// wire but a copy, handshakes per second, bulk throughput and ping-pong
+// latency are what the stacks themselves cost. Then bulk transfers over
+// shaped links on a simulated clock: goodput is in simulated time, exact
+// and repeatable, and the wall time column is what the run cost.
+// Usage: wire_bench [megabytes] (default 64)
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "link/virtual_wire.h"
+#include "stack.h"
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr uint32_t CLIENT = 0x0A000001;
+static constexpr uint32_t SERVER = 0x0A000002;
+static constexpr uint16_t PORT = 5001;
+static constexpr uint64_t SIMULATED_STEP_NS = 10'000;
+
+static uint64_t simulated_ns = 0;
+static uint64_t simulated_clock() { return simulated_ns; }
+
+static double elapsed_seconds(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Bulk transfers get megabyte buffers; thousands of handshakes get small
+// ones, or they would need gigabytes
+static StackConfig host(uint32_t address, uint8_t id, uint8_t peer, uint64_t (*clock)(), bool bulk) {
+    StackConfig config;
+    config.clock = clock;
+    config.address = address;
+    config.mac = {0x02, 0, 0, 0, 0, id};
+    config.gateway_mac = {0x02, 0, 0, 0, 0, peer};
+    config.iss_secret = 0x5EED;
+    config.pool.buffer_count = 16384;
+    config.receive_buffer_size = bulk ? 1 << 20 : 4096;
+    config.sender.send_buffer_size = bulk ? 1 << 20 : 4096;
+    return config;
+}
+
+struct Pair {
+    VirtualWire wire;
+    TCPIPStack client;
+    TCPIPStack server;
+    bool simulated;
+
+    Pair(const VirtualWireConfig& config, bool simulated, bool bulk = true)
+        : wire(config), client(wire.get_a(), host(CLIENT, 1, 2, config.clock, bulk)),
+          server(wire.get_b(), host(SERVER, 2, 1, config.clock, bulk)), simulated(simulated) {}
+
+    void turn() {
+        if (simulated) {
+            simulated_ns += SIMULATED_STEP_NS;
+        }
+        client.poll();
+        server.poll();
+    }
+};
+
+// Keeps a fixed number of handshakes in flight, as a load generator would;
+// opening them all at once only measures SYNs dropped and resent
+static void bench_handshakes() {
+    constexpr size_t CONNECTIONS = 10'000;
+    constexpr size_t IN_FLIGHT = 16;
+    Pair pair(VirtualWireConfig(), false, false);
+    SocketId listener = pair.server.listen_socket(PORT, CONNECTIONS);
+    size_t connected = 0;
+    size_t accepted = 0;
+
+    Clock::time_point start = Clock::now();
+    while (accepted < CONNECTIONS) {
+        while (connected < CONNECTIONS && connected - accepted < IN_FLIGHT) {
+            pair.client.connect(SERVER, PORT);
+            connected++;
+        }
+        pair.turn();
+        while (pair.server.accept(listener) != 0) {
+            accepted++;
+        }
+    }
+    double seconds = elapsed_seconds(start);
+    std::printf("handshakes:  %10.0f per second (%zu connections)\n", CONNECTIONS / seconds, CONNECTIONS);
+}
+
+// Sends bytes from client to server; returns the seconds it took, on
+// whichever clock the pair runs
+static double bulk(Pair& pair, size_t bytes, bool& intact) {
+    SocketId listener = pair.server.listen_socket(PORT);
+    SocketId client = pair.client.connect(SERVER, PORT);
+    SocketId server = 0;
+    std::vector<uint8_t> chunk(64 * 1024, 0x5A);
+    std::vector<uint8_t> buffer(64 * 1024);
+    size_t sent = 0;
+    size_t received = 0;
+    uint64_t simulated_start = simulated_ns;
+    Clock::time_point start = Clock::now();
+
+    while (received < bytes) {
+        pair.turn();
+        if (server == 0) {
+            server = pair.server.accept(listener);
+        }
+        while (sent < bytes) {
+            IoResult written = pair.client.send(client, std::span<const uint8_t>(chunk).subspan(
+                0, std::min(chunk.size(), bytes - sent)));
+            if (written.bytes == 0) {
+                break;
+            }
+            sent += written.bytes;
+        }
+        IoResult read;
+        while (server != 0 && (read = pair.server.recv(server, buffer)).bytes > 0) {
+            received += read.bytes;
+        }
+        if (pair.client.get_error(client) != SocketError::NONE) {
+            break;
+        }
+    }
+    intact = received == bytes;
+    pair.client.close(client);
+    pair.server.close(server);
+    pair.server.close(listener);
+    return pair.simulated ? static_cast<double>(simulated_ns - simulated_start) / 1e9 : elapsed_seconds(start);
+}
+
+static void bench_throughput(size_t megabytes) {
+    Pair pair(VirtualWireConfig(), false);
+    bool intact = false;
+    double seconds = bulk(pair, megabytes << 20, intact);
+    std::printf("throughput:  %10.2f Gbit/s (%zu MiB)%s\n", static_cast<double>(megabytes << 20) * 8 / seconds / 1e9,
+                megabytes, intact ? "" : " did not complete");
+}
+
+static void bench_latency() {
+    constexpr size_t ROUNDS = 100'000;
+    Pair pair(VirtualWireConfig(), false);
+    SocketId listener = pair.server.listen_socket(PORT);
+    SocketId client = pair.client.connect(SERVER, PORT);
+    SocketId server = 0;
+    while (server == 0 || !(pair.client.get_events(client) & SocketEvent::WRITABLE)) {
+        pair.turn();
+        if (server == 0) {
+            server = pair.server.accept(listener);
+        }
+    }
+
+    std::vector<uint8_t> message(64, 0x5A);
+    std::vector<uint8_t> buffer(64);
+    Clock::time_point start = Clock::now();
+    for (size_t round = 0; round < ROUNDS; ++round) {
+        pair.client.send(client, message);
+        size_t echoed = 0;
+        while (echoed < message.size()) {
+            pair.turn();
+            IoResult read = pair.server.recv(server, buffer);
+            if (read.bytes > 0) {
+                pair.server.send(server, std::span<const uint8_t>(buffer.data(), read.bytes));
+            }
+            read = pair.client.recv(client, buffer);
+            echoed += read.bytes;
+        }
+    }
+    double seconds = elapsed_seconds(start);
+    std::printf("latency:     %10.2f us per 64 byte round trip\n", seconds * 1e6 / ROUNDS);
+}
+
+static void bench_link(const char* label, uint64_t rate_bps, uint64_t latency_ns, double loss, double reorder,
+                       size_t megabytes) {
+    VirtualWireConfig config;
+    config.clock = simulated_clock;
+    for (WireLinkConfig* link : {&config.a_to_b, &config.b_to_a}) {
+        link->rate_bps = rate_bps;
+        link->latency_ns = latency_ns;
+        // A bandwidth-delay product of queue; the 1 MiB windows cap long links
+        link->queue_bytes = std::max<size_t>(64 * 1024, rate_bps / 8 * latency_ns * 2 / 1'000'000'000);
+        link->loss = loss;
+        link->reorder = reorder;
+    }
+    config.b_to_a.seed = 2;
+    config.pool.buffer_count = 65536;
+
+    simulated_ns = 1'000'000'000;
+    Pair pair(config, true);
+    bool intact = false;
+    Clock::time_point start = Clock::now();
+    double seconds = bulk(pair, megabytes << 20, intact);
+    double wall_ms = elapsed_seconds(start) * 1e3;
+    WireStats forward = pair.wire.get_a().get_stats();
+    std::printf("%-28s %10.2f %8llu %8llu %8llu %9.1f%s\n", label,
+                static_cast<double>(megabytes << 20) * 8 / seconds / 1e6,
+                static_cast<unsigned long long>(forward.lost),
+                static_cast<unsigned long long>(forward.queue_drops),
+                static_cast<unsigned long long>(forward.reordered), wall_ms, intact ? "" : " did not complete");
+}
+
+int main(int argc, char* argv[]) {
+    size_t megabytes = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 64;
+
+    bench_handshakes();
+    bench_throughput(megabytes);
+    bench_latency();
+
+    std::printf("\n%-28s %10s %8s %8s %8s %9s\n", "link", "Mbit/s", "lost", "q drops", "reorder", "wall ms");
+    bench_link("100 Mbit/s, 1 ms", 100'000'000, 1'000'000, 0, 0, megabytes);
+    bench_link("1 Gbit/s, 1 ms", 1'000'000'000, 1'000'000, 0, 0, megabytes);
+    bench_link("1 Gbit/s, 10 ms", 1'000'000'000, 10'000'000, 0, 0, megabytes);
+    bench_link("1 Gbit/s, 1 ms, 0.1% loss", 1'000'000'000, 1'000'000, 0.001, 0, megabytes);
+    bench_link("1 Gbit/s, 1 ms, 1% loss", 1'000'000'000, 1'000'000, 0.01, 0, megabytes);
+    bench_link("1 Gbit/s, 1 ms, 1% reorder", 1'000'000'000, 1'000'000, 0, 0.01, megabytes);
+    return 0;
+}
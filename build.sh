@@ -49,16 +49,18 @@ manual_build() {
     echo "Attempting manual compilation..."
     
     # Create object files
-    for src in src/ethernet/ethernet_frame.cpp src/ip/ipv4_packet.cpp src/ip/checksum.cpp src/tcp/tcp_segment.cpp src/tcp/tcp_state_machine.cpp src/stack.cpp; do
+    objs=""
+    for src in src/ethernet/ethernet_frame.cpp src/ip/ipv4_packet.cpp src/ip/ipv4_reassembler.cpp src/ip/checksum.cpp src/tcp/tcp_segment.cpp src/tcp/tcp_options.cpp src/tcp/tcp_segmenter.cpp src/tcp/tcp_coalescer.cpp src/tcp/tcp_socket.cpp src/tcp/tcp_receive_buffer.cpp src/tcp/tcp_state_machine.cpp src/tcp/congestion_control.cpp src/tcp/tcp_sender.cpp src/tcp/transfer_simulator.cpp src/buffer/packet_pool.cpp src/core/metrics.cpp src/core/rss.cpp src/core/trace.cpp src/link/capture_file.cpp src/link/pcap_device.cpp src/link/lossy_link.cpp src/link/virtual_wire.cpp src/stack.cpp src/coro/task.cpp src/coro/event_loop.cpp; do
         obj=${src%.cpp}.o
         echo "Compiling $src..."
-        g++ -std=c++17 -Iinclude -c $src -o $obj
+        g++ -std=c++20 -Iinclude -c $src -o $obj
+        objs="$objs $obj"
     done
     
     # Compile and link demo
     echo "Building demo..."
-    g++ -std=c++17 -Iinclude -c demo/simple_demo.cpp -o demo/simple_demo.o
-    g++ -o demo/simple_demo demo/simple_demo.o src/ethernet/ethernet_frame.o src/ip/ipv4_packet.o src/ip/checksum.o src/tcp/tcp_segment.o src/tcp/tcp_state_machine.o src/stack.o -lpcap
+    g++ -std=c++20 -Iinclude -c demo/simple_demo.cpp -o demo/simple_demo.o
+    g++ -o demo/simple_demo demo/simple_demo.o $objs -lpcap -lpthread
     
     if [ -f "demo/simple_demo" ]; then
         echo "✅ Manual build successful!"
@@ -4,7 +4,7 @@
 void demo_tcp_handshake() {
     std::cout << "=== TCP 3-Way Handshake Demo ===" << std::endl;
     
-    TCPStateMachine sm;
+    VerboseTCPStateMachine sm;
     
     std::cout << "\n1. Client sends SYN" << std::endl;
     sm.send_syn();
@@ -22,12 +22,11 @@ void demo_tcp_handshake() {
 void demo_tcp_teardown() {
     std::cout << "\n=== TCP Connection Teardown Demo ===" << std::endl;
     
-    TCPStateMachine sm;
+    VerboseTCPStateMachine sm;
     
-    // Simulate established connection
     std::cout << "\nStarting from ESTABLISHED state..." << std::endl;
-    // We'll manually set up the state for demo purposes
-    // In real code, this would happen through the state transitions
+    sm.send_syn();
+    sm.handle_syn_ack();
     
     std::cout << "\n1. Client sends FIN" << std::endl;
     sm.send_fin();
@@ -40,6 +39,10 @@ void demo_tcp_teardown() {
     
     std::cout << "\n4. Client sends final ACK" << std::endl;
     sm.send_ack();
+    
+    std::cout << "\n5. TIME_WAIT expires" << std::endl;
+    sm.handle_time_wait_expired();
+    std::cout << "Current state: " << sm.get_state_name() << std::endl;
 }
 
 int main() {
@@ -0,0 +1,115 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <mutex>
+#include <span>
+
+struct PacketPoolConfig {
+    size_t buffer_count = 4096; // total buffers; bounds the pool's memory
+    size_t buffer_size = 2048;  // bytes per buffer: headroom + data + tailroom
+    size_t headroom = 128;      // reserved in front of the data for prepending headers
+    size_t cache_size = 32;     // per-thread cache depth (0 disables caching)
+};
+
+struct PacketPoolStats {
+    size_t capacity = 0;      // buffers in the pool
+    size_t memory_bytes = 0;  // size of the preallocated slab
+    size_t free_buffers = 0;  // on the shared free list (excludes thread caches)
+    uint64_t exhausted = 0;   // allocations refused because the pool was empty
+};
+
+class PacketPool;
+
+// Buffer metadata, stored in front of its data area in the pool's slab
+struct PacketBuffer {
+    PacketPool* pool;
+    PacketBuffer* next_free;
+    std::atomic<uint32_t> refcount;
+    uint32_t capacity;
+    uint32_t data_offset;
+    uint32_t data_length;
+
+    uint8_t* storage() { return reinterpret_cast<uint8_t*>(this) + STORAGE_OFFSET; }
+
+    static constexpr size_t STORAGE_OFFSET = 64;
+};
+
+// Refcounted handle to a pooled buffer (mbuf-style). Copies share the same
+// buffer and data window; the buffer goes back to its pool when the last
+// handle is released or destroyed.
+class PacketHandle {
+public:
+    PacketHandle() = default;
+    PacketHandle(const PacketHandle& other);
+    PacketHandle(PacketHandle&& other) noexcept : buffer_(other.buffer_) { other.buffer_ = nullptr; }
+    PacketHandle& operator=(const PacketHandle& other);
+    PacketHandle& operator=(PacketHandle&& other) noexcept;
+    ~PacketHandle() { release(); }
+
+    explicit operator bool() const { return buffer_ != nullptr; }
+
+    uint8_t* data() { return buffer_->storage() + buffer_->data_offset; }
+    const uint8_t* data() const { return buffer_->storage() + buffer_->data_offset; }
+    size_t size() const { return buffer_->data_length; }
+    std::span<uint8_t> span() { return {data(), size()}; }
+    std::span<const uint8_t> span() const { return {data(), size()}; }
+
+    size_t headroom() const { return buffer_->data_offset; }
+    size_t tailroom() const { return buffer_->capacity - buffer_->data_offset - buffer_->data_length; }
+
+    // Grow the data window at the front/back; nullptr if there is no room
+    uint8_t* prepend(size_t length);
+    uint8_t* append(size_t length);
+    // Shrink the data window at the front/back; false if it is too short
+    bool adjust(size_t length);
+    bool trim(size_t length);
+
+    uint32_t get_refcount() const { return buffer_->refcount.load(std::memory_order_relaxed); }
+    void release();
+
+private:
+    friend class PacketPool;
+    explicit PacketHandle(PacketBuffer* buffer) : buffer_(buffer) {}
+
+    PacketBuffer* buffer_ = nullptr;
+};
+
+// Fixed-size pool of preallocated packet buffers. All memory is allocated up
+// front, so allocation never calls malloc; a per-thread cache keeps the
+// shared free list's lock off the per-packet path. An empty pool refuses the
+// allocation and counts it, so bursts cannot grow memory use.
+class PacketPool {
+public:
+    explicit PacketPool(const PacketPoolConfig& config = {});
+    ~PacketPool();
+
+    PacketPool(const PacketPool&) = delete;
+    PacketPool& operator=(const PacketPool&) = delete;
+
+    // Returns an empty handle (and counts a drop) when the pool is exhausted
+    PacketHandle alloc();
+    size_t alloc_burst(PacketHandle* out, size_t count);
+
+    const PacketPoolConfig& get_config() const { return config_; }
+    PacketPoolStats get_stats() const;
+
+private:
+    friend class PacketHandle;
+    friend struct PacketPoolThreadCache;
+
+    PacketPoolConfig config_;
+    uint64_t id_;
+    uint8_t* slab_ = nullptr;
+    size_t slab_size_ = 0;
+
+    std::mutex free_mutex_;
+    PacketBuffer* free_list_ = nullptr;
+    std::atomic<size_t> free_count_{0};
+    std::atomic<uint64_t> exhausted_{0};
+
+    PacketBuffer* alloc_buffer();
+    void free_buffer(PacketBuffer* buffer);
+    size_t take_from_free_list(PacketBuffer** out, size_t count);
+    void return_to_free_list(PacketBuffer* const* buffers, size_t count);
+};
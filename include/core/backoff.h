@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <chrono>
+#include <thread>
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+// Idle strategy for polling loops: spin briefly, then yield, then sleep, so
+// an idle poller gives its core back without adding latency under load
+class Backoff {
+public:
+    static constexpr uint32_t SPIN_LIMIT = 64;
+    static constexpr uint32_t YIELD_LIMIT = 256;
+
+    void idle() {
+        if (rounds_ < SPIN_LIMIT) {
+            cpu_relax();
+        } else if (rounds_ < YIELD_LIMIT) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+            return;
+        }
+        ++rounds_;
+    }
+
+    void reset() { rounds_ = 0; }
+
+private:
+    uint32_t rounds_ = 0;
+};
@@ -0,0 +1,99 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <atomic>
+#include <ostream>
+#include <string_view>
+
+// Counters for every layer of the stack. Each thread updates its own
+// cache-line-aligned block with plain loads and stores, never a locked
+// instruction; readers sum the blocks into a MetricsSnapshot. Counters only
+// grow, so the difference of two snapshots is the activity in between.
+
+enum class Metric : uint16_t {
+    RX_PACKETS,
+    RX_BYTES,
+    RX_NO_BUFFER,           // dropped: packet pool exhausted
+    RX_OVERSIZE,            // dropped: capture larger than a pool buffer
+    RX_QUEUE_FULL,          // dropped: worker queue at its depth limit
+    ETH_TOO_SHORT,
+    ETH_UNKNOWN_TYPE,       // not IPv4
+    IP_PACKETS,             // valid IPv4 headers
+    IP_MALFORMED,           // truncated, bad version, IHL or length
+    IP_BAD_CHECKSUM,
+    IP_UNKNOWN_PROTOCOL,    // not TCP
+    IP_FRAGMENTS,           // fragments offered for reassembly
+    IP_REASSEMBLED,         // datagrams rebuilt from fragments
+    IP_FRAGMENT_OVERLAPS,   // datagrams dropped for overlapping fragments
+    IP_REASSEMBLY_TIMEOUTS, // datagrams expired incomplete
+    IP_REASSEMBLY_DROPS,    // evicted for room, invalid, or no buffer
+    TCP_SEGMENTS,           // valid TCP headers
+    TCP_GRO_MERGED,         // segments merged into the one before them
+    TCP_MALFORMED,          // truncated or bad data offset
+    TCP_BAD_CHECKSUM,       // only when checksum verification is on
+    TCP_NO_CONNECTION,      // no connection and not a SYN to a listening port
+    TCP_BAD_STATE,          // flags not valid in the connection's state
+    TCP_BYTES_RECEIVED,     // payload bytes that became readable in order
+    TCP_OUT_OF_ORDER,       // segments held ahead of a hole
+    TCP_DUPLICATE,          // segments carrying only data already received
+    TCP_OUT_OF_WINDOW,      // segments past the window, or past the out-of-order range limit
+    TCP_CONNECTIONS_OPENED,
+    TCP_CONNECTIONS_CLOSED,
+    TCP_TIME_WAIT_EXPIRED,  // closed after 2*MSL in TIME_WAIT
+    TCP_KEEPALIVE_TIMEOUTS, // closed after the keepalive idle time
+    TCP_SEGMENTS_SENT,      // by connections with a socket
+    TCP_RETRANSMIT_TIMEOUTS, // retransmission timer expiries, handshake and FIN included
+    TCP_LISTEN_OVERFLOWS,   // SYNs dropped: the listening socket's accept queue was full
+    TCP_RESETS_IGNORED,     // RSTs not at RCV.NXT, or in SYN_SENT not acknowledging our SYN
+    TCP_CHALLENGE_ACKS,     // ACKs sent for RSTs in the window but not at RCV.NXT
+    TX_PACKETS,
+    TX_RING_FULL,           // transmit() refused
+    TX_DEVICE_ERRORS,       // frames the device refused
+    TX_NO_BUFFER,           // segments not sent: packet pool exhausted
+    TX_OVERSIZE,            // segments not sent: larger than a pool buffer
+    COUNT
+};
+
+constexpr size_t METRIC_COUNT = static_cast<size_t>(Metric::COUNT);
+
+// Lower-case identifier, e.g. "ip_bad_checksum"
+const char* metric_name(Metric metric);
+const char* metric_help(Metric metric);
+
+// One thread's counters. Only the owning thread may call add(); any thread
+// may read.
+struct alignas(64) MetricCounters {
+    std::array<std::atomic<uint64_t>, METRIC_COUNT> values{};
+
+    void add(Metric metric, uint64_t amount = 1) {
+        auto& counter = values[static_cast<size_t>(metric)];
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+    uint64_t get(Metric metric) const {
+        return values[static_cast<size_t>(metric)].load(std::memory_order_relaxed);
+    }
+};
+
+// Point-in-time totals, summed over any number of counter blocks
+struct MetricsSnapshot {
+    std::array<uint64_t, METRIC_COUNT> values{};
+
+    uint64_t get(Metric metric) const { return values[static_cast<size_t>(metric)]; }
+    void add(Metric metric, uint64_t amount) { values[static_cast<size_t>(metric)] += amount; }
+    void add(const MetricCounters& counters);
+
+    // Activity since an earlier snapshot of the same counters
+    MetricsSnapshot since(const MetricsSnapshot& before) const;
+
+    // "name value" per line, zero counters included
+    void write_text(std::ostream& out) const;
+    // Prometheus text exposition format; names become <prefix>_<name>_total
+    void write_prometheus(std::ostream& out, std::string_view prefix = "tcp_stack") const;
+};
+
+// Process-wide counters for code with no owning context, such as the owning
+// packet classes' deserialize(). Each thread gets a block on first use; its
+// totals are folded into the process totals when the thread exits.
+void count_metric(Metric metric, uint64_t amount = 1);
+MetricsSnapshot get_process_metrics();
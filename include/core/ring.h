@@ -0,0 +1,231 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <utility>
+
+// Bounded lock-free rings for handing packet handles between pipeline stages.
+// Capacity is rounded up to a power of two. Items are moved in and out, so a
+// ring of PacketHandle transfers ownership without touching refcounts.
+
+static constexpr size_t RING_CACHE_LINE = 64;
+
+struct RingStats {
+    uint64_t enqueued = 0; // items accepted
+    uint64_t dequeued = 0;
+    uint64_t full = 0;     // items refused because the ring was full
+};
+
+inline size_t ring_capacity_for(size_t requested) {
+    size_t capacity = 2;
+    while (capacity < requested) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+// Single producer, single consumer. Each side keeps a cached copy of the
+// other's index and only reloads it when the ring looks full or empty, so
+// in steady state the two cores only exchange the cache lines holding the
+// items themselves.
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity)
+        : capacity_(ring_capacity_for(capacity)), mask_(capacity_ - 1),
+          slots_(std::make_unique<T[]>(capacity_)) {}
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer only. Moves up to count items from items[]; returns how many
+    // were accepted. Refused items stay in items[] and are counted as full.
+    size_t enqueue_burst(T* items, size_t count) {
+        size_t head = producer_.head.load(std::memory_order_relaxed);
+        size_t free_slots = capacity_ - (head - producer_.cached_tail);
+        if (free_slots < count) {
+            producer_.cached_tail = consumer_.tail.load(std::memory_order_acquire);
+            free_slots = capacity_ - (head - producer_.cached_tail);
+        }
+
+        size_t accepted = std::min(count, free_slots);
+        for (size_t i = 0; i < accepted; ++i) {
+            slots_[(head + i) & mask_] = std::move(items[i]);
+        }
+        producer_.head.store(head + accepted, std::memory_order_release);
+
+        bump(producer_.enqueued, accepted);
+        if (accepted < count) {
+            bump(producer_.full, count - accepted);
+        }
+        return accepted;
+    }
+
+    bool enqueue(T&& item) { return enqueue_burst(&item, 1) == 1; }
+
+    // Consumer only. Moves up to max_items into out[]; returns how many.
+    size_t dequeue_burst(T* out, size_t max_items) {
+        size_t tail = consumer_.tail.load(std::memory_order_relaxed);
+        size_t available = consumer_.cached_head - tail;
+        if (available < max_items) {
+            consumer_.cached_head = producer_.head.load(std::memory_order_acquire);
+            available = consumer_.cached_head - tail;
+        }
+
+        size_t taken = std::min(max_items, available);
+        for (size_t i = 0; i < taken; ++i) {
+            out[i] = std::move(slots_[(tail + i) & mask_]);
+        }
+        consumer_.tail.store(tail + taken, std::memory_order_release);
+
+        bump(consumer_.dequeued, taken);
+        return taken;
+    }
+
+    bool dequeue(T& out) { return dequeue_burst(&out, 1) == 1; }
+
+    // Approximate when called concurrently with either side
+    size_t size() const {
+        return producer_.head.load(std::memory_order_acquire) - consumer_.tail.load(std::memory_order_acquire);
+    }
+    bool empty() const { return size() == 0; }
+    size_t capacity() const { return capacity_; }
+
+    RingStats get_stats() const {
+        RingStats stats;
+        stats.enqueued = producer_.enqueued.load(std::memory_order_relaxed);
+        stats.full = producer_.full.load(std::memory_order_relaxed);
+        stats.dequeued = consumer_.dequeued.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+    static void bump(std::atomic<uint64_t>& counter, uint64_t amount) {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    struct alignas(RING_CACHE_LINE) ProducerSide {
+        std::atomic<size_t> head{0};
+        size_t cached_tail = 0;
+        std::atomic<uint64_t> enqueued{0};
+        std::atomic<uint64_t> full{0};
+    };
+
+    struct alignas(RING_CACHE_LINE) ConsumerSide {
+        std::atomic<size_t> tail{0};
+        size_t cached_head = 0;
+        std::atomic<uint64_t> dequeued{0};
+    };
+
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<T[]> slots_;
+    ProducerSide producer_;
+    ConsumerSide consumer_;
+};
+
+// Multiple producers, single consumer. Producers claim a run of slots with
+// one CAS on the head and then publish each slot through its sequence
+// number, so a burst costs one contended operation however long it is. The
+// consumer takes the longest published run.
+template <typename T>
+class MpscRing {
+public:
+    explicit MpscRing(size_t capacity)
+        : capacity_(ring_capacity_for(capacity)), mask_(capacity_ - 1),
+          slots_(std::make_unique<Slot[]>(capacity_)) {
+        for (size_t i = 0; i < capacity_; ++i) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscRing(const MpscRing&) = delete;
+    MpscRing& operator=(const MpscRing&) = delete;
+
+    // Any thread. Moves up to count items from items[]; returns how many
+    // were accepted. Refused items stay in items[] and are counted as full.
+    size_t enqueue_burst(T* items, size_t count) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t accepted = 0;
+        while (true) {
+            size_t tail = tail_.load(std::memory_order_acquire);
+            accepted = std::min(count, capacity_ - (head - tail));
+            if (accepted == 0) {
+                break;
+            }
+            if (head_.compare_exchange_weak(head, head + accepted, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+
+        for (size_t i = 0; i < accepted; ++i) {
+            Slot& slot = slots_[(head + i) & mask_];
+            slot.value = std::move(items[i]);
+            slot.sequence.store(head + i + 1, std::memory_order_release);
+        }
+
+        if (accepted > 0) {
+            enqueued_.fetch_add(accepted, std::memory_order_relaxed);
+        }
+        if (accepted < count) {
+            full_.fetch_add(count - accepted, std::memory_order_relaxed);
+        }
+        return accepted;
+    }
+
+    bool enqueue(T&& item) { return enqueue_burst(&item, 1) == 1; }
+
+    // Consumer only. A slot claimed but not yet published ends the run, so
+    // a stalled producer delays only the items behind it.
+    size_t dequeue_burst(T* out, size_t max_items) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t taken = 0;
+        while (taken < max_items) {
+            Slot& slot = slots_[(tail + taken) & mask_];
+            if (slot.sequence.load(std::memory_order_acquire) != tail + taken + 1) {
+                break;
+            }
+            out[taken] = std::move(slot.value);
+            slot.sequence.store(tail + taken + capacity_, std::memory_order_relaxed);
+            ++taken;
+        }
+        tail_.store(tail + taken, std::memory_order_release);
+
+        dequeued_.store(dequeued_.load(std::memory_order_relaxed) + taken, std::memory_order_relaxed);
+        return taken;
+    }
+
+    bool dequeue(T& out) { return dequeue_burst(&out, 1) == 1; }
+
+    // Approximate when called concurrently with either side
+    size_t size() const {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+    bool empty() const { return size() == 0; }
+    size_t capacity() const { return capacity_; }
+
+    RingStats get_stats() const {
+        RingStats stats;
+        stats.enqueued = enqueued_.load(std::memory_order_relaxed);
+        stats.full = full_.load(std::memory_order_relaxed);
+        stats.dequeued = dequeued_.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T value{};
+    };
+
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+    alignas(RING_CACHE_LINE) std::atomic<size_t> head_{0};
+    std::atomic<uint64_t> enqueued_{0};
+    std::atomic<uint64_t> full_{0};
+    alignas(RING_CACHE_LINE) std::atomic<size_t> tail_{0};
+    std::atomic<uint64_t> dequeued_{0};
+};
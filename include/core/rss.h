@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <span>
+
+// Toeplitz receive-side-scaling hash, as computed by NICs for flow steering.
+// The default key repeats 0x6d5a, which makes the hash symmetric: both
+// directions of a connection hash to the same value, so a flow stays on one
+// core for its whole lifetime.
+class RssHasher {
+public:
+    static constexpr size_t KEY_SIZE = 40;
+    // Inputs up to the IPv4 4-tuple use the lookup tables
+    static constexpr size_t MAX_TABLE_INPUT = 12;
+
+    RssHasher();
+    explicit RssHasher(const std::array<uint8_t, KEY_SIZE>& key);
+
+    // Generic Toeplitz hash of up to KEY_SIZE - 4 bytes
+    uint32_t hash(std::span<const uint8_t> input) const;
+
+    // Addresses in host order; input laid out as src, dst, sport, dport
+    uint32_t hash_ipv4(uint32_t source, uint32_t destination) const;
+    uint32_t hash_ipv4_tcp(uint32_t source, uint32_t destination,
+                           uint16_t source_port, uint16_t dest_port) const;
+
+    static std::array<uint8_t, KEY_SIZE> symmetric_key();
+
+private:
+    std::array<uint8_t, KEY_SIZE> key_;
+    // table_[i][b]: contribution of byte value b at input byte position i
+    std::array<std::array<uint32_t, 256>, MAX_TABLE_INPUT> table_;
+
+    uint32_t key_window(size_t bit) const;
+    uint32_t lookup(size_t position, uint8_t value) const { return table_[position][value]; }
+};
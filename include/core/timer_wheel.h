@@ -0,0 +1,229 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <array>
+#include <bit>
+
+class TimerWheel;
+
+// An intrusive timer, embedded in whatever it times (a connection, a
+// reassembly table). The wheel links timers by address, so a Timer must
+// not move while armed: copies and moves produce a disarmed timer and
+// assigning leaves the target's arming alone. owner and kind are for the
+// expiry callback to tell timers apart.
+class Timer {
+public:
+    Timer() = default;
+    Timer(const Timer& other) : owner(other.owner), kind(other.kind) {}
+    Timer& operator=(const Timer& other) {
+        owner = other.owner;
+        kind = other.kind;
+        return *this;
+    }
+
+    bool is_armed() const { return pprev_ != nullptr; }
+
+    void* owner = nullptr;
+    uint32_t kind = 0;
+
+private:
+    friend class TimerWheel;
+
+    Timer* next_ = nullptr;
+    Timer** pprev_ = nullptr;   // the link pointing at this timer, null when disarmed
+    uint64_t expires_ = 0;      // in ticks
+    uint32_t slot_ = 0;
+};
+
+struct TimerWheelStats {
+    size_t armed = 0;
+    uint64_t expired = 0;
+    uint64_t cascaded = 0;  // timers moved down a level as their time approached
+};
+
+// Hierarchical timing wheel (Varghese & Lauck), owned by one thread and
+// driven by its loop: no clock of its own and no threads, so a test can
+// step it through any sequence of times.
+//
+// Four levels of 256 slots cover 2^32 ticks (49 days at the default 1 ms).
+// A timer goes in the level whose span holds its deadline; arm(), re-arm
+// and cancel() are O(1) list operations with no allocation, which matters
+// because an RTO timer is re-armed on nearly every ACK. advance() fires
+// each level-0 slot whose tick has passed, and every 256 ticks moves the
+// next slot of the level above down. A bitmap of occupied level-0 slots
+// lets advance() skip idle stretches. Timers fire at most one tick late,
+// never early.
+class TimerWheel {
+public:
+    static constexpr size_t LEVELS = 4;
+    static constexpr size_t SLOT_BITS = 8;
+    static constexpr size_t SLOTS = size_t{1} << SLOT_BITS;
+    static constexpr uint64_t DEFAULT_TICK_NS = 1'000'000;
+
+    explicit TimerWheel(uint64_t now_ns = 0, uint64_t tick_ns = DEFAULT_TICK_NS)
+        : origin_ns_(now_ns), tick_ns_(std::max<uint64_t>(tick_ns, 1)) {}
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    // Arms or re-arms; a deadline already passed fires at the next tick
+    void arm(Timer& timer, uint64_t deadline_ns) {
+        if (timer.is_armed()) {
+            unlink(timer);
+        } else {
+            armed_++;
+        }
+        uint64_t since_origin = deadline_ns > origin_ns_ ? deadline_ns - origin_ns_ : 0;
+        timer.expires_ = (since_origin + tick_ns_ - 1) / tick_ns_;
+        link(timer);
+    }
+
+    void cancel(Timer& timer) {
+        if (timer.is_armed()) {
+            unlink(timer);
+            armed_--;
+        }
+    }
+
+    // Fires every timer due by now_ns, calling on_expired(Timer&) with the
+    // timer already disarmed; the callback may arm or cancel any timer.
+    // Returns how many fired.
+    template <typename Fn>
+    size_t advance(uint64_t now_ns, Fn&& on_expired) {
+        if (now_ns < origin_ns_) {
+            return 0;
+        }
+        uint64_t target = (now_ns - origin_ns_) / tick_ns_;
+        size_t fired = 0;
+        while (current_ <= target) {
+            if (armed_ == 0) {
+                current_ = target + 1;
+                break;
+            }
+
+            size_t index = current_ & (SLOTS - 1);
+            if (index == 0) {
+                cascade(current_);
+            }
+            if (slots_[index] == nullptr) {
+                // Nothing due before the next occupied slot or the next cascade
+                current_ = std::min(current_ - index + next_occupied(index), target + 1);
+                continue;
+            }
+
+            // Detach the slot so callbacks can re-arm into it for a later lap
+            expiring_ = slots_[index];
+            expiring_->pprev_ = &expiring_;
+            slots_[index] = nullptr;
+            occupied_[index / 64] &= ~(uint64_t{1} << (index % 64));
+            for (Timer* timer = expiring_; timer != nullptr; timer = timer->next_) {
+                timer->slot_ = DETACHED;
+            }
+            current_++;
+
+            while (expiring_ != nullptr) {
+                Timer& timer = *expiring_;
+                unlink(timer);
+                armed_--;
+                fired++;
+                on_expired(timer);
+            }
+        }
+        expired_ += fired;
+        return fired;
+    }
+
+    size_t get_armed() const { return armed_; }
+    uint64_t get_tick_ns() const { return tick_ns_; }
+
+    TimerWheelStats get_stats() const {
+        TimerWheelStats stats;
+        stats.armed = armed_;
+        stats.expired = expired_;
+        stats.cascaded = cascaded_;
+        return stats;
+    }
+
+private:
+    static constexpr uint32_t DETACHED = LEVELS * SLOTS;
+    static constexpr uint64_t MAX_DELTA = (uint64_t{1} << (LEVELS * SLOT_BITS)) - 1;
+
+    uint64_t origin_ns_;
+    uint64_t tick_ns_;
+    uint64_t current_ = 0;      // next tick to process
+    std::array<Timer*, LEVELS * SLOTS> slots_{};
+    std::array<uint64_t, SLOTS / 64> occupied_{}; // level 0 only
+    Timer* expiring_ = nullptr; // the slot being fired
+    size_t armed_ = 0;
+    uint64_t expired_ = 0;
+    uint64_t cascaded_ = 0;
+
+    void link(Timer& timer) {
+        uint64_t expires = std::max(timer.expires_, current_);
+        uint64_t delta = std::min(expires - current_, MAX_DELTA);
+        expires = current_ + delta;
+        timer.expires_ = expires;
+
+        size_t level = 0;
+        while (level + 1 < LEVELS && delta >= (uint64_t{1} << ((level + 1) * SLOT_BITS))) {
+            level++;
+        }
+        size_t index = (expires >> (level * SLOT_BITS)) & (SLOTS - 1);
+        size_t slot = level * SLOTS + index;
+
+        timer.slot_ = static_cast<uint32_t>(slot);
+        timer.next_ = slots_[slot];
+        if (timer.next_ != nullptr) {
+            timer.next_->pprev_ = &timer.next_;
+        }
+        slots_[slot] = &timer;
+        timer.pprev_ = &slots_[slot];
+        if (level == 0) {
+            occupied_[index / 64] |= uint64_t{1} << (index % 64);
+        }
+    }
+
+    void unlink(Timer& timer) {
+        *timer.pprev_ = timer.next_;
+        if (timer.next_ != nullptr) {
+            timer.next_->pprev_ = timer.pprev_;
+        }
+        if (timer.slot_ < SLOTS && slots_[timer.slot_] == nullptr) {
+            occupied_[timer.slot_ / 64] &= ~(uint64_t{1} << (timer.slot_ % 64));
+        }
+        timer.next_ = nullptr;
+        timer.pprev_ = nullptr;
+    }
+
+    // At a level-0 wrap, re-files the upper slots whose span starts at tick
+    void cascade(uint64_t tick) {
+        for (size_t level = 1; level < LEVELS; ++level) {
+            size_t index = (tick >> (level * SLOT_BITS)) & (SLOTS - 1);
+            Timer* timer = slots_[level * SLOTS + index];
+            slots_[level * SLOTS + index] = nullptr;
+            while (timer != nullptr) {
+                Timer* next = timer->next_;
+                link(*timer);
+                cascaded_++;
+                timer = next;
+            }
+            if (index != 0) {
+                break;
+            }
+        }
+    }
+
+    // First occupied level-0 slot at or after index, SLOTS if none
+    size_t next_occupied(size_t index) const {
+        size_t word = index / 64;
+        uint64_t bits = occupied_[word] & (~uint64_t{0} << (index % 64));
+        while (bits == 0) {
+            if (++word == occupied_.size()) {
+                return SLOTS;
+            }
+            bits = occupied_[word];
+        }
+        return word * 64 + static_cast<size_t>(std::countr_zero(bits));
+    }
+};
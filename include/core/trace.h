@@ -0,0 +1,114 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+// Binary event tracing. Each thread appends fixed-size records to its own
+// lock-free ring; a background drainer writes them to a file that
+// tools/trace_decode turns back into text. With tracing off, a TRACE()
+// costs one relaxed load and a predicted branch, so tracepoints stay
+// compiled into production builds.
+
+enum class TraceEvent : uint16_t {
+    NONE,
+    CLOCK_SYNC,             // arg1: steady clock ns at the record's timestamp
+    RECORDS_DROPPED,        // arg0: thread whose ring was full, arg1: records lost
+    STACK_STARTED,
+    STACK_STOPPED,
+    STACK_ALREADY_RUNNING,
+    THREAD_STARTED,         // arg0: 0 capture, 1 worker; arg1: worker index
+    RX_BURST,               // arg0: packets
+    WORKER_QUEUE_FULL,      // arg0: worker, arg1: packets dropped
+    TX_ERROR,               // arg0: packets the device refused
+    PCAP_DISPATCH_FAILED,   // arg0: pcap_dispatch result
+    ETH_MALFORMED,          // arg0: frame length
+    IP_MALFORMED,           // arg0: packet length
+    TCP_MALFORMED,          // arg0: segment length
+    TCP_NO_CONNECTION,      // arg0: TCP flags
+    CONNECTION_OPENED,
+    CONNECTION_CLOSED,
+    TCP_TRANSITION,         // arg0: from | event << 8 | to << 16
+    TCP_BAD_STATE,          // arg0: state | event << 8
+    DESERIALIZE_TOO_SHORT,  // arg0: layer (2 Ethernet, 3 IP, 4 TCP), arg1: bytes
+    COUNT
+};
+
+const char* trace_event_name(TraceEvent event);
+
+struct TraceRecord {
+    uint64_t timestamp;   // trace_timestamp() ticks
+    uint64_t connection;  // flow id, 0 when not tied to a connection
+    uint16_t event;
+    uint16_t thread;      // registration order of the recording thread
+    uint32_t arg0;
+    uint64_t arg1;
+};
+static_assert(sizeof(TraceRecord) == 32, "two records per cache line");
+
+struct TraceConfig {
+    size_t ring_size = 8192;           // records per thread; full rings drop and count
+    unsigned drain_interval_us = 1000; // drainer sleep when every ring is empty
+};
+
+// TSC on x86, nanoseconds elsewhere. CLOCK_SYNC records let the decoder
+// convert either to wall time.
+inline uint64_t trace_timestamp() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+class Tracer {
+public:
+    // Opens the output file and starts the drainer; false if the file cannot
+    // be created or tracing is already on
+    static bool start(const std::string& path, const TraceConfig& config = {});
+    // Stops recording and writes out everything still queued
+    static void stop();
+
+    static bool is_enabled() { return enabled_.load(std::memory_order_relaxed); }
+    static void record(TraceEvent event, uint64_t connection = 0, uint32_t arg0 = 0, uint64_t arg1 = 0);
+
+private:
+    static inline std::atomic<bool> enabled_{false};
+};
+
+#define TRACE(...)                                        \
+    do {                                                  \
+        if (__builtin_expect(Tracer::is_enabled(), 0)) {  \
+            Tracer::record(__VA_ARGS__);                  \
+        }                                                 \
+    } while (0)
+
+// Loads a trace file, sorted by time
+class TraceReader {
+public:
+    bool open(const std::string& path);
+
+    const std::vector<TraceRecord>& get_records() const { return records_; }
+    // Nanoseconds since the first record, from the file's CLOCK_SYNC records
+    double to_nanoseconds(uint64_t timestamp) const;
+
+private:
+    std::vector<TraceRecord> records_;
+    uint64_t base_timestamp_ = 0;
+    double nanoseconds_per_tick_ = 1.0;
+};
+
+static constexpr char TRACE_FILE_MAGIC[8] = {'T', 'C', 'P', 'T', 'R', 'A', 'C', 'E'};
+static constexpr uint32_t TRACE_FILE_VERSION = 1;
+
+struct TraceFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+};
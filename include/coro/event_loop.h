@@ -0,0 +1,208 @@
+#pragma once
+#include <array>
+#include <coroutine>
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <vector>
+#include "coro/task.h"
+#include "tcp/tcp_socket.h"
+
+class TCPIPStack;
+class EventLoop;
+
+// An awaiter parked on a socket. The loop calls attempt() when the socket
+// reports ready and resumes handle once it succeeds, so a coroutine wakes
+// with its result already in hand.
+class SocketWaiter {
+public:
+    std::coroutine_handle<> handle;
+
+    // Tries the operation again; true once there is a result
+    virtual bool attempt() = 0;
+
+protected:
+    ~SocketWaiter() = default;
+};
+
+class AsyncConnection;
+
+// co_await yields IoResult: bytes read (0 with NONE at the end of the
+// stream) or why nothing can be
+class ReadAwaiter final : public SocketWaiter {
+public:
+    ReadAwaiter(EventLoop& loop, SocketId socket, std::span<uint8_t> buffer)
+        : loop_(loop), socket_(socket), buffer_(buffer) {}
+
+    bool await_ready() { return attempt(); }
+    void await_suspend(std::coroutine_handle<> handle);
+    IoResult await_resume() const { return result_; }
+    bool attempt() override;
+
+private:
+    EventLoop& loop_;
+    SocketId socket_;
+    std::span<uint8_t> buffer_;
+    IoResult result_;
+};
+
+// co_await yields IoResult: bytes queued, which may be fewer than given
+class WriteAwaiter final : public SocketWaiter {
+public:
+    WriteAwaiter(EventLoop& loop, SocketId socket, std::span<const uint8_t> data)
+        : loop_(loop), socket_(socket), data_(data) {}
+
+    bool await_ready() { return attempt(); }
+    void await_suspend(std::coroutine_handle<> handle);
+    IoResult await_resume() const { return result_; }
+    bool attempt() override;
+
+private:
+    EventLoop& loop_;
+    SocketId socket_;
+    std::span<const uint8_t> data_;
+    IoResult result_;
+};
+
+// co_await yields the AsyncConnection, open once the handshake completed,
+// else closed with get_error() saying why
+class ConnectAwaiter final : public SocketWaiter {
+public:
+    ConnectAwaiter(EventLoop& loop, SocketId socket) : loop_(loop), socket_(socket) {}
+
+    bool await_ready() { return attempt(); }
+    void await_suspend(std::coroutine_handle<> handle);
+    AsyncConnection await_resume();
+    bool attempt() override;
+
+private:
+    EventLoop& loop_;
+    SocketId socket_;
+    SocketError error_ = SocketError::NONE;
+};
+
+// co_await yields the next established connection, or a closed one if the
+// listener is not open
+class AcceptAwaiter final : public SocketWaiter {
+public:
+    AcceptAwaiter(EventLoop& loop, SocketId listener) : loop_(loop), listener_(listener) {}
+
+    bool await_ready() { return attempt(); }
+    void await_suspend(std::coroutine_handle<> handle);
+    AsyncConnection await_resume();
+    bool attempt() override;
+
+private:
+    EventLoop& loop_;
+    SocketId listener_;
+    SocketId accepted_ = 0;
+};
+
+// A connected socket for coroutines; closes it when destroyed. Only from
+// the thread running the loop.
+class AsyncConnection {
+public:
+    AsyncConnection() = default;
+    AsyncConnection(EventLoop& loop, SocketId socket, SocketError error = SocketError::NONE)
+        : loop_(&loop), socket_(socket), error_(error) {}
+    AsyncConnection(AsyncConnection&& other) noexcept;
+    AsyncConnection& operator=(AsyncConnection&& other) noexcept;
+    ~AsyncConnection() { close(); }
+
+    // Completes with at least one byte, the end of the stream, or an error
+    ReadAwaiter read(std::span<uint8_t> buffer) { return ReadAwaiter(*loop_, socket_, buffer); }
+    // Completes once some of data is queued for sending, or with an error
+    WriteAwaiter write(std::span<const uint8_t> data) { return WriteAwaiter(*loop_, socket_, data); }
+    // Sends what is queued, then the FIN; a coroutine waiting on it wakes
+    // with INVALID
+    void close();
+
+    bool is_open() const { return socket_ != 0; }
+    SocketId get_socket() const { return socket_; }
+    // Why connecting failed
+    SocketError get_error() const { return error_; }
+
+private:
+    EventLoop* loop_ = nullptr;
+    SocketId socket_ = 0;
+    SocketError error_ = SocketError::NONE;
+};
+
+class AsyncListener {
+public:
+    AsyncListener() = default;
+    AsyncListener(EventLoop& loop, SocketId socket) : loop_(&loop), socket_(socket) {}
+    AsyncListener(AsyncListener&& other) noexcept;
+    AsyncListener& operator=(AsyncListener&& other) noexcept;
+    ~AsyncListener() { close(); }
+
+    AcceptAwaiter accept() { return AcceptAwaiter(*loop_, socket_); }
+    void close();
+
+    bool is_open() const { return socket_ != 0; }
+    SocketId get_socket() const { return socket_; }
+
+private:
+    EventLoop* loop_ = nullptr;
+    SocketId socket_ = 0;
+};
+
+struct EventLoopStats {
+    uint64_t polls = 0;
+    uint64_t resumed = 0;       // coroutines woken with a result
+    uint64_t suspended = 0;     // awaits that had to wait
+};
+
+// Runs coroutines against a TCPIPStack's sockets. run_once() drives the
+// stack with poll() and resumes every coroutine whose socket became ready,
+// all on the calling thread, so coroutines never race with the stack or
+// each other. At most one coroutine reads and one writes a socket at a
+// time. Coroutines still waiting when the loop is destroyed are destroyed
+// with it, closing the sockets they hold.
+class EventLoop {
+public:
+    static constexpr size_t EVENT_BATCH = 64;  // readiness events taken per turn
+
+    explicit EventLoop(TCPIPStack& stack) : stack_(stack) {}
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // A closed listener if the port is taken or sockets cannot be used
+    AsyncListener listen(uint16_t port, size_t backlog = 128);
+    ConnectAwaiter connect(uint32_t address, uint16_t port);
+
+    // One turn: poll() the stack, then resume whatever became ready.
+    // Returns the coroutines resumed.
+    size_t run_once();
+    // Turns until nothing waits on a socket, or turns run out
+    size_t run(size_t max_turns = SIZE_MAX);
+
+    TCPIPStack& get_stack() { return stack_; }
+    size_t get_waiting() const { return waiting_; }
+    EventLoopStats get_stats() const { return stats_; }
+
+    // For the awaiters: parks waiter until socket has one of events
+    void wait(SocketId socket, uint32_t events, SocketWaiter& waiter);
+    // For close(): wakes whatever waits on the socket on the next turn
+    void forget(SocketId socket);
+
+private:
+    struct Waiters {
+        SocketId socket = 0;
+        SocketWaiter* reader = nullptr;     // READABLE: read, accept
+        SocketWaiter* writer = nullptr;     // WRITABLE: write, connect
+        uint32_t interest = 0;              // as last given to watch()
+    };
+
+    TCPIPStack& stack_;
+    std::vector<Waiters> waiters_;          // by socket slot
+    std::vector<SocketWaiter*> orphans_;    // their socket was closed under them
+    std::array<SocketEvent, EVENT_BATCH> events_{};
+    size_t waiting_ = 0;
+    EventLoopStats stats_;
+
+    bool resume(SocketWaiter*& waiter);
+    void rewatch(uint32_t index);
+};
@@ -0,0 +1,44 @@
+#pragma once
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+
+struct FramePoolStats {
+    uint64_t allocations = 0;
+    uint64_t reused = 0;        // served from a free list
+    uint64_t oversize = 0;      // too large to pool, from operator new
+};
+
+// Coroutine frames, recycled through per-size-class free lists. A frame
+// is freed on the thread that runs the coroutine, which for sockets is the
+// one driving the stack, so the lists are per thread and take no locks.
+// Freed frames are kept for reuse until the thread exits.
+class FramePool {
+public:
+    static constexpr size_t CLASS_SIZE = 64;
+    static constexpr size_t MAX_POOLED = 4096;  // larger frames are not pooled
+
+    static void* allocate(size_t size);
+    static void release(void* frame, size_t size);
+    // This thread's
+    static FramePoolStats get_stats();
+};
+
+// A coroutine that runs as soon as it is called, until its first co_await
+// that suspends. Nothing owns or awaits it: whatever it waits for resumes
+// it, and the frame is freed when the body returns. An exception escaping
+// the body terminates, as the stack uses none.
+class Task {
+public:
+    struct promise_type {
+        Task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+
+        static void* operator new(size_t size) { return FramePool::allocate(size); }
+        static void operator delete(void* frame, size_t size) { FramePool::release(frame, size); }
+    };
+};
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <span>
+#include "ethernet/ethernet_frame.h"
+#include "util/byte_order.h"
+
+// Non-owning, read-only view of an Ethernet frame sitting in a capture buffer.
+// Header fields are decoded on demand and the payload is handed on as a
+// subspan, so nothing is copied or allocated on the receive path.
+class EthernetView {
+public:
+    static constexpr size_t HEADER_SIZE = 14;
+
+    EthernetView() = default;
+
+    // Returns false if the buffer cannot hold an Ethernet header
+    bool parse(std::span<const uint8_t> data) {
+        if (data.size() < HEADER_SIZE) {
+            return false;
+        }
+        data_ = data;
+        return true;
+    }
+
+    std::array<uint8_t, 6> get_destination_mac() const { return read_mac(0); }
+    std::array<uint8_t, 6> get_source_mac() const { return read_mac(6); }
+    uint16_t get_ethertype() const { return read_be16(data_.data() + 12); }
+
+    // Decodes the full header into the owning representation
+    EthernetHeader get_header() const {
+        return EthernetHeader{get_destination_mac(), get_source_mac(), get_ethertype()};
+    }
+
+    std::span<const uint8_t> get_payload() const { return data_.subspan(HEADER_SIZE); }
+    std::span<const uint8_t> get_bytes() const { return data_; }
+
+private:
+    std::span<const uint8_t> data_;
+
+    std::array<uint8_t, 6> read_mac(size_t offset) const {
+        std::array<uint8_t, 6> mac;
+        for (size_t i = 0; i < mac.size(); ++i) {
+            mac[i] = data_[offset + i];
+        }
+        return mac;
+    }
+};
@@ -1,5 +1,92 @@
 #pragma once
 #include <cstdint>
+#include <cstddef>
 #include <vector>
+#include <span>
+#include <initializer_list>
 
+// RFC 1071 Internet checksum. Results are numeric 16-bit values, ready to be
+// written big-endian into a header.
 uint16_t calculate_checksum(const std::vector<uint8_t>& data);
+uint16_t calculate_checksum(std::span<const uint8_t> data);
+
+// Scatter-gather variants: checksum the concatenation of all parts (e.g.
+// pseudo-header + header + payload) without copying them together first.
+// Parts may have odd lengths.
+uint16_t calculate_checksum(std::initializer_list<std::span<const uint8_t>> parts);
+uint16_t calculate_checksum(std::span<const std::span<const uint8_t>> parts);
+
+// Partial sums for building a checksum piecewise. checksum_partial() adds
+// data (which must start at an even offset of the checksummed stream) to a
+// running ones' complement sum; checksum_finish() folds and complements it.
+uint32_t checksum_partial(std::span<const uint8_t> data, uint32_t sum = 0);
+uint16_t checksum_finish(uint32_t sum);
+
+// Copies src to dst and returns the updated partial sum of the copied bytes,
+// working in cache-sized blocks so the data is only pulled in from memory once.
+uint32_t checksum_partial_copy(uint8_t* dst, std::span<const uint8_t> src, uint32_t sum = 0);
+
+// Streaming accumulator that folds header fields and buffers into one sum in
+// stream order, tracking odd byte offsets across calls, so checksummed data
+// never has to be laid out contiguously first.
+class ChecksumAccumulator {
+public:
+    void add(std::span<const uint8_t> data) {
+        add_partial(checksum_partial(data), data.size());
+    }
+
+    // A sum previously computed with checksum_partial() over length bytes
+    void add_partial(uint32_t partial, size_t length) {
+        add_aligned(partial);
+        odd_offset_ ^= (length & 1) != 0;
+    }
+
+    void add8(uint8_t value) {
+        add_aligned(static_cast<uint32_t>(value) << 8);
+        odd_offset_ = !odd_offset_;
+    }
+
+    void add16(uint16_t value) { add_aligned(value); }
+
+    void add32(uint32_t value) {
+        add_aligned(value >> 16);
+        add_aligned(value & 0xFFFF);
+    }
+
+    uint32_t get_partial() const { return sum_; }
+    uint16_t finish() const { return checksum_finish(sum_); }
+
+private:
+    uint32_t sum_ = 0;
+    bool odd_offset_ = false;
+
+    // Adds a 16-bit-aligned sum; data starting at an odd offset pairs its bytes
+    // the other way round, which for a ones' complement sum is a byte swap
+    void add_aligned(uint32_t value) {
+        value = (value & 0xFFFF) + (value >> 16);
+        value = (value & 0xFFFF) + (value >> 16);
+        if (odd_offset_) {
+            value = ((value & 0xFF) << 8) | (value >> 8);
+        }
+        sum_ += value;
+        sum_ = (sum_ & 0xFFFF) + (sum_ >> 16);
+    }
+};
+
+// Incremental update after a header field changes (RFC 1624, eqn. 3):
+// HC' = ~(~HC + ~m + m'). O(1) regardless of how much data is covered.
+uint16_t checksum_update16(uint16_t checksum, uint16_t old_value, uint16_t new_value);
+uint16_t checksum_update32(uint16_t checksum, uint32_t old_value, uint32_t new_value);
+
+// Summing kernels. The fastest supported one is picked at first use.
+enum class ChecksumKernel {
+    PORTABLE,
+    SSE2,
+    AVX2
+};
+
+bool checksum_kernel_supported(ChecksumKernel kernel);
+ChecksumKernel get_checksum_kernel();
+// Forces a specific kernel (tests and benchmarks); false if unsupported
+bool set_checksum_kernel(ChecksumKernel kernel);
+const char* checksum_kernel_name(ChecksumKernel kernel);
@@ -1,7 +1,11 @@
 #pragma once
 #include <cstdint>
+#include <cstddef>
 #include <vector>
 #include <array>
+#include <span>
+
+class PacketHandle;
 
 struct IPv4Header {
     uint8_t version_ihl;
@@ -26,18 +30,38 @@ public:
     void set_destination_ip(const std::array<uint8_t, 4>& ip);
     void set_payload(const std::vector<uint8_t>& payload);
     void set_ttl(uint8_t ttl);
+    void set_identification(uint16_t identification);
+    
+    // Forwarding/NAT rewrites. These patch header_checksum incrementally
+    // (RFC 1624) instead of re-summing the header.
+    bool decrement_ttl(); // false if the packet must be dropped (TTL expired)
+    void rewrite_source_ip(const std::array<uint8_t, 4>& ip);
+    void rewrite_destination_ip(const std::array<uint8_t, 4>& ip);
     
     uint16_t calculate_checksum() const;
     std::vector<uint8_t> serialize() const;
     bool deserialize(const std::vector<uint8_t>& data);
     
+    // In-place encapsulation. write_header_to() fills the first HEADER_SIZE
+    // bytes of out with the header for a payload_length-byte payload, total
+    // length and checksum included; the stored payload is not used.
+    // prepend_to() does the same in the packet's headroom, for its current
+    // contents. False if there is no room or the payload is too long.
+    bool write_header_to(std::span<uint8_t> out, size_t payload_length) const;
+    bool prepend_to(PacketHandle& packet) const;
+    
     const IPv4Header& get_header() const { return header_; }
     const std::vector<uint8_t>& get_payload() const { return payload_; }
 
     static constexpr uint8_t PROTOCOL_TCP = 6;
     static constexpr uint8_t PROTOCOL_UDP = 17;
+    static constexpr size_t HEADER_SIZE = 20; // serialized without options
+    static constexpr size_t MAX_PAYLOAD = 65535 - HEADER_SIZE;
 
 private:
-    IPv4Header header_;
+    IPv4Header header_{};
     std::vector<uint8_t> payload_;
+    
+    uint16_t header_checksum(uint16_t total_length) const;
+    void write_header(uint8_t* out, uint16_t total_length) const;
 };
@@ -0,0 +1,143 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <span>
+#include <vector>
+#include "buffer/packet_pool.h"
+
+class IPv4View;
+
+// Every held fragment takes one buffer from the reassembler's pool, so the
+// pool should have max_fragments buffers to itself; a pool shared with
+// receive would let a fragment flood starve other traffic.
+struct ReassemblyConfig {
+    size_t max_datagrams = 256;              // in progress at once; the oldest is evicted for a new one
+    size_t max_fragments = 1024;             // buffered fragments across all datagrams, one pool buffer each
+    size_t max_fragments_per_datagram = 64;
+    size_t max_buffered_bytes = 1 << 20;     // fragment payload bytes held across all datagrams
+    size_t max_datagram_size = 65535;        // reassembled size, header included
+    uint64_t timeout_ns = 30'000'000'000ULL; // from the first fragment, as in Linux
+};
+
+struct ReassemblyStats {
+    uint64_t fragments = 0;        // fragments offered
+    uint64_t completed = 0;        // datagrams reassembled
+    uint64_t timeouts = 0;         // datagrams expired incomplete
+    uint64_t evicted = 0;          // datagrams dropped to make room
+    uint64_t overlaps = 0;         // datagrams dropped for overlapping fragments
+    uint64_t duplicates = 0;       // exact repeats of a held fragment, ignored
+    uint64_t invalid = 0;          // bad length or offset, or over a per-datagram cap
+    uint64_t no_buffer = 0;        // fragments dropped because the pool was empty
+    size_t pending_datagrams = 0;
+    size_t buffered_bytes = 0;
+};
+
+enum class ReassemblyResult {
+    COMPLETE,  // the datagram is whole
+    PENDING,   // held until the rest arrives
+    DROPPED    // the fragment, and possibly its datagram, was discarded
+};
+
+// Reassembles fragmented IPv4 datagrams keyed by (source, destination,
+// protocol, identification), owned by a single thread.
+//
+// Each fragment's payload is copied once into a pooled buffer and linked
+// into its datagram's offset-ordered list; the datagram is copied out once
+// when it completes, so no byte moves more than twice. All tables are
+// allocated up front and every limit is a fixed cap, so a fragment flood
+// costs at most a bounded walk per fragment and never grows memory.
+// Overlapping fragments drop the whole datagram (as RFC 5722 requires for
+// IPv6) since they are only ever sent to evade inspection.
+class IPv4Reassembler {
+public:
+    IPv4Reassembler(PacketPool& pool, const ReassemblyConfig& config = {});
+
+    IPv4Reassembler(const IPv4Reassembler&) = delete;
+    IPv4Reassembler& operator=(const IPv4Reassembler&) = delete;
+
+    // Adds a parsed fragment (is_fragment() is true). On COMPLETE, datagram
+    // views the reassembled packet with a fresh, unfragmented header; it
+    // stays valid until the next call.
+    ReassemblyResult add(const IPv4View& fragment, uint64_t now_ns, std::span<const uint8_t>& datagram);
+
+    // Drops datagrams whose timeout has passed; returns how many
+    size_t expire(uint64_t now_ns);
+    // When expire() next has work, UINT64_MAX if nothing is pending
+    uint64_t get_next_deadline() const { return oldest_ != NONE ? datagrams_[oldest_].deadline_ns : UINT64_MAX; }
+
+    ReassemblyStats get_stats() const;
+
+private:
+    static constexpr uint32_t NONE = UINT32_MAX;
+    static constexpr size_t MAX_HEADER_SIZE = 60;
+
+    struct Key {
+        uint32_t source;
+        uint32_t destination;
+        uint16_t identification;
+        uint8_t protocol;
+
+        bool operator==(const Key&) const = default;
+    };
+
+    struct Fragment {
+        PacketHandle data;
+        uint32_t offset = 0;
+        uint32_t length = 0;
+        uint32_t next = NONE;       // next by offset, or next free
+    };
+
+    struct Datagram {
+        Key key{};
+        uint64_t deadline_ns = 0;
+        uint32_t first = NONE;      // fragments ordered by offset
+        uint32_t fragment_count = 0;
+        uint32_t received = 0;      // payload bytes held
+        uint32_t total = 0;         // payload length, once the last fragment arrived
+        bool have_last = false;
+        uint8_t header_length = 0;  // of the offset-0 fragment, 0 until it arrives
+        uint8_t header[MAX_HEADER_SIZE];
+        uint32_t older = NONE;      // age list, oldest first
+        uint32_t newer = NONE;
+        bool in_use = false;
+    };
+
+    PacketPool& pool_;
+    ReassemblyConfig config_;
+
+    std::vector<Datagram> datagrams_;
+    std::vector<uint32_t> free_datagrams_;
+    std::vector<uint32_t> index_;   // open addressing over datagrams_, NONE when empty
+    size_t index_mask_;
+    uint32_t oldest_ = NONE;
+    uint32_t newest_ = NONE;
+
+    std::vector<Fragment> fragments_;
+    uint32_t free_fragment_ = NONE;
+    size_t buffered_bytes_ = 0;
+
+    std::vector<uint8_t> output_;
+
+    // Written only by the owning thread, readable from any
+    std::atomic<uint64_t> fragments_seen_{0};
+    std::atomic<uint64_t> completed_{0};
+    std::atomic<uint64_t> timeouts_{0};
+    std::atomic<uint64_t> evicted_{0};
+    std::atomic<uint64_t> overlaps_{0};
+    std::atomic<uint64_t> duplicates_{0};
+    std::atomic<uint64_t> invalid_{0};
+    std::atomic<uint64_t> no_buffer_{0};
+    std::atomic<size_t> pending_{0};
+    std::atomic<size_t> buffered_{0};
+
+    static uint64_t hash_key(const Key& key);
+    uint32_t find(const Key& key) const;
+    uint32_t create(const Key& key, uint64_t now_ns);
+    void release(uint32_t index);
+    void make_room(size_t length, uint32_t keep);
+
+    ReassemblyResult insert(Datagram& datagram, const IPv4View& fragment, uint32_t offset,
+                            std::span<const uint8_t> payload, bool last);
+    std::span<const uint8_t> assemble(Datagram& datagram);
+};
@@ -0,0 +1,148 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <span>
+#include "ip/ipv4_packet.h"
+#include "ip/checksum.h"
+#include "util/byte_order.h"
+
+// Non-owning, read-only view of an IPv4 packet inside a capture buffer.
+// parse() validates the header and total length; the payload is the subspan
+// between the header (including options) and total_length, which drops any
+// link-layer padding without copying.
+class IPv4View {
+public:
+    static constexpr size_t MIN_HEADER_SIZE = 20;
+    static constexpr uint16_t FLAG_DF = 0x4000;
+    static constexpr uint16_t FLAG_MF = 0x2000;
+    static constexpr uint16_t FRAGMENT_OFFSET_MASK = 0x1FFF;
+
+    IPv4View() = default;
+
+    // Returns false on truncated buffers, a non-IPv4 version or a bad IHL
+    bool parse(std::span<const uint8_t> data) {
+        if (data.size() < MIN_HEADER_SIZE) {
+            return false;
+        }
+        if ((data[0] >> 4) != 4) {
+            return false;
+        }
+
+        size_t header_length = static_cast<size_t>(data[0] & 0x0F) * 4;
+        size_t total_length = read_be16(data.data() + 2);
+        if (header_length < MIN_HEADER_SIZE || total_length < header_length ||
+            total_length > data.size()) {
+            return false;
+        }
+
+        data_ = data.first(total_length);
+        return true;
+    }
+
+    uint8_t get_version() const { return data_[0] >> 4; }
+    uint8_t get_ihl() const { return data_[0] & 0x0F; }
+    size_t get_header_length() const { return static_cast<size_t>(get_ihl()) * 4; }
+    uint8_t get_dscp_ecn() const { return data_[1]; }
+    uint16_t get_total_length() const { return read_be16(data_.data() + 2); }
+    uint16_t get_identification() const { return read_be16(data_.data() + 4); }
+    uint16_t get_flags_fragment_offset() const { return read_be16(data_.data() + 6); }
+    uint8_t get_ttl() const { return data_[8]; }
+    uint8_t get_protocol() const { return data_[9]; }
+    uint16_t get_header_checksum() const { return read_be16(data_.data() + 10); }
+
+    std::array<uint8_t, 4> get_source_ip() const { return read_ip(12); }
+    std::array<uint8_t, 4> get_destination_ip() const { return read_ip(16); }
+
+    // Addresses as host-order integers, for hashing and table keys
+    uint32_t get_source_address() const { return read_be32(data_.data() + 12); }
+    uint32_t get_destination_address() const { return read_be32(data_.data() + 16); }
+
+    // Fragment offset in bytes
+    size_t get_fragment_offset() const {
+        return static_cast<size_t>(get_flags_fragment_offset() & FRAGMENT_OFFSET_MASK) * 8;
+    }
+    bool has_more_fragments() const { return (get_flags_fragment_offset() & FLAG_MF) != 0; }
+    bool is_fragment() const { return has_more_fragments() || get_fragment_offset() != 0; }
+
+    // Summing a header that includes its checksum gives zero when intact
+    bool has_valid_checksum() const { return calculate_checksum(get_header_bytes()) == 0; }
+
+    // Decodes the fixed header into the owning representation
+    IPv4Header get_header() const {
+        IPv4Header header;
+        header.version_ihl = data_[0];
+        header.dscp_ecn = get_dscp_ecn();
+        header.total_length = get_total_length();
+        header.identification = get_identification();
+        header.flags_fragment_offset = get_flags_fragment_offset();
+        header.ttl = get_ttl();
+        header.protocol = get_protocol();
+        header.header_checksum = get_header_checksum();
+        header.source_ip = get_source_ip();
+        header.dest_ip = get_destination_ip();
+        return header;
+    }
+
+    std::span<const uint8_t> get_header_bytes() const { return data_.first(get_header_length()); }
+    std::span<const uint8_t> get_options() const {
+        return data_.subspan(MIN_HEADER_SIZE, get_header_length() - MIN_HEADER_SIZE);
+    }
+    std::span<const uint8_t> get_payload() const { return data_.subspan(get_header_length()); }
+    std::span<const uint8_t> get_bytes() const { return data_; }
+
+private:
+    std::span<const uint8_t> data_;
+
+    std::array<uint8_t, 4> read_ip(size_t offset) const {
+        return {data_[offset], data_[offset + 1], data_[offset + 2], data_[offset + 3]};
+    }
+};
+
+// Writable view for in-place forwarding/NAT rewrites. Every setter patches the
+// header checksum incrementally (RFC 1624) rather than re-summing the header.
+class IPv4MutableView : public IPv4View {
+public:
+    IPv4MutableView() = default;
+
+    bool parse(std::span<uint8_t> data) {
+        if (!IPv4View::parse(data)) {
+            return false;
+        }
+        bytes_ = data.data();
+        return true;
+    }
+
+    // Returns false if the TTL expired and the packet must be dropped
+    bool decrement_ttl() {
+        if (get_ttl() <= 1) {
+            return false;
+        }
+        set_ttl(get_ttl() - 1);
+        return true;
+    }
+
+    void set_ttl(uint8_t ttl) {
+        // TTL shares a 16-bit header word with the protocol field
+        uint16_t old_word = read_be16(bytes_ + 8);
+        bytes_[8] = ttl;
+        patch_checksum16(old_word, read_be16(bytes_ + 8));
+    }
+
+    void set_source_ip(const std::array<uint8_t, 4>& ip) { rewrite_address(12, ip); }
+    void set_destination_ip(const std::array<uint8_t, 4>& ip) { rewrite_address(16, ip); }
+
+private:
+    uint8_t* bytes_ = nullptr;
+
+    void patch_checksum16(uint16_t old_word, uint16_t new_word) {
+        write_be16(bytes_ + 10, checksum_update16(read_be16(bytes_ + 10), old_word, new_word));
+    }
+
+    void rewrite_address(size_t offset, const std::array<uint8_t, 4>& ip) {
+        uint32_t old_address = read_be32(bytes_ + offset);
+        uint32_t new_address = read_be32(ip.data());
+        write_be32(bytes_ + offset, new_address);
+        write_be16(bytes_ + 10, checksum_update32(read_be16(bytes_ + 10), old_address, new_address));
+    }
+};
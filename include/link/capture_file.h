@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <string>
+#include <vector>
+
+struct CapturedPacket {
+    uint64_t timestamp_ns = 0;
+    uint32_t original_length = 0;
+    uint16_t link_type = 0;
+    std::span<const uint8_t> data; // points into the mapped file
+};
+
+// Memory-mapped reader for pcap and pcapng capture files. Packets are
+// returned as spans into the mapping, so reading never copies packet data.
+class CaptureFile {
+public:
+    static constexpr uint16_t LINKTYPE_ETHERNET = 1;
+
+    CaptureFile() = default;
+    ~CaptureFile();
+
+    CaptureFile(const CaptureFile&) = delete;
+    CaptureFile& operator=(const CaptureFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    // Returns false at the end of the file or on a corrupt record
+    bool next(CapturedPacket& packet);
+    // Starts reading from the first packet again
+    void rewind();
+
+    bool is_pcapng() const { return pcapng_; }
+    // Reading stopped early because a record was truncated or malformed
+    bool is_truncated() const { return truncated_; }
+    size_t get_file_size() const { return size_; }
+
+private:
+    struct Interface {
+        uint16_t link_type;
+        bool binary_resolution; // timestamps in units of 2^-exponent seconds
+        uint8_t exponent;       // otherwise 10^-exponent seconds
+    };
+
+    const uint8_t* base_ = nullptr;
+    size_t size_ = 0;
+    size_t offset_ = 0;
+    bool pcapng_ = false;
+    bool swapped_ = false;
+    bool truncated_ = false;
+
+    // Classic pcap
+    bool nanosecond_ = false;
+    uint16_t link_type_ = 0;
+
+    // pcapng
+    std::vector<Interface> interfaces_;
+
+    bool parse_file_header();
+    bool next_pcap(CapturedPacket& packet);
+    bool next_pcapng(CapturedPacket& packet);
+    bool parse_section_header(size_t offset, size_t block_length);
+    void parse_interface(const uint8_t* body, size_t body_length);
+    uint64_t to_nanoseconds(const Interface& interface, uint64_t ticks) const;
+
+    uint16_t read16(const uint8_t* p) const;
+    uint32_t read32(const uint8_t* p) const;
+};
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <random>
+#include <vector>
+
+struct LossyLinkConfig {
+    uint64_t delay_ns = 10'000'000;     // one-way propagation
+    uint64_t rate_bps = 20'000'000;     // serialization rate, 0 for unlimited
+    size_t queue_bytes = 64 * 1024;     // drop-tail buffer in front of the wire
+    double loss = 0;                    // chance each packet is lost on the wire
+    uint64_t seed = 1;
+};
+
+struct LossyLinkStats {
+    uint64_t sent = 0;          // packets offered
+    uint64_t delivered = 0;
+    uint64_t lost = 0;          // random loss
+    uint64_t queue_drops = 0;   // the queue was full
+    uint64_t bytes_delivered = 0;
+};
+
+// One direction of a simulated link for in-process tests: a drop-tail
+// queue draining at a fixed rate, then a fixed delay, with independent
+// random loss. It runs on the caller's clock, so a transfer over it is
+// deterministic for a given seed and takes no wall time.
+class LossyLink {
+public:
+    explicit LossyLink(const LossyLinkConfig& config = {});
+
+    // Queues a packet at now_ns; false if the queue had no room
+    bool send(std::vector<uint8_t> packet, uint64_t now_ns);
+    // Takes the next packet that has arrived by now_ns
+    bool receive(uint64_t now_ns, std::vector<uint8_t>& packet);
+    // When the next packet arrives, UINT64_MAX if none is in flight
+    uint64_t get_next_arrival() const { return in_flight_.empty() ? UINT64_MAX : in_flight_.front().arrival_ns; }
+
+    LossyLinkStats get_stats() const { return stats_; }
+
+private:
+    struct InFlight {
+        uint64_t arrival_ns;
+        std::vector<uint8_t> packet;
+    };
+
+    LossyLinkConfig config_;
+    std::mt19937_64 rng_;
+    std::bernoulli_distribution lose_;
+    std::deque<InFlight> in_flight_;   // in arrival order
+    uint64_t wire_free_ns_ = 0;        // when the last queued packet finishes serializing
+    LossyLinkStats stats_;
+};
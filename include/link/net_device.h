@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include "buffer/packet_pool.h"
+
+// What TCPIPStack receives frames from and sends them to: a pcap handle, a
+// virtual wire to another stack in the same process, or anything else that
+// moves Ethernet frames in bursts.
+class NetDevice {
+public:
+    virtual ~NetDevice() = default;
+
+    virtual bool is_open() const = 0;
+    virtual void close() = 0;
+
+    // Moves up to max_packets received frames into out[]; returns how many.
+    // Frames are normally copied into pool, but a device may hand over
+    // buffers it already holds. Returns 0 when nothing has arrived, after
+    // at most a short wait.
+    virtual size_t rx_burst(PacketPool& pool, PacketHandle* out, size_t max_packets) = 0;
+
+    // Sends packets in order; returns how many the device accepted
+    virtual size_t tx_burst(const PacketHandle* packets, size_t count) = 0;
+
+    // Makes a blocked rx_burst() return early (safe from another thread)
+    virtual void break_loop() {}
+
+    // No frame will ever arrive again, like the end of a savefile
+    virtual bool at_end() const { return false; }
+    // Frames larger than a pool buffer, dropped on receive
+    virtual uint64_t get_dropped_oversize() const { return 0; }
+};
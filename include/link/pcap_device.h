@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <string>
+#include "buffer/packet_pool.h"
+#include "link/net_device.h"
+
+typedef struct pcap pcap_t;
+
+struct PcapConfig {
+    int snaplen = 65535;
+    bool promiscuous = true;
+    bool immediate_mode = true;         // deliver packets as they arrive, no batching delay
+    int buffer_size = 4 * 1024 * 1024;  // kernel capture buffer in bytes (0 = libpcap default)
+    int timeout_ms = 10;                // read timeout; bounds how long an idle read blocks
+};
+
+// libpcap-backed packet source that receives in bursts. Packets are copied
+// once from libpcap's buffer into pooled buffers the stack can hold on to.
+class PcapDevice final : public NetDevice {
+public:
+    PcapDevice() = default;
+    ~PcapDevice() override;
+
+    PcapDevice(const PcapDevice&) = delete;
+    PcapDevice& operator=(const PcapDevice&) = delete;
+
+    bool open_live(const std::string& interface, const PcapConfig& config = {});
+    bool open_offline(const std::string& path);
+    void close() override;
+    bool is_open() const override { return handle_ != nullptr; }
+
+    // Drains up to max_packets into out[] with one pcap_dispatch call.
+    // Returns the number received; 0 on timeout, end of file or error. An
+    // error ends the device, like the end of a savefile.
+    size_t rx_burst(PacketPool& pool, PacketHandle* out, size_t max_packets) override;
+
+    // Sends packets in order; returns how many the device accepted
+    size_t tx_burst(const PacketHandle* packets, size_t count) override;
+
+    // Makes a blocked rx_burst() return early (safe from another thread)
+    void break_loop() override;
+
+    // An offline savefile has been read to the end, or reading failed
+    bool at_end() const override { return at_end_; }
+    // What libpcap said of the read that failed; empty if none did
+    const std::string& get_error() const { return error_; }
+    uint64_t get_dropped_oversize() const override { return dropped_oversize_.load(std::memory_order_relaxed); }
+
+private:
+    pcap_t* handle_ = nullptr;
+    bool offline_ = false;
+    bool at_end_ = false;
+    std::string error_;
+    std::atomic<uint64_t> dropped_oversize_{0};
+
+    struct BurstContext {
+        PcapDevice* device;
+        PacketPool* pool;
+        PacketHandle* out;
+        size_t count;
+    };
+
+    static void on_packet(uint8_t* user, const struct pcap_pkthdr* header, const uint8_t* bytes);
+};
@@ -0,0 +1,121 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <random>
+#include <vector>
+#include "core/ring.h"
+#include "link/net_device.h"
+
+// One direction of a VirtualWire
+struct WireLinkConfig {
+    uint64_t rate_bps = 0;              // serialization rate, 0 for unlimited
+    uint64_t latency_ns = 0;            // one-way propagation
+    uint64_t jitter_ns = 0;             // extra delay, uniform up to this; frames stay in order
+    double loss = 0;                    // chance each frame is lost on the wire
+    double reorder = 0;                 // chance a frame is held back by reorder_ns, so later ones pass it
+    uint64_t reorder_ns = 1'000'000;
+    size_t queue_bytes = 1 << 20;       // drop-tail buffer in front of the rate limit
+    uint64_t seed = 1;
+};
+
+struct VirtualWireConfig {
+    WireLinkConfig a_to_b;
+    WireLinkConfig b_to_a;
+    size_t ring_size = 4096;            // frames per direction sent but not yet taken by the receiver
+    PacketPoolConfig pool;              // per direction; bounds the frames in flight
+    uint64_t (*clock)() = nullptr;      // monotonic nanoseconds; steady_clock when null
+};
+
+struct WireStats {
+    uint64_t sent = 0;          // frames offered
+    uint64_t delivered = 0;
+    uint64_t lost = 0;          // random loss
+    uint64_t queue_drops = 0;   // the queue in front of the rate limit was full
+    uint64_t overflows = 0;     // the ring or the pool was full: the receiver fell behind, or too much was in flight
+    uint64_t reordered = 0;     // held back so later frames passed
+    uint64_t bytes_delivered = 0;
+};
+
+class VirtualWire;
+
+// One end of a VirtualWire, as the NetDevice of a TCPIPStack. A frame is
+// copied once, into a buffer of the direction's pool, which the receiver
+// gets as it is; the sender's buffer goes back to its pool at once.
+class VirtualPort final : public NetDevice {
+public:
+    bool is_open() const override { return open_.load(std::memory_order_relaxed); }
+    // Frames sent either way afterwards are refused
+    void close() override { open_.store(false, std::memory_order_relaxed); }
+    // Takes frames that have arrived by now, in the wire's buffers rather
+    // than pool's
+    size_t rx_burst(PacketPool& pool, PacketHandle* out, size_t max_packets) override;
+    size_t tx_burst(const PacketHandle* packets, size_t count) override;
+
+    // The direction this end sends on. Read while neither end is in use.
+    WireStats get_stats() const;
+    // When the next frame already taken off the ring arrives, UINT64_MAX if none
+    uint64_t get_next_arrival() const { return arrivals_.empty() ? UINT64_MAX : arrivals_.front().arrival_ns; }
+
+private:
+    friend class VirtualWire;
+
+    struct InFlight {
+        uint64_t arrival_ns;
+        uint64_t sequence;          // breaks ties in sending order
+        PacketHandle frame;
+    };
+    // Sending state of one direction, used by the sending end only
+    struct Shaper {
+        WireLinkConfig config;
+        std::mt19937_64 rng;
+        std::bernoulli_distribution lose;
+        std::bernoulli_distribution hold;
+        std::uniform_int_distribution<uint64_t> jitter;
+        uint64_t wire_free_ns = 0;  // when the last accepted frame finishes serializing
+        uint64_t last_arrival_ns = 0;
+        uint64_t sequence = 0;
+
+        explicit Shaper(const WireLinkConfig& config);
+    };
+
+    VirtualPort(const WireLinkConfig& config, size_t ring_size, const PacketPoolConfig& pool,
+                uint64_t (*clock)());
+    static bool arrives_later(const InFlight& a, const InFlight& b);
+
+    uint64_t (*clock_)();
+    std::atomic<bool> open_{true};
+    VirtualPort* peer_ = nullptr;
+    Shaper shaper_;
+    // Frames on their way to this end: the sending end produces, this
+    // end consumes, so each end may be polled from its own thread
+    PacketPool pool_;
+    SpscRing<InFlight> incoming_;
+    std::vector<InFlight> arrivals_;    // taken off the ring, min-heap by arrival
+    std::vector<InFlight> drained_;
+    // Counters of the direction starting here, then of the one ending here
+    WireStats sent_stats_;
+    uint64_t delivered_ = 0;
+    uint64_t bytes_delivered_ = 0;
+};
+
+// A cable between two TCPIPStacks in one process: what one end sends, the
+// other receives, after the link each direction models. Each direction
+// serializes at a rate behind a drop-tail queue, then adds latency and
+// jitter, and may lose or reorder frames. With a clock the caller advances,
+// a run is the same every time for the same seeds.
+class VirtualWire {
+public:
+    explicit VirtualWire(const VirtualWireConfig& config = {});
+
+    VirtualWire(const VirtualWire&) = delete;
+    VirtualWire& operator=(const VirtualWire&) = delete;
+
+    VirtualPort& get_a() { return *a_; }
+    VirtualPort& get_b() { return *b_; }
+
+private:
+    std::unique_ptr<VirtualPort> a_;
+    std::unique_ptr<VirtualPort> b_;
+};
@@ -3,20 +3,277 @@
 #include <memory>
 #include <thread>
 #include <atomic>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <array>
+#include <bitset>
+#include "buffer/packet_pool.h"
+#include "core/metrics.h"
+#include "core/rss.h"
+#include "core/ring.h"
+#include "ip/ipv4_reassembler.h"
+#include "link/pcap_device.h"
+#include "tcp/connection_table.h"
+#include "tcp/tcp_coalescer.h"
+#include "tcp/tcp_segment.h"
+#include "tcp/tcp_sender.h"
+#include "tcp/tcp_socket.h"
+
+class IPv4View;
+class TCPView;
+class Timer;
+struct TCPConnection;
+
+struct StackConfig {
+    PacketPoolConfig pool;      // RX buffers; bounds the memory a burst can use
+    PcapConfig pcap;            // live capture settings
+    size_t rx_burst_size = 32;  // packets drained per receive call
+    size_t worker_count = 0;    // 0 processes packets on the receiving thread
+    size_t worker_queue_depth = 4096; // packets queued per worker before dropping
+    size_t tx_ring_size = 1024; // packets queued for transmit before dropping
+    size_t connection_table_size = 1024; // initial slots per worker; grows incrementally
+    size_t receive_buffer_size = 65536; // per connection; the receive window
+    bool verify_tcp_checksum = false; // IPv4 header checksums are always checked
+    uint64_t time_wait_ns = 60'000'000'000ULL;      // 2*MSL
+    uint64_t keepalive_idle_ns = 7'200'000'000'000ULL; // idle time before a connection is dropped; 0 never
+    uint64_t delayed_ack_ns = 40'000'000; // longest an ACK of in-order data waits; 0 acknowledges every burst
+    uint64_t (*clock)() = nullptr; // monotonic nanoseconds for timers; steady_clock when null
+    ReassemblyConfig reassembly; // bounds memory held by incomplete datagrams; see reassembly_pool_
+    GroConfig gro;              // merging of back-to-back segments within a burst
+    // Sockets
+    uint32_t address = 0;       // this host's IPv4 address, host order; what connect() sends from
+    std::array<uint8_t, 6> mac{};           // source of every frame sent
+    std::array<uint8_t, 6> gateway_mac{};   // next hop for connect(); accepted connections answer the SYN's sender
+    SenderConfig sender;        // MSS, send buffer, congestion control and RTO; SACK and timestamps are negotiated
+    uint8_t syn_retries = 5;    // SYN, SYN-ACK or FIN resends before the connection is dropped
+    uint8_t data_retries = 15;  // data or window probe timeouts in a row before the connection is reset
+    uint64_t iss_secret = 0;    // keys initial sequence numbers; 0 picks one at random
+};
+
+// Why received packets never reached a protocol handler
+struct DropStats {
+    uint64_t no_buffer = 0;           // packet pool exhausted
+    uint64_t oversize = 0;            // capture larger than a pool buffer
+    uint64_t queue_full = 0;          // worker queue at its depth limit
+    uint64_t eth_too_short = 0;
+    uint64_t eth_unknown_type = 0;    // not IPv4
+    uint64_t ip_malformed = 0;        // truncated, bad version, IHL or length
+    uint64_t ip_bad_checksum = 0;
+    uint64_t ip_unknown_protocol = 0; // not TCP
+    uint64_t tcp_malformed = 0;       // truncated or bad data offset
+    uint64_t tcp_bad_checksum = 0;    // only with verify_tcp_checksum
+    uint64_t tcp_no_connection = 0;   // no connection and not a SYN to a listening port
+    uint64_t tcp_bad_state = 0;       // flags not valid in the connection's state
+};
+
+struct StackStats {
+    uint64_t rx_packets = 0;
+    uint64_t rx_bytes = 0;
+    std::vector<uint64_t> worker_packets; // packets processed by each worker
+    uint64_t tx_packets = 0;
+    uint64_t tx_dropped = 0;              // no buffer, too large, TX ring full or device refused
+    uint64_t connections = 0;             // open across all workers
+    DropStats drops;
+};
+
+enum class ReplayTiming {
+    ORIGINAL,            // reproduce the capture's inter-packet gaps
+    SCALED,              // original gaps divided by ReplayConfig::speed
+    AS_FAST_AS_POSSIBLE  // no pacing
+};
+
+struct ReplayConfig {
+    ReplayTiming timing = ReplayTiming::AS_FAST_AS_POSSIBLE;
+    double speed = 1.0;  // SCALED only: 2.0 replays twice as fast
+    size_t loops = 1;    // passes over the file
+};
+
+struct ReplayReport {
+    uint64_t packets = 0;
+    uint64_t bytes = 0;
+    uint64_t skipped = 0;        // records with a non-Ethernet link type
+    bool file_truncated = false; // stopped at a corrupt or truncated record
+    double elapsed_seconds = 0;
+    double packets_per_second = 0;
+    double bytes_per_second = 0;
+    DropStats drops;             // drops during this replay only
+    MetricsSnapshot metrics;     // counters during this replay only
+};
 
 class TCPIPStack {
 public:
-    TCPIPStack(const std::string& interface);
+    static constexpr size_t DEFAULT_BACKLOG = 128;
+    
+    TCPIPStack(const std::string& interface, const StackConfig& config = {});
+    // Runs on a device the caller owns and has opened, such as one end of a
+    // VirtualWire, instead of capturing from an interface. The device must
+    // outlive the stack; stop() leaves it open.
+    TCPIPStack(NetDevice& device, const StackConfig& config = {});
     ~TCPIPStack();
     
     bool start();
     void stop();
     
+    // Accepts connections on a local port. Only while stopped. Nothing
+    // reads them or sends on them: data is counted and discarded, as a
+    // passive observer of captured traffic would.
+    bool listen(uint16_t port);
+    
+    // Runs a pcap savefile through the same burst RX path on the calling
+    // thread. Fails if the stack is already running or was given a device.
+    bool process_savefile(const std::string& path);
+    
+    // Replays a memory-mapped pcap/pcapng file straight from the mapping on
+    // the calling thread, for reproducible throughput measurements. stop()
+    // from another thread ends it early.
+    bool replay(const std::string& path, const ReplayConfig& config, ReplayReport& report);
+    
+    // Fires every due timer on the calling thread. Only while stopped; a
+    // running stack does this on each burst and whenever it is idle.
+    size_t poll_timers();
+    
+    StackStats get_stats() const;
+    // Every layer's counters summed over the receiving thread and workers
+    MetricsSnapshot get_metrics() const;
+    
+    // Worker a frame is steered to: a symmetric RSS hash of the IPv4/TCP
+    // 4-tuple through an indirection table, so both directions of a
+    // connection land on the same worker
+    size_t select_worker(std::span<const uint8_t> frame) const;
+    
+    // Queues a frame for transmit from any thread; the receiving thread
+    // sends queued frames after each burst. False if the TX ring is full.
+    bool transmit(PacketHandle packet);
+    
+    // Sockets. An application drives the stack itself: it calls poll()
+    // in its own loop and everything else from the same thread, without
+    // start() and without workers; otherwise these calls fail. Nothing
+    // blocks. watch() and wait_events() tell which sockets are ready, in
+    // the style of epoll, so one loop serves any number of connections.
+    
+    // Opens the live device for poll() rather than start(); a device
+    // given to the constructor only has to be open already
+    bool open();
+    // One turn of the event loop: a burst from the device if it is open,
+    // frames this host sent to itself, due timers, then queued frames.
+    // Returns the packets received.
+    size_t poll();
+    
+    // Queues connections to port for accept() once established. SYNs are
+    // dropped while backlog connections are handshaking or waiting to be
+    // accepted. 0 if the port is taken.
+    SocketId listen_socket(uint16_t port, size_t backlog = DEFAULT_BACKLOG);
+    // The oldest established connection, 0 if there is none
+    SocketId accept(SocketId listener);
+    // Starts the handshake from StackConfig::address and a free ephemeral
+    // port. The socket turns WRITABLE once connected, CLOSED if refused.
+    SocketId connect(uint32_t address, uint16_t port);
+    IoResult send(SocketId socket, std::span<const uint8_t> data);
+    IoResult recv(SocketId socket, std::span<uint8_t> data);
+    // Releases the handle. A connection sends what is buffered, then its
+    // FIN, and finishes closing on its own. A listener resets the
+    // connections it has not handed out.
+    bool close(SocketId socket);
+    // The connection's addresses and ports; false if there is no connection
+    bool get_flow(SocketId socket, FlowKey& key) const;
+    // Why a connection ended; NONE while it is open or if it closed cleanly
+    SocketError get_error(SocketId socket) const;
+    // The SocketEvent flags a socket has now, watched or not; 0 if invalid
+    uint32_t get_events(SocketId socket) const;
+    
+    // Sets the SocketEvent flags to report for a socket, and the data they
+    // come with; 0 stops watching it
+    bool watch(SocketId socket, uint32_t events, uint64_t data = 0);
+    // Fills events with ready sockets without waiting; call after poll()
+    size_t wait_events(std::span<SocketEvent> events);
+    
 private:
+    static constexpr size_t RSS_TABLE_SIZE = 128;
+    static constexpr size_t TX_BURST_SIZE = 32;
+    static constexpr uint16_t EPHEMERAL_FIRST = 49152;
+    
+    // A received frame; buffer owns it unless it points into a replay mapping
+    struct RxItem {
+        PacketHandle buffer;
+        std::span<const uint8_t> frame;
+    };
+    struct RxContext;
+    struct Worker;
+    
     std::string interface_;
+    StackConfig config_;
+    uint64_t (*clock_)();
+    PacketPool pool_;
+    // Held fragments, one buffer each up to reassembly.max_fragments, so a
+    // fragment flood cannot take pool_'s buffers from other traffic
+    PacketPool reassembly_pool_;
+    PcapDevice pcap_;
+    NetDevice* device_;         // pcap_ unless the caller gave one
     std::atomic<bool> running_{false};
     std::thread capture_thread_;
+    MpscRing<PacketHandle> tx_ring_;
+    
+    std::bitset<65536> listening_ports_;
+    RssHasher hasher_;
+    std::array<uint16_t, RSS_TABLE_SIZE> rss_table_{};
+    // State of the receiving thread, which also processes packets when
+    // there are no workers
+    std::unique_ptr<RxContext> receive_context_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    // Per-worker staging for the current burst, receiving thread only
+    std::vector<std::vector<RxItem>> pending_;
+    // poll()'s burst
+    std::vector<PacketHandle> poll_burst_;
+    std::vector<RxItem> poll_items_;
+    std::vector<PacketHandle> poll_loopback_;
+    
+    SocketTable sockets_;
+    std::vector<uint32_t> listeners_;   // socket slot + 1 per port, for ports with a listening socket
+    uint16_t next_ephemeral_port_ = EPHEMERAL_FIRST;
+    uint64_t iss_secret_;
+    
+    void start_workers();
+    void stop_workers();
+    void worker_loop(Worker& worker);
+    void flush_tx();
+    uint32_t flow_hash(std::span<const uint8_t> frame) const;
     
     void capture_loop();
-    void process_packet(const std::vector<uint8_t>& packet_data);
+    void receive_bursts(bool lossless);
+    void deliver_burst(std::span<RxItem> items, bool lossless);
+    void steer_burst(std::span<RxItem> items, bool lossless);
+    bool hold_fragment(RxItem& item);
+    void process_burst(RxContext& context, std::span<const RxItem> items);
+    void process_packet(RxContext& context, std::span<const uint8_t> frame);
+    void process_ipv4(RxContext& context, std::span<const uint8_t> ip_data);
+    bool reassemble(RxContext& context, IPv4View& ip);
+    void process_tcp(RxContext& context, const IPv4View& ip, std::span<const uint8_t> tcp_data, bool may_hold);
+    void process_segment(RxContext& context, const CoalescedSegment& segment);
+    void record_options(TCPConnection& connection, const TCPOptions& options, bool opening);
+    void receive_payload(RxContext& context, TCPConnection& connection, const CoalescedSegment& segment);
+    void close_connection(RxContext& context, TCPConnection& connection, SocketError reason = SocketError::NONE);
+    
+    bool sockets_usable() const;
+    size_t deliver_loopback();
+    TCPConnection* open_connection(RxContext& context, const FlowKey& key);
+    void start_sender(TCPConnection& connection);
+    void process_ack(RxContext& context, TCPConnection& connection, const CoalescedSegment& segment,
+                     const TCPOptions& options);
+    bool establish(TCPConnection& connection);
+    void notify(const TCPConnection& connection);
+    uint32_t readiness(const SocketSlot& slot) const;
+    void queue_output(RxContext& context, TCPConnection& connection);
+    void flush_output(RxContext& context);
+    void output(RxContext& context, TCPConnection& connection);
+    void send_control(RxContext& context, TCPConnection& connection, uint8_t flags);
+    void send_segments(RxContext& context, TCPConnection& connection);
+    void send_frame(RxContext& context, TCPConnection& connection, const TCPSegment& segment);
+    void arm_retransmit(RxContext& context, TCPConnection& connection);
+    void on_retransmit_timer(RxContext& context, TCPConnection& connection);
+    void abort_connection(RxContext& context, TCPConnection& connection, SocketError reason);
+    
+    size_t run_timers(RxContext& context);
+    void on_timer(RxContext& context, Timer& timer);
+    void arm_reassembly_timer(RxContext& context);
 };
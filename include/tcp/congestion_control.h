@@ -0,0 +1,100 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+
+enum class CongestionAlgorithm {
+    NEW_RENO,   // RFC 5681 / RFC 6582
+    CUBIC       // RFC 9438, the Linux default
+};
+
+// Congestion window policy for one connection, driven by TCPSender.
+//
+// The sender owns loss detection and recovery; the algorithm only decides
+// how the window moves: on_ack() for new data acknowledged outside
+// recovery, and one call per congestion event. Fast recovery's per-dupack
+// inflation is the sender's too, so an algorithm sees a loss once.
+// Windows are in bytes.
+class CongestionControl {
+public:
+    explicit CongestionControl(uint32_t mss);
+    virtual ~CongestionControl() = default;
+
+    CongestionControl(const CongestionControl&) = delete;
+    CongestionControl& operator=(const CongestionControl&) = delete;
+
+    virtual const char* get_name() const = 0;
+
+    // acked bytes of new data; rtt_ns is the latest smoothed RTT, 0 before
+    // the first sample
+    virtual void on_ack(uint32_t acked, uint64_t rtt_ns, uint64_t now_ns) = 0;
+    // Three duplicate ACKs: entering fast recovery with flight bytes out
+    virtual void on_fast_retransmit(uint32_t flight, uint64_t now_ns) = 0;
+    // An ACK covered everything outstanding when recovery began
+    virtual void on_recovery_exit(uint64_t now_ns);
+    // The retransmission timer expired
+    virtual void on_timeout(uint32_t flight, uint64_t now_ns) = 0;
+
+    uint32_t get_cwnd() const { return cwnd_; }
+    uint32_t get_ssthresh() const { return ssthresh_; }
+    bool in_slow_start() const { return cwnd_ < ssthresh_; }
+
+protected:
+    uint32_t mss_;
+    uint32_t cwnd_;
+    uint32_t ssthresh_ = UINT32_MAX;
+
+    // Slow start growth, one MSS per ACK at most (RFC 5681 3.1); returns
+    // the part of acked left over once cwnd reaches ssthresh
+    uint32_t slow_start(uint32_t acked);
+    // Half the flight, at least two segments (RFC 5681 equation 4)
+    uint32_t half_flight(uint32_t flight) const;
+};
+
+// Additive increase of one MSS per window, halving on loss
+class NewRenoCongestionControl : public CongestionControl {
+public:
+    using CongestionControl::CongestionControl;
+
+    const char* get_name() const override { return "newreno"; }
+    void on_ack(uint32_t acked, uint64_t rtt_ns, uint64_t now_ns) override;
+    void on_fast_retransmit(uint32_t flight, uint64_t now_ns) override;
+    void on_timeout(uint32_t flight, uint64_t now_ns) override;
+
+private:
+    uint32_t bytes_acked_ = 0;  // toward the next increase in avoidance
+};
+
+// Grows the window as a cubic function of the time since the last loss,
+// centred on the window where it happened (W_max), so it flattens out near
+// the previous limit and probes quickly away from it. Never grows slower
+// than Reno would (the "Reno-friendly" region).
+class CubicCongestionControl : public CongestionControl {
+public:
+    static constexpr double C = 0.4;
+    static constexpr double BETA = 0.7;
+
+    using CongestionControl::CongestionControl;
+
+    const char* get_name() const override { return "cubic"; }
+    void on_ack(uint32_t acked, uint64_t rtt_ns, uint64_t now_ns) override;
+    void on_fast_retransmit(uint32_t flight, uint64_t now_ns) override;
+    void on_timeout(uint32_t flight, uint64_t now_ns) override;
+
+    // Window at the last loss and the time to regain it, in segments and
+    // seconds
+    double get_w_max() const { return w_max_; }
+    double get_k() const { return k_; }
+
+private:
+    double w_max_ = 0;
+    double w_last_max_ = 0;     // for fast convergence
+    double k_ = 0;
+    double w_est_ = 0;          // the Reno-friendly estimate, segments
+    double cwnd_segments_ = 0;  // fractional cwnd, so sub-MSS increments add up
+    uint64_t epoch_start_ns_ = 0;  // start of growth since the last loss, 0 before the first ACK
+
+    void reduce(uint32_t flight);
+};
+
+std::unique_ptr<CongestionControl> make_congestion_control(CongestionAlgorithm algorithm, uint32_t mss);
@@ -0,0 +1,331 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// A connection as seen from this host. Addresses in host order.
+struct FlowKey {
+    uint32_t local_address = 0;
+    uint32_t remote_address = 0;
+    uint16_t local_port = 0;
+    uint16_t remote_port = 0;
+
+    bool operator==(const FlowKey&) const = default;
+};
+
+inline uint64_t hash_flow_key(const FlowKey& key) {
+    uint64_t addresses = (static_cast<uint64_t>(key.local_address) << 32) | key.remote_address;
+    uint64_t ports = (static_cast<uint64_t>(key.local_port) << 16) | key.remote_port;
+    uint64_t hash = addresses ^ (ports * 0x9E3779B97F4A7C15ULL);
+    // MurmurHash3 finalizer
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+struct ConnectionTableStats {
+    size_t size = 0;           // live connections
+    size_t slots = 0;          // hot slots, including a table being drained
+    size_t memory_bytes = 0;   // hot slots plus allocated cold chunks
+    bool resizing = false;
+    uint64_t lookups = 0;
+    uint64_t cache_hits = 0;   // lookups answered by the last-flow cache
+    uint64_t resizes = 0;
+};
+
+// Open-addressing TCB store keyed by 4-tuple, owned by a single thread.
+//
+// The hot array holds only 16-byte {key, index} slots probed linearly, so a
+// lookup usually touches one cache line before it reaches the value. Values
+// live in fixed-size chunks that never move: pointers returned by find()
+// and emplace() stay valid until the entry is erased.
+//
+// Growing allocates a table twice the size (zero pages, so no upfront
+// cost) and moves MIGRATE_STEP old slots per insert or erase until the old
+// table is empty. Lookups check both tables meanwhile.
+template <typename Value>
+class ConnectionTable {
+public:
+    static constexpr size_t CHUNK_SIZE = 4096;     // values per cold allocation
+    static constexpr size_t MIGRATE_STEP = 64;     // old slots moved per update while resizing
+    static constexpr size_t MAX_LOAD_PERCENT = 70;
+
+    explicit ConnectionTable(size_t initial_slots = 1024)
+        : current_(std::make_unique<SlotArray>(slot_count_for(initial_slots))) {}
+
+    ConnectionTable(const ConnectionTable&) = delete;
+    ConnectionTable& operator=(const ConnectionTable&) = delete;
+
+    Value* find(const FlowKey& key) {
+        lookups_++;
+        if (cached_value_ != nullptr && cached_key_ == key) {
+            cache_hits_++;
+            return cached_value_;
+        }
+
+        uint32_t index = lookup_index(key, hash_flow_key(key));
+        if (index == EMPTY) {
+            return nullptr;
+        }
+        return remember(key, &entry(index).value);
+    }
+
+    // Inserts Value(args...) unless the key is present. Returns the value and
+    // whether it was inserted.
+    template <typename... Args>
+    std::pair<Value*, bool> emplace(const FlowKey& key, Args&&... args) {
+        uint64_t hash = hash_flow_key(key);
+        uint32_t existing = lookup_index(key, hash);
+        if (existing != EMPTY) {
+            return {&entry(existing).value, false};
+        }
+
+        if (old_) {
+            migrate(MIGRATE_STEP);
+        }
+        if ((size_ + 1) * 100 > current_->count() * MAX_LOAD_PERCENT) {
+            grow();
+        }
+
+        uint32_t index = allocate_entry();
+        Entry& e = entry(index);
+        e.key = key;
+        e.value = Value(std::forward<Args>(args)...);
+        place(*current_, key, hash, index);
+        size_++;
+        return {remember(key, &e.value), true};
+    }
+
+    bool erase(const FlowKey& key) {
+        uint64_t hash = hash_flow_key(key);
+        size_t position = find_slot(*current_, key, hash);
+        uint32_t index;
+        if (position != NOT_FOUND) {
+            index = current_->slots[position].index;
+            remove_slot(*current_, position);
+        } else if (old_ && (position = find_slot(*old_, key, hash)) != NOT_FOUND) {
+            // Tombstone rather than shift: the migration cursor depends on positions
+            index = old_->slots[position].index;
+            old_->slots[position].index = TOMBSTONE;
+        } else {
+            return false;
+        }
+
+        if (cached_value_ != nullptr && cached_key_ == key) {
+            cached_value_ = nullptr;
+        }
+        free_entry(index);
+        size_--;
+        if (old_) {
+            migrate(MIGRATE_STEP);
+        }
+        return true;
+    }
+
+    // Completes a pending resize now, e.g. from an idle loop
+    void finish_resize() {
+        while (old_) {
+            migrate(MIGRATE_STEP);
+        }
+    }
+
+    // Visits every live connection as fn(const FlowKey&, Value&). The table
+    // must not be modified during the walk.
+    template <typename Fn>
+    void for_each(Fn&& fn) {
+        for (auto& chunk : chunks_) {
+            for (size_t i = 0; i < CHUNK_SIZE; ++i) {
+                if (chunk[i].next_free == LIVE) {
+                    fn(static_cast<const FlowKey&>(chunk[i].key), chunk[i].value);
+                }
+            }
+        }
+    }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    bool is_resizing() const { return old_ != nullptr; }
+
+    ConnectionTableStats get_stats() const {
+        ConnectionTableStats stats;
+        stats.size = size_;
+        stats.slots = current_->count() + (old_ ? old_->count() : 0);
+        stats.memory_bytes = stats.slots * sizeof(Slot) + chunks_.size() * CHUNK_SIZE * sizeof(Entry);
+        stats.resizing = old_ != nullptr;
+        stats.lookups = lookups_;
+        stats.cache_hits = cache_hits_;
+        stats.resizes = resizes_;
+        return stats;
+    }
+
+private:
+    // Slot indices are entry index + 1, so a zeroed slot is empty
+    static constexpr uint32_t EMPTY = 0;
+    static constexpr uint32_t TOMBSTONE = UINT32_MAX;
+    static constexpr uint32_t LIVE = UINT32_MAX;
+    static constexpr uint32_t NO_FREE = UINT32_MAX - 1;
+    static constexpr size_t NOT_FOUND = SIZE_MAX;
+
+    struct Slot {
+        FlowKey key;
+        uint32_t index;
+    };
+    static_assert(sizeof(Slot) == 16, "four hot slots per cache line");
+
+    struct Entry {
+        FlowKey key;
+        uint32_t next_free = NO_FREE; // LIVE while in use
+        Value value{};
+    };
+
+    // calloc'd so large tables start out as untouched zero pages
+    struct SlotArray {
+        explicit SlotArray(size_t count)
+            : slots(static_cast<Slot*>(std::calloc(count, sizeof(Slot)))), mask(count - 1) {
+            if (slots == nullptr) {
+                throw std::bad_alloc();
+            }
+        }
+        ~SlotArray() { std::free(slots); }
+
+        size_t count() const { return mask + 1; }
+
+        Slot* slots;
+        size_t mask;
+    };
+
+    std::unique_ptr<SlotArray> current_;
+    std::unique_ptr<SlotArray> old_;   // being drained into current_
+    size_t migrate_cursor_ = 0;
+    size_t size_ = 0;
+
+    std::vector<std::unique_ptr<Entry[]>> chunks_;
+    uint32_t free_head_ = NO_FREE;
+    uint32_t next_unused_ = 0;
+
+    FlowKey cached_key_;
+    Value* cached_value_ = nullptr;
+
+    uint64_t lookups_ = 0;
+    uint64_t cache_hits_ = 0;
+    uint64_t resizes_ = 0;
+
+    static size_t slot_count_for(size_t requested) {
+        size_t count = 16;
+        while (count < requested) {
+            count <<= 1;
+        }
+        return count;
+    }
+
+    Entry& entry(uint32_t slot_index) {
+        uint32_t index = slot_index - 1;
+        return chunks_[index / CHUNK_SIZE][index % CHUNK_SIZE];
+    }
+
+    Value* remember(const FlowKey& key, Value* value) {
+        cached_key_ = key;
+        cached_value_ = value;
+        return value;
+    }
+
+    static size_t find_slot(const SlotArray& table, const FlowKey& key, uint64_t hash) {
+        for (size_t position = hash & table.mask;; position = (position + 1) & table.mask) {
+            const Slot& slot = table.slots[position];
+            if (slot.index == EMPTY) {
+                return NOT_FOUND;
+            }
+            if (slot.index != TOMBSTONE && slot.key == key) {
+                return position;
+            }
+        }
+    }
+
+    uint32_t lookup_index(const FlowKey& key, uint64_t hash) const {
+        size_t position = find_slot(*current_, key, hash);
+        if (position != NOT_FOUND) {
+            return current_->slots[position].index;
+        }
+        if (old_ && (position = find_slot(*old_, key, hash)) != NOT_FOUND) {
+            return old_->slots[position].index;
+        }
+        return EMPTY;
+    }
+
+    // current_ never holds tombstones, so the first empty slot is free
+    static void place(SlotArray& table, const FlowKey& key, uint64_t hash, uint32_t index) {
+        size_t position = hash & table.mask;
+        while (table.slots[position].index != EMPTY) {
+            position = (position + 1) & table.mask;
+        }
+        table.slots[position].key = key;
+        table.slots[position].index = index;
+    }
+
+    // Backward-shift deletion keeps probe runs unbroken without tombstones
+    static void remove_slot(SlotArray& table, size_t hole) {
+        size_t next = (hole + 1) & table.mask;
+        while (table.slots[next].index != EMPTY) {
+            size_t home = hash_flow_key(table.slots[next].key) & table.mask;
+            if (((next - home) & table.mask) >= ((next - hole) & table.mask)) {
+                table.slots[hole] = table.slots[next];
+                hole = next;
+            }
+            next = (next + 1) & table.mask;
+        }
+        table.slots[hole].index = EMPTY;
+    }
+
+    void grow() {
+        // Normally the previous resize is long finished by now
+        finish_resize();
+        old_ = std::move(current_);
+        current_ = std::make_unique<SlotArray>(old_->count() * 2);
+        migrate_cursor_ = 0;
+        resizes_++;
+    }
+
+    void migrate(size_t budget) {
+        size_t end = std::min(old_->count(), migrate_cursor_ + budget);
+        for (; migrate_cursor_ < end; ++migrate_cursor_) {
+            Slot& slot = old_->slots[migrate_cursor_];
+            if (slot.index != EMPTY && slot.index != TOMBSTONE) {
+                place(*current_, slot.key, hash_flow_key(slot.key), slot.index);
+                slot.index = TOMBSTONE;
+            }
+        }
+        if (migrate_cursor_ == old_->count()) {
+            old_.reset();
+        }
+    }
+
+    uint32_t allocate_entry() {
+        uint32_t index;
+        if (free_head_ != NO_FREE) {
+            index = free_head_;
+            free_head_ = chunks_[index / CHUNK_SIZE][index % CHUNK_SIZE].next_free;
+        } else {
+            index = next_unused_++;
+            if (index / CHUNK_SIZE == chunks_.size()) {
+                chunks_.push_back(std::make_unique<Entry[]>(CHUNK_SIZE));
+            }
+        }
+        chunks_[index / CHUNK_SIZE][index % CHUNK_SIZE].next_free = LIVE;
+        return index + 1;
+    }
+
+    void free_entry(uint32_t slot_index) {
+        Entry& e = entry(slot_index);
+        e.value = Value();
+        e.next_free = free_head_;
+        free_head_ = slot_index - 1;
+    }
+};
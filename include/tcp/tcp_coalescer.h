@@ -0,0 +1,124 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <span>
+#include "ip/ipv4_view.h"
+#include "tcp/connection_table.h"
+#include "tcp/tcp_view.h"
+
+struct GroConfig {
+    bool enabled = true;
+    size_t max_segments = 32;   // merged into one before it is flushed; at most MAX_SEGMENTS
+    size_t max_bytes = 65535;   // payload bytes merged into one before it is flushed
+};
+
+// What TCP input processes: one received segment, or several back-to-back
+// segments of one flow that GRO merged. ip and tcp are the first segment's
+// headers; flags and window are the last one's, so a PSH is kept. The
+// payloads stay where they were received.
+struct CoalescedSegment {
+    static constexpr size_t MAX_SEGMENTS = 32;
+
+    IPv4View ip;
+    TCPView tcp;
+    uint8_t flags = 0;
+    uint16_t window = 0;
+    size_t payload_length = 0;
+    size_t count = 0;           // segments received
+    std::array<std::span<const uint8_t>, MAX_SEGMENTS> payloads{};
+
+    bool has_flag(uint8_t flag) const { return (flags & flag) != 0; }
+    uint32_t get_end_sequence() const { return tcp.get_sequence_number() + static_cast<uint32_t>(payload_length); }
+    std::span<const std::span<const uint8_t>> get_payloads() const { return {payloads.data(), count}; }
+};
+
+// Receive-side coalescing (GRO) within one RX burst.
+//
+// Segments that only carry data (ACK, optionally PSH) are held per flow.
+// The next segment of the same flow is appended if all of these match:
+// - its sequence number continues the held payload
+// - the ACK number and option bytes are the same
+// - the TTL and DSCP/ECN are the same
+// A PSH, the segment or byte cap, or any other segment of the flow
+// delivers what is held first. flush() delivers the rest at the end of
+// the burst. Segments are delivered in arrival order within each flow.
+// The received buffers must stay valid until they are delivered.
+// Single-threaded, one per RX context.
+class TCPCoalescer {
+public:
+    static constexpr size_t MAX_FLOWS = 16; // held at once; another evicts one
+
+    explicit TCPCoalescer(const GroConfig& config = {});
+
+    // Offers a parsed segment whose checksum has been checked if it is
+    // going to be. With may_hold false (GRO off, or a buffer that will not
+    // last until the end of the burst), the segment is delivered at once,
+    // after anything held for its flow. deliver is called with a
+    // const CoalescedSegment& for every segment that is ready.
+    template <typename Deliver>
+    void add(const IPv4View& ip, const TCPView& tcp, bool may_hold, Deliver&& deliver) {
+        FlowKey key = flow_key(ip, tcp);
+        size_t slot = find(key);
+        if (slot < held_count_ && may_hold && can_append(held_[slot], ip, tcp)) {
+            append(held_[slot], tcp);
+            if (is_full(held_[slot])) {
+                deliver(held_[slot]);
+                release(slot);
+            }
+            return;
+        }
+        if (slot < held_count_) {
+            deliver(held_[slot]);
+            release(slot);
+        }
+
+        if (!may_hold || !is_candidate(tcp)) {
+            CoalescedSegment single;
+            start(single, ip, tcp);
+            deliver(single);
+            return;
+        }
+        if (held_count_ == MAX_FLOWS) {
+            // Evict in turn, so a busy flow cannot be starved of merging
+            victim_ = (victim_ + 1) % MAX_FLOWS;
+            deliver(held_[victim_]);
+            release(victim_);
+        }
+        keys_[held_count_] = key;
+        start(held_[held_count_], ip, tcp);
+        if (is_full(held_[held_count_])) {
+            deliver(held_[held_count_]);
+            return;
+        }
+        held_count_++;
+    }
+
+    // Delivers everything held; the end of a burst
+    template <typename Deliver>
+    void flush(Deliver&& deliver) {
+        for (size_t i = 0; i < held_count_; ++i) {
+            deliver(held_[i]);
+        }
+        held_count_ = 0;
+    }
+
+    size_t get_held() const { return held_count_; }
+
+private:
+    GroConfig config_;
+    std::array<CoalescedSegment, MAX_FLOWS> held_{};
+    std::array<FlowKey, MAX_FLOWS> keys_{};
+    size_t held_count_ = 0;
+    size_t victim_ = 0;
+
+    static FlowKey flow_key(const IPv4View& ip, const TCPView& tcp);
+    // Data with nothing but ACK and PSH set
+    static bool is_candidate(const TCPView& tcp);
+    static void start(CoalescedSegment& segment, const IPv4View& ip, const TCPView& tcp);
+    size_t find(const FlowKey& key) const;
+    bool can_append(const CoalescedSegment& held, const IPv4View& ip, const TCPView& tcp) const;
+    void append(CoalescedSegment& held, const TCPView& tcp);
+    bool is_full(const CoalescedSegment& held) const;
+    void release(size_t slot);
+};
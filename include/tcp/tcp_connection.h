@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <array>
+#include <memory>
+#include "core/timer_wheel.h"
+#include "tcp/connection_table.h"
+#include "tcp/tcp_state_machine.h"
+#include "tcp/tcp_receive_buffer.h"
+#include "tcp/tcp_sender.h"
+
+// Per-connection timers; Timer::kind holds the value
+enum class TCPTimer : uint8_t {
+    RETRANSMIT,
+    DELAYED_ACK,
+    KEEPALIVE,
+    TIME_WAIT,  // 2*MSL
+    COUNT
+};
+
+// Per-connection state (TCB), owned by the worker whose connection table
+// holds it. Timers are armed on that worker's wheel and must be cancelled
+// before the entry is erased.
+struct TCPConnection {
+    FlowKey key;
+    TCPStateMachine machine;
+    TCPReceiveBuffer receive;   // opened when the peer's SYN arrives
+    std::array<Timer, static_cast<size_t>(TCPTimer::COUNT)> timers;
+    uint64_t segments_received = 0;
+    uint64_t bytes_received = 0;
+
+    // What the peer's SYN offered (RFC 9293 3.7.1, RFC 7323, RFC 2018)
+    uint16_t peer_mss = 536;        // the default when the SYN has no MSS option
+    uint8_t peer_window_scale = 0;  // shift on the windows the peer advertises
+    bool window_scaling = false;
+    bool sack_permitted = false;
+    bool timestamps = false;
+    uint32_t ts_recent = 0;         // the peer's latest TSval, to echo back
+
+    // This host's end of the connection, for a socket (see
+    // TCPIPStack::listen_socket() and connect()). Connections on a
+    // listen() port only receive, and have none of it.
+    bool endpoint = false;
+    uint32_t socket = 0;            // slot + 1 in the stack's SocketTable; 0 once the application closed it
+    std::unique_ptr<TCPSender> sender; // once the peer's SYN has said what it supports
+    std::array<uint8_t, 6> peer_mac{}; // where frames to the peer go
+    uint32_t iss = 0;               // our SYN's sequence number
+    uint8_t window_scale = 0;       // shift on the windows we advertise
+    uint32_t advertised_window = 0; // the last window we sent, unscaled
+    bool ack_pending = false;       // something arrived that needs an ACK
+    uint32_t ack_sent = 0;          // RCV.NXT as our last segment acknowledged it
+    bool in_output = false;         // on the context's list of connections to send for
+    bool fin_queued = false;        // the application closed; a FIN follows the data
+    bool fin_sent = false;
+    uint32_t fin_sequence = 0;
+    uint8_t retries = 0;            // of the SYN, SYN-ACK or FIN, which the sender does not time
+    uint64_t control_deadline_ns = UINT64_MAX; // when that one goes out again
+
+    Timer& timer(TCPTimer which) { return timers[static_cast<size_t>(which)]; }
+};
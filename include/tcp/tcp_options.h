@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <span>
+#include "tcp/tcp_sequence.h"
+
+// Option kinds (RFC 793, 7323, 2018)
+enum class TCPOptionKind : uint8_t {
+    END = 0,
+    NOP = 1,
+    MSS = 2,
+    WINDOW_SCALE = 3,
+    SACK_PERMITTED = 4,
+    SACK = 5,
+    TIMESTAMPS = 8
+};
+
+// The options this stack understands, decoded. Unknown options are
+// skipped on parse and never written.
+struct TCPOptions {
+    static constexpr size_t MAX_SIZE = 40;          // data offset 15
+    static constexpr size_t MAX_SACK_BLOCKS = 4;    // 3 alongside timestamps
+    static constexpr uint8_t MAX_WINDOW_SCALE = 14;
+    static constexpr size_t TIMESTAMPS_SIZE = 12;   // as written: NOP NOP TS
+
+    uint16_t mss = 0;               // SYN only; 0 when absent
+    bool has_window_scale = false;  // SYN only
+    uint8_t window_scale = 0;
+    bool sack_permitted = false;    // SYN only
+    bool has_timestamps = false;
+    uint32_t ts_value = 0;
+    uint32_t ts_echo = 0;
+    uint8_t sack_count = 0;
+    std::array<SequenceRange, MAX_SACK_BLOCKS> sack_blocks{};
+
+    std::span<const SequenceRange> get_sack_blocks() const { return {sack_blocks.data(), sack_count}; }
+    // Reports the receiver's out-of-order ranges, the one holding
+    // most_recent first as RFC 2018 asks, then the rest in order
+    void set_sack_blocks(std::span<const SequenceRange> ranges, uint32_t most_recent);
+};
+
+// Decodes an option area (the bytes between the fixed header and the
+// payload). False if an option's length is invalid or runs past the end;
+// options is then only partly filled and should be ignored. The layouts
+// Linux sends (timestamps alone on established segments, MSS, SACK-OK,
+// timestamps and window scale on SYNs) are recognised without walking.
+bool parse_tcp_options(std::span<const uint8_t> data, TCPOptions& options);
+
+// Encodes options in Linux's order, NOP-padded to a multiple of 4 bytes,
+// and returns the length. SACK blocks that do not fit are left out.
+size_t write_tcp_options(const TCPOptions& options, std::span<uint8_t, TCPOptions::MAX_SIZE> out);
@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <memory>
+#include <span>
+#include "tcp/tcp_sequence.h"
+
+enum class ReceiveOutcome {
+    IN_ORDER,       // at rcv_nxt; readable now, possibly with queued data behind it
+    OUT_OF_ORDER,   // stored ahead of a hole
+    DUPLICATE,      // every byte was already received
+    OUT_OF_WINDOW,  // starts beyond the receive window
+    NO_ROOM         // ahead of a hole, but every out-of-order range slot is taken
+};
+
+// Per-connection receive window as one contiguous ring sized to the window.
+//
+// A segment is copied straight to its final position, (seq - rcv_nxt) past
+// the end of the readable bytes, whether or not it arrives in order; a
+// small sorted array of sequence ranges records what has landed beyond
+// rcv_nxt. When the hole at rcv_nxt fills, the ranges behind it become
+// readable without moving a byte. Readers see the in-order bytes in place
+// through peek()/consume().
+//
+// Storage is allocated by open(), so a default-constructed buffer (an idle
+// connection table slot) costs nothing. Single-threaded, like the
+// connection that owns it.
+class TCPReceiveBuffer {
+public:
+    static constexpr size_t MAX_OUT_OF_ORDER_RANGES = 16;
+    static constexpr size_t DEFAULT_CAPACITY = 65536;
+
+    TCPReceiveBuffer() = default;
+    TCPReceiveBuffer(TCPReceiveBuffer&&) noexcept = default;
+    TCPReceiveBuffer& operator=(TCPReceiveBuffer&&) noexcept = default;
+
+    // Allocates the ring (rounded up to a power of two) and expects the next
+    // byte at initial_sequence, i.e. the peer's ISN + 1
+    void open(uint32_t initial_sequence, size_t capacity = DEFAULT_CAPACITY);
+    bool is_open() const { return storage_ != nullptr; }
+
+    // Stores a segment's payload. Bytes before rcv_nxt or past the window are
+    // trimmed; overlaps with data already held are rewritten in place.
+    ReceiveOutcome receive(uint32_t sequence, std::span<const uint8_t> payload);
+
+    // The in-order bytes up to the end of the ring; the rest, if they wrap,
+    // follow after consume()
+    std::span<const uint8_t> peek() const;
+    void consume(size_t length);
+    // Copies out and consumes up to out.size() in-order bytes
+    size_t read(std::span<uint8_t> out);
+
+    uint32_t get_rcv_nxt() const { return rcv_nxt_; }
+    size_t get_readable() const { return readable_; }
+    // Free space past rcv_nxt, the window to advertise
+    size_t get_window() const { return capacity_ - readable_; }
+    size_t get_capacity() const { return capacity_; }
+    // Data held beyond rcv_nxt, in sequence order (what SACK reports)
+    std::span<const SequenceRange> get_out_of_order() const { return {ranges_.data(), range_count_}; }
+
+private:
+    std::unique_ptr<uint8_t[]> storage_;
+    size_t capacity_ = 0;
+    size_t mask_ = 0;
+    size_t read_position_ = 0;  // ring index of the first readable byte
+    size_t readable_ = 0;
+    uint32_t rcv_nxt_ = 0;
+    std::array<SequenceRange, MAX_OUT_OF_ORDER_RANGES> ranges_{};
+    size_t range_count_ = 0;
+
+    void write(size_t offset, std::span<const uint8_t> data);
+    bool insert_range(SequenceRange range);
+    void advance(uint32_t end);
+};
@@ -1,6 +1,13 @@
 #pragma once
 #include <cstdint>
+#include <cstddef>
 #include <vector>
+#include <array>
+#include <span>
+#include "ip/checksum.h"
+#include "tcp/tcp_options.h"
+
+class PacketHandle;
 
 struct TCPHeader {
     uint16_t source_port;
@@ -16,6 +23,8 @@ struct TCPHeader {
 
 class TCPSegment {
 public:
+    static constexpr size_t HEADER_SIZE = 20; // without options
+    
     TCPSegment() = default;
     
     void set_source_port(uint16_t port);
@@ -25,6 +34,17 @@ public:
     void set_flags(uint8_t flags);
     void set_window_size(uint16_t window);
     void set_payload(const std::vector<uint8_t>& payload);
+    void set_payload(std::vector<uint8_t>&& payload);
+    // Encodes options to go between the fixed header and the payload
+    void set_options(const TCPOptions& options);
+    
+    // NAT rewrites. These patch the stored checksum incrementally (RFC 1624)
+    // instead of re-summing the whole segment.
+    void rewrite_source_port(uint16_t port);
+    void rewrite_dest_port(uint16_t port);
+    // The IP layer changed an address covered by the pseudo-header
+    void rewrite_pseudo_header_address(const std::array<uint8_t, 4>& old_ip,
+                                       const std::array<uint8_t, 4>& new_ip);
     
     // TCP Flags
     static constexpr uint8_t FIN = 0x01;
@@ -35,15 +55,46 @@ public:
     static constexpr uint8_t URG = 0x20;
     
     std::vector<uint8_t> serialize() const;
+    // Serializes with the real checksum filled in, in a single pass over the payload
+    std::vector<uint8_t> serialize(const std::array<uint8_t, 4>& source_ip,
+                                   const std::array<uint8_t, 4>& dest_ip) const;
     bool deserialize(const std::vector<uint8_t>& data);
     
+    // In-place encapsulation; the stored payload is not used. The payload
+    // is described by its length and its checksum_partial() sum, which
+    // checksum_partial_copy() yields while the payload is copied into a
+    // buffer, so the checksum costs no second pass over the data.
+    // write_header_to() fills the first get_header_length() bytes of out.
+    bool write_header_to(std::span<uint8_t> out, const std::array<uint8_t, 4>& source_ip,
+                         const std::array<uint8_t, 4>& dest_ip,
+                         size_t payload_length, uint32_t payload_sum) const;
+    // Writes the header into the packet's headroom in front of its current
+    // contents, which are the payload. Without payload_sum the payload is
+    // summed here. False if there is no headroom.
+    bool prepend_to(PacketHandle& packet, const std::array<uint8_t, 4>& source_ip,
+                    const std::array<uint8_t, 4>& dest_ip) const;
+    bool prepend_to(PacketHandle& packet, const std::array<uint8_t, 4>& source_ip,
+                    const std::array<uint8_t, 4>& dest_ip, uint32_t payload_sum) const;
+    
     uint16_t calculate_checksum(const std::array<uint8_t, 4>& source_ip, 
                                const std::array<uint8_t, 4>& dest_ip) const;
     
     const TCPHeader& get_header() const { return header_; }
     const std::vector<uint8_t>& get_payload() const { return payload_; }
+    // Fixed header plus options
+    size_t get_header_length() const { return HEADER_SIZE + options_length_; }
+    std::span<const uint8_t> get_option_bytes() const { return {options_.data(), options_length_}; }
+    // Decodes the options; false if they are malformed
+    bool decode_options(TCPOptions& options) const { return parse_tcp_options(get_option_bytes(), options); }
 
 private:
-    TCPHeader header_;
+    TCPHeader header_{};
+    std::array<uint8_t, TCPOptions::MAX_SIZE> options_{};
+    uint8_t options_length_ = 0;
     std::vector<uint8_t> payload_;
+    
+    void write_header(uint8_t* out, uint16_t checksum) const;
+    ChecksumAccumulator header_checksum_accumulator(const std::array<uint8_t, 4>& source_ip,
+                                                    const std::array<uint8_t, 4>& dest_ip,
+                                                    size_t payload_length) const;
 };
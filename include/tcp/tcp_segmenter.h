@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <span>
+#include <vector>
+#include "buffer/packet_pool.h"
+#include "ethernet/ethernet_frame.h"
+#include "ip/ipv4_packet.h"
+#include "tcp/tcp_segment.h"
+
+// Software segmentation offload (GSO) for bulk sends.
+//
+// One large payload goes in. MSS-sized Ethernet frames come out, each in
+// its own pooled buffer. The Ethernet, IPv4 and TCP headers are written
+// and summed once, when the segmenter is built. Each frame gets a copy of
+// them with only a few fields patched: sequence number, IP ID, lengths,
+// last-frame flags and both checksums. The TCP checksum starts from the
+// shared header sum and takes in the payload while it is copied, so each
+// payload byte is read once.
+class TCPSegmenter {
+public:
+    static constexpr size_t MAX_HEADER_SIZE =
+        EthernetFrame::HEADER_SIZE + IPv4Packet::HEADER_SIZE + TCPSegment::HEADER_SIZE + TCPOptions::MAX_SIZE;
+
+    // The headers every frame shares. The segment's sequence number is that
+    // of the first payload byte. PSH and FIN go on the last frame of a
+    // segment() call only. The packet's identification is the first
+    // frame's and counts up from there. Payloads stored in the templates
+    // are ignored.
+    TCPSegmenter(const EthernetFrame& frame, const IPv4Packet& packet, const TCPSegment& segment, uint16_t mss);
+
+    // Appends one frame to out per mss bytes of payload; the last frame may
+    // be shorter. Returns how many payload bytes went out. That is fewer
+    // than payload.size() when the pool runs out or a frame would not fit
+    // in a pool buffer. Sequence number and ID carry on into the next call,
+    // so the caller can continue from where this one stopped.
+    size_t segment(std::span<const uint8_t> payload, PacketPool& pool, std::vector<PacketHandle>& out);
+
+    uint32_t get_sequence_number() const { return sequence_; }      // of the next frame
+    uint16_t get_identification() const { return identification_; } // of the next frame
+    uint16_t get_mss() const { return mss_; }
+    size_t get_header_length() const { return header_length_; }    // Ethernet + IPv4 + TCP
+
+private:
+    static constexpr size_t BURST = 32; // buffers taken from the pool at once
+
+    std::array<uint8_t, MAX_HEADER_SIZE> headers_{};
+    size_t header_length_;
+    size_t tcp_offset_;
+    uint16_t mss_;
+    uint32_t sequence_;
+    uint16_t identification_;
+    uint16_t flags_word_;       // data offset and flags of all but the last frame
+    uint16_t last_flags_word_;
+    uint32_t ip_sum_;           // header sum without total length and ID
+    uint32_t tcp_sum_;          // pseudo-header and header, without length, sequence and flags
+
+    void write_frame(uint8_t* frame, std::span<const uint8_t> payload, bool last);
+};
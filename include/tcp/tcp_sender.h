@@ -0,0 +1,178 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <span>
+#include <vector>
+#include "tcp/congestion_control.h"
+#include "tcp/tcp_options.h"
+#include "tcp/tcp_segment.h"
+#include "tcp/tcp_sequence.h"
+#include "tcp/tcp_state_machine.h"
+
+// Retransmission timeout from RTT samples (RFC 6298)
+class RttEstimator {
+public:
+    RttEstimator(uint64_t initial_rto_ns, uint64_t min_rto_ns, uint64_t max_rto_ns, uint64_t granularity_ns);
+
+    // A measurement from a segment sent once (Karn's rule is the caller's);
+    // also clears any backoff
+    void sample(uint64_t rtt_ns);
+    // Doubles the RTO after a timeout, up to the maximum
+    void backoff();
+
+    bool has_sample() const { return srtt_ns_ != 0; }
+    uint64_t get_srtt_ns() const { return srtt_ns_; }
+    uint64_t get_rttvar_ns() const { return rttvar_ns_; }
+    uint64_t get_rto_ns() const { return rto_ns_; }
+
+private:
+    uint64_t min_rto_ns_;
+    uint64_t max_rto_ns_;
+    uint64_t granularity_ns_;
+    uint64_t srtt_ns_ = 0;
+    uint64_t rttvar_ns_ = 0;
+    uint64_t rto_ns_;
+};
+
+struct SenderConfig {
+    uint32_t mss = 1460;
+    size_t send_buffer_size = 256 * 1024;   // rounded up to a power of two
+    CongestionAlgorithm congestion = CongestionAlgorithm::CUBIC;
+    uint64_t initial_rto_ns = 1'000'000'000;
+    uint64_t min_rto_ns = 200'000'000;      // Linux's floor; RFC 6298 suggests 1 s
+    uint64_t max_rto_ns = 60'000'000'000ULL;
+    uint64_t clock_granularity_ns = 1'000'000; // the timer wheel tick
+    uint32_t dup_ack_threshold = 3;
+    // Negotiated on the handshake
+    bool sack = false;              // the peer's SYN carried SACK-permitted
+    bool timestamps = false;        // both SYNs carried timestamps
+};
+
+struct SenderStats {
+    uint64_t segments_sent = 0;     // retransmissions included
+    uint64_t bytes_sent = 0;
+    uint64_t retransmits = 0;       // segments sent again, for any reason
+    uint64_t fast_retransmits = 0;  // recoveries entered on duplicate ACKs
+    uint64_t timeouts = 0;
+    uint64_t dup_acks = 0;
+};
+
+// Only these states may send new data
+inline bool can_send_data(TCPState state) {
+    return state == TCPState::ESTABLISHED || state == TCPState::CLOSE_WAIT;
+}
+
+// Send side of one connection: the send buffer from SND.UNA on, the
+// retransmission queue, RTO, and loss recovery, with the window left to a
+// pluggable CongestionControl.
+//
+// Without SACK, recovery is NewReno (RFC 6582): fast retransmit on the
+// third duplicate ACK, one hole resent per partial ACK. With SACK the
+// retransmission queue doubles as the scoreboard (RFC 6675): SACKed
+// segments are marked, a segment with enough SACKed data above it counts
+// as lost, and during recovery every lost segment is resent as the pipe
+// (data estimated to be in the network) drops below cwnd. An RTO forgets
+// the scoreboard and goes back to SND.UNA.
+//
+// Data stays in a byte ring until acknowledged; the retransmission queue
+// holds only sequence ranges, send times and scoreboard flags, and a
+// segment's payload is copied from the ring each time it goes out.
+// Segments are returned with their sequence number, flags, payload and
+// timestamps set; the caller fills in ports, ACK number and window and
+// transmits them. The sender has no clock or
+// timer of its own: every call takes the time, and the caller keeps a
+// timer armed at get_retransmit_deadline() (a TCPTimer::RETRANSMIT on its
+// wheel) and calls on_retransmit_timeout() when it fires.
+class TCPSender {
+public:
+    // iss is the sequence number our SYN used; data starts after it
+    TCPSender(uint32_t iss, const SenderConfig& config = {});
+
+    TCPSender(const TCPSender&) = delete;
+    TCPSender& operator=(const TCPSender&) = delete;
+
+    // Queues application data; returns how much fitted
+    size_t write(std::span<const uint8_t> data);
+    size_t get_writable() const { return capacity_ - buffered_; }
+
+    // Sends new data (or resends after a timeout) as far as the congestion
+    // and peer windows allow, if the state permits
+    void send(TCPState state, uint64_t now_ns, std::vector<TCPSegment>& out);
+    // Processes the ACK number, window (already scaled) and options of a
+    // segment from the peer. A duplicate ACK counts only when the segment
+    // carried no data, so pass has_payload. May append retransmissions to
+    // out.
+    void on_ack(uint32_t ack, uint32_t window, bool has_payload, uint64_t now_ns,
+                std::vector<TCPSegment>& out, const TCPOptions& options = {});
+    // The retransmission timer fired: retransmits the oldest unacknowledged
+    // segment (or probes a zero window) and backs the RTO off
+    void on_retransmit_timeout(uint64_t now_ns, std::vector<TCPSegment>& out);
+    // When on_retransmit_timeout() is due, UINT64_MAX if nothing is outstanding
+    uint64_t get_retransmit_deadline() const { return retransmit_deadline_ns_; }
+    // Timeouts and window probes in a row, with no ACK from a live peer between
+    uint32_t get_backoffs() const { return backoffs_; }
+
+    uint32_t get_snd_una() const { return snd_una_; }
+    uint32_t get_snd_nxt() const { return snd_nxt_; }
+    uint32_t get_flight() const { return snd_nxt_ - snd_una_; }
+    size_t get_buffered() const { return buffered_; }   // unacknowledged, sent or not
+    uint32_t get_peer_window() const { return peer_window_; }
+    bool in_recovery() const { return in_recovery_; }
+    uint32_t get_sacked_bytes() const { return sacked_bytes_; }
+    // Payload bytes per full segment: the MSS less the timestamp option
+    uint32_t get_segment_size() const { return segment_size_; }
+    const RttEstimator& get_rtt() const { return rtt_; }
+    const CongestionControl& get_congestion() const { return *congestion_; }
+    SenderStats get_stats() const { return stats_; }
+
+private:
+    struct SentSegment {
+        uint32_t sequence;
+        uint32_t length;
+        uint64_t sent_ns;
+        bool retransmitted;     // no RTT sample from it (Karn)
+        bool resent = false;    // by loss recovery rather than go-back-N
+        bool sacked = false;
+        bool lost = false;
+    };
+
+    SenderConfig config_;
+    uint32_t segment_size_;
+    std::unique_ptr<CongestionControl> congestion_;
+    RttEstimator rtt_;
+
+    std::unique_ptr<uint8_t[]> storage_;
+    size_t capacity_;
+    size_t mask_;
+    size_t head_ = 0;           // ring position of snd_una
+    size_t buffered_ = 0;
+
+    uint32_t snd_una_;
+    uint32_t snd_nxt_;
+    uint32_t snd_max_;          // highest snd_nxt so far; below it, sending is resending
+    uint32_t peer_window_ = 0;
+    std::deque<SentSegment> retransmit_queue_;  // [snd_una, snd_nxt) in order
+    uint64_t retransmit_deadline_ns_ = UINT64_MAX;
+    uint32_t backoffs_ = 0;
+
+    uint32_t dup_acks_ = 0;
+    bool in_recovery_ = false;
+    uint32_t recover_;          // snd_max when recovery or the last timeout began
+    uint32_t inflation_ = 0;    // cwnd inflation during NewReno recovery
+    uint32_t sacked_bytes_ = 0;
+    uint32_t pipe_ = 0;         // during SACK recovery
+    uint32_t ts_offset_;        // added to our timestamp clock (RFC 7323 5.4)
+    uint32_t ts_recent_ = 0;    // the peer's latest TSval, echoed back
+
+    SenderStats stats_;
+
+    void transmit(uint32_t sequence, uint32_t length, uint64_t now_ns, std::vector<TCPSegment>& out);
+    void resend(SentSegment& segment, uint64_t now_ns, std::vector<TCPSegment>& out);
+    void acknowledge(uint32_t ack, uint64_t now_ns, const TCPOptions& options);
+    void update_scoreboard(std::span<const SequenceRange> blocks);
+    void retransmit_lost(uint64_t now_ns, std::vector<TCPSegment>& out);
+    void on_duplicate_ack(uint64_t now_ns, std::vector<TCPSegment>& out);
+    void restart_timer(uint64_t now_ns);
+};
@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+
+// Sequence-space comparisons (RFC 793 section 3.3). Sequence numbers wrap at
+// 2^32, so a is before b when the signed distance from b to a is negative;
+// valid only while the two are less than 2^31 apart.
+
+inline int32_t seq_diff(uint32_t a, uint32_t b) { return static_cast<int32_t>(a - b); }
+inline bool seq_lt(uint32_t a, uint32_t b) { return seq_diff(a, b) < 0; }
+inline bool seq_le(uint32_t a, uint32_t b) { return seq_diff(a, b) <= 0; }
+inline bool seq_gt(uint32_t a, uint32_t b) { return seq_diff(a, b) > 0; }
+inline bool seq_ge(uint32_t a, uint32_t b) { return seq_diff(a, b) >= 0; }
+inline uint32_t seq_min(uint32_t a, uint32_t b) { return seq_lt(a, b) ? a : b; }
+inline uint32_t seq_max(uint32_t a, uint32_t b) { return seq_lt(a, b) ? b : a; }
+
+// Half-open [start, end) in sequence space
+struct SequenceRange {
+    uint32_t start = 0;
+    uint32_t end = 0;
+
+    uint32_t length() const { return end - start; }
+    bool operator==(const SequenceRange&) const = default;
+};
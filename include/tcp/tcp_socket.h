@@ -0,0 +1,128 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <span>
+#include <vector>
+
+struct TCPConnection;
+
+// Handle to a listening port or a connection; 0 is never a socket. A slot
+// index in the low 32 bits and the slot's generation in the high, so a
+// handle to a closed socket is refused after the slot is reused.
+using SocketId = uint64_t;
+
+enum class SocketError : uint8_t {
+    NONE,
+    WOULD_BLOCK,    // nothing to read, no room to write, or still connecting
+    INVALID,        // not an open socket of that kind, or sockets are not in use
+    CLOSED,         // this side already closed, or the connection ended
+    RESET,          // the peer reset or refused the connection
+    TIMED_OUT       // the handshake, a FIN or keepalive went unanswered
+};
+
+const char* socket_error_name(SocketError error);
+
+// What send() and recv() did. recv() reports the end of the stream as 0
+// bytes with no error.
+struct IoResult {
+    size_t bytes = 0;
+    SocketError error = SocketError::NONE;
+};
+
+// One ready socket from TCPIPStack::wait_events()
+struct SocketEvent {
+    static constexpr uint32_t READABLE = 0x1;  // data or end of stream; a listener has a connection to accept
+    static constexpr uint32_t WRITABLE = 0x2;  // room in a connected socket's send buffer
+    static constexpr uint32_t CLOSED = 0x4;    // no more data will arrive: the peer closed, reset or timed out
+    // Interest flag: report a socket once per change rather than on every
+    // wait while it stays ready, like EPOLLET
+    static constexpr uint32_t EDGE = 0x80000000;
+
+    SocketId socket = 0;
+    uint32_t events = 0;
+    uint64_t data = 0;          // as given to watch()
+};
+
+enum class SocketKind : uint8_t {
+    FREE,
+    LISTENER,
+    STREAM
+};
+
+struct SocketSlot {
+    SocketKind kind = SocketKind::FREE;
+    uint32_t generation = 1;
+    bool accepted = false;      // the application holds the handle; a queued connection is not yet
+    SocketError error = SocketError::NONE;  // why connection went away, NONE for an orderly close
+    TCPConnection* connection = nullptr;    // STREAM; null once the connection is gone
+    uint16_t port = 0;                      // LISTENER
+    size_t backlog = 0;                     // bounds handshaking plus accept_queue, as BSD's did
+    size_t handshaking = 0;                 // SYN answered, not yet established
+    std::deque<SocketId> accept_queue;      // established, not yet accepted
+    uint32_t interest = 0;      // SocketEvent flags from watch()
+    uint64_t data = 0;
+    bool queued = false;        // on the ready list
+};
+
+// The stack's sockets and the ready list behind watch() and wait_events().
+//
+// Readiness is not stored. The stack calls notify() wherever it may have
+// changed (data arrived, an ACK freed send space, a connection was
+// established or closed) and wait_events() asks for the current state of
+// each queued socket. A socket that is still ready stays queued for the
+// next wait unless its interest has EDGE, so the cost of a wait is the
+// number of ready sockets, not of open ones. Single-threaded.
+class SocketTable {
+public:
+    // A fresh slot's handle; slots are reused most recently freed first
+    SocketId allocate(SocketKind kind);
+    void free(uint32_t index);
+
+    // The slot a handle names, or null if it is stale or of another kind
+    SocketSlot* get(SocketId id, SocketKind kind);
+    const SocketSlot* get(SocketId id, SocketKind kind) const {
+        return const_cast<SocketTable*>(this)->get(id, kind);
+    }
+    SocketSlot& at(uint32_t index) { return slots_[index]; }
+    SocketId id_of(uint32_t index) const {
+        return static_cast<SocketId>(slots_[index].generation) << 32 | (index + 1);
+    }
+    static uint32_t index_of(SocketId id) { return static_cast<uint32_t>(id) - 1; }
+
+    // The slot's readiness may have changed; queues it if anything is watched
+    void notify(uint32_t index);
+
+    // Fills events from the ready list. readiness(const SocketSlot&) returns
+    // a socket's current SocketEvent flags.
+    template <typename Readiness>
+    size_t collect(std::span<SocketEvent> events, Readiness&& readiness) {
+        size_t count = 0;
+        // Sockets re-queued below are not looked at again in this call
+        for (size_t pending = ready_.size(); pending > 0 && count < events.size(); --pending) {
+            uint32_t index = ready_.front();
+            ready_.pop_front();
+            SocketSlot& slot = slots_[index];
+            uint32_t ready = slot.kind == SocketKind::FREE ? 0 : readiness(slot) & slot.interest;
+            if (ready == 0) {
+                slot.queued = false;
+                continue;
+            }
+            events[count++] = SocketEvent{id_of(index), ready, slot.data};
+            if (slot.interest & SocketEvent::EDGE) {
+                slot.queued = false;
+            } else {
+                ready_.push_back(index);
+            }
+        }
+        return count;
+    }
+
+    size_t get_open() const { return slots_.size() - free_.size(); }
+    size_t get_ready() const { return ready_.size(); }
+
+private:
+    std::vector<SocketSlot> slots_;
+    std::vector<uint32_t> free_;
+    std::deque<uint32_t> ready_;
+};
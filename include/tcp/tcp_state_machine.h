@@ -1,7 +1,9 @@
 #pragma once
 #include <cstdint>
+#include <cstddef>
+#include <array>
 
-enum class TCPState {
+enum class TCPState : uint8_t {
     CLOSED,
     LISTEN,
     SYN_SENT,
@@ -15,25 +17,152 @@ enum class TCPState {
     TIME_WAIT
 };
 
-class TCPStateMachine {
+enum class TCPEvent : uint8_t {
+    OPEN_PASSIVE,       // listen()
+    CLOSE,              // abort before synchronizing
+    SEND_SYN,
+    SEND_ACK,
+    SEND_FIN,
+    RECV_SYN,
+    RECV_SYN_ACK,
+    RECV_ACK,           // in FIN_WAIT_1, CLOSING and LAST_ACK: the ACK of our FIN
+    RECV_FIN,
+    RECV_RST,
+    TIME_WAIT_EXPIRED   // 2*MSL elapsed
+};
+
+const char* tcp_state_name(TCPState state);
+const char* tcp_event_name(TCPEvent event);
+
+constexpr size_t TCP_STATE_COUNT = 11;
+constexpr size_t TCP_EVENT_COUNT = 11;
+// Marks an event that is not valid in a state; the state is left unchanged
+constexpr uint8_t TCP_INVALID_TRANSITION = 0xFF;
+
+using TCPTransitionTable = std::array<std::array<uint8_t, TCP_EVENT_COUNT>, TCP_STATE_COUNT>;
+
+constexpr TCPTransitionTable build_tcp_transition_table() {
+    TCPTransitionTable table{};
+    for (auto& row : table) {
+        row.fill(TCP_INVALID_TRANSITION);
+    }
+
+    auto set = [&table](TCPState from, TCPEvent event, TCPState to) {
+        table[static_cast<size_t>(from)][static_cast<size_t>(event)] = static_cast<uint8_t>(to);
+    };
+    using S = TCPState;
+    using E = TCPEvent;
+
+    set(S::CLOSED, E::OPEN_PASSIVE, S::LISTEN);
+    set(S::CLOSED, E::SEND_SYN, S::SYN_SENT);
+
+    set(S::LISTEN, E::RECV_SYN, S::SYN_RECEIVED);
+    set(S::LISTEN, E::SEND_SYN, S::SYN_SENT);
+    set(S::LISTEN, E::CLOSE, S::CLOSED);
+    set(S::LISTEN, E::RECV_RST, S::LISTEN);
+
+    set(S::SYN_SENT, E::RECV_SYN_ACK, S::ESTABLISHED);
+    set(S::SYN_SENT, E::RECV_SYN, S::SYN_RECEIVED);     // simultaneous open
+    set(S::SYN_SENT, E::CLOSE, S::CLOSED);
+
+    set(S::SYN_RECEIVED, E::RECV_ACK, S::ESTABLISHED);
+    set(S::SYN_RECEIVED, E::SEND_FIN, S::FIN_WAIT_1);
+    set(S::SYN_RECEIVED, E::SEND_ACK, S::SYN_RECEIVED);
+    set(S::SYN_RECEIVED, E::RECV_SYN_ACK, S::ESTABLISHED); // the crossed SYN-ACK of a simultaneous open
+
+    set(S::ESTABLISHED, E::RECV_ACK, S::ESTABLISHED);
+    set(S::ESTABLISHED, E::SEND_ACK, S::ESTABLISHED);
+    set(S::ESTABLISHED, E::RECV_FIN, S::CLOSE_WAIT);
+    set(S::ESTABLISHED, E::SEND_FIN, S::FIN_WAIT_1);
+
+    set(S::FIN_WAIT_1, E::RECV_ACK, S::FIN_WAIT_2);
+    set(S::FIN_WAIT_1, E::RECV_FIN, S::CLOSING);        // simultaneous close
+    set(S::FIN_WAIT_1, E::SEND_ACK, S::FIN_WAIT_1);
+
+    set(S::FIN_WAIT_2, E::RECV_ACK, S::FIN_WAIT_2);
+    set(S::FIN_WAIT_2, E::SEND_ACK, S::FIN_WAIT_2);
+    set(S::FIN_WAIT_2, E::RECV_FIN, S::TIME_WAIT);
+
+    set(S::CLOSE_WAIT, E::RECV_ACK, S::CLOSE_WAIT);
+    set(S::CLOSE_WAIT, E::SEND_ACK, S::CLOSE_WAIT);
+    set(S::CLOSE_WAIT, E::SEND_FIN, S::LAST_ACK);
+    set(S::CLOSE_WAIT, E::RECV_FIN, S::CLOSE_WAIT);     // retransmitted FIN
+
+    set(S::CLOSING, E::RECV_ACK, S::TIME_WAIT);
+    set(S::CLOSING, E::SEND_ACK, S::CLOSING);
+    set(S::CLOSING, E::RECV_FIN, S::CLOSING);
+
+    set(S::LAST_ACK, E::RECV_ACK, S::CLOSED);
+    set(S::LAST_ACK, E::RECV_FIN, S::LAST_ACK);
+
+    set(S::TIME_WAIT, E::RECV_ACK, S::TIME_WAIT);
+    set(S::TIME_WAIT, E::SEND_ACK, S::TIME_WAIT);
+    set(S::TIME_WAIT, E::RECV_FIN, S::TIME_WAIT);       // retransmitted FIN
+    set(S::TIME_WAIT, E::TIME_WAIT_EXPIRED, S::CLOSED);
+
+    // A reset aborts any synchronized or half-open connection
+    for (S state : {S::SYN_SENT, S::SYN_RECEIVED, S::ESTABLISHED, S::FIN_WAIT_1, S::FIN_WAIT_2,
+                    S::CLOSE_WAIT, S::CLOSING, S::LAST_ACK, S::TIME_WAIT}) {
+        set(state, E::RECV_RST, S::CLOSED);
+    }
+    return table;
+}
+
+inline constexpr TCPTransitionTable TCP_TRANSITIONS = build_tcp_transition_table();
+
+// Compile-time logging policies for BasicTCPStateMachine
+struct NoStateLogging {
+    static void on_transition(TCPState, TCPEvent, TCPState) {}
+    static void on_rejected(TCPState, TCPEvent) {}
+};
+
+// Prints every event to stdout; for demos and debugging only
+struct StreamStateLogging {
+    static void on_transition(TCPState from, TCPEvent event, TCPState to);
+    static void on_rejected(TCPState state, TCPEvent event);
+};
+
+// Connection state driven by a constexpr (state x event) table. One byte
+// per connection; the logging policy is stateless and compiles away when
+// it does nothing.
+template <typename LogPolicy>
+class BasicTCPStateMachine {
 public:
-    TCPStateMachine();
-    
-    void handle_syn();
-    void handle_syn_ack();
-    void handle_ack();
-    void handle_fin();
-    void handle_rst();
-    
-    void send_syn();
-    void send_ack();
-    void send_fin();
-    
-    TCPState get_state() const { return current_state_; }
-    const char* get_state_name() const;
+    // Applies an event. Returns false, leaving the state unchanged, if the
+    // event is not valid in the current state.
+    bool apply(TCPEvent event) {
+        uint8_t next = TCP_TRANSITIONS[state_][static_cast<size_t>(event)];
+        if (next == TCP_INVALID_TRANSITION) [[unlikely]] {
+            LogPolicy::on_rejected(get_state(), event);
+            return false;
+        }
+        LogPolicy::on_transition(get_state(), event, static_cast<TCPState>(next));
+        state_ = next;
+        return true;
+    }
+
+    bool listen() { return apply(TCPEvent::OPEN_PASSIVE); }
+    bool close() { return apply(TCPEvent::CLOSE); }
+
+    bool handle_syn() { return apply(TCPEvent::RECV_SYN); }
+    bool handle_syn_ack() { return apply(TCPEvent::RECV_SYN_ACK); }
+    bool handle_ack() { return apply(TCPEvent::RECV_ACK); }
+    bool handle_fin() { return apply(TCPEvent::RECV_FIN); }
+    bool handle_rst() { return apply(TCPEvent::RECV_RST); }
+    bool handle_time_wait_expired() { return apply(TCPEvent::TIME_WAIT_EXPIRED); }
+
+    bool send_syn() { return apply(TCPEvent::SEND_SYN); }
+    bool send_ack() { return apply(TCPEvent::SEND_ACK); }
+    bool send_fin() { return apply(TCPEvent::SEND_FIN); }
+
+    TCPState get_state() const { return static_cast<TCPState>(state_); }
+    const char* get_state_name() const { return tcp_state_name(get_state()); }
 
 private:
-    TCPState current_state_ = TCPState::CLOSED;
-    
-    void transition_to(TCPState new_state);
+    uint8_t state_ = static_cast<uint8_t>(TCPState::CLOSED);
 };
+
+using TCPStateMachine = BasicTCPStateMachine<NoStateLogging>;
+using VerboseTCPStateMachine = BasicTCPStateMachine<StreamStateLogging>;
+
+static_assert(sizeof(TCPStateMachine) == 1);
@@ -0,0 +1,117 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include "tcp/tcp_options.h"
+#include "tcp/tcp_segment.h"
+#include "ip/ipv4_packet.h"
+#include "ip/checksum.h"
+#include "util/byte_order.h"
+
+// Non-owning, read-only view of a TCP segment inside a capture buffer.
+// Fields are decoded on demand; options and payload are subspans.
+class TCPView {
+public:
+    static constexpr size_t MIN_HEADER_SIZE = 20;
+
+    TCPView() = default;
+
+    // Returns false on truncated buffers or a data offset outside the segment
+    bool parse(std::span<const uint8_t> data) {
+        if (data.size() < MIN_HEADER_SIZE) {
+            return false;
+        }
+
+        size_t header_length = static_cast<size_t>(data[12] >> 4) * 4;
+        if (header_length < MIN_HEADER_SIZE || header_length > data.size()) {
+            return false;
+        }
+
+        data_ = data;
+        return true;
+    }
+
+    uint16_t get_source_port() const { return read_be16(data_.data()); }
+    uint16_t get_dest_port() const { return read_be16(data_.data() + 2); }
+    uint32_t get_sequence_number() const { return read_be32(data_.data() + 4); }
+    uint32_t get_ack_number() const { return read_be32(data_.data() + 8); }
+    uint8_t get_data_offset() const { return data_[12] >> 4; }
+    size_t get_header_length() const { return static_cast<size_t>(get_data_offset()) * 4; }
+    uint8_t get_flags() const { return data_[13]; }
+    uint16_t get_window_size() const { return read_be16(data_.data() + 14); }
+    uint16_t get_checksum() const { return read_be16(data_.data() + 16); }
+    uint16_t get_urgent_pointer() const { return read_be16(data_.data() + 18); }
+
+    bool has_flag(uint8_t flag) const { return (get_flags() & flag) != 0; }
+
+    // Checks the checksum over the pseudo-header and the whole segment, given
+    // the IP layer's host-order addresses
+    bool has_valid_checksum(uint32_t source_address, uint32_t dest_address) const {
+        ChecksumAccumulator accumulator;
+        accumulator.add32(source_address);
+        accumulator.add32(dest_address);
+        accumulator.add16(IPv4Packet::PROTOCOL_TCP);
+        accumulator.add16(static_cast<uint16_t>(data_.size()));
+        accumulator.add(data_);
+        return accumulator.finish() == 0;
+    }
+
+    // Decodes the fixed header into the owning representation
+    TCPHeader get_header() const {
+        TCPHeader header;
+        header.source_port = get_source_port();
+        header.dest_port = get_dest_port();
+        header.sequence_number = get_sequence_number();
+        header.acknowledgment_number = get_ack_number();
+        header.data_offset = get_data_offset();
+        header.flags = get_flags();
+        header.window_size = get_window_size();
+        header.checksum = get_checksum();
+        header.urgent_pointer = get_urgent_pointer();
+        return header;
+    }
+
+    std::span<const uint8_t> get_options() const {
+        return data_.subspan(MIN_HEADER_SIZE, get_header_length() - MIN_HEADER_SIZE);
+    }
+    // False if the options are malformed
+    bool decode_options(TCPOptions& options) const { return parse_tcp_options(get_options(), options); }
+    std::span<const uint8_t> get_payload() const { return data_.subspan(get_header_length()); }
+    std::span<const uint8_t> get_bytes() const { return data_; }
+
+private:
+    std::span<const uint8_t> data_;
+};
+
+// Writable view for in-place NAT rewrites. Setters patch the TCP checksum
+// incrementally (RFC 1624) instead of re-summing the whole segment.
+class TCPMutableView : public TCPView {
+public:
+    TCPMutableView() = default;
+
+    bool parse(std::span<uint8_t> data) {
+        if (!TCPView::parse(data)) {
+            return false;
+        }
+        bytes_ = data.data();
+        return true;
+    }
+
+    void set_source_port(uint16_t port) { rewrite16(0, port); }
+    void set_dest_port(uint16_t port) { rewrite16(2, port); }
+
+    // The IP layer changed an address covered by the pseudo-header
+    // (host-order addresses, as returned by IPv4View)
+    void rewrite_pseudo_header_address(uint32_t old_address, uint32_t new_address) {
+        write_be16(bytes_ + 16, checksum_update32(read_be16(bytes_ + 16), old_address, new_address));
+    }
+
+private:
+    uint8_t* bytes_ = nullptr;
+
+    void rewrite16(size_t offset, uint16_t value) {
+        uint16_t old_value = read_be16(bytes_ + offset);
+        write_be16(bytes_ + offset, value);
+        write_be16(bytes_ + 16, checksum_update16(read_be16(bytes_ + 16), old_value, value));
+    }
+};
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include "link/lossy_link.h"
+#include "tcp/tcp_sender.h"
+
+struct TransferConfig {
+    size_t bytes = 4 << 20;
+    SenderConfig sender;
+    LossyLinkConfig forward;            // data direction
+    LossyLinkConfig reverse;            // ACKs
+    size_t receive_window = 65535;
+    uint8_t window_scale = 0;           // shift on the advertised window (RFC 7323)
+    uint64_t time_limit_ns = 600'000'000'000ULL; // simulated time
+};
+
+struct TransferResult {
+    bool completed = false;     // every byte arrived within the time limit
+    bool intact = true;         // and in order with the right contents
+    uint64_t elapsed_ns = 0;    // simulated
+    double goodput_bps = 0;     // application bytes per simulated second, in bits
+    uint32_t final_cwnd = 0;
+    SenderStats sender;
+    LossyLinkStats forward;
+    LossyLinkStats reverse;
+};
+
+// Runs one bulk transfer between a TCPSender and a TCPReceiveBuffer over a
+// pair of LossyLinks. Segments cross the links serialized and checksummed,
+// the receiver ACKs every segment (with SACK blocks and timestamps when
+// config.sender enables them), and the retransmission timer runs on a
+// TimerWheel. Simulated time jumps from event to event, so a transfer of
+// seconds runs in milliseconds and repeats exactly for the same seeds.
+TransferResult simulate_transfer(const TransferConfig& config);
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+
+// Big-endian (network order) load/store helpers for raw packet buffers.
+
+inline uint16_t read_be16(const uint8_t* p) {
+    return static_cast<uint16_t>((static_cast<uint16_t>(p[0]) << 8) | p[1]);
+}
+
+inline uint32_t read_be32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) |
+           (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) |
+           p[3];
+}
+
+inline void write_be16(uint8_t* p, uint16_t value) {
+    p[0] = static_cast<uint8_t>((value >> 8) & 0xFF);
+    p[1] = static_cast<uint8_t>(value & 0xFF);
+}
+
+inline void write_be32(uint8_t* p, uint32_t value) {
+    p[0] = static_cast<uint8_t>((value >> 24) & 0xFF);
+    p[1] = static_cast<uint8_t>((value >> 16) & 0xFF);
+    p[2] = static_cast<uint8_t>((value >> 8) & 0xFF);
+    p[3] = static_cast<uint8_t>(value & 0xFF);
+}
@@ -5,29 +5,31 @@ echo "Simple TCP/IP Stack Builder"
 # Create necessary directories
 mkdir -p demo tests
 
+SRCS="src/ethernet/ethernet_frame.cpp src/ip/ipv4_packet.cpp src/ip/ipv4_reassembler.cpp src/ip/checksum.cpp src/tcp/tcp_segment.cpp src/tcp/tcp_options.cpp src/tcp/tcp_segmenter.cpp src/tcp/tcp_coalescer.cpp src/tcp/tcp_socket.cpp src/tcp/tcp_receive_buffer.cpp src/tcp/tcp_state_machine.cpp src/tcp/congestion_control.cpp src/tcp/tcp_sender.cpp src/tcp/transfer_simulator.cpp src/buffer/packet_pool.cpp src/core/metrics.cpp src/core/rss.cpp src/core/trace.cpp src/link/capture_file.cpp src/link/pcap_device.cpp src/link/lossy_link.cpp src/link/virtual_wire.cpp src/stack.cpp src/coro/task.cpp src/coro/event_loop.cpp"
+OBJS=""
+
 # Compile all source files
 echo "Compiling source files..."
-g++ -std=c++17 -Iinclude -c src/ethernet/ethernet_frame.cpp -o src/ethernet/ethernet_frame.o
-g++ -std=c++17 -Iinclude -c src/ip/ipv4_packet.cpp -o src/ip/ipv4_packet.o
-g++ -std=c++17 -Iinclude -c src/ip/checksum.cpp -o src/ip/checksum.o
-g++ -std=c++17 -Iinclude -c src/tcp/tcp_segment.cpp -o src/tcp/tcp_segment.o
-g++ -std=c++17 -Iinclude -c src/tcp/tcp_state_machine.cpp -o src/tcp/tcp_state_machine.o
-g++ -std=c++17 -Iinclude -c src/stack.cpp -o src/stack.o
+for src in $SRCS; do
+    obj=${src%.cpp}.o
+    g++ -std=c++20 -Iinclude -c $src -o $obj
+    OBJS="$OBJS $obj"
+done
 
 # Build demo
 echo "Building demo..."
-g++ -std=c++17 -Iinclude -c demo/simple_demo.cpp -o demo/simple_demo.o
-g++ -o demo/simple_demo demo/simple_demo.o src/ethernet/ethernet_frame.o src/ip/ipv4_packet.o src/ip/checksum.o src/tcp/tcp_segment.o src/tcp/tcp_state_machine.o src/stack.o -lpcap
+g++ -std=c++20 -Iinclude -c demo/simple_demo.cpp -o demo/simple_demo.o
+g++ -o demo/simple_demo demo/simple_demo.o $OBJS -lpcap -lpthread
 
 # Build state machine demo
 echo "Building state machine demo..."
-g++ -std=c++17 -Iinclude -c demo/state_machine_demo.cpp -o demo/state_machine_demo.o
-g++ -o demo/state_machine_demo demo/state_machine_demo.o src/ethernet/ethernet_frame.o src/ip/ipv4_packet.o src/ip/checksum.o src/tcp/tcp_segment.o src/tcp/tcp_state_machine.o src/stack.o -lpcap
+g++ -std=c++20 -Iinclude -c demo/state_machine_demo.cpp -o demo/state_machine_demo.o
+g++ -o demo/state_machine_demo demo/state_machine_demo.o $OBJS -lpcap -lpthread
 
 # Build tests
 echo "Building tests..."
-g++ -std=c++17 -Iinclude -c tests/manual_test.cpp -o tests/manual_test.o
-g++ -o tests/manual_test tests/manual_test.o src/ethernet/ethernet_frame.o src/ip/ipv4_packet.o src/ip/checksum.o src/tcp/tcp_segment.o src/tcp/tcp_state_machine.o src/stack.o -lpcap
+g++ -std=c++20 -Iinclude -c tests/manual_test.cpp -o tests/manual_test.o
+g++ -o tests/manual_test tests/manual_test.o $OBJS -lpcap -lpthread
 
 if [ -f "demo/simple_demo" ]; then
     echo ""
@@ -0,0 +1,290 @@
+#include "buffer/packet_pool.h"
+#include <algorithm>
+#include <mutex>
+#include <new>
+#include <unordered_set>
+
+static_assert(sizeof(PacketBuffer) <= PacketBuffer::STORAGE_OFFSET,
+              "packet buffer metadata must fit in front of its storage");
+
+static constexpr size_t CACHE_LINE_SIZE = 64;
+static constexpr size_t MAX_CACHE_SIZE = 256;
+static constexpr size_t MAX_CACHED_POOLS = 4;
+
+static size_t round_up(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Pools that are still alive, so exiting threads only flush their caches into
+// pools that have not been destroyed yet
+static std::mutex& registry_mutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+static std::unordered_set<uint64_t>& live_pools() {
+    static std::unordered_set<uint64_t> pools;
+    return pools;
+}
+
+static std::atomic<uint64_t> next_pool_id{1};
+
+// Per-thread buffer cache, one slot per pool this thread has used recently
+struct PacketPoolThreadCache {
+    struct Entry {
+        PacketPool* pool = nullptr;
+        uint64_t pool_id = 0;
+        size_t count = 0;
+        PacketBuffer* buffers[MAX_CACHE_SIZE];
+    };
+
+    Entry entries[MAX_CACHED_POOLS];
+    size_t next_victim = 0;
+
+    ~PacketPoolThreadCache() {
+        std::lock_guard<std::mutex> lock(registry_mutex());
+        for (auto& entry : entries) {
+            if (entry.count > 0 && live_pools().count(entry.pool_id) != 0) {
+                entry.pool->return_to_free_list(entry.buffers, entry.count);
+            }
+        }
+    }
+
+    Entry* find(PacketPool* pool, uint64_t pool_id) {
+        for (auto& entry : entries) {
+            if (entry.pool == pool && entry.pool_id == pool_id) {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+    Entry* find_or_claim(PacketPool* pool, uint64_t pool_id) {
+        if (Entry* entry = find(pool, pool_id)) {
+            return entry;
+        }
+        
+        for (auto& entry : entries) {
+            if (entry.pool == nullptr) {
+                entry.pool = pool;
+                entry.pool_id = pool_id;
+                return &entry;
+            }
+        }
+        
+        // Reuse a slot; buffers still cached for another pool go back to it
+        Entry& entry = entries[next_victim];
+        next_victim = (next_victim + 1) % MAX_CACHED_POOLS;
+        if (entry.count > 0) {
+            std::lock_guard<std::mutex> lock(registry_mutex());
+            if (live_pools().count(entry.pool_id) != 0) {
+                entry.pool->return_to_free_list(entry.buffers, entry.count);
+            }
+        }
+        entry.pool = pool;
+        entry.pool_id = pool_id;
+        entry.count = 0;
+        return &entry;
+    }
+};
+
+static thread_local PacketPoolThreadCache thread_cache;
+
+PacketHandle::PacketHandle(const PacketHandle& other) : buffer_(other.buffer_) {
+    if (buffer_ != nullptr) {
+        buffer_->refcount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+PacketHandle& PacketHandle::operator=(const PacketHandle& other) {
+    if (this != &other) {
+        release();
+        buffer_ = other.buffer_;
+        if (buffer_ != nullptr) {
+            buffer_->refcount.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    return *this;
+}
+
+PacketHandle& PacketHandle::operator=(PacketHandle&& other) noexcept {
+    if (this != &other) {
+        release();
+        buffer_ = other.buffer_;
+        other.buffer_ = nullptr;
+    }
+    return *this;
+}
+
+void PacketHandle::release() {
+    if (buffer_ == nullptr) {
+        return;
+    }
+    if (buffer_->refcount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        buffer_->pool->free_buffer(buffer_);
+    }
+    buffer_ = nullptr;
+}
+
+uint8_t* PacketHandle::prepend(size_t length) {
+    if (length > headroom()) {
+        return nullptr;
+    }
+    buffer_->data_offset -= static_cast<uint32_t>(length);
+    buffer_->data_length += static_cast<uint32_t>(length);
+    return data();
+}
+
+uint8_t* PacketHandle::append(size_t length) {
+    if (length > tailroom()) {
+        return nullptr;
+    }
+    uint8_t* tail = data() + size();
+    buffer_->data_length += static_cast<uint32_t>(length);
+    return tail;
+}
+
+bool PacketHandle::adjust(size_t length) {
+    if (length > size()) {
+        return false;
+    }
+    buffer_->data_offset += static_cast<uint32_t>(length);
+    buffer_->data_length -= static_cast<uint32_t>(length);
+    return true;
+}
+
+bool PacketHandle::trim(size_t length) {
+    if (length > size()) {
+        return false;
+    }
+    buffer_->data_length -= static_cast<uint32_t>(length);
+    return true;
+}
+
+PacketPool::PacketPool(const PacketPoolConfig& config)
+    : config_(config), id_(next_pool_id.fetch_add(1)) {
+    config_.cache_size = std::min(config_.cache_size, MAX_CACHE_SIZE);
+    config_.headroom = std::min(config_.headroom, config_.buffer_size);
+    
+    size_t stride = PacketBuffer::STORAGE_OFFSET + round_up(config_.buffer_size, CACHE_LINE_SIZE);
+    slab_size_ = stride * config_.buffer_count;
+    slab_ = static_cast<uint8_t*>(::operator new(slab_size_, std::align_val_t(CACHE_LINE_SIZE)));
+    
+    // Thread the free list through the slab back to front so buffers are
+    // handed out in address order
+    for (size_t i = config_.buffer_count; i-- > 0;) {
+        auto* buffer = new (slab_ + i * stride) PacketBuffer;
+        buffer->pool = this;
+        buffer->refcount.store(0, std::memory_order_relaxed);
+        buffer->capacity = static_cast<uint32_t>(config_.buffer_size);
+        buffer->data_offset = 0;
+        buffer->data_length = 0;
+        buffer->next_free = free_list_;
+        free_list_ = buffer;
+    }
+    free_count_.store(config_.buffer_count, std::memory_order_relaxed);
+    
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    live_pools().insert(id_);
+}
+
+PacketPool::~PacketPool() {
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex());
+        live_pools().erase(id_);
+    }
+    
+    size_t stride = PacketBuffer::STORAGE_OFFSET + round_up(config_.buffer_size, CACHE_LINE_SIZE);
+    for (size_t i = 0; i < config_.buffer_count; ++i) {
+        reinterpret_cast<PacketBuffer*>(slab_ + i * stride)->~PacketBuffer();
+    }
+    ::operator delete(slab_, std::align_val_t(CACHE_LINE_SIZE));
+}
+
+PacketHandle PacketPool::alloc() {
+    PacketBuffer* buffer = alloc_buffer();
+    if (buffer == nullptr) {
+        exhausted_.fetch_add(1, std::memory_order_relaxed);
+        return PacketHandle();
+    }
+    
+    buffer->refcount.store(1, std::memory_order_relaxed);
+    buffer->data_offset = static_cast<uint32_t>(config_.headroom);
+    buffer->data_length = 0;
+    return PacketHandle(buffer);
+}
+
+size_t PacketPool::alloc_burst(PacketHandle* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = alloc();
+        if (!out[i]) {
+            return i;
+        }
+    }
+    return count;
+}
+
+PacketPoolStats PacketPool::get_stats() const {
+    PacketPoolStats stats;
+    stats.capacity = config_.buffer_count;
+    stats.memory_bytes = slab_size_;
+    stats.free_buffers = free_count_.load(std::memory_order_relaxed);
+    stats.exhausted = exhausted_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+PacketBuffer* PacketPool::alloc_buffer() {
+    if (config_.cache_size == 0) {
+        PacketBuffer* buffer = nullptr;
+        take_from_free_list(&buffer, 1);
+        return buffer;
+    }
+    
+    auto* entry = thread_cache.find_or_claim(this, id_);
+    if (entry->count == 0) {
+        // Refill half the cache in one locked transfer
+        size_t refill = std::max<size_t>(1, config_.cache_size / 2);
+        entry->count = take_from_free_list(entry->buffers, refill);
+        if (entry->count == 0) {
+            return nullptr;
+        }
+    }
+    return entry->buffers[--entry->count];
+}
+
+void PacketPool::free_buffer(PacketBuffer* buffer) {
+    if (config_.cache_size == 0) {
+        return_to_free_list(&buffer, 1);
+        return;
+    }
+    
+    auto* entry = thread_cache.find_or_claim(this, id_);
+    if (entry->count == config_.cache_size) {
+        // Spill the older half back to the shared list
+        size_t spill = std::max<size_t>(1, config_.cache_size / 2);
+        return_to_free_list(entry->buffers, spill);
+        std::copy(entry->buffers + spill, entry->buffers + entry->count, entry->buffers);
+        entry->count -= spill;
+    }
+    entry->buffers[entry->count++] = buffer;
+}
+
+size_t PacketPool::take_from_free_list(PacketBuffer** out, size_t count) {
+    std::lock_guard<std::mutex> lock(free_mutex_);
+    size_t taken = 0;
+    while (taken < count && free_list_ != nullptr) {
+        out[taken++] = free_list_;
+        free_list_ = free_list_->next_free;
+    }
+    free_count_.fetch_sub(taken, std::memory_order_relaxed);
+    return taken;
+}
+
+void PacketPool::return_to_free_list(PacketBuffer* const* buffers, size_t count) {
+    std::lock_guard<std::mutex> lock(free_mutex_);
+    for (size_t i = 0; i < count; ++i) {
+        buffers[i]->next_free = free_list_;
+        free_list_ = buffers[i];
+    }
+    free_count_.fetch_add(count, std::memory_order_relaxed);
+}
@@ -0,0 +1,159 @@
+#include "core/metrics.h"
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct MetricInfo {
+    const char* name;
+    const char* help;
+};
+
+static const MetricInfo METRIC_INFO[] = {
+    {"rx_packets", "Frames received"},
+    {"rx_bytes", "Bytes received"},
+    {"rx_no_buffer", "Frames dropped because the packet pool was exhausted"},
+    {"rx_oversize", "Frames dropped because they exceeded a pool buffer"},
+    {"rx_queue_full", "Frames dropped because a worker queue was full"},
+    {"eth_too_short", "Frames shorter than an Ethernet header"},
+    {"eth_unknown_type", "Frames with an EtherType other than IPv4"},
+    {"ip_packets", "IPv4 packets with a valid header"},
+    {"ip_malformed", "IPv4 packets with a truncated or invalid header"},
+    {"ip_bad_checksum", "IPv4 packets with a wrong header checksum"},
+    {"ip_unknown_protocol", "IPv4 packets carrying a protocol other than TCP"},
+    {"ip_fragments", "IPv4 fragments offered for reassembly"},
+    {"ip_reassembled", "IPv4 datagrams rebuilt from fragments"},
+    {"ip_fragment_overlaps", "IPv4 datagrams dropped for overlapping fragments"},
+    {"ip_reassembly_timeouts", "IPv4 datagrams whose fragments timed out incomplete"},
+    {"ip_reassembly_drops", "IPv4 fragments or datagrams dropped for reassembly limits"},
+    {"tcp_segments", "TCP segments with a valid header"},
+    {"tcp_gro_merged", "TCP segments merged into the segment before them by GRO"},
+    {"tcp_malformed", "TCP segments with a truncated header or bad data offset"},
+    {"tcp_bad_checksum", "TCP segments with a wrong checksum"},
+    {"tcp_no_connection", "TCP segments for no connection and not opening one"},
+    {"tcp_bad_state", "TCP segments rejected by the connection's state"},
+    {"tcp_bytes_received", "TCP payload bytes received in order"},
+    {"tcp_out_of_order", "TCP segments held ahead of a hole in the sequence space"},
+    {"tcp_duplicate", "TCP segments carrying only data already received"},
+    {"tcp_out_of_window", "TCP segments dropped outside the receive window"},
+    {"tcp_connections_opened", "TCP connections created"},
+    {"tcp_connections_closed", "TCP connections closed"},
+    {"tcp_time_wait_expired", "TCP connections closed when TIME_WAIT ran out"},
+    {"tcp_keepalive_timeouts", "TCP connections dropped after the keepalive idle time"},
+    {"tcp_segments_sent", "TCP segments sent by connections with a socket"},
+    {"tcp_retransmit_timeouts", "TCP retransmission timer expiries, handshake and FIN included"},
+    {"tcp_listen_overflows", "SYNs dropped because the listening socket's accept queue was full"},
+    {"tcp_resets_ignored", "TCP resets ignored for a sequence number other than the next expected"},
+    {"tcp_challenge_acks", "TCP challenge ACKs sent for resets inside the receive window"},
+    {"tx_packets", "Frames transmitted"},
+    {"tx_ring_full", "Frames refused because the transmit ring was full"},
+    {"tx_device_errors", "Frames the device failed to send"},
+    {"tx_no_buffer", "TCP segments not sent because the packet pool was exhausted"},
+    {"tx_oversize", "TCP segments not sent because they exceeded a pool buffer"},
+};
+static_assert(sizeof(METRIC_INFO) / sizeof(METRIC_INFO[0]) == METRIC_COUNT);
+
+const char* metric_name(Metric metric) {
+    size_t index = static_cast<size_t>(metric);
+    return index < METRIC_COUNT ? METRIC_INFO[index].name : "unknown";
+}
+
+const char* metric_help(Metric metric) {
+    size_t index = static_cast<size_t>(metric);
+    return index < METRIC_COUNT ? METRIC_INFO[index].help : "";
+}
+
+void MetricsSnapshot::add(const MetricCounters& counters) {
+    for (size_t i = 0; i < METRIC_COUNT; ++i) {
+        values[i] += counters.values[i].load(std::memory_order_relaxed);
+    }
+}
+
+MetricsSnapshot MetricsSnapshot::since(const MetricsSnapshot& before) const {
+    MetricsSnapshot delta;
+    for (size_t i = 0; i < METRIC_COUNT; ++i) {
+        delta.values[i] = values[i] - before.values[i];
+    }
+    return delta;
+}
+
+void MetricsSnapshot::write_text(std::ostream& out) const {
+    for (size_t i = 0; i < METRIC_COUNT; ++i) {
+        std::string name = METRIC_INFO[i].name;
+        name.resize(std::max<size_t>(name.size() + 1, 24), ' ');
+        out << name << values[i] << '\n';
+    }
+}
+
+void MetricsSnapshot::write_prometheus(std::ostream& out, std::string_view prefix) const {
+    for (size_t i = 0; i < METRIC_COUNT; ++i) {
+        std::string name = std::string(prefix) + "_" + METRIC_INFO[i].name + "_total";
+        out << "# HELP " << name << ' ' << METRIC_INFO[i].help << '\n';
+        out << "# TYPE " << name << " counter\n";
+        out << name << ' ' << values[i] << '\n';
+    }
+}
+
+// Blocks of live threads, plus the totals of threads that have exited
+struct ProcessMetrics {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<MetricCounters>> blocks;
+    MetricsSnapshot retired;
+};
+
+static ProcessMetrics& process_metrics() {
+    // Never destroyed: threads may still count during static destruction
+    static ProcessMetrics* metrics = new ProcessMetrics();
+    return *metrics;
+}
+
+// The thread's block, folded into the retired totals by the slot's
+// destructor when the thread exits. Counts made after that, from other
+// thread_local destructors, are dropped. Both live outside the slot, as
+// stores to an object in its own destructor may be elided.
+static thread_local MetricCounters* t_metrics_block = nullptr;
+static thread_local bool t_metrics_exited = false;
+
+struct ThreadMetricsSlot {
+    ~ThreadMetricsSlot() {
+        MetricCounters* block = t_metrics_block;
+        t_metrics_block = nullptr;
+        t_metrics_exited = true;
+        if (block == nullptr) {
+            return;
+        }
+        ProcessMetrics& metrics = process_metrics();
+        std::lock_guard<std::mutex> lock(metrics.mutex);
+        metrics.retired.add(*block);
+        std::erase_if(metrics.blocks, [block](const auto& candidate) { return candidate.get() == block; });
+    }
+};
+
+static thread_local ThreadMetricsSlot t_metrics_slot;
+
+void count_metric(Metric metric, uint64_t amount) {
+    MetricCounters* block = t_metrics_block;
+    if (block == nullptr) [[unlikely]] {
+        if (t_metrics_exited) {
+            return;
+        }
+        ProcessMetrics& metrics = process_metrics();
+        std::lock_guard<std::mutex> lock(metrics.mutex);
+        metrics.blocks.push_back(std::make_unique<MetricCounters>());
+        // Touching the slot registers its destructor
+        (void)&t_metrics_slot;
+        block = t_metrics_block = metrics.blocks.back().get();
+    }
+    block->add(metric, amount);
+}
+
+MetricsSnapshot get_process_metrics() {
+    ProcessMetrics& metrics = process_metrics();
+    std::lock_guard<std::mutex> lock(metrics.mutex);
+    MetricsSnapshot snapshot = metrics.retired;
+    for (const auto& block : metrics.blocks) {
+        snapshot.add(*block);
+    }
+    return snapshot;
+}
@@ -0,0 +1,66 @@
+#include "core/rss.h"
+
+RssHasher::RssHasher() : RssHasher(symmetric_key()) {}
+
+RssHasher::RssHasher(const std::array<uint8_t, KEY_SIZE>& key) : key_(key) {
+    for (size_t position = 0; position < MAX_TABLE_INPUT; ++position) {
+        for (uint32_t value = 0; value < 256; ++value) {
+            uint32_t result = 0;
+            for (size_t bit = 0; bit < 8; ++bit) {
+                if (value & (0x80u >> bit)) {
+                    result ^= key_window(position * 8 + bit);
+                }
+            }
+            table_[position][value] = result;
+        }
+    }
+}
+
+std::array<uint8_t, RssHasher::KEY_SIZE> RssHasher::symmetric_key() {
+    std::array<uint8_t, KEY_SIZE> key;
+    for (size_t i = 0; i < KEY_SIZE; i += 2) {
+        key[i] = 0x6D;
+        key[i + 1] = 0x5A;
+    }
+    return key;
+}
+
+// The 32 key bits starting at the given bit offset
+uint32_t RssHasher::key_window(size_t bit) const {
+    size_t byte = bit / 8;
+    uint64_t window = 0;
+    for (size_t i = 0; i < 5; ++i) {
+        window = (window << 8) | (byte + i < KEY_SIZE ? key_[byte + i] : 0);
+    }
+    return static_cast<uint32_t>(window >> (8 - bit % 8));
+}
+
+uint32_t RssHasher::hash(std::span<const uint8_t> input) const {
+    uint32_t result = 0;
+    for (size_t position = 0; position < input.size() && position + 4 < KEY_SIZE; ++position) {
+        if (position < MAX_TABLE_INPUT) {
+            result ^= lookup(position, input[position]);
+            continue;
+        }
+        for (size_t bit = 0; bit < 8; ++bit) {
+            if (input[position] & (0x80u >> bit)) {
+                result ^= key_window(position * 8 + bit);
+            }
+        }
+    }
+    return result;
+}
+
+uint32_t RssHasher::hash_ipv4(uint32_t source, uint32_t destination) const {
+    return lookup(0, source >> 24) ^ lookup(1, (source >> 16) & 0xFF) ^
+           lookup(2, (source >> 8) & 0xFF) ^ lookup(3, source & 0xFF) ^
+           lookup(4, destination >> 24) ^ lookup(5, (destination >> 16) & 0xFF) ^
+           lookup(6, (destination >> 8) & 0xFF) ^ lookup(7, destination & 0xFF);
+}
+
+uint32_t RssHasher::hash_ipv4_tcp(uint32_t source, uint32_t destination,
+                                  uint16_t source_port, uint16_t dest_port) const {
+    return hash_ipv4(source, destination) ^
+           lookup(8, source_port >> 8) ^ lookup(9, source_port & 0xFF) ^
+           lookup(10, dest_port >> 8) ^ lookup(11, dest_port & 0xFF);
+}
@@ -0,0 +1,259 @@
+#include "core/trace.h"
+#include "core/ring.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+static const char* const EVENT_NAMES[] = {
+    "NONE", "CLOCK_SYNC", "RECORDS_DROPPED", "STACK_STARTED", "STACK_STOPPED",
+    "STACK_ALREADY_RUNNING", "THREAD_STARTED", "RX_BURST", "WORKER_QUEUE_FULL", "TX_ERROR",
+    "PCAP_DISPATCH_FAILED", "ETH_MALFORMED", "IP_MALFORMED", "TCP_MALFORMED", "TCP_NO_CONNECTION",
+    "CONNECTION_OPENED", "CONNECTION_CLOSED", "TCP_TRANSITION", "TCP_BAD_STATE", "DESERIALIZE_TOO_SHORT"
+};
+static_assert(sizeof(EVENT_NAMES) / sizeof(EVENT_NAMES[0]) == static_cast<size_t>(TraceEvent::COUNT));
+
+const char* trace_event_name(TraceEvent event) {
+    size_t index = static_cast<size_t>(event);
+    return index < static_cast<size_t>(TraceEvent::COUNT) ? EVENT_NAMES[index] : "UNKNOWN";
+}
+
+// Written only by its thread, drained only by the drainer. A buffer is
+// freed once its thread has exited and it is empty, so a thread never
+// sees its buffer disappear.
+struct ThreadTraceBuffer {
+    ThreadTraceBuffer(size_t size, uint16_t id) : ring(size), thread(id) {}
+
+    SpscRing<TraceRecord> ring;
+    uint16_t thread;
+    std::atomic<bool> retired{false};
+    uint64_t reported_full = 0;  // drainer only
+};
+
+struct TraceState {
+    std::mutex mutex;  // guards buffers and registration
+    std::vector<std::unique_ptr<ThreadTraceBuffer>> buffers;
+    uint16_t next_thread = 0;
+    TraceConfig config;
+    FILE* file = nullptr;
+    std::thread drainer;
+    std::atomic<bool> running{false};
+
+    ~TraceState() {
+        Tracer::stop();
+    }
+};
+
+static TraceState& trace_state() {
+    static TraceState state;
+    return state;
+}
+
+// The thread's buffer, retired by the slot's destructor when the thread
+// exits. Records made after that, from other thread_local destructors, are
+// dropped: the drainer may free a retired buffer at once. Both live outside
+// the slot, as stores to an object in its own destructor may be elided.
+static thread_local ThreadTraceBuffer* t_trace_buffer = nullptr;
+static thread_local bool t_trace_exited = false;
+
+struct ThreadTraceSlot {
+    ~ThreadTraceSlot() {
+        if (t_trace_buffer != nullptr) {
+            t_trace_buffer->retired.store(true, std::memory_order_release);
+            t_trace_buffer = nullptr;
+        }
+        t_trace_exited = true;
+    }
+};
+
+static thread_local ThreadTraceSlot t_trace_slot;
+
+static ThreadTraceBuffer* register_thread() {
+    TraceState& state = trace_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.buffers.push_back(std::make_unique<ThreadTraceBuffer>(state.config.ring_size, state.next_thread++));
+    // Touching the slot registers its destructor
+    (void)&t_trace_slot;
+    t_trace_buffer = state.buffers.back().get();
+    return t_trace_buffer;
+}
+
+void Tracer::record(TraceEvent event, uint64_t connection, uint32_t arg0, uint64_t arg1) {
+    ThreadTraceBuffer* buffer = t_trace_buffer;
+    if (buffer == nullptr) [[unlikely]] {
+        if (t_trace_exited) {
+            return;
+        }
+        buffer = register_thread();
+    }
+    TraceRecord record{trace_timestamp(), connection, static_cast<uint16_t>(event), buffer->thread, arg0, arg1};
+    buffer->ring.enqueue(std::move(record));
+}
+
+static uint64_t steady_nanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void write_clock_sync(FILE* file) {
+    TraceRecord record{trace_timestamp(), 0, static_cast<uint16_t>(TraceEvent::CLOCK_SYNC), 0, 0, steady_nanoseconds()};
+    std::fwrite(&record, sizeof(record), 1, file);
+}
+
+// Writes out every ring; returns the number of records written. With a
+// null file the records are discarded.
+static size_t drain_buffers(TraceState& state, FILE* file) {
+    std::vector<ThreadTraceBuffer*> buffers;
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        for (auto& buffer : state.buffers) {
+            buffers.push_back(buffer.get());
+        }
+    }
+
+    TraceRecord batch[256];
+    size_t written = 0;
+    for (ThreadTraceBuffer* buffer : buffers) {
+        size_t count;
+        while ((count = buffer->ring.dequeue_burst(batch, 256)) > 0) {
+            if (file != nullptr) {
+                std::fwrite(batch, sizeof(TraceRecord), count, file);
+            }
+            written += count;
+        }
+
+        uint64_t full = buffer->ring.get_stats().full;
+        if (full != buffer->reported_full) {
+            if (file != nullptr) {
+                TraceRecord dropped{trace_timestamp(), 0, static_cast<uint16_t>(TraceEvent::RECORDS_DROPPED),
+                                    buffer->thread, buffer->thread, full - buffer->reported_full};
+                std::fwrite(&dropped, sizeof(dropped), 1, file);
+            }
+            buffer->reported_full = full;
+        }
+    }
+
+    // Retire buffers of exited threads once they are empty
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.buffers.erase(std::remove_if(state.buffers.begin(), state.buffers.end(), [](const auto& buffer) {
+        return buffer->retired.load(std::memory_order_acquire) && buffer->ring.empty();
+    }), state.buffers.end());
+    return written;
+}
+
+static void drain_loop(TraceState& state) {
+    constexpr auto SYNC_INTERVAL = std::chrono::seconds(1);
+    auto last_sync = std::chrono::steady_clock::now();
+
+    while (state.running.load(std::memory_order_acquire)) {
+        size_t written = drain_buffers(state, state.file);
+        if (std::chrono::steady_clock::now() - last_sync >= SYNC_INTERVAL) {
+            write_clock_sync(state.file);
+            last_sync = std::chrono::steady_clock::now();
+        }
+        if (written == 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(state.config.drain_interval_us));
+        }
+    }
+}
+
+bool Tracer::start(const std::string& path, const TraceConfig& config) {
+    TraceState& state = trace_state();
+    if (state.running.load()) {
+        return false;
+    }
+
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    TraceFileHeader header;
+    std::memcpy(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_FILE_VERSION;
+    header.record_size = sizeof(TraceRecord);
+    std::fwrite(&header, sizeof(header), 1, file);
+
+    // Records left over from a previous session's late writers
+    drain_buffers(state, nullptr);
+
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.config = config;
+    }
+    state.file = file;
+    write_clock_sync(file);
+    state.running.store(true, std::memory_order_release);
+    state.drainer = std::thread(drain_loop, std::ref(state));
+    enabled_.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+void Tracer::stop() {
+    TraceState& state = trace_state();
+    if (!state.running.load()) {
+        return;
+    }
+
+    enabled_.store(false, std::memory_order_relaxed);
+    state.running.store(false, std::memory_order_release);
+    state.drainer.join();
+
+    drain_buffers(state, state.file);
+    write_clock_sync(state.file);
+    std::fclose(state.file);
+    state.file = nullptr;
+}
+
+bool TraceReader::open(const std::string& path) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    TraceFileHeader header;
+    bool valid = std::fread(&header, sizeof(header), 1, file) == 1 &&
+                 std::memcmp(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic)) == 0 &&
+                 header.version == TRACE_FILE_VERSION && header.record_size == sizeof(TraceRecord);
+    records_.clear();
+    if (valid) {
+        TraceRecord batch[256];
+        size_t count;
+        while ((count = std::fread(batch, sizeof(TraceRecord), 256, file)) > 0) {
+            records_.insert(records_.end(), batch, batch + count);
+        }
+    }
+    std::fclose(file);
+    if (!valid) {
+        return false;
+    }
+
+    std::stable_sort(records_.begin(), records_.end(), [](const TraceRecord& a, const TraceRecord& b) {
+        return a.timestamp < b.timestamp;
+    });
+
+    // Fit ticks to nanoseconds between the first and last clock sync
+    const TraceRecord* first_sync = nullptr;
+    const TraceRecord* last_sync = nullptr;
+    for (const auto& record : records_) {
+        if (record.event == static_cast<uint16_t>(TraceEvent::CLOCK_SYNC)) {
+            if (first_sync == nullptr) {
+                first_sync = &record;
+            }
+            last_sync = &record;
+        }
+    }
+    base_timestamp_ = records_.empty() ? 0 : records_.front().timestamp;
+    if (first_sync != nullptr && last_sync->timestamp > first_sync->timestamp) {
+        nanoseconds_per_tick_ = static_cast<double>(last_sync->arg1 - first_sync->arg1) /
+                                static_cast<double>(last_sync->timestamp - first_sync->timestamp);
+    }
+    return true;
+}
+
+double TraceReader::to_nanoseconds(uint64_t timestamp) const {
+    return static_cast<double>(timestamp - base_timestamp_) * nanoseconds_per_tick_;
+}
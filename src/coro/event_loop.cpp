@@ -0,0 +1,247 @@
+#include "coro/event_loop.h"
+#include "stack.h"
+#include <utility>
+
+static constexpr uint32_t READ_EVENTS = SocketEvent::READABLE | SocketEvent::CLOSED;
+static constexpr uint32_t WRITE_EVENTS = SocketEvent::WRITABLE | SocketEvent::CLOSED;
+
+bool ReadAwaiter::attempt() {
+    result_ = loop_.get_stack().recv(socket_, buffer_);
+    return result_.error != SocketError::WOULD_BLOCK;
+}
+
+void ReadAwaiter::await_suspend(std::coroutine_handle<> coroutine) {
+    handle = coroutine;
+    loop_.wait(socket_, READ_EVENTS, *this);
+}
+
+bool WriteAwaiter::attempt() {
+    if (data_.empty()) {
+        result_ = IoResult();
+        return true;
+    }
+    result_ = loop_.get_stack().send(socket_, data_);
+    return result_.error != SocketError::WOULD_BLOCK;
+}
+
+void WriteAwaiter::await_suspend(std::coroutine_handle<> coroutine) {
+    handle = coroutine;
+    loop_.wait(socket_, WRITE_EVENTS, *this);
+}
+
+// Connected once there is room to send; gone if it closed before that
+bool ConnectAwaiter::attempt() {
+    TCPIPStack& stack = loop_.get_stack();
+    uint32_t events = socket_ != 0 ? stack.get_events(socket_) : 0;
+    if (events & SocketEvent::WRITABLE) {
+        return true;
+    }
+    error_ = socket_ != 0 ? stack.get_error(socket_) : SocketError::INVALID;
+    if (error_ == SocketError::NONE && (events & SocketEvent::CLOSED)) {
+        error_ = SocketError::CLOSED;
+    }
+    return error_ != SocketError::NONE;
+}
+
+void ConnectAwaiter::await_suspend(std::coroutine_handle<> coroutine) {
+    handle = coroutine;
+    loop_.wait(socket_, WRITE_EVENTS, *this);
+}
+
+AsyncConnection ConnectAwaiter::await_resume() {
+    if (error_ != SocketError::NONE) {
+        if (socket_ != 0) {
+            loop_.get_stack().close(socket_);
+        }
+        return AsyncConnection(loop_, 0, error_);
+    }
+    return AsyncConnection(loop_, socket_);
+}
+
+bool AcceptAwaiter::attempt() {
+    accepted_ = listener_ != 0 ? loop_.get_stack().accept(listener_) : 0;
+    return accepted_ != 0 || listener_ == 0;
+}
+
+void AcceptAwaiter::await_suspend(std::coroutine_handle<> coroutine) {
+    handle = coroutine;
+    loop_.wait(listener_, SocketEvent::READABLE, *this);
+}
+
+AsyncConnection AcceptAwaiter::await_resume() {
+    return AsyncConnection(loop_, accepted_, accepted_ != 0 ? SocketError::NONE : SocketError::INVALID);
+}
+
+AsyncConnection::AsyncConnection(AsyncConnection&& other) noexcept
+    : loop_(other.loop_), socket_(std::exchange(other.socket_, 0)), error_(other.error_) {}
+
+AsyncConnection& AsyncConnection::operator=(AsyncConnection&& other) noexcept {
+    if (this != &other) {
+        close();
+        loop_ = other.loop_;
+        socket_ = std::exchange(other.socket_, 0);
+        error_ = other.error_;
+    }
+    return *this;
+}
+
+void AsyncConnection::close() {
+    if (socket_ != 0) {
+        loop_->forget(socket_);
+        loop_->get_stack().close(socket_);
+        socket_ = 0;
+    }
+}
+
+AsyncListener::AsyncListener(AsyncListener&& other) noexcept
+    : loop_(other.loop_), socket_(std::exchange(other.socket_, 0)) {}
+
+AsyncListener& AsyncListener::operator=(AsyncListener&& other) noexcept {
+    if (this != &other) {
+        close();
+        loop_ = other.loop_;
+        socket_ = std::exchange(other.socket_, 0);
+    }
+    return *this;
+}
+
+void AsyncListener::close() {
+    if (socket_ != 0) {
+        loop_->forget(socket_);
+        loop_->get_stack().close(socket_);
+        socket_ = 0;
+    }
+}
+
+// Destroying a frame runs its destructors, which close sockets through
+// forget(); the lists are emptied first so that finds nothing
+EventLoop::~EventLoop() {
+    std::vector<std::coroutine_handle<>> handles;
+    for (const Waiters& entry : waiters_) {
+        for (SocketWaiter* waiter : {entry.reader, entry.writer}) {
+            if (waiter != nullptr) {
+                handles.push_back(waiter->handle);
+            }
+        }
+    }
+    for (SocketWaiter* waiter : orphans_) {
+        handles.push_back(waiter->handle);
+    }
+    waiters_.clear();
+    orphans_.clear();
+    waiting_ = 0;
+    for (std::coroutine_handle<> handle : handles) {
+        handle.destroy();
+    }
+}
+
+AsyncListener EventLoop::listen(uint16_t port, size_t backlog) {
+    return AsyncListener(*this, stack_.listen_socket(port, backlog));
+}
+
+ConnectAwaiter EventLoop::connect(uint32_t address, uint16_t port) {
+    return ConnectAwaiter(*this, stack_.connect(address, port));
+}
+
+size_t EventLoop::run_once() {
+    stats_.polls++;
+    stack_.poll();
+    size_t resumed = 0;
+
+    if (!orphans_.empty()) {
+        std::vector<SocketWaiter*> orphans;
+        orphans.swap(orphans_);
+        for (SocketWaiter* waiter : orphans) {
+            waiter->attempt();
+            waiting_--;
+            stats_.resumed++;
+            resumed++;
+            waiter->handle.resume();
+        }
+    }
+
+    size_t count = stack_.wait_events(events_);
+    for (size_t i = 0; i < count; ++i) {
+        const SocketEvent& event = events_[i];
+        uint32_t index = static_cast<uint32_t>(event.data);
+        // A resumed coroutine may have closed the socket, or waits again
+        if ((event.events & READ_EVENTS) && index < waiters_.size() && waiters_[index].socket == event.socket &&
+            resume(waiters_[index].reader)) {
+            rewatch(index);
+            resumed++;
+        }
+        if ((event.events & WRITE_EVENTS) && index < waiters_.size() && waiters_[index].socket == event.socket &&
+            resume(waiters_[index].writer)) {
+            rewatch(index);
+            resumed++;
+        }
+    }
+    return resumed;
+}
+
+size_t EventLoop::run(size_t max_turns) {
+    size_t resumed = 0;
+    for (size_t turn = 0; turn < max_turns && waiting_ > 0; ++turn) {
+        resumed += run_once();
+    }
+    return resumed;
+}
+
+// Clears waiter before resuming, so the coroutine can wait again at once.
+// waiters_ may grow while it runs; nothing here is used after.
+bool EventLoop::resume(SocketWaiter*& waiter) {
+    SocketWaiter* ready = waiter;
+    if (ready == nullptr || !ready->attempt()) {
+        return false;
+    }
+    waiter = nullptr;
+    waiting_--;
+    stats_.resumed++;
+    ready->handle.resume();
+    return true;
+}
+
+void EventLoop::wait(SocketId socket, uint32_t events, SocketWaiter& waiter) {
+    uint32_t index = SocketTable::index_of(socket);
+    if (index >= waiters_.size()) {
+        waiters_.resize(index + 1);
+    }
+    Waiters& entry = waiters_[index];
+    entry.socket = socket;
+    ((events & SocketEvent::WRITABLE) ? entry.writer : entry.reader) = &waiter;
+    waiting_++;
+    stats_.suspended++;
+    rewatch(index);
+}
+
+void EventLoop::forget(SocketId socket) {
+    uint32_t index = SocketTable::index_of(socket);
+    if (index >= waiters_.size() || waiters_[index].socket != socket) {
+        return;
+    }
+    Waiters& entry = waiters_[index];
+    for (SocketWaiter* waiter : {entry.reader, entry.writer}) {
+        if (waiter != nullptr) {
+            orphans_.push_back(waiter);
+        }
+    }
+    entry = Waiters();
+}
+
+// Watches only what someone waits for, so a ready socket nobody is
+// reading is not reported turn after turn. A coroutine usually waits again
+// for the same thing, which needs no call at all.
+void EventLoop::rewatch(uint32_t index) {
+    Waiters& entry = waiters_[index];
+    if (entry.socket == 0) {
+        return;
+    }
+    uint32_t interest = (entry.reader != nullptr ? READ_EVENTS : 0) | (entry.writer != nullptr ? WRITE_EVENTS : 0);
+    if (interest != entry.interest) {
+        stack_.watch(entry.socket, interest, index);
+        entry.interest = interest;
+    }
+    if (interest == 0) {
+        entry.socket = 0;
+    }
+}
@@ -0,0 +1,59 @@
+#include "coro/task.h"
+#include <array>
+#include <new>
+
+struct FreeFrame {
+    FreeFrame* next;
+};
+
+struct ThreadFrames {
+    std::array<FreeFrame*, FramePool::MAX_POOLED / FramePool::CLASS_SIZE> free{};
+    FramePoolStats stats;
+
+    ~ThreadFrames() {
+        for (FreeFrame* frame : free) {
+            while (frame != nullptr) {
+                FreeFrame* next = frame->next;
+                ::operator delete(frame);
+                frame = next;
+            }
+        }
+    }
+};
+
+static thread_local ThreadFrames frames;
+
+static size_t size_class(size_t size) {
+    return (size + FramePool::CLASS_SIZE - 1) / FramePool::CLASS_SIZE - 1;
+}
+
+void* FramePool::allocate(size_t size) {
+    frames.stats.allocations++;
+    if (size > MAX_POOLED) {
+        frames.stats.oversize++;
+        return ::operator new(size);
+    }
+    size_t index = size_class(size);
+    FreeFrame* frame = frames.free[index];
+    if (frame == nullptr) {
+        return ::operator new((index + 1) * CLASS_SIZE);
+    }
+    frames.free[index] = frame->next;
+    frames.stats.reused++;
+    return frame;
+}
+
+void FramePool::release(void* frame, size_t size) {
+    if (size > MAX_POOLED) {
+        ::operator delete(frame);
+        return;
+    }
+    size_t index = size_class(size);
+    FreeFrame* free = static_cast<FreeFrame*>(frame);
+    free->next = frames.free[index];
+    frames.free[index] = free;
+}
+
+FramePoolStats FramePool::get_stats() {
+    return frames.stats;
+}
@@ -1,6 +1,10 @@
 #include "ethernet/ethernet_frame.h"
+#include "buffer/packet_pool.h"
+#include "util/byte_order.h"
+#include "core/metrics.h"
+#include "core/trace.h"
+#include <algorithm>
 #include <cstring>
-#include <iostream>
 #include <cstddef>
 
 
@@ -25,32 +29,31 @@ void EthernetFrame::set_payload(const std::vector<uint8_t>& payload) {
 }
 
 std::vector<uint8_t> EthernetFrame::serialize() const {
-    std::vector<uint8_t> frame;
-    frame.reserve(14 + payload_.size()); // 14 bytes header + payload
-    
-    // Destination MAC
-    for (auto byte : header_.dest_mac) {
-        frame.push_back(byte);
-    }
-    
-    // Source MAC
-    for (auto byte : header_.src_mac) {
-        frame.push_back(byte);
-    }
-    
-    // Ethertype (big-endian)
-    frame.push_back(static_cast<uint8_t>((header_.ethertype >> 8) & 0xFF));
-    frame.push_back(static_cast<uint8_t>(header_.ethertype & 0xFF));
-    
-    // Payload
-    frame.insert(frame.end(), payload_.begin(), payload_.end());
-    
+    std::vector<uint8_t> frame(HEADER_SIZE + payload_.size());
+    write_header_to(frame);
+    std::copy(payload_.begin(), payload_.end(), frame.begin() + HEADER_SIZE);
     return frame;
 }
 
+bool EthernetFrame::write_header_to(std::span<uint8_t> out) const {
+    if (out.size() < HEADER_SIZE) {
+        return false;
+    }
+    std::memcpy(out.data(), header_.dest_mac.data(), 6);
+    std::memcpy(out.data() + 6, header_.src_mac.data(), 6);
+    write_be16(out.data() + 12, header_.ethertype);
+    return true;
+}
+
+bool EthernetFrame::prepend_to(PacketHandle& packet) const {
+    uint8_t* header = packet.prepend(HEADER_SIZE);
+    return header != nullptr && write_header_to({header, HEADER_SIZE});
+}
+
 bool EthernetFrame::deserialize(const std::vector<uint8_t>& data) {
     if (data.size() < 14) {
-        std::cerr << "Ethernet frame too small: " << data.size() << " bytes" << std::endl;
+        count_metric(Metric::ETH_TOO_SHORT);
+        TRACE(TraceEvent::DESERIALIZE_TOO_SHORT, 0, 2, data.size());
         return false;
     }
     
@@ -1,25 +1,291 @@
 #include "ip/checksum.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <cstdint>
+#include <cstring>
 #include <vector>
 
-uint16_t calculate_checksum(const std::vector<uint8_t>& data) {
-    uint32_t sum = 0;
-    auto length = data.size();  // Use auto to avoid type issues
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define CHECKSUM_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+// All kernels sum native-endian 32-bit words into a 64-bit accumulator. The
+// ones' complement sum is byte-order independent (RFC 1071 section 2), so the
+// folded result only needs one byte swap at the end on little-endian hosts.
+using SumKernel = uint64_t (*)(const uint8_t* data, size_t length);
+
+static uint64_t sum_tail(const uint8_t* data, size_t length, uint64_t acc) {
+    while (length >= 4) {
+        uint32_t word;
+        std::memcpy(&word, data, 4);
+        acc += word;
+        data += 4;
+        length -= 4;
+    }
+    if (length >= 2) {
+        uint16_t word;
+        std::memcpy(&word, data, 2);
+        acc += word;
+        data += 2;
+        length -= 2;
+    }
+    if (length == 1) {
+        // Odd trailing byte is padded with a zero byte
+        uint16_t word = 0;
+        std::memcpy(&word, data, 1);
+        acc += word;
+    }
+    return acc;
+}
+
+static uint64_t sum_portable(const uint8_t* data, size_t length) {
+    uint64_t acc0 = 0;
+    uint64_t acc1 = 0;
+    
+    while (length >= 16) {
+        uint64_t a;
+        uint64_t b;
+        std::memcpy(&a, data, 8);
+        std::memcpy(&b, data + 8, 8);
+        acc0 += (a & 0xFFFFFFFF) + (a >> 32);
+        acc1 += (b & 0xFFFFFFFF) + (b >> 32);
+        data += 16;
+        length -= 16;
+    }
     
-    // Sum up 16-bit words
-    for (decltype(length) i = 0; i + 1 < length; i += 2) {
-        sum += (static_cast<uint16_t>(data[i]) << 8) | data[i + 1];
+    if (length >= 8) {
+        uint64_t a;
+        std::memcpy(&a, data, 8);
+        acc0 += (a & 0xFFFFFFFF) + (a >> 32);
+        data += 8;
+        length -= 8;
     }
     
-    // Handle odd length
-    if (length % 2 != 0) {
-        sum += static_cast<uint16_t>(data[length - 1]) << 8;
+    return sum_tail(data, length, acc0 + acc1);
+}
+
+#ifdef CHECKSUM_HAVE_X86
+__attribute__((target("sse2")))
+static uint64_t sum_sse2(const uint8_t* data, size_t length) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc0 = zero;
+    __m128i acc1 = zero;
+    
+    // Widen each 32-bit word into a 64-bit lane so lanes never overflow
+    while (length >= 64) {
+        __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16));
+        __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 32));
+        __m128i v3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 48));
+        acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(v0, zero));
+        acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(v0, zero));
+        acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(v1, zero));
+        acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(v1, zero));
+        acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(v2, zero));
+        acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(v2, zero));
+        acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(v3, zero));
+        acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(v3, zero));
+        data += 64;
+        length -= 64;
+    }
+    
+    while (length >= 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(v, zero));
+        acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(v, zero));
+        data += 16;
+        length -= 16;
+    }
+    
+    alignas(16) uint64_t lanes[2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), _mm_add_epi64(acc0, acc1));
+    return sum_tail(data, length, lanes[0] + lanes[1]);
+}
+
+__attribute__((target("avx2")))
+static uint64_t sum_avx2(const uint8_t* data, size_t length) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc0 = zero;
+    __m256i acc1 = zero;
+    
+    while (length >= 128) {
+        __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+        __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + 32));
+        __m256i v2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + 64));
+        __m256i v3 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + 96));
+        acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(v0, zero));
+        acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(v0, zero));
+        acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(v1, zero));
+        acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(v1, zero));
+        acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(v2, zero));
+        acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(v2, zero));
+        acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(v3, zero));
+        acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(v3, zero));
+        data += 128;
+        length -= 128;
+    }
+    
+    while (length >= 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+        acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(v, zero));
+        acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(v, zero));
+        data += 32;
+        length -= 32;
+    }
+    
+    alignas(32) uint64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), _mm256_add_epi64(acc0, acc1));
+    return sum_tail(data, length, lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+}
+#endif
+
+static SumKernel kernel_function(ChecksumKernel kernel) {
+    switch (kernel) {
+#ifdef CHECKSUM_HAVE_X86
+        case ChecksumKernel::SSE2:
+            return sum_sse2;
+        case ChecksumKernel::AVX2:
+            return sum_avx2;
+#endif
+        default:
+            return sum_portable;
+    }
+}
+
+static ChecksumKernel best_kernel() {
+    if (checksum_kernel_supported(ChecksumKernel::AVX2)) {
+        return ChecksumKernel::AVX2;
+    }
+    if (checksum_kernel_supported(ChecksumKernel::SSE2)) {
+        return ChecksumKernel::SSE2;
+    }
+    return ChecksumKernel::PORTABLE;
+}
+
+static std::atomic<ChecksumKernel>& active_kernel() {
+    static std::atomic<ChecksumKernel> kernel{best_kernel()};
+    return kernel;
+}
+
+static std::atomic<SumKernel>& active_function() {
+    static std::atomic<SumKernel> function{kernel_function(active_kernel().load())};
+    return function;
+}
+
+bool checksum_kernel_supported(ChecksumKernel kernel) {
+    switch (kernel) {
+        case ChecksumKernel::PORTABLE:
+            return true;
+#ifdef CHECKSUM_HAVE_X86
+        case ChecksumKernel::SSE2:
+            return __builtin_cpu_supports("sse2");
+        case ChecksumKernel::AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+ChecksumKernel get_checksum_kernel() {
+    return active_kernel().load(std::memory_order_relaxed);
+}
+
+bool set_checksum_kernel(ChecksumKernel kernel) {
+    if (!checksum_kernel_supported(kernel)) {
+        return false;
+    }
+    active_kernel().store(kernel, std::memory_order_relaxed);
+    active_function().store(kernel_function(kernel), std::memory_order_relaxed);
+    return true;
+}
+
+const char* checksum_kernel_name(ChecksumKernel kernel) {
+    switch (kernel) {
+        case ChecksumKernel::SSE2:
+            return "sse2";
+        case ChecksumKernel::AVX2:
+            return "avx2";
+        default:
+            return "portable";
     }
+}
+
+// Folds a native-order 64-bit accumulator to a numeric (network-order) 16-bit sum
+static uint32_t fold_native(uint64_t acc) {
+    acc = (acc & 0xFFFFFFFF) + (acc >> 32);
+    acc = (acc & 0xFFFFFFFF) + (acc >> 32);
+    uint32_t sum = static_cast<uint32_t>((acc & 0xFFFF) + (acc >> 16));
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
     
-    // Fold 32-bit sum to 16 bits
-    while (sum >> 16) {
-        sum = (sum & 0xFFFF) + (sum >> 16);
+    if constexpr (std::endian::native == std::endian::little) {
+        sum = ((sum & 0xFF) << 8) | (sum >> 8);
     }
+    return sum;
+}
+
+static uint32_t fold32(uint32_t sum) {
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    return sum;
+}
+
+uint32_t checksum_partial(std::span<const uint8_t> data, uint32_t sum) {
+    SumKernel kernel = active_function().load(std::memory_order_relaxed);
+    return fold32(fold32(sum) + fold_native(kernel(data.data(), data.size())));
+}
+
+uint16_t checksum_finish(uint32_t sum) {
+    return static_cast<uint16_t>(~fold32(sum));
+}
+
+uint32_t checksum_partial_copy(uint8_t* dst, std::span<const uint8_t> src, uint32_t sum) {
+    // Even block size keeps every block at an even stream offset
+    constexpr size_t BLOCK_SIZE = 2048;
     
-    return static_cast<uint16_t>(~sum);
+    for (size_t offset = 0; offset < src.size(); offset += BLOCK_SIZE) {
+        size_t length = std::min(BLOCK_SIZE, src.size() - offset);
+        std::memcpy(dst + offset, src.data() + offset, length);
+        sum = checksum_partial(std::span<const uint8_t>(dst + offset, length), sum);
+    }
+    return sum;
+}
+
+uint16_t calculate_checksum(std::span<const uint8_t> data) {
+    return checksum_finish(checksum_partial(data));
+}
+
+uint16_t calculate_checksum(const std::vector<uint8_t>& data) {
+    return calculate_checksum(std::span<const uint8_t>(data));
+}
+
+uint16_t calculate_checksum(std::span<const std::span<const uint8_t>> parts) {
+    ChecksumAccumulator accumulator;
+    for (const auto& part : parts) {
+        accumulator.add(part);
+    }
+    return accumulator.finish();
+}
+
+uint16_t calculate_checksum(std::initializer_list<std::span<const uint8_t>> parts) {
+    return calculate_checksum(std::span<const std::span<const uint8_t>>(parts.begin(), parts.size()));
+}
+
+uint16_t checksum_update16(uint16_t checksum, uint16_t old_value, uint16_t new_value) {
+    uint32_t sum = static_cast<uint16_t>(~checksum);
+    sum += static_cast<uint16_t>(~old_value);
+    sum += new_value;
+    return checksum_finish(sum);
+}
+
+uint16_t checksum_update32(uint16_t checksum, uint32_t old_value, uint32_t new_value) {
+    uint32_t sum = static_cast<uint16_t>(~checksum);
+    sum += static_cast<uint16_t>(~(old_value >> 16));
+    sum += static_cast<uint16_t>(~(old_value & 0xFFFF));
+    sum += new_value >> 16;
+    sum += new_value & 0xFFFF;
+    return checksum_finish(sum);
 }
@@ -1,7 +1,11 @@
 #include "ip/ipv4_packet.h"
 #include "ip/checksum.h"
+#include "buffer/packet_pool.h"
+#include "util/byte_order.h"
+#include "core/metrics.h"
+#include "core/trace.h"
+#include <algorithm>
 #include <cstring>
-#include <iostream>
 #include <cstddef>
 
 void IPv4Packet::set_version_ihl(uint8_t version, uint8_t ihl) {
@@ -29,93 +33,98 @@ void IPv4Packet::set_ttl(uint8_t ttl) {
     header_.ttl = ttl;
 }
 
-uint16_t IPv4Packet::calculate_checksum() const {
-    // Make a copy of the header for checksum calculation
-    IPv4Header temp_header = header_;
-    temp_header.header_checksum = 0; // Must be zero for calculation
-    
-    std::vector<uint8_t> header_bytes;
-    header_bytes.reserve(20); // IPv4 header is 20 bytes without options
-    
-    // Serialize header for checksum calculation
-    header_bytes.push_back(temp_header.version_ihl);
-    header_bytes.push_back(temp_header.dscp_ecn);
-    header_bytes.push_back(static_cast<uint8_t>((temp_header.total_length >> 8) & 0xFF));
-    header_bytes.push_back(static_cast<uint8_t>(temp_header.total_length & 0xFF));
-    header_bytes.push_back(static_cast<uint8_t>((temp_header.identification >> 8) & 0xFF));
-    header_bytes.push_back(static_cast<uint8_t>(temp_header.identification & 0xFF));
-    header_bytes.push_back(static_cast<uint8_t>((temp_header.flags_fragment_offset >> 8) & 0xFF));
-    header_bytes.push_back(static_cast<uint8_t>(temp_header.flags_fragment_offset & 0xFF));
-    header_bytes.push_back(temp_header.ttl);
-    header_bytes.push_back(temp_header.protocol);
-    header_bytes.push_back(0); // checksum high byte (zero for calculation)
-    header_bytes.push_back(0); // checksum low byte (zero for calculation)
-    
-    for (auto byte : temp_header.source_ip) {
-        header_bytes.push_back(byte);
-    }
-    
-    for (auto byte : temp_header.dest_ip) {
-        header_bytes.push_back(byte);
+void IPv4Packet::set_identification(uint16_t identification) {
+    header_.identification = identification;
+}
+
+bool IPv4Packet::decrement_ttl() {
+    if (header_.ttl <= 1) {
+        return false;
     }
     
-    return calculate_checksum(header_bytes);
+    // TTL shares a 16-bit header word with the protocol field
+    uint16_t old_word = (static_cast<uint16_t>(header_.ttl) << 8) | header_.protocol;
+    header_.ttl--;
+    uint16_t new_word = (static_cast<uint16_t>(header_.ttl) << 8) | header_.protocol;
+    header_.header_checksum = checksum_update16(header_.header_checksum, old_word, new_word);
+    return true;
+}
+
+void IPv4Packet::rewrite_source_ip(const std::array<uint8_t, 4>& ip) {
+    header_.header_checksum = checksum_update32(header_.header_checksum,
+                                                read_be32(header_.source_ip.data()),
+                                                read_be32(ip.data()));
+    header_.source_ip = ip;
+}
+
+void IPv4Packet::rewrite_destination_ip(const std::array<uint8_t, 4>& ip) {
+    header_.header_checksum = checksum_update32(header_.header_checksum,
+                                                read_be32(header_.dest_ip.data()),
+                                                read_be32(ip.data()));
+    header_.dest_ip = ip;
+}
+
+uint16_t IPv4Packet::calculate_checksum() const {
+    return header_checksum(header_.total_length);
+}
+
+uint16_t IPv4Packet::header_checksum(uint16_t total_length) const {
+    // Sum the header words exactly as write_header() writes them (IHL=5),
+    // with the checksum field taken as zero
+    uint32_t sum = 0x4500 | header_.dscp_ecn;
+    sum += total_length;
+    sum += header_.identification;
+    sum += header_.flags_fragment_offset;
+    sum += (static_cast<uint16_t>(header_.ttl) << 8) | header_.protocol;
+    sum += read_be16(header_.source_ip.data());
+    sum += read_be16(header_.source_ip.data() + 2);
+    sum += read_be16(header_.dest_ip.data());
+    sum += read_be16(header_.dest_ip.data() + 2);
+    
+    return checksum_finish(sum);
+}
+
+void IPv4Packet::write_header(uint8_t* out, uint16_t total_length) const {
+    out[0] = 0x45; // Version=4, IHL=5
+    out[1] = header_.dscp_ecn;
+    write_be16(out + 2, total_length);
+    write_be16(out + 4, header_.identification);
+    write_be16(out + 6, header_.flags_fragment_offset);
+    out[8] = header_.ttl;
+    out[9] = header_.protocol;
+    write_be16(out + 10, header_checksum(total_length));
+    std::memcpy(out + 12, header_.source_ip.data(), 4);
+    std::memcpy(out + 16, header_.dest_ip.data(), 4);
 }
 
 std::vector<uint8_t> IPv4Packet::serialize() const {
-    std::vector<uint8_t> packet;
-    packet.reserve(20 + payload_.size());
-    
-    // Calculate checksum
-    uint16_t checksum = calculate_checksum();
-    
-    // Version and IHL (assuming 20 byte header, so IHL=5)
-    packet.push_back(0x45); // Version=4, IHL=5
-    
-    // DSCP and ECN
-    packet.push_back(header_.dscp_ecn);
-    
-    // Total Length
-    packet.push_back(static_cast<uint8_t>((header_.total_length >> 8) & 0xFF));
-    packet.push_back(static_cast<uint8_t>(header_.total_length & 0xFF));
-    
-    // Identification
-    packet.push_back(static_cast<uint8_t>((header_.identification >> 8) & 0xFF));
-    packet.push_back(static_cast<uint8_t>(header_.identification & 0xFF));
-    
-    // Flags and Fragment Offset
-    packet.push_back(static_cast<uint8_t>((header_.flags_fragment_offset >> 8) & 0xFF));
-    packet.push_back(static_cast<uint8_t>(header_.flags_fragment_offset & 0xFF));
-    
-    // TTL
-    packet.push_back(header_.ttl);
-    
-    // Protocol
-    packet.push_back(header_.protocol);
-    
-    // Header Checksum
-    packet.push_back(static_cast<uint8_t>((checksum >> 8) & 0xFF));
-    packet.push_back(static_cast<uint8_t>(checksum & 0xFF));
-    
-    // Source IP
-    for (auto byte : header_.source_ip) {
-        packet.push_back(byte);
+    std::vector<uint8_t> packet(HEADER_SIZE + payload_.size());
+    write_header(packet.data(), header_.total_length);
+    std::copy(payload_.begin(), payload_.end(), packet.begin() + HEADER_SIZE);
+    return packet;
+}
+
+bool IPv4Packet::write_header_to(std::span<uint8_t> out, size_t payload_length) const {
+    if (out.size() < HEADER_SIZE || payload_length > MAX_PAYLOAD) {
+        return false;
     }
-    
-    // Destination IP
-    for (auto byte : header_.dest_ip) {
-        packet.push_back(byte);
+    write_header(out.data(), static_cast<uint16_t>(HEADER_SIZE + payload_length));
+    return true;
+}
+
+bool IPv4Packet::prepend_to(PacketHandle& packet) const {
+    size_t payload_length = packet.size();
+    if (payload_length > MAX_PAYLOAD) {
+        return false;
     }
-    
-    // Payload
-    packet.insert(packet.end(), payload_.begin(), payload_.end());
-    
-    return packet;
+    uint8_t* header = packet.prepend(HEADER_SIZE);
+    return header != nullptr && write_header_to({header, HEADER_SIZE}, payload_length);
 }
 
 bool IPv4Packet::deserialize(const std::vector<uint8_t>& data) {
     if (data.size() < 20) {
-        std::cerr << "IP packet too small: " << data.size() << " bytes" << std::endl;
+        count_metric(Metric::IP_MALFORMED);
+        TRACE(TraceEvent::DESERIALIZE_TOO_SHORT, 0, 3, data.size());
         return false;
     }
     
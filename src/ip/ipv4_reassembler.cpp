@@ -0,0 +1,324 @@
+#include "ip/ipv4_reassembler.h"
+#include "ip/ipv4_view.h"
+#include "ip/checksum.h"
+#include "util/byte_order.h"
+#include <algorithm>
+#include <cstring>
+
+// Single-writer counter update: a plain load/store, no atomic read-modify-write
+static void bump(std::atomic<uint64_t>& counter, uint64_t amount = 1) {
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+IPv4Reassembler::IPv4Reassembler(PacketPool& pool, const ReassemblyConfig& config)
+    : pool_(pool), config_(config) {
+    config_.max_datagrams = std::max<size_t>(1, config_.max_datagrams);
+    config_.max_fragments = std::max<size_t>(1, config_.max_fragments);
+    config_.max_datagram_size = std::min<size_t>(config_.max_datagram_size, 65535);
+
+    datagrams_.resize(config_.max_datagrams);
+    free_datagrams_.reserve(config_.max_datagrams);
+    for (size_t i = config_.max_datagrams; i-- > 0;) {
+        free_datagrams_.push_back(static_cast<uint32_t>(i));
+    }
+
+    size_t slots = 16;
+    while (slots < config_.max_datagrams * 2) {
+        slots <<= 1;
+    }
+    index_.assign(slots, NONE);
+    index_mask_ = slots - 1;
+
+    fragments_.resize(config_.max_fragments);
+    for (size_t i = config_.max_fragments; i-- > 0;) {
+        fragments_[i].next = free_fragment_;
+        free_fragment_ = static_cast<uint32_t>(i);
+    }
+
+    output_.reserve(config_.max_datagram_size);
+}
+
+uint64_t IPv4Reassembler::hash_key(const Key& key) {
+    uint64_t hash = (static_cast<uint64_t>(key.source) << 32) | key.destination;
+    hash ^= ((static_cast<uint64_t>(key.identification) << 8) | key.protocol) * 0x9E3779B97F4A7C15ULL;
+    // MurmurHash3 finalizer
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+uint32_t IPv4Reassembler::find(const Key& key) const {
+    for (size_t position = hash_key(key) & index_mask_;; position = (position + 1) & index_mask_) {
+        uint32_t index = index_[position];
+        if (index == NONE || datagrams_[index].key == key) {
+            return index;
+        }
+    }
+}
+
+uint32_t IPv4Reassembler::create(const Key& key, uint64_t now_ns) {
+    if (free_datagrams_.empty()) {
+        release(oldest_);
+        bump(evicted_);
+    }
+    uint32_t index = free_datagrams_.back();
+    free_datagrams_.pop_back();
+
+    Datagram& datagram = datagrams_[index];
+    datagram.key = key;
+    datagram.deadline_ns = now_ns + config_.timeout_ns;
+    datagram.first = NONE;
+    datagram.fragment_count = 0;
+    datagram.received = 0;
+    datagram.total = 0;
+    datagram.have_last = false;
+    datagram.header_length = 0;
+    datagram.in_use = true;
+
+    size_t position = hash_key(key) & index_mask_;
+    while (index_[position] != NONE) {
+        position = (position + 1) & index_mask_;
+    }
+    index_[position] = index;
+
+    // Deadlines follow creation order, so the age list is also the expiry order
+    datagram.older = newest_;
+    datagram.newer = NONE;
+    if (newest_ != NONE) {
+        datagrams_[newest_].newer = index;
+    } else {
+        oldest_ = index;
+    }
+    newest_ = index;
+    return index;
+}
+
+void IPv4Reassembler::release(uint32_t index) {
+    Datagram& datagram = datagrams_[index];
+    for (uint32_t node = datagram.first; node != NONE;) {
+        Fragment& fragment = fragments_[node];
+        uint32_t next = fragment.next;
+        fragment.data.release();
+        fragment.next = free_fragment_;
+        free_fragment_ = node;
+        node = next;
+    }
+    buffered_bytes_ -= datagram.received;
+
+    // Backward-shift deletion keeps probe runs unbroken without tombstones
+    size_t hole = hash_key(datagram.key) & index_mask_;
+    while (index_[hole] != index) {
+        hole = (hole + 1) & index_mask_;
+    }
+    size_t next = (hole + 1) & index_mask_;
+    while (index_[next] != NONE) {
+        size_t home = hash_key(datagrams_[index_[next]].key) & index_mask_;
+        if (((next - home) & index_mask_) >= ((next - hole) & index_mask_)) {
+            index_[hole] = index_[next];
+            hole = next;
+        }
+        next = (next + 1) & index_mask_;
+    }
+    index_[hole] = NONE;
+
+    if (datagram.older != NONE) {
+        datagrams_[datagram.older].newer = datagram.newer;
+    } else {
+        oldest_ = datagram.newer;
+    }
+    if (datagram.newer != NONE) {
+        datagrams_[datagram.newer].older = datagram.older;
+    } else {
+        newest_ = datagram.older;
+    }
+
+    datagram.in_use = false;
+    free_datagrams_.push_back(index);
+}
+
+ReassemblyResult IPv4Reassembler::add(const IPv4View& fragment, uint64_t now_ns,
+                                      std::span<const uint8_t>& datagram) {
+    if (!fragment.is_fragment()) {
+        datagram = fragment.get_bytes();
+        return ReassemblyResult::COMPLETE;
+    }
+    bump(fragments_seen_);
+
+    auto payload = fragment.get_payload();
+    size_t offset = fragment.get_fragment_offset();
+    bool last = !fragment.has_more_fragments();
+    // Every fragment but the last carries a multiple of 8 bytes
+    if (payload.empty() || (!last && payload.size() % 8 != 0) ||
+        fragment.get_header_length() + offset + payload.size() > config_.max_datagram_size) {
+        bump(invalid_);
+        return ReassemblyResult::DROPPED;
+    }
+
+    Key key{fragment.get_source_address(), fragment.get_destination_address(),
+            fragment.get_identification(), fragment.get_protocol()};
+    uint32_t index = find(key);
+    if (index == NONE) {
+        index = create(key, now_ns);
+    }
+
+    Datagram& entry = datagrams_[index];
+    ReassemblyResult result = insert(entry, fragment, static_cast<uint32_t>(offset), payload, last);
+    if (result == ReassemblyResult::COMPLETE) {
+        datagram = assemble(entry);
+        bump(completed_);
+        release(index);
+    } else if (entry.in_use && entry.fragment_count == 0) {
+        release(index);
+    }
+
+    pending_.store(config_.max_datagrams - free_datagrams_.size(), std::memory_order_relaxed);
+    buffered_.store(buffered_bytes_, std::memory_order_relaxed);
+    return result;
+}
+
+ReassemblyResult IPv4Reassembler::insert(Datagram& datagram, const IPv4View& fragment, uint32_t offset,
+                                         std::span<const uint8_t> payload, bool last) {
+    uint32_t index = static_cast<uint32_t>(&datagram - datagrams_.data());
+    uint32_t length = static_cast<uint32_t>(payload.size());
+    uint32_t end = offset + length;
+
+    if ((datagram.have_last && (end > datagram.total || (last && end != datagram.total))) ||
+        datagram.fragment_count >= config_.max_fragments_per_datagram) {
+        bump(invalid_);
+        release(index);
+        return ReassemblyResult::DROPPED;
+    }
+
+    // Bounded walk: at most max_fragments_per_datagram nodes
+    uint32_t previous = NONE;
+    uint32_t next = datagram.first;
+    while (next != NONE && fragments_[next].offset < offset) {
+        previous = next;
+        next = fragments_[next].next;
+    }
+    if (next != NONE && fragments_[next].offset == offset && fragments_[next].length == length) {
+        bump(duplicates_);
+        return ReassemblyResult::PENDING;
+    }
+    bool overlaps = (previous != NONE && fragments_[previous].offset + fragments_[previous].length > offset) ||
+                    (next != NONE && fragments_[next].offset < end);
+    if (overlaps) {
+        bump(overlaps_);
+        release(index);
+        return ReassemblyResult::DROPPED;
+    }
+    if (last && next != NONE) {
+        // Data beyond the end of the datagram
+        bump(invalid_);
+        release(index);
+        return ReassemblyResult::DROPPED;
+    }
+
+    make_room(length, index);
+    if (free_fragment_ == NONE || buffered_bytes_ + length > config_.max_buffered_bytes) {
+        bump(evicted_);
+        release(index);
+        return ReassemblyResult::DROPPED;
+    }
+
+    PacketHandle buffer = pool_.alloc();
+    uint8_t* data = buffer ? buffer.append(length) : nullptr;
+    if (data == nullptr) {
+        bump(no_buffer_);
+        return ReassemblyResult::DROPPED;
+    }
+    std::memcpy(data, payload.data(), length);
+
+    uint32_t node = free_fragment_;
+    Fragment& held = fragments_[node];
+    free_fragment_ = held.next;
+    held.data = std::move(buffer);
+    held.offset = offset;
+    held.length = length;
+    held.next = next;
+    if (previous == NONE) {
+        datagram.first = node;
+    } else {
+        fragments_[previous].next = node;
+    }
+
+    datagram.fragment_count++;
+    datagram.received += length;
+    buffered_bytes_ += length;
+    if (offset == 0) {
+        auto header = fragment.get_header_bytes();
+        std::memcpy(datagram.header, header.data(), header.size());
+        datagram.header_length = static_cast<uint8_t>(header.size());
+    }
+    if (last) {
+        datagram.have_last = true;
+        datagram.total = end;
+    }
+
+    // Fragments are disjoint and inside [0, total), so a full count means full coverage
+    bool complete = datagram.have_last && datagram.header_length != 0 && datagram.received == datagram.total;
+    return complete ? ReassemblyResult::COMPLETE : ReassemblyResult::PENDING;
+}
+
+// Evicts the oldest other datagrams until a fragment of length bytes fits
+void IPv4Reassembler::make_room(size_t length, uint32_t keep) {
+    while (free_fragment_ == NONE || buffered_bytes_ + length > config_.max_buffered_bytes) {
+        uint32_t victim = oldest_ != keep ? oldest_ : datagrams_[keep].newer;
+        if (victim == NONE) {
+            return;
+        }
+        release(victim);
+        bump(evicted_);
+    }
+}
+
+std::span<const uint8_t> IPv4Reassembler::assemble(Datagram& datagram) {
+    size_t header_length = datagram.header_length;
+    output_.resize(header_length + datagram.total);
+    uint8_t* out = output_.data();
+
+    for (uint32_t node = datagram.first; node != NONE; node = fragments_[node].next) {
+        const Fragment& fragment = fragments_[node];
+        std::memcpy(out + header_length + fragment.offset, fragment.data.data(), fragment.length);
+    }
+
+    // The first fragment's header, now describing the whole datagram
+    std::memcpy(out, datagram.header, header_length);
+    write_be16(out + 2, static_cast<uint16_t>(output_.size()));
+    write_be16(out + 6, static_cast<uint16_t>(read_be16(out + 6) & ~(IPv4View::FLAG_MF | IPv4View::FRAGMENT_OFFSET_MASK)));
+    write_be16(out + 10, 0);
+    write_be16(out + 10, calculate_checksum(std::span<const uint8_t>(out, header_length)));
+    return output_;
+}
+
+size_t IPv4Reassembler::expire(uint64_t now_ns) {
+    size_t expired = 0;
+    while (oldest_ != NONE && datagrams_[oldest_].deadline_ns <= now_ns) {
+        release(oldest_);
+        expired++;
+    }
+    if (expired > 0) {
+        bump(timeouts_, expired);
+        pending_.store(config_.max_datagrams - free_datagrams_.size(), std::memory_order_relaxed);
+        buffered_.store(buffered_bytes_, std::memory_order_relaxed);
+    }
+    return expired;
+}
+
+ReassemblyStats IPv4Reassembler::get_stats() const {
+    ReassemblyStats stats;
+    stats.fragments = fragments_seen_.load(std::memory_order_relaxed);
+    stats.completed = completed_.load(std::memory_order_relaxed);
+    stats.timeouts = timeouts_.load(std::memory_order_relaxed);
+    stats.evicted = evicted_.load(std::memory_order_relaxed);
+    stats.overlaps = overlaps_.load(std::memory_order_relaxed);
+    stats.duplicates = duplicates_.load(std::memory_order_relaxed);
+    stats.invalid = invalid_.load(std::memory_order_relaxed);
+    stats.no_buffer = no_buffer_.load(std::memory_order_relaxed);
+    stats.pending_datagrams = pending_.load(std::memory_order_relaxed);
+    stats.buffered_bytes = buffered_.load(std::memory_order_relaxed);
+    return stats;
+}
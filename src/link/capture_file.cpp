@@ -0,0 +1,298 @@
+#include "link/capture_file.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static constexpr uint32_t PCAP_MAGIC_USEC = 0xA1B2C3D4;
+static constexpr uint32_t PCAP_MAGIC_NSEC = 0xA1B23C4D;
+static constexpr size_t PCAP_FILE_HEADER_SIZE = 24;
+static constexpr size_t PCAP_RECORD_HEADER_SIZE = 16;
+
+static constexpr uint32_t PCAPNG_SECTION_HEADER = 0x0A0D0D0A;
+static constexpr uint32_t PCAPNG_BYTE_ORDER_MAGIC = 0x1A2B3C4D;
+static constexpr uint32_t PCAPNG_INTERFACE_DESCRIPTION = 0x00000001;
+static constexpr uint32_t PCAPNG_OBSOLETE_PACKET = 0x00000002;
+static constexpr uint32_t PCAPNG_SIMPLE_PACKET = 0x00000003;
+static constexpr uint32_t PCAPNG_ENHANCED_PACKET = 0x00000006;
+static constexpr uint16_t PCAPNG_OPTION_END = 0;
+static constexpr uint16_t PCAPNG_OPTION_TSRESOL = 9;
+
+static uint32_t native32(const uint8_t* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+CaptureFile::~CaptureFile() {
+    close();
+}
+
+bool CaptureFile::open(const std::string& path) {
+    close();
+    
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Couldn't open capture file " << path << std::endl;
+        return false;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        std::cerr << "Capture file is empty: " << path << std::endl;
+        ::close(fd);
+        return false;
+    }
+    
+    void* mapping = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Couldn't map capture file " << path << std::endl;
+        return false;
+    }
+    
+    base_ = static_cast<const uint8_t*>(mapping);
+    size_ = static_cast<size_t>(st.st_size);
+    // One advice per call: the values are not flags
+    madvise(mapping, size_, MADV_SEQUENTIAL);
+    madvise(mapping, size_, MADV_WILLNEED);
+    
+    if (!parse_file_header()) {
+        std::cerr << "Not a pcap or pcapng file: " << path << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+void CaptureFile::close() {
+    if (base_ != nullptr) {
+        munmap(const_cast<uint8_t*>(base_), size_);
+    }
+    base_ = nullptr;
+    size_ = 0;
+    offset_ = 0;
+    truncated_ = false;
+    interfaces_.clear();
+}
+
+void CaptureFile::rewind() {
+    truncated_ = false;
+    interfaces_.clear();
+    parse_file_header();
+}
+
+bool CaptureFile::next(CapturedPacket& packet) {
+    if (base_ == nullptr || truncated_) {
+        return false;
+    }
+    return pcapng_ ? next_pcapng(packet) : next_pcap(packet);
+}
+
+bool CaptureFile::parse_file_header() {
+    if (size_ < PCAP_FILE_HEADER_SIZE) {
+        return false;
+    }
+    
+    uint32_t magic = native32(base_);
+    if (magic == PCAPNG_SECTION_HEADER) {
+        pcapng_ = true;
+        offset_ = 0;
+        return true;
+    }
+    
+    pcapng_ = false;
+    if (magic == PCAP_MAGIC_USEC || magic == PCAP_MAGIC_NSEC) {
+        swapped_ = false;
+    } else if (__builtin_bswap32(magic) == PCAP_MAGIC_USEC || __builtin_bswap32(magic) == PCAP_MAGIC_NSEC) {
+        swapped_ = true;
+    } else {
+        return false;
+    }
+    
+    nanosecond_ = read32(base_) == PCAP_MAGIC_NSEC;
+    // The upper bits of the link type field carry FCS information
+    link_type_ = static_cast<uint16_t>(read32(base_ + 20) & 0xFFFF);
+    offset_ = PCAP_FILE_HEADER_SIZE;
+    return true;
+}
+
+bool CaptureFile::next_pcap(CapturedPacket& packet) {
+    if (offset_ == size_) {
+        return false;
+    }
+    if (size_ - offset_ < PCAP_RECORD_HEADER_SIZE) {
+        truncated_ = true;
+        return false;
+    }
+    
+    const uint8_t* record = base_ + offset_;
+    uint64_t seconds = read32(record);
+    uint64_t fraction = read32(record + 4);
+    uint32_t captured_length = read32(record + 8);
+    
+    if (captured_length > size_ - offset_ - PCAP_RECORD_HEADER_SIZE) {
+        truncated_ = true;
+        return false;
+    }
+    
+    packet.timestamp_ns = seconds * 1000000000ULL + (nanosecond_ ? fraction : fraction * 1000);
+    packet.original_length = read32(record + 12);
+    packet.link_type = link_type_;
+    packet.data = std::span<const uint8_t>(record + PCAP_RECORD_HEADER_SIZE, captured_length);
+    
+    offset_ += PCAP_RECORD_HEADER_SIZE + captured_length;
+    return true;
+}
+
+bool CaptureFile::next_pcapng(CapturedPacket& packet) {
+    while (offset_ < size_) {
+        if (size_ - offset_ < 12) {
+            truncated_ = true;
+            return false;
+        }
+        
+        const uint8_t* block = base_ + offset_;
+        uint32_t block_type = native32(block);
+        
+        // A section header may switch byte order, so it is parsed before
+        // its length is trusted
+        if (block_type == PCAPNG_SECTION_HEADER) {
+            uint32_t byte_order = native32(block + 8);
+            if (byte_order == PCAPNG_BYTE_ORDER_MAGIC) {
+                swapped_ = false;
+            } else if (__builtin_bswap32(byte_order) == PCAPNG_BYTE_ORDER_MAGIC) {
+                swapped_ = true;
+            } else {
+                truncated_ = true;
+                return false;
+            }
+        } else {
+            block_type = read32(block);
+        }
+        
+        uint32_t block_length = read32(block + 4);
+        if (block_length < 12 || block_length % 4 != 0 || block_length > size_ - offset_) {
+            truncated_ = true;
+            return false;
+        }
+        
+        const uint8_t* body = block + 8;
+        size_t body_length = block_length - 12;
+        offset_ += block_length;
+        
+        switch (block_type) {
+            case PCAPNG_SECTION_HEADER:
+                // Interface ids are scoped to their section
+                interfaces_.clear();
+                break;
+                
+            case PCAPNG_INTERFACE_DESCRIPTION:
+                parse_interface(body, body_length);
+                break;
+                
+            case PCAPNG_ENHANCED_PACKET:
+            case PCAPNG_OBSOLETE_PACKET: {
+                if (body_length < 20) {
+                    truncated_ = true;
+                    return false;
+                }
+                
+                bool enhanced = block_type == PCAPNG_ENHANCED_PACKET;
+                uint32_t interface_id = enhanced ? read32(body) : read16(body);
+                uint32_t captured_length = read32(body + 12);
+                if (interface_id >= interfaces_.size() || captured_length > body_length - 20) {
+                    truncated_ = true;
+                    return false;
+                }
+                
+                const Interface& interface = interfaces_[interface_id];
+                uint64_t ticks = (static_cast<uint64_t>(read32(body + 4)) << 32) | read32(body + 8);
+                packet.timestamp_ns = to_nanoseconds(interface, ticks);
+                packet.original_length = read32(body + 16);
+                packet.link_type = interface.link_type;
+                packet.data = std::span<const uint8_t>(body + 20, captured_length);
+                return true;
+            }
+                
+            case PCAPNG_SIMPLE_PACKET: {
+                if (body_length < 4 || interfaces_.empty()) {
+                    truncated_ = true;
+                    return false;
+                }
+                
+                // Simple packets carry no timestamp and belong to interface 0
+                uint32_t original_length = read32(body);
+                size_t captured_length = std::min<size_t>(original_length, body_length - 4);
+                packet.timestamp_ns = 0;
+                packet.original_length = original_length;
+                packet.link_type = interfaces_[0].link_type;
+                packet.data = std::span<const uint8_t>(body + 4, captured_length);
+                return true;
+            }
+                
+            default:
+                // Name resolution, statistics and custom blocks are skipped
+                break;
+        }
+    }
+    
+    return false;
+}
+
+void CaptureFile::parse_interface(const uint8_t* body, size_t body_length) {
+    Interface interface{0, false, 6}; // default resolution is microseconds
+    if (body_length >= 8) {
+        interface.link_type = read16(body);
+        
+        size_t offset = 8;
+        while (offset + 4 <= body_length) {
+            uint16_t code = read16(body + offset);
+            uint16_t length = read16(body + offset + 2);
+            if (code == PCAPNG_OPTION_END || offset + 4 + length > body_length) {
+                break;
+            }
+            if (code == PCAPNG_OPTION_TSRESOL && length >= 1) {
+                uint8_t resolution = body[offset + 4];
+                interface.binary_resolution = (resolution & 0x80) != 0;
+                interface.exponent = resolution & 0x7F;
+            }
+            // Option values are padded to 32 bits
+            offset += 4 + ((length + 3u) & ~3u);
+        }
+    }
+    interfaces_.push_back(interface);
+}
+
+uint64_t CaptureFile::to_nanoseconds(const Interface& interface, uint64_t ticks) const {
+    if (interface.binary_resolution) {
+        unsigned __int128 scaled = static_cast<unsigned __int128>(ticks) * 1000000000ULL;
+        return static_cast<uint64_t>(scaled >> interface.exponent);
+    }
+    
+    uint64_t factor = 1;
+    if (interface.exponent <= 9) {
+        for (int i = interface.exponent; i < 9; ++i) {
+            factor *= 10;
+        }
+        return ticks * factor;
+    }
+    for (int i = 9; i < interface.exponent && i < 28; ++i) {
+        factor *= 10;
+    }
+    return ticks / factor;
+}
+
+uint16_t CaptureFile::read16(const uint8_t* p) const {
+    uint16_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return swapped_ ? __builtin_bswap16(value) : value;
+}
+
+uint32_t CaptureFile::read32(const uint8_t* p) const {
+    uint32_t value = native32(p);
+    return swapped_ ? __builtin_bswap32(value) : value;
+}
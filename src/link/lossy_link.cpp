@@ -0,0 +1,41 @@
+#include "link/lossy_link.h"
+#include <algorithm>
+#include <utility>
+
+LossyLink::LossyLink(const LossyLinkConfig& config)
+    : config_(config), rng_(config.seed), lose_(std::clamp(config.loss, 0.0, 1.0)) {}
+
+bool LossyLink::send(std::vector<uint8_t> packet, uint64_t now_ns) {
+    stats_.sent++;
+    uint64_t start_ns = std::max(wire_free_ns_, now_ns);
+    uint64_t serialize_ns = 0;
+    if (config_.rate_bps != 0) {
+        // Bytes still waiting to go on the wire decide whether this one fits
+        uint64_t backlog = (start_ns - now_ns) * config_.rate_bps / 8'000'000'000ULL;
+        if (backlog + packet.size() > config_.queue_bytes) {
+            stats_.queue_drops++;
+            return false;
+        }
+        serialize_ns = packet.size() * 8'000'000'000ULL / config_.rate_bps;
+    }
+    wire_free_ns_ = start_ns + serialize_ns;
+
+    // A lost packet still took its turn on the wire
+    if (lose_(rng_)) {
+        stats_.lost++;
+        return true;
+    }
+    in_flight_.push_back({wire_free_ns_ + config_.delay_ns, std::move(packet)});
+    return true;
+}
+
+bool LossyLink::receive(uint64_t now_ns, std::vector<uint8_t>& packet) {
+    if (in_flight_.empty() || in_flight_.front().arrival_ns > now_ns) {
+        return false;
+    }
+    packet = std::move(in_flight_.front().packet);
+    in_flight_.pop_front();
+    stats_.delivered++;
+    stats_.bytes_delivered += packet.size();
+    return true;
+}
@@ -0,0 +1,130 @@
+#include "link/pcap_device.h"
+#include "core/trace.h"
+#include <cstring>
+#include <iostream>
+#include <pcap.h>
+
+PcapDevice::~PcapDevice() {
+    close();
+}
+
+bool PcapDevice::open_live(const std::string& interface, const PcapConfig& config) {
+    close();
+    
+    char errbuf[PCAP_ERRBUF_SIZE];
+    pcap_t* handle = pcap_create(interface.c_str(), errbuf);
+    if (handle == nullptr) {
+        std::cerr << "Couldn't open device " << interface << ": " << errbuf << std::endl;
+        return false;
+    }
+    
+    pcap_set_snaplen(handle, config.snaplen);
+    pcap_set_promisc(handle, config.promiscuous ? 1 : 0);
+    pcap_set_timeout(handle, config.timeout_ms);
+    pcap_set_immediate_mode(handle, config.immediate_mode ? 1 : 0);
+    if (config.buffer_size > 0) {
+        pcap_set_buffer_size(handle, config.buffer_size);
+    }
+    
+    int status = pcap_activate(handle);
+    if (status < 0) {
+        std::cerr << "Couldn't activate device " << interface << ": " << pcap_geterr(handle) << std::endl;
+        pcap_close(handle);
+        return false;
+    }
+    
+    handle_ = handle;
+    offline_ = false;
+    at_end_ = false;
+    error_.clear();
+    return true;
+}
+
+bool PcapDevice::open_offline(const std::string& path) {
+    close();
+    
+    char errbuf[PCAP_ERRBUF_SIZE];
+    pcap_t* handle = pcap_open_offline(path.c_str(), errbuf);
+    if (handle == nullptr) {
+        std::cerr << "Couldn't open savefile " << path << ": " << errbuf << std::endl;
+        return false;
+    }
+    
+    handle_ = handle;
+    offline_ = true;
+    at_end_ = false;
+    error_.clear();
+    return true;
+}
+
+void PcapDevice::close() {
+    if (handle_ != nullptr) {
+        pcap_close(handle_);
+        handle_ = nullptr;
+    }
+}
+
+void PcapDevice::break_loop() {
+    if (handle_ != nullptr) {
+        pcap_breakloop(handle_);
+    }
+}
+
+size_t PcapDevice::rx_burst(PacketPool& pool, PacketHandle* out, size_t max_packets) {
+    if (handle_ == nullptr || at_end_ || max_packets == 0) {
+        return 0;
+    }
+    
+    BurstContext context{this, &pool, out, 0};
+    int result = pcap_dispatch(handle_, static_cast<int>(max_packets), &PcapDevice::on_packet,
+                               reinterpret_cast<u_char*>(&context));
+    
+    // For a savefile, a dispatch that yields nothing means end of file.
+    // An error ends either kind of handle: a truncated record leaves nothing
+    // more to read, and a live interface that fails has usually gone away.
+    // Only a break_loop() leaves the rest to read later.
+    if (offline_ && result == 0) {
+        at_end_ = true;
+    } else if (result < 0 && result != PCAP_ERROR_BREAK) {
+        at_end_ = true;
+        error_ = pcap_geterr(handle_);
+        TRACE(TraceEvent::PCAP_DISPATCH_FAILED, 0, static_cast<uint32_t>(result));
+        std::cerr << "Couldn't read packets: " << error_ << std::endl;
+    }
+    return context.count;
+}
+
+size_t PcapDevice::tx_burst(const PacketHandle* packets, size_t count) {
+    if (handle_ == nullptr || offline_) {
+        return 0;
+    }
+    
+    size_t sent = 0;
+    for (; sent < count; ++sent) {
+        if (pcap_inject(handle_, packets[sent].data(), packets[sent].size()) < 0) {
+            break;
+        }
+    }
+    return sent;
+}
+
+void PcapDevice::on_packet(uint8_t* user, const struct pcap_pkthdr* header, const uint8_t* bytes) {
+    auto* context = reinterpret_cast<BurstContext*>(user);
+    
+    // Pool exhaustion is counted by the pool itself
+    PacketHandle buffer = context->pool->alloc();
+    if (!buffer) {
+        return;
+    }
+    
+    // Only caplen bytes were captured
+    uint8_t* dst = buffer.append(header->caplen);
+    if (dst == nullptr) {
+        auto& dropped = context->device->dropped_oversize_;
+        dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+    std::memcpy(dst, bytes, header->caplen);
+    
+    context->out[context->count++] = std::move(buffer);
+}
@@ -0,0 +1,120 @@
+#include "link/virtual_wire.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <utility>
+
+static uint64_t steady_now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Earliest arrival on top of the heap, then sending order
+bool VirtualPort::arrives_later(const InFlight& a, const InFlight& b) {
+    return a.arrival_ns != b.arrival_ns ? a.arrival_ns > b.arrival_ns : a.sequence > b.sequence;
+}
+
+static constexpr size_t DRAIN_BURST = 64;
+
+VirtualPort::Shaper::Shaper(const WireLinkConfig& config)
+    : config(config), rng(config.seed), lose(std::clamp(config.loss, 0.0, 1.0)),
+      hold(std::clamp(config.reorder, 0.0, 1.0)), jitter(0, config.jitter_ns) {}
+
+VirtualPort::VirtualPort(const WireLinkConfig& config, size_t ring_size, const PacketPoolConfig& pool,
+                         uint64_t (*clock)())
+    : clock_(clock), shaper_(config), pool_(pool), incoming_(ring_size), drained_(DRAIN_BURST) {}
+
+size_t VirtualPort::tx_burst(const PacketHandle* packets, size_t count) {
+    if (!is_open() || !peer_->is_open()) {
+        return 0;
+    }
+    uint64_t now_ns = clock_();
+    const WireLinkConfig& config = shaper_.config;
+    // Like a NIC, the port takes every frame; what the link drops is gone
+    // without the sender hearing of it
+    for (size_t i = 0; i < count; ++i) {
+        const PacketHandle& frame = packets[i];
+        sent_stats_.sent++;
+        uint64_t start_ns = std::max(shaper_.wire_free_ns, now_ns);
+        uint64_t serialize_ns = 0;
+        if (config.rate_bps != 0) {
+            // Bytes still waiting to go on the wire decide whether this one fits
+            uint64_t backlog = (start_ns - now_ns) * config.rate_bps / 8'000'000'000ULL;
+            if (backlog + frame.size() > config.queue_bytes) {
+                sent_stats_.queue_drops++;
+                continue;
+            }
+            serialize_ns = frame.size() * 8'000'000'000ULL / config.rate_bps;
+        }
+        shaper_.wire_free_ns = start_ns + serialize_ns;
+
+        // A lost frame still took its turn on the wire
+        if (shaper_.lose(shaper_.rng)) {
+            sent_stats_.lost++;
+            continue;
+        }
+        uint64_t arrival_ns = shaper_.wire_free_ns + config.latency_ns;
+        if (config.jitter_ns != 0) {
+            arrival_ns += shaper_.jitter(shaper_.rng);
+        }
+        if (config.reorder > 0 && shaper_.hold(shaper_.rng)) {
+            sent_stats_.reordered++;
+            arrival_ns += config.reorder_ns;
+        } else {
+            // Jitter alone never lets a frame pass the one before it
+            arrival_ns = std::max(arrival_ns, shaper_.last_arrival_ns);
+            shaper_.last_arrival_ns = arrival_ns;
+        }
+        PacketHandle copy = peer_->pool_.alloc();
+        uint8_t* data = copy ? copy.append(frame.size()) : nullptr;
+        if (data == nullptr) {
+            sent_stats_.overflows++;
+            continue;
+        }
+        std::memcpy(data, frame.data(), frame.size());
+        InFlight item{arrival_ns, shaper_.sequence++, std::move(copy)};
+        if (!peer_->incoming_.enqueue(std::move(item))) {
+            sent_stats_.overflows++;
+        }
+    }
+    return count;
+}
+
+size_t VirtualPort::rx_burst(PacketPool&, PacketHandle* out, size_t max_packets) {
+    if (!is_open()) {
+        return 0;
+    }
+    size_t drained;
+    while ((drained = incoming_.dequeue_burst(drained_.data(), drained_.size())) > 0) {
+        for (size_t i = 0; i < drained; ++i) {
+            arrivals_.push_back(std::move(drained_[i]));
+            std::push_heap(arrivals_.begin(), arrivals_.end(), arrives_later);
+        }
+    }
+    uint64_t now_ns = clock_();
+    size_t count = 0;
+    while (count < max_packets && !arrivals_.empty() && arrivals_.front().arrival_ns <= now_ns) {
+        std::pop_heap(arrivals_.begin(), arrivals_.end(), arrives_later);
+        out[count] = std::move(arrivals_.back().frame);
+        arrivals_.pop_back();
+        delivered_++;
+        bytes_delivered_ += out[count].size();
+        count++;
+    }
+    return count;
+}
+
+WireStats VirtualPort::get_stats() const {
+    WireStats stats = sent_stats_;
+    stats.delivered = peer_->delivered_;
+    stats.bytes_delivered = peer_->bytes_delivered_;
+    return stats;
+}
+
+VirtualWire::VirtualWire(const VirtualWireConfig& config) {
+    uint64_t (*clock)() = config.clock != nullptr ? config.clock : steady_now_ns;
+    a_.reset(new VirtualPort(config.a_to_b, config.ring_size, config.pool, clock));
+    b_.reset(new VirtualPort(config.b_to_a, config.ring_size, config.pool, clock));
+    a_->peer_ = b_.get();
+    b_->peer_ = a_.get();
+}
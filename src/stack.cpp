@@ -1,8 +1,134 @@
 #include "stack.h"
-#include <iostream>
-#include <pcap.h>
+#include "ethernet/ethernet_view.h"
+#include "ip/ipv4_view.h"
+#include "tcp/tcp_view.h"
+#include "tcp/tcp_connection.h"
+#include "tcp/connection_table.h"
+#include "ip/ipv4_reassembler.h"
+#include "link/capture_file.h"
+#include "util/byte_order.h"
+#include "core/backoff.h"
+#include "core/trace.h"
+#include "ip/checksum.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
 
-TCPIPStack::TCPIPStack(const std::string& interface) : interface_(interface) {}
+// Single-writer counter update: a plain load/store, no atomic read-modify-write
+static void bump(std::atomic<uint64_t>& counter, uint64_t amount = 1) {
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+// Sleeps most of the way to a deadline, then spins for the last stretch so
+// short inter-packet gaps are reproduced accurately
+static void wait_until(std::chrono::steady_clock::time_point deadline) {
+    constexpr auto SPIN_WINDOW = std::chrono::microseconds(100);
+    auto now = std::chrono::steady_clock::now();
+    if (deadline - now > SPIN_WINDOW) {
+        std::this_thread::sleep_until(deadline - SPIN_WINDOW);
+    }
+    while (std::chrono::steady_clock::now() < deadline) {
+    }
+}
+
+static uint64_t steady_now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Timer::kind for a context's own timers; connection timers use TCPTimer
+static constexpr uint32_t REASSEMBLY_TIMER = static_cast<uint32_t>(TCPTimer::COUNT);
+
+static DropStats drop_stats(const MetricsSnapshot& metrics) {
+    DropStats drops;
+    drops.no_buffer = metrics.get(Metric::RX_NO_BUFFER);
+    drops.oversize = metrics.get(Metric::RX_OVERSIZE);
+    drops.queue_full = metrics.get(Metric::RX_QUEUE_FULL);
+    drops.eth_too_short = metrics.get(Metric::ETH_TOO_SHORT);
+    drops.eth_unknown_type = metrics.get(Metric::ETH_UNKNOWN_TYPE);
+    drops.ip_malformed = metrics.get(Metric::IP_MALFORMED);
+    drops.ip_bad_checksum = metrics.get(Metric::IP_BAD_CHECKSUM);
+    drops.ip_unknown_protocol = metrics.get(Metric::IP_UNKNOWN_PROTOCOL);
+    drops.tcp_malformed = metrics.get(Metric::TCP_MALFORMED);
+    drops.tcp_bad_checksum = metrics.get(Metric::TCP_BAD_CHECKSUM);
+    drops.tcp_no_connection = metrics.get(Metric::TCP_NO_CONNECTION);
+    drops.tcp_bad_state = metrics.get(Metric::TCP_BAD_STATE);
+    return drops;
+}
+
+// State owned by one processing thread. Counters are written only by that
+// thread and summed by get_metrics(); the counter block is cache-line
+// aligned, so contexts never share a line.
+struct TCPIPStack::RxContext {
+    RxContext(size_t table_size, PacketPool& fragment_pool, const StackConfig& config, uint64_t now)
+        : connections(table_size), reassembler(fragment_pool, config.reassembly), gro(config.gro), timers(now),
+          now_ns(now) {
+        reassembly_timer.kind = REASSEMBLY_TIMER;
+    }
+    
+    MetricCounters metrics;
+    std::atomic<uint64_t> processed{0}; // packets this context handled
+    ConnectionTable<TCPConnection> connections;
+    IPv4Reassembler reassembler;    // the receiving thread's alone once there are workers
+    TCPCoalescer gro;               // segments held until the end of the burst
+    TimerWheel timers;              // every timer of this context's connections
+    Timer reassembly_timer;         // armed for the oldest incomplete datagram
+    uint64_t now_ns;                // the stack's clock, sampled once per burst
+    std::array<uint8_t, 6> source_mac{};    // of the frame being processed
+    // Endpoint connections with something to send once the burst is done,
+    // so one ACK covers everything a burst brought
+    std::vector<TCPConnection*> output;
+    std::vector<TCPSegment> segments;       // outgoing, reused
+    std::vector<PacketHandle> loopback;     // frames to this host's own address, received on the next poll()
+    uint16_t ip_identification = 0;
+};
+
+// A worker owns every flow steered to it and polls its own ring, which
+// only the receiving thread fills
+struct TCPIPStack::Worker {
+    Worker(size_t id, size_t table_size, PacketPool& fragment_pool, const StackConfig& config, uint64_t now)
+        : index(id), context(table_size, fragment_pool, config, now), ring(config.worker_queue_depth) {}
+    
+    size_t index;
+    RxContext context;
+    SpscRing<RxItem> ring;
+    std::thread thread;
+    std::atomic<bool> stopping{false};
+};
+
+// Buffers the size of the receive pool's, as fragments arrive in them
+static PacketPoolConfig reassembly_pool_config(const StackConfig& config) {
+    PacketPoolConfig pool = config.pool;
+    pool.buffer_count = config.reassembly.max_fragments;
+    pool.headroom = 0;
+    pool.cache_size = 0;
+    return pool;
+}
+
+TCPIPStack::TCPIPStack(const std::string& interface, const StackConfig& config)
+    : interface_(interface), config_(config), clock_(config.clock != nullptr ? config.clock : steady_now_ns),
+      pool_(config.pool), reassembly_pool_(reassembly_pool_config(config)), device_(&pcap_),
+      tx_ring_(config.tx_ring_size),
+      receive_context_(std::make_unique<RxContext>(config.worker_count == 0 ? config.connection_table_size : 0,
+                                                   reassembly_pool_, config, clock_())) {
+    iss_secret_ = config.iss_secret;
+    if (iss_secret_ == 0) {
+        std::random_device random;
+        iss_secret_ = static_cast<uint64_t>(random()) << 32 | random();
+    }
+    for (size_t i = 0; i < config_.worker_count; ++i) {
+        workers_.push_back(std::make_unique<Worker>(i, config_.connection_table_size, reassembly_pool_, config_,
+                                                    clock_()));
+    }
+    pending_.resize(config_.worker_count);
+    for (size_t i = 0; i < RSS_TABLE_SIZE; ++i) {
+        rss_table_[i] = static_cast<uint16_t>(config_.worker_count > 0 ? i % config_.worker_count : 0);
+    }
+}
+
+TCPIPStack::TCPIPStack(NetDevice& device, const StackConfig& config) : TCPIPStack(std::string(), config) {
+    device_ = &device;
+}
 
 TCPIPStack::~TCPIPStack() {
     stop();
@@ -10,24 +136,29 @@ TCPIPStack::~TCPIPStack() {
 
 bool TCPIPStack::start() {
     if (running_) {
-        std::cout << "Stack is already running" << std::endl;
+        TRACE(TraceEvent::STACK_ALREADY_RUNNING);
         return false;
     }
     
-    char errbuf[PCAP_ERRBUF_SIZE];
-    pcap_t* handle = pcap_open_live(interface_.c_str(), BUFSIZ, 1, 1000, errbuf);
-    
-    if (handle == nullptr) {
-        std::cerr << "Couldn't open device " << interface_ << ": " << errbuf << std::endl;
+    // A device the caller gave is theirs to open
+    bool opened = device_ == &pcap_ ? pcap_.open_live(interface_, config_.pcap) : device_->is_open();
+    if (!opened) {
         return false;
     }
     
-    pcap_close(handle);
-    
     running_ = true;
+    start_workers();
     capture_thread_ = std::thread(&TCPIPStack::capture_loop, this);
     
-    std::cout << "TCP/IP Stack started on interface: " << interface_ << std::endl;
+    TRACE(TraceEvent::STACK_STARTED);
+    return true;
+}
+
+bool TCPIPStack::listen(uint16_t port) {
+    if (running_ || (!listeners_.empty() && listeners_[port] != 0)) {
+        return false;
+    }
+    listening_ports_.set(port);
     return true;
 }
 
@@ -35,44 +166,1510 @@ void TCPIPStack::stop() {
     if (!running_) return;
     
     running_ = false;
+    device_->break_loop();
     if (capture_thread_.joinable()) {
         capture_thread_.join();
     }
+    stop_workers();
+    flush_tx();
+    pcap_.close();
+    
+    TRACE(TraceEvent::STACK_STOPPED);
+}
+
+bool TCPIPStack::process_savefile(const std::string& path) {
+    if (running_) {
+        TRACE(TraceEvent::STACK_ALREADY_RUNNING);
+        return false;
+    }
+    
+    if (device_ != &pcap_ || !pcap_.open_offline(path)) {
+        return false;
+    }
+    
+    running_ = true;
+    start_workers();
+    receive_bursts(true);
+    stop_workers();
+    flush_tx();
+    running_ = false;
+    pcap_.close();
+    return true;
+}
+
+bool TCPIPStack::replay(const std::string& path, const ReplayConfig& config, ReplayReport& report) {
+    if (running_) {
+        TRACE(TraceEvent::STACK_ALREADY_RUNNING);
+        return false;
+    }
+    
+    CaptureFile file;
+    if (!file.open(path)) {
+        return false;
+    }
+    
+    using Clock = std::chrono::steady_clock;
+    double speed = config.timing == ReplayTiming::SCALED && config.speed > 0 ? config.speed : 1.0;
+    bool paced = config.timing != ReplayTiming::AS_FAST_AS_POSSIBLE;
+    
+    report = ReplayReport();
+    MetricsSnapshot before = get_metrics();
+    std::vector<RxItem> items;
+    items.reserve(std::max<size_t>(1, config_.rx_burst_size));
+    
+    running_ = true;
+    start_workers();
+    Clock::time_point start = Clock::now();
+    
+    for (size_t loop = 0; loop < config.loops && running_; ++loop) {
+        file.rewind();
+        Clock::time_point loop_start = Clock::now();
+        uint64_t first_timestamp = 0;
+        bool have_first = false;
+        CapturedPacket packet;
+        
+        while (running_ && file.next(packet)) {
+            if (packet.link_type != CaptureFile::LINKTYPE_ETHERNET) {
+                report.skipped++;
+                continue;
+            }
+            
+            if (paced) {
+                if (!have_first) {
+                    first_timestamp = packet.timestamp_ns;
+                    have_first = true;
+                }
+                uint64_t offset_ns = packet.timestamp_ns > first_timestamp ? packet.timestamp_ns - first_timestamp : 0;
+                auto due = loop_start + std::chrono::nanoseconds(static_cast<int64_t>(offset_ns / speed));
+                if (due > Clock::now()) {
+                    // Deliver what is already due before waiting
+                    if (!items.empty()) {
+                        deliver_burst(items, true);
+                        items.clear();
+                    }
+                    wait_until(due);
+                }
+            }
+            
+            items.push_back(RxItem{PacketHandle(), packet.data});
+            report.packets++;
+            report.bytes += packet.data.size();
+            if (items.size() == items.capacity()) {
+                deliver_burst(items, true);
+                items.clear();
+            }
+        }
+        
+        if (!items.empty()) {
+            deliver_burst(items, true);
+            items.clear();
+        }
+        report.file_truncated = report.file_truncated || file.is_truncated();
+    }
+    
+    // Workers read straight from the mapping, so they finish before it closes
+    stop_workers();
+    flush_tx();
+    report.elapsed_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    running_ = false;
+    
+    if (report.elapsed_seconds > 0) {
+        report.packets_per_second = report.packets / report.elapsed_seconds;
+        report.bytes_per_second = report.bytes / report.elapsed_seconds;
+    }
+    
+    report.metrics = get_metrics().since(before);
+    report.drops = drop_stats(report.metrics);
+    return true;
+}
+
+size_t TCPIPStack::poll_timers() {
+    if (running_) {
+        return 0;
+    }
+    size_t fired = run_timers(*receive_context_);
+    for (auto& worker : workers_) {
+        fired += run_timers(worker->context);
+    }
+    return fired;
+}
+
+MetricsSnapshot TCPIPStack::get_metrics() const {
+    MetricsSnapshot metrics;
+    auto add_context = [&metrics](const RxContext& context) {
+        metrics.add(context.metrics);
+        ReassemblyStats reassembly = context.reassembler.get_stats();
+        metrics.add(Metric::IP_FRAGMENTS, reassembly.fragments);
+        metrics.add(Metric::IP_REASSEMBLED, reassembly.completed);
+        metrics.add(Metric::IP_FRAGMENT_OVERLAPS, reassembly.overlaps);
+        metrics.add(Metric::IP_REASSEMBLY_TIMEOUTS, reassembly.timeouts);
+        metrics.add(Metric::IP_REASSEMBLY_DROPS, reassembly.evicted + reassembly.invalid + reassembly.no_buffer);
+    };
+    add_context(*receive_context_);
+    for (const auto& worker : workers_) {
+        add_context(worker->context);
+    }
+    // Counted where they happen by structures with their own stats
+    // Sends take from the same pool, and count their own failures
+    metrics.add(Metric::RX_NO_BUFFER, pool_.get_stats().exhausted - metrics.get(Metric::TX_NO_BUFFER));
+    metrics.add(Metric::RX_OVERSIZE, device_->get_dropped_oversize());
+    metrics.add(Metric::TX_RING_FULL, tx_ring_.get_stats().full);
+    return metrics;
+}
+
+StackStats TCPIPStack::get_stats() const {
+    MetricsSnapshot metrics = get_metrics();
+    StackStats stats;
+    stats.rx_packets = metrics.get(Metric::RX_PACKETS);
+    stats.rx_bytes = metrics.get(Metric::RX_BYTES);
+    for (const auto& worker : workers_) {
+        stats.worker_packets.push_back(worker->context.processed.load(std::memory_order_relaxed));
+    }
+    stats.tx_packets = metrics.get(Metric::TX_PACKETS);
+    stats.tx_dropped = metrics.get(Metric::TX_RING_FULL) + metrics.get(Metric::TX_DEVICE_ERRORS) +
+                       metrics.get(Metric::TX_NO_BUFFER) + metrics.get(Metric::TX_OVERSIZE);
+    stats.connections = metrics.get(Metric::TCP_CONNECTIONS_OPENED) - metrics.get(Metric::TCP_CONNECTIONS_CLOSED);
+    stats.drops = drop_stats(metrics);
+    return stats;
+}
+
+size_t TCPIPStack::select_worker(std::span<const uint8_t> frame) const {
+    if (workers_.size() <= 1) {
+        return 0;
+    }
+    return rss_table_[flow_hash(frame) % RSS_TABLE_SIZE];
+}
+
+// Non-IPv4 and malformed frames hash to 0. Fragments hash on the address
+// pair alone; only ones hold_fragment() passes on, as malformed, get here.
+uint32_t TCPIPStack::flow_hash(std::span<const uint8_t> frame) const {
+    EthernetView eth;
+    if (!eth.parse(frame) || eth.get_ethertype() != EthernetFrame::ETHERTYPE_IPV4) {
+        return 0;
+    }
+    
+    IPv4View ip;
+    if (!ip.parse(eth.get_payload())) {
+        return 0;
+    }
+    
+    auto payload = ip.get_payload();
+    if (ip.get_protocol() == IPv4Packet::PROTOCOL_TCP && !ip.is_fragment() && payload.size() >= 4) {
+        return hasher_.hash_ipv4_tcp(ip.get_source_address(), ip.get_destination_address(),
+                                     read_be16(payload.data()), read_be16(payload.data() + 2));
+    }
+    return hasher_.hash_ipv4(ip.get_source_address(), ip.get_destination_address());
+}
+
+bool TCPIPStack::transmit(PacketHandle packet) {
+    return tx_ring_.enqueue(std::move(packet));
+}
+
+void TCPIPStack::flush_tx() {
+    PacketHandle burst[TX_BURST_SIZE];
+    RxContext& context = *receive_context_;
+    
+    size_t count;
+    while ((count = tx_ring_.dequeue_burst(burst, TX_BURST_SIZE)) > 0) {
+        size_t sent = device_->tx_burst(burst, count);
+        context.metrics.add(Metric::TX_PACKETS, sent);
+        if (sent < count) {
+            context.metrics.add(Metric::TX_DEVICE_ERRORS, count - sent);
+            TRACE(TraceEvent::TX_ERROR, 0, static_cast<uint32_t>(count - sent));
+        }
+        for (size_t i = 0; i < count; ++i) {
+            burst[i].release();
+        }
+    }
+}
+
+void TCPIPStack::start_workers() {
+    for (auto& worker : workers_) {
+        worker->stopping.store(false, std::memory_order_relaxed);
+        worker->thread = std::thread(&TCPIPStack::worker_loop, this, std::ref(*worker));
+    }
+}
+
+// Workers drain their rings before exiting
+void TCPIPStack::stop_workers() {
+    for (auto& worker : workers_) {
+        worker->stopping.store(true, std::memory_order_release);
+    }
+    for (auto& worker : workers_) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+}
+
+void TCPIPStack::worker_loop(Worker& worker) {
+    TRACE(TraceEvent::THREAD_STARTED, 0, 1, worker.index);
+    std::vector<RxItem> batch(std::max<size_t>(1, config_.rx_burst_size));
+    Backoff backoff;
     
-    std::cout << "TCP/IP Stack stopped" << std::endl;
+    while (true) {
+        size_t count = worker.ring.dequeue_burst(batch.data(), batch.size());
+        if (count == 0) {
+            // The receiving thread stops producing before it raises the flag
+            if (worker.stopping.load(std::memory_order_acquire) && worker.ring.empty()) {
+                return;
+            }
+            run_timers(worker.context);
+            backoff.idle();
+            continue;
+        }
+        backoff.reset();
+        
+        process_burst(worker.context, std::span<const RxItem>(batch.data(), count));
+        for (size_t i = 0; i < count; ++i) {
+            batch[i].buffer.release();
+        }
+    }
 }
 
 void TCPIPStack::capture_loop() {
-    char errbuf[PCAP_ERRBUF_SIZE];
-    pcap_t* handle = pcap_open_live(interface_.c_str(), BUFSIZ, 1, 1000, errbuf);
+    TRACE(TraceEvent::THREAD_STARTED, 0, 0);
+    receive_bursts(false);
+}
+
+void TCPIPStack::receive_bursts(bool lossless) {
+    std::vector<PacketHandle> burst(std::max<size_t>(1, config_.rx_burst_size));
+    std::vector<RxItem> items(burst.size());
+    
+    while (running_) {
+        size_t count = device_->rx_burst(pool_, burst.data(), burst.size());
+        if (count == 0) {
+            run_timers(*receive_context_);
+            flush_tx();
+            if (device_->at_end()) {
+                break;
+            }
+            continue;
+        }
+        
+        for (size_t i = 0; i < count; ++i) {
+            items[i].frame = burst[i].span();
+            items[i].buffer = std::move(burst[i]);
+        }
+        deliver_burst(std::span<RxItem>(items.data(), count), lossless);
+    }
+}
+
+void TCPIPStack::deliver_burst(std::span<RxItem> items, bool lossless) {
+    RxContext& context = *receive_context_;
+    uint64_t bytes = 0;
+    for (const auto& item : items) {
+        bytes += item.frame.size();
+    }
+    context.metrics.add(Metric::RX_PACKETS, items.size());
+    context.metrics.add(Metric::RX_BYTES, bytes);
+    TRACE(TraceEvent::RX_BURST, 0, static_cast<uint32_t>(items.size()));
+    
+    if (!workers_.empty()) {
+        steer_burst(items, lossless);
+    } else {
+        process_burst(context, items);
+        // Layers that still need a packet hold their own reference
+        for (auto& item : items) {
+            item.buffer.release();
+        }
+    }
+    flush_tx();
+}
+
+// Live capture drops what a full ring cannot take, as a NIC ring would.
+// Offline sources wait for room instead, so a replay is reproducible.
+void TCPIPStack::steer_burst(std::span<RxItem> items, bool lossless) {
+    run_timers(*receive_context_);
+    for (auto& item : items) {
+        if (!hold_fragment(item)) {
+            pending_[select_worker(item.frame)].push_back(std::move(item));
+        }
+    }
+    
+    uint64_t dropped = 0;
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        auto& pending = pending_[i];
+        if (pending.empty()) {
+            continue;
+        }
+        
+        Worker& worker = *workers_[i];
+        size_t accepted = worker.ring.enqueue_burst(pending.data(), pending.size());
+        Backoff backoff;
+        while (lossless && accepted < pending.size()) {
+            backoff.idle();
+            accepted += worker.ring.enqueue_burst(pending.data() + accepted, pending.size() - accepted);
+        }
+        if (accepted < pending.size()) {
+            dropped += pending.size() - accepted;
+            TRACE(TraceEvent::WORKER_QUEUE_FULL, 0, static_cast<uint32_t>(i), pending.size() - accepted);
+        }
+        pending.clear();
+    }
+    
+    if (dropped > 0) {
+        receive_context_->metrics.add(Metric::RX_QUEUE_FULL, dropped);
+    }
+}
+
+// Fragments carry no ports after the first, so with workers the receiving
+// thread reassembles them and steers the whole datagram like any other
+// segment of its flow. Returns true when the item was taken: held, or
+// dropped. A completed datagram is copied into a pool buffer, which
+// replaces the item's, and is dropped as oversize if it does not fit.
+bool TCPIPStack::hold_fragment(RxItem& item) {
+    EthernetView eth;
+    IPv4View ip;
+    if (!eth.parse(item.frame) || eth.get_ethertype() != EthernetFrame::ETHERTYPE_IPV4 ||
+        !ip.parse(eth.get_payload()) || !ip.is_fragment() || !ip.has_valid_checksum()) {
+        // A worker counts whatever is wrong with it
+        return false;
+    }
     
-    if (handle == nullptr) {
-        std::cerr << "Couldn't open device in capture thread: " << errbuf << std::endl;
+    RxContext& context = *receive_context_;
+    if (reassemble(context, ip)) {
+        std::span<const uint8_t> datagram = ip.get_bytes();
+        size_t length = EthernetView::HEADER_SIZE + datagram.size();
+        PacketHandle whole = pool_.alloc();
+        uint8_t* out = whole ? whole.append(length) : nullptr;
+        if (whole && out == nullptr) {
+            context.metrics.add(Metric::RX_OVERSIZE);
+        } else if (whole) {
+            out = std::copy_n(item.frame.data(), EthernetView::HEADER_SIZE, out);
+            std::copy(datagram.begin(), datagram.end(), out);
+            item.buffer = std::move(whole);
+            item.frame = item.buffer.span();
+            // Counted as an IP packet by the worker, as without workers
+            return false;
+        }
+    }
+    context.metrics.add(Metric::IP_PACKETS);
+    item.buffer.release();
+    return true;
+}
+
+// Samples the clock for the context and fires whatever is due
+size_t TCPIPStack::run_timers(RxContext& context) {
+    context.now_ns = clock_();
+    return context.timers.advance(context.now_ns, [this, &context](Timer& timer) { on_timer(context, timer); });
+}
+
+void TCPIPStack::on_timer(RxContext& context, Timer& timer) {
+    if (timer.kind == REASSEMBLY_TIMER) {
+        context.reassembler.expire(context.now_ns);
+        arm_reassembly_timer(context);
         return;
     }
     
-    struct pcap_pkthdr header;
-    const u_char* packet;
+    TCPConnection& connection = *static_cast<TCPConnection*>(timer.owner);
+    switch (static_cast<TCPTimer>(timer.kind)) {
+    case TCPTimer::TIME_WAIT:
+        connection.machine.handle_time_wait_expired();
+        context.metrics.add(Metric::TCP_TIME_WAIT_EXPIRED);
+        close_connection(context, connection);
+        break;
+    case TCPTimer::KEEPALIVE:
+        // No probes yet: an idle peer counts as gone, and is told so if
+        // this host is an end of the connection
+        context.metrics.add(Metric::TCP_KEEPALIVE_TIMEOUTS);
+        if (connection.endpoint) {
+            abort_connection(context, connection, SocketError::TIMED_OUT);
+        } else {
+            close_connection(context, connection, SocketError::TIMED_OUT);
+        }
+        break;
+    case TCPTimer::RETRANSMIT:
+        on_retransmit_timer(context, connection);
+        break;
+    case TCPTimer::DELAYED_ACK:
+        connection.ack_pending = true;
+        output(context, connection);
+        break;
+    case TCPTimer::COUNT:
+        break;
+    }
+}
+
+void TCPIPStack::arm_reassembly_timer(RxContext& context) {
+    uint64_t deadline = context.reassembler.get_next_deadline();
+    if (deadline == UINT64_MAX) {
+        context.timers.cancel(context.reassembly_timer);
+    } else {
+        context.timers.arm(context.reassembly_timer, deadline);
+    }
+}
+
+// Cancels the connection's timers, then erases it; connection is gone after.
+// Its socket, if the application still holds it, reports reason.
+void TCPIPStack::close_connection(RxContext& context, TCPConnection& connection, SocketError reason) {
+    for (Timer& timer : connection.timers) {
+        context.timers.cancel(timer);
+    }
+    if (connection.in_output) {
+        std::erase(context.output, &connection);
+    }
+    if (connection.socket != 0) {
+        uint32_t index = connection.socket - 1;
+        SocketSlot& slot = sockets_.at(index);
+        slot.connection = nullptr;
+        slot.error = reason;
+        if (slot.accepted) {
+            sockets_.notify(index);
+        } else {
+            // Still on its listener's queue, or not yet established
+            uint32_t listener = listeners_.empty() ? 0 : listeners_[connection.key.local_port];
+            if (listener != 0) {
+                SocketSlot& owner = sockets_.at(listener - 1);
+                if (std::erase(owner.accept_queue, sockets_.id_of(index)) == 0 && owner.handshaking > 0) {
+                    owner.handshaking--;
+                }
+            }
+            sockets_.free(index);
+        }
+    }
+    FlowKey key = connection.key;
+    context.connections.erase(key);
+    context.metrics.add(Metric::TCP_CONNECTIONS_CLOSED);
+    TRACE(TraceEvent::CONNECTION_CLOSED, hash_flow_key(key));
+}
+
+void TCPIPStack::process_burst(RxContext& context, std::span<const RxItem> items) {
+    run_timers(context);
     
-    std::cout << "Capture thread started" << std::endl;
+    for (size_t i = 0; i < items.size(); ++i) {
+        // Pull the next packet's headers in while this one is parsed
+        if (i + 1 < items.size()) {
+            __builtin_prefetch(items[i + 1].frame.data());
+        }
+        process_packet(context, items[i].frame);
+    }
+    // The burst's buffers are released after this, so nothing stays held
+    context.gro.flush([&](const CoalescedSegment& segment) { process_segment(context, segment); });
+    flush_output(context);
     
-    while (running_) {
-        packet = pcap_next(handle, &header);
-        if (packet != nullptr) {
-            std::vector<uint8_t> packet_data(packet, packet + header.len);
-            process_packet(packet_data);
+    bump(context.processed, items.size());
+}
+
+void TCPIPStack::process_packet(RxContext& context, std::span<const uint8_t> frame) {
+    EthernetView eth;
+    if (!eth.parse(frame)) {
+        context.metrics.add(Metric::ETH_TOO_SHORT);
+        TRACE(TraceEvent::ETH_MALFORMED, 0, static_cast<uint32_t>(frame.size()));
+        return;
+    }
+    
+    if (eth.get_ethertype() == EthernetFrame::ETHERTYPE_IPV4) {
+        context.source_mac = eth.get_source_mac();
+        process_ipv4(context, eth.get_payload());
+    } else {
+        context.metrics.add(Metric::ETH_UNKNOWN_TYPE);
+    }
+}
+
+void TCPIPStack::process_ipv4(RxContext& context, std::span<const uint8_t> ip_data) {
+    IPv4View ip;
+    if (!ip.parse(ip_data)) {
+        context.metrics.add(Metric::IP_MALFORMED);
+        TRACE(TraceEvent::IP_MALFORMED, 0, static_cast<uint32_t>(ip_data.size()));
+        return;
+    }
+    if (!ip.has_valid_checksum()) {
+        context.metrics.add(Metric::IP_BAD_CHECKSUM);
+        return;
+    }
+    context.metrics.add(Metric::IP_PACKETS);
+    
+    // A reassembled datagram lives in the reassembler, not the burst, so
+    // is never held for merging
+    bool fragment = ip.is_fragment();
+    if (fragment && !reassemble(context, ip)) {
+        return;
+    }
+    
+    if (ip.get_protocol() == IPv4Packet::PROTOCOL_TCP) {
+        process_tcp(context, ip, ip.get_payload(), !fragment);
+    } else {
+        context.metrics.add(Metric::IP_UNKNOWN_PROTOCOL);
+    }
+}
+
+// Adds a fragment to the context's reassembler; true once its datagram is
+// whole, with ip then viewing the datagram
+bool TCPIPStack::reassemble(RxContext& context, IPv4View& ip) {
+    std::span<const uint8_t> datagram;
+    ReassemblyResult result = context.reassembler.add(ip, context.now_ns, datagram);
+    if (!context.reassembly_timer.is_armed()) {
+        arm_reassembly_timer(context);
+    }
+    if (result != ReassemblyResult::COMPLETE) {
+        return false;
+    }
+    // The reassembled header is rebuilt with a fresh checksum
+    ip.parse(datagram);
+    return true;
+}
+
+void TCPIPStack::process_tcp(RxContext& context, const IPv4View& ip, std::span<const uint8_t> tcp_data,
+                             bool may_hold) {
+    TCPView tcp;
+    if (!tcp.parse(tcp_data)) {
+        context.metrics.add(Metric::TCP_MALFORMED);
+        TRACE(TraceEvent::TCP_MALFORMED, 0, static_cast<uint32_t>(tcp_data.size()));
+        return;
+    }
+    if (config_.verify_tcp_checksum &&
+        !tcp.has_valid_checksum(ip.get_source_address(), ip.get_destination_address())) {
+        context.metrics.add(Metric::TCP_BAD_CHECKSUM);
+        return;
+    }
+    context.metrics.add(Metric::TCP_SEGMENTS);
+    context.gro.add(ip, tcp, may_hold && config_.gro.enabled,
+                    [&](const CoalescedSegment& segment) { process_segment(context, segment); });
+}
+
+// The peer's FIN has been received
+static bool peer_closed(TCPState state) {
+    return state == TCPState::CLOSE_WAIT || state == TCPState::CLOSING ||
+           state == TCPState::LAST_ACK || state == TCPState::TIME_WAIT;
+}
+
+// Whether an ACK may move an endpoint's state on: while our SYN or FIN
+// is unacknowledged, only one that covers it does
+static bool acknowledges_control(const TCPConnection& connection, uint32_t ack) {
+    switch (connection.machine.get_state()) {
+    case TCPState::SYN_RECEIVED:
+        return ack == connection.iss + 1;
+    case TCPState::FIN_WAIT_1:
+    case TCPState::CLOSING:
+    case TCPState::LAST_ACK:
+        return connection.fin_sent && ack == connection.fin_sequence + 1;
+    default:
+        return true;
+    }
+}
+
+enum class ResetCheck { ACCEPT, CHALLENGE, IGNORE };
+
+// A reset is taken only at exactly RCV.NXT; one elsewhere in the window
+// gets a challenge ACK, so a blind attacker must guess the number (RFC 5961
+// section 3.2). In SYN_SENT it must acknowledge our SYN (RFC 793 section 3.4).
+static ResetCheck check_reset(const TCPConnection& connection, const CoalescedSegment& segment) {
+    TCPState state = connection.machine.get_state();
+    if (state == TCPState::SYN_SENT) {
+        return segment.has_flag(TCPSegment::ACK) && segment.tcp.get_ack_number() == connection.iss + 1
+                   ? ResetCheck::ACCEPT : ResetCheck::IGNORE;
+    }
+    if (!connection.receive.is_open()) {
+        return ResetCheck::IGNORE;
+    }
+    uint32_t rcv_nxt = connection.receive.get_rcv_nxt() + (peer_closed(state) ? 1 : 0);
+    uint32_t window = static_cast<uint32_t>(std::clamp<size_t>(connection.receive.get_window(), 1, 1u << 30));
+    uint32_t sequence = segment.tcp.get_sequence_number();
+    if (sequence == rcv_nxt) {
+        return ResetCheck::ACCEPT;
+    }
+    return seq_gt(sequence, rcv_nxt) && seq_lt(sequence, rcv_nxt + window) ? ResetCheck::CHALLENGE
+                                                                           : ResetCheck::IGNORE;
+}
+
+// TCP input, once per segment or run of merged segments
+void TCPIPStack::process_segment(RxContext& context, const CoalescedSegment& segment) {
+    const IPv4View& ip = segment.ip;
+    const TCPView& tcp = segment.tcp;
+    if (segment.count > 1) {
+        context.metrics.add(Metric::TCP_GRO_MERGED, segment.count - 1);
+    }
+    FlowKey key{ip.get_destination_address(), ip.get_source_address(),
+                tcp.get_dest_port(), tcp.get_source_port()};
+    TCPConnection* connection = context.connections.find(key);
+    if (connection == nullptr) {
+        bool opening = segment.has_flag(TCPSegment::SYN) && !segment.has_flag(TCPSegment::ACK);
+        uint32_t listener = opening && !listeners_.empty() ? listeners_[key.local_port] : 0;
+        if (!opening || (listener == 0 && !listening_ports_.test(key.local_port))) {
+            context.metrics.add(Metric::TCP_NO_CONNECTION);
+            TRACE(TraceEvent::TCP_NO_CONNECTION, hash_flow_key(key), segment.flags);
+            return;
+        }
+        if (listener != 0) {
+            SocketSlot& slot = sockets_.at(listener - 1);
+            if (slot.handshaking + slot.accept_queue.size() >= slot.backlog) {
+                context.metrics.add(Metric::TCP_LISTEN_OVERFLOWS);
+                return;
+            }
+            slot.handshaking++;
         }
+        connection = open_connection(context, key);
+        connection->machine.listen();
+        connection->receive.open(tcp.get_sequence_number() + 1, config_.receive_buffer_size);
+        if (listener != 0) {
+            uint32_t index = SocketTable::index_of(sockets_.allocate(SocketKind::STREAM));
+            sockets_.at(index).connection = connection;
+            connection->endpoint = true;
+            connection->socket = index + 1;
+            connection->peer_mac = context.source_mac;
+        }
+    }
+    
+    connection->segments_received += segment.count;
+    connection->bytes_received += segment.payload_length;
+    // Malformed options are ignored rather than the segment dropped
+    TCPOptions options;
+    if (tcp.get_header_length() > TCPView::MIN_HEADER_SIZE && !tcp.decode_options(options)) {
+        options = TCPOptions();
     }
     
-    pcap_close(handle);
+    TCPStateMachine& machine = connection->machine;
+    auto apply = [&](TCPEvent event) {
+        TCPState from = machine.get_state();
+        bool applied = machine.apply(event);
+        if (applied) {
+            TRACE(TraceEvent::TCP_TRANSITION, hash_flow_key(key),
+                  static_cast<uint32_t>(from) | static_cast<uint32_t>(event) << 8 |
+                  static_cast<uint32_t>(machine.get_state()) << 16);
+        } else {
+            context.metrics.add(Metric::TCP_BAD_STATE);
+            TRACE(TraceEvent::TCP_BAD_STATE, hash_flow_key(key),
+                  static_cast<uint32_t>(from) | static_cast<uint32_t>(event) << 8);
+        }
+        return applied;
+    };
+    
+    // ACK before FIN, so a FIN+ACK in FIN_WAIT_1 ends in TIME_WAIT
+    bool endpoint = connection->endpoint;
+    TCPState before = machine.get_state();
+    if (segment.has_flag(TCPSegment::RST)) {
+        ResetCheck check = check_reset(*connection, segment);
+        if (check == ResetCheck::ACCEPT) {
+            apply(TCPEvent::RECV_RST);
+        } else {
+            context.metrics.add(Metric::TCP_RESETS_IGNORED);
+            if (check == ResetCheck::CHALLENGE && endpoint) {
+                context.metrics.add(Metric::TCP_CHALLENGE_ACKS);
+                connection->ack_pending = true;
+                queue_output(context, *connection);
+            }
+            return;
+        }
+    } else {
+        bool accepted = true;
+        if (segment.has_flag(TCPSegment::SYN)) {
+            if (!segment.has_flag(TCPSegment::ACK)) {
+                accepted = apply(TCPEvent::RECV_SYN);
+                if (endpoint && !accepted && before == TCPState::SYN_RECEIVED) {
+                    // The SYN again: our SYN-ACK was lost
+                    send_control(context, *connection, TCPSegment::SYN | TCPSegment::ACK);
+                }
+            } else if (endpoint && tcp.get_ack_number() == connection->iss + 1 && before != TCPState::SYN_SENT &&
+                       before != TCPState::SYN_RECEIVED) {
+                // The SYN-ACK again: our ACK of it was lost
+                accepted = false;
+                connection->ack_pending = true;
+            } else if (!endpoint || tcp.get_ack_number() == connection->iss + 1) {
+                accepted = apply(TCPEvent::RECV_SYN_ACK);
+                if (endpoint && accepted) {
+                    connection->receive.open(tcp.get_sequence_number() + 1, config_.receive_buffer_size);
+                    connection->ack_pending = true;
+                }
+            } else {
+                // Not an answer to our SYN
+                accepted = false;
+                context.metrics.add(Metric::TCP_BAD_STATE);
+            }
+        } else if (segment.has_flag(TCPSegment::ACK)) {
+            if (!endpoint || acknowledges_control(*connection, tcp.get_ack_number())) {
+                accepted = apply(TCPEvent::RECV_ACK);
+            } else if (before == TCPState::SYN_RECEIVED || before == TCPState::SYN_SENT) {
+                accepted = false;
+                context.metrics.add(Metric::TCP_BAD_STATE);
+            }
+        }
+        
+        if (accepted) {
+            TCPState state = machine.get_state();
+            bool opened = segment.has_flag(TCPSegment::SYN) && state != before &&
+                          (before == TCPState::LISTEN || before == TCPState::SYN_SENT);
+            record_options(*connection, options, opened);
+        }
+        
+        if (endpoint && accepted) {
+            TCPState state = machine.get_state();
+            if (before == TCPState::LISTEN && state == TCPState::SYN_RECEIVED) {
+                start_sender(*connection);
+                send_control(context, *connection, TCPSegment::SYN | TCPSegment::ACK);
+            } else if (before == TCPState::SYN_SENT && state == TCPState::SYN_RECEIVED) {
+                // Simultaneous open: our SYN again, now acknowledging theirs
+                connection->receive.open(tcp.get_sequence_number() + 1, config_.receive_buffer_size);
+                start_sender(*connection);
+                send_control(context, *connection, TCPSegment::SYN | TCPSegment::ACK);
+            } else if (before == TCPState::SYN_SENT && state == TCPState::ESTABLISHED) {
+                start_sender(*connection);
+            }
+            if (connection->sender != nullptr && segment.has_flag(TCPSegment::ACK)) {
+                process_ack(context, *connection, segment, options);
+            }
+            if (state != before && (state == TCPState::ESTABLISHED || state == TCPState::FIN_WAIT_2 ||
+                                    state == TCPState::TIME_WAIT || state == TCPState::CLOSED)) {
+                // Our SYN or FIN was acknowledged
+                connection->control_deadline_ns = UINT64_MAX;
+                connection->retries = 0;
+            }
+            if (state == TCPState::ESTABLISHED && state != before && !establish(*connection)) {
+                abort_connection(context, *connection, SocketError::RESET);
+                return;
+            }
+        }
+        
+        if (accepted && segment.payload_length > 0) {
+            receive_payload(context, *connection, segment);
+        }
+        if (accepted && segment.has_flag(TCPSegment::FIN)) {
+            if (!endpoint) {
+                apply(TCPEvent::RECV_FIN);
+            } else {
+                // Only a FIN right after everything received so far; one
+                // past a hole waits for its retransmission
+                connection->ack_pending = true;
+                uint32_t end = segment.get_end_sequence() + (segment.has_flag(TCPSegment::SYN) ? 1 : 0);
+                if (connection->receive.is_open() && end == connection->receive.get_rcv_nxt() &&
+                    !peer_closed(machine.get_state())) {
+                    apply(TCPEvent::RECV_FIN);
+                    notify(*connection);
+                }
+            }
+        }
+    }
+    
+    TCPState state = machine.get_state();
+    if (state == TCPState::CLOSED) {
+        close_connection(context, *connection,
+                         segment.has_flag(TCPSegment::RST) ? SocketError::RESET : SocketError::NONE);
+        return;
+    } else if (state == TCPState::TIME_WAIT) {
+        // A retransmitted FIN restarts the 2*MSL wait (RFC 793 section 3.9)
+        Timer& time_wait = connection->timer(TCPTimer::TIME_WAIT);
+        if (!time_wait.is_armed() || segment.has_flag(TCPSegment::FIN)) {
+            context.timers.arm(time_wait, context.now_ns + config_.time_wait_ns);
+        }
+        context.timers.cancel(connection->timer(TCPTimer::KEEPALIVE));
+    } else if (config_.keepalive_idle_ns != 0) {
+        context.timers.arm(connection->timer(TCPTimer::KEEPALIVE), context.now_ns + config_.keepalive_idle_ns);
+    }
+    if (endpoint) {
+        queue_output(context, *connection);
+    }
 }
 
-void TCPIPStack::process_packet(const std::vector<uint8_t>& packet_data) {
-    // Basic packet processing - just print size for now
-    std::cout << "Received packet: " << packet_data.size() << " bytes" << std::endl;
+// What the peer's SYN offers is recorded only by the SYN that moves the
+// connection out of LISTEN or SYN_SENT, so a stray SYN later cannot turn
+// scaling, SACK or timestamps off. TS.Recent follows accepted segments.
+void TCPIPStack::record_options(TCPConnection& connection, const TCPOptions& options, bool opening) {
+    if (opening) {
+        if (options.mss != 0) {
+            connection.peer_mss = options.mss;
+        }
+        connection.window_scaling = options.has_window_scale;
+        connection.peer_window_scale = options.window_scale;
+        connection.sack_permitted = options.sack_permitted;
+        connection.timestamps = options.has_timestamps;
+        connection.ts_recent = options.ts_value;
+    }
+    if (connection.timestamps && options.has_timestamps && seq_ge(options.ts_value, connection.ts_recent)) {
+        connection.ts_recent = options.ts_value;
+    }
+}
+
+// The largest MSS whose frames fit a pool buffer whole, with room for a
+// full TCP header: sent, the headers go in the headroom, but a received
+// frame is copied in behind it
+static uint32_t pool_mss(const PacketPoolConfig& pool) {
+    constexpr size_t HEADERS = EthernetView::HEADER_SIZE + IPv4View::MIN_HEADER_SIZE + TCPView::MIN_HEADER_SIZE +
+                               TCPOptions::MAX_SIZE;
+    size_t room = pool.buffer_size > pool.headroom + HEADERS ? pool.buffer_size - pool.headroom - HEADERS : 0;
+    return static_cast<uint32_t>(std::min<size_t>(room, 65535));
+}
+
+// Data is only taken while the connection can still receive it (RFC 793
+// section 3.9, "process the segment text")
+static bool accepts_data(TCPState state) {
+    return state == TCPState::SYN_RECEIVED || state == TCPState::ESTABLISHED ||
+           state == TCPState::FIN_WAIT_1 || state == TCPState::FIN_WAIT_2;
+}
+
+void TCPIPStack::receive_payload(RxContext& context, TCPConnection& connection, const CoalescedSegment& segment) {
+    if (!accepts_data(connection.machine.get_state())) {
+        return;
+    }
+    
+    // A SYN occupies the first sequence number, ahead of its data
+    uint32_t sequence = segment.tcp.get_sequence_number() + (segment.has_flag(TCPSegment::SYN) ? 1 : 0);
+    // Filling a hole is acknowledged at once, like anything out of order
+    bool in_order = connection.receive.get_out_of_order().empty();
+    for (std::span<const uint8_t> payload : segment.get_payloads()) {
+        size_t readable = connection.receive.get_readable();
+        ReceiveOutcome outcome = connection.receive.receive(sequence, payload);
+        switch (outcome) {
+        case ReceiveOutcome::IN_ORDER:
+            context.metrics.add(Metric::TCP_BYTES_RECEIVED, connection.receive.get_readable() - readable);
+            break;
+        case ReceiveOutcome::OUT_OF_ORDER:
+            context.metrics.add(Metric::TCP_OUT_OF_ORDER);
+            break;
+        case ReceiveOutcome::DUPLICATE:
+            context.metrics.add(Metric::TCP_DUPLICATE);
+            break;
+        case ReceiveOutcome::OUT_OF_WINDOW:
+        case ReceiveOutcome::NO_ROOM:
+            context.metrics.add(Metric::TCP_OUT_OF_WINDOW);
+            break;
+        }
+        in_order = in_order && outcome == ReceiveOutcome::IN_ORDER;
+        sequence += static_cast<uint32_t>(payload.size());
+    }
     
-    // Here you would:
-    // 1. Parse as Ethernet frame
-    // 2. Check EtherType and process accordingly
-    // 3. Handle IP packets, TCP segments, etc.
+    if (connection.socket == 0) {
+        // Nothing reads it, so in-order data is discarded once counted
+        // rather than closing the window
+        connection.receive.consume(connection.receive.get_readable());
+    } else {
+        notify(connection);
+    }
+    if (!connection.endpoint) {
+        return;
+    }
+    
+    // RFC 5681 section 4.2: an ACK for at least every second full-sized
+    // segment, at once for anything out of order, and otherwise within
+    // delayed_ack_ns, unless data going back carries it first
+    uint32_t mss = std::min(config_.sender.mss, pool_mss(pool_.get_config()));
+    uint32_t unacknowledged = connection.receive.get_rcv_nxt() - connection.ack_sent;
+    Timer& delayed = connection.timer(TCPTimer::DELAYED_ACK);
+    if (!in_order || unacknowledged >= 2 * mss || config_.delayed_ack_ns == 0) {
+        connection.ack_pending = true;
+    } else if (!delayed.is_armed()) {
+        context.timers.arm(delayed, context.now_ns + config_.delayed_ack_ns);
+    }
+}
+
+static std::array<uint8_t, 4> address_bytes(uint32_t address) {
+    return {static_cast<uint8_t>(address >> 24), static_cast<uint8_t>(address >> 16),
+            static_cast<uint8_t>(address >> 8), static_cast<uint8_t>(address)};
+}
+
+// The smallest shift that lets the whole receive buffer be advertised
+static uint8_t window_scale_for(size_t buffer_size) {
+    uint8_t scale = 0;
+    while (scale < TCPOptions::MAX_WINDOW_SCALE && (buffer_size >> scale) > 65535) {
+        scale++;
+    }
+    return scale;
+}
+
+// SND.NXT for segments that carry no data
+static uint32_t next_sequence(const TCPConnection& connection) {
+    if (connection.fin_sent) {
+        return connection.fin_sequence + 1;
+    }
+    return connection.sender != nullptr ? connection.sender->get_snd_nxt() : connection.iss + 1;
+}
+
+// Our TSval clock, the sender's: milliseconds offset by the ISS
+static uint32_t timestamp_now(const TCPConnection& connection, uint64_t now_ns) {
+    return static_cast<uint32_t>(now_ns / 1'000'000) + connection.iss;
+}
+
+bool TCPIPStack::sockets_usable() const {
+    return !running_ && workers_.empty();
+}
+
+bool TCPIPStack::open() {
+    if (running_) {
+        return false;
+    }
+    if (device_ != &pcap_) {
+        return device_->is_open();
+    }
+    return !pcap_.is_open() && pcap_.open_live(interface_, config_.pcap);
+}
+
+size_t TCPIPStack::poll() {
+    if (!sockets_usable()) {
+        return 0;
+    }
+    // What the application sent since the last turn goes out before waiting
+    flush_tx();
+    size_t count = 0;
+    if (device_->is_open()) {
+        if (poll_burst_.empty()) {
+            poll_burst_.resize(std::max<size_t>(1, config_.rx_burst_size));
+            poll_items_.resize(poll_burst_.size());
+        }
+        count = device_->rx_burst(pool_, poll_burst_.data(), poll_burst_.size());
+        for (size_t i = 0; i < count; ++i) {
+            poll_items_[i].frame = poll_burst_[i].span();
+            poll_items_[i].buffer = std::move(poll_burst_[i]);
+        }
+        if (count > 0) {
+            deliver_burst(std::span<RxItem>(poll_items_.data(), count), false);
+        }
+    }
+    count += deliver_loopback();
+    run_timers(*receive_context_);
+    flush_tx();
+    return count;
+}
+
+// Frames sent while these are processed wait for the next poll(), so a
+// busy loopback connection cannot keep one poll() from returning
+size_t TCPIPStack::deliver_loopback() {
+    RxContext& context = *receive_context_;
+    if (context.loopback.empty()) {
+        return 0;
+    }
+    poll_loopback_.swap(context.loopback);
+    size_t burst = std::max<size_t>(1, config_.rx_burst_size);
+    if (poll_items_.size() < burst) {
+        poll_items_.resize(burst);
+    }
+    for (size_t first = 0; first < poll_loopback_.size(); first += burst) {
+        size_t count = std::min(burst, poll_loopback_.size() - first);
+        for (size_t i = 0; i < count; ++i) {
+            poll_items_[i].frame = poll_loopback_[first + i].span();
+            poll_items_[i].buffer = std::move(poll_loopback_[first + i]);
+        }
+        deliver_burst(std::span<RxItem>(poll_items_.data(), count), false);
+    }
+    size_t delivered = poll_loopback_.size();
+    poll_loopback_.clear();
+    return delivered;
+}
+
+SocketId TCPIPStack::listen_socket(uint16_t port, size_t backlog) {
+    if (!sockets_usable() || listening_ports_.test(port)) {
+        return 0;
+    }
+    if (listeners_.empty()) {
+        listeners_.resize(65536);
+    }
+    if (listeners_[port] != 0) {
+        return 0;
+    }
+    SocketId id = sockets_.allocate(SocketKind::LISTENER);
+    uint32_t index = SocketTable::index_of(id);
+    SocketSlot& slot = sockets_.at(index);
+    slot.accepted = true;
+    slot.port = port;
+    slot.backlog = std::max<size_t>(1, backlog);
+    listeners_[port] = index + 1;
+    return id;
+}
+
+SocketId TCPIPStack::accept(SocketId listener) {
+    SocketSlot* slot = sockets_usable() ? sockets_.get(listener, SocketKind::LISTENER) : nullptr;
+    if (slot == nullptr || slot->accept_queue.empty()) {
+        return 0;
+    }
+    SocketId id = slot->accept_queue.front();
+    slot->accept_queue.pop_front();
+    sockets_.at(SocketTable::index_of(id)).accepted = true;
+    return id;
+}
+
+SocketId TCPIPStack::connect(uint32_t address, uint16_t port) {
+    if (!sockets_usable() || config_.address == 0) {
+        return 0;
+    }
+    RxContext& context = *receive_context_;
+    context.now_ns = clock_();
+    
+    FlowKey key{config_.address, address, 0, port};
+    bool found = false;
+    for (uint32_t tries = 0; tries < 65536u - EPHEMERAL_FIRST && !found; ++tries) {
+        key.local_port = next_ephemeral_port_;
+        next_ephemeral_port_ = next_ephemeral_port_ == 65535 ? EPHEMERAL_FIRST : next_ephemeral_port_ + 1;
+        found = context.connections.find(key) == nullptr;
+    }
+    if (!found) {
+        return 0;
+    }
+    
+    TCPConnection* connection = open_connection(context, key);
+    SocketId id = sockets_.allocate(SocketKind::STREAM);
+    uint32_t index = SocketTable::index_of(id);
+    sockets_.at(index).accepted = true;
+    sockets_.at(index).connection = connection;
+    connection->endpoint = true;
+    connection->socket = index + 1;
+    connection->peer_mac = config_.gateway_mac;
+    connection->machine.send_syn();
+    send_control(context, *connection, TCPSegment::SYN);
+    return id;
+}
+
+IoResult TCPIPStack::send(SocketId socket, std::span<const uint8_t> data) {
+    SocketSlot* slot = sockets_usable() ? sockets_.get(socket, SocketKind::STREAM) : nullptr;
+    if (slot == nullptr) {
+        return {0, SocketError::INVALID};
+    }
+    TCPConnection* connection = slot->connection;
+    if (connection == nullptr) {
+        return {0, slot->error == SocketError::NONE ? SocketError::CLOSED : slot->error};
+    }
+    TCPState state = connection->machine.get_state();
+    if (state == TCPState::SYN_SENT || state == TCPState::SYN_RECEIVED) {
+        return {0, SocketError::WOULD_BLOCK};
+    }
+    if (!can_send_data(state) || connection->fin_queued) {
+        return {0, SocketError::CLOSED};
+    }
+    size_t written = connection->sender->write(data);
+    if (written == 0) {
+        return {0, SocketError::WOULD_BLOCK};
+    }
+    RxContext& context = *receive_context_;
+    context.now_ns = clock_();
+    output(context, *connection);
+    return {written, SocketError::NONE};
+}
+
+IoResult TCPIPStack::recv(SocketId socket, std::span<uint8_t> data) {
+    SocketSlot* slot = sockets_usable() ? sockets_.get(socket, SocketKind::STREAM) : nullptr;
+    if (slot == nullptr) {
+        return {0, SocketError::INVALID};
+    }
+    TCPConnection* connection = slot->connection;
+    if (connection == nullptr) {
+        // NONE: the end of the stream
+        return {0, slot->error};
+    }
+    if (!connection->receive.is_open()) {
+        return {0, SocketError::WOULD_BLOCK};
+    }
+    size_t read = connection->receive.read(data);
+    if (read > 0) {
+        // Tell the peer once the window has opened by two segments or half
+        // the buffer, not on every read (RFC 9293 3.8.6.2.2)
+        TCPReceiveBuffer& receive = connection->receive;
+        size_t threshold = std::min(receive.get_capacity() / 2, size_t{2} * connection->peer_mss);
+        if (receive.get_window() >= connection->advertised_window + threshold) {
+            RxContext& context = *receive_context_;
+            context.now_ns = clock_();
+            connection->ack_pending = true;
+            output(context, *connection);
+        }
+        return {read, SocketError::NONE};
+    }
+    if (peer_closed(connection->machine.get_state())) {
+        return {0, SocketError::NONE};
+    }
+    return {0, SocketError::WOULD_BLOCK};
+}
+
+bool TCPIPStack::close(SocketId socket) {
+    if (!sockets_usable()) {
+        return false;
+    }
+    RxContext& context = *receive_context_;
+    context.now_ns = clock_();
+    
+    if (SocketSlot* listener = sockets_.get(socket, SocketKind::LISTENER)) {
+        listeners_[listener->port] = 0;
+        std::deque<SocketId> queued = std::move(listener->accept_queue);
+        for (SocketId id : queued) {
+            TCPConnection* connection = sockets_.at(SocketTable::index_of(id)).connection;
+            if (connection != nullptr) {
+                abort_connection(context, *connection, SocketError::RESET);
+            }
+        }
+        sockets_.free(SocketTable::index_of(socket));
+        return true;
+    }
+    
+    SocketSlot* slot = sockets_.get(socket, SocketKind::STREAM);
+    if (slot == nullptr) {
+        return false;
+    }
+    TCPConnection* connection = slot->connection;
+    sockets_.free(SocketTable::index_of(socket));
+    if (connection == nullptr) {
+        return true;
+    }
+    connection->socket = 0;
+    if (connection->machine.get_state() == TCPState::SYN_SENT) {
+        connection->machine.close();
+        close_connection(context, *connection);
+        return true;
+    }
+    // Unread data is dropped, and whatever arrives from here on
+    connection->receive.consume(connection->receive.get_readable());
+    connection->fin_queued = true;
+    output(context, *connection);
+    return true;
+}
+
+bool TCPIPStack::get_flow(SocketId socket, FlowKey& key) const {
+    const SocketSlot* slot = sockets_.get(socket, SocketKind::STREAM);
+    if (slot == nullptr || slot->connection == nullptr) {
+        return false;
+    }
+    key = slot->connection->key;
+    return true;
+}
+
+SocketError TCPIPStack::get_error(SocketId socket) const {
+    const SocketSlot* slot = sockets_.get(socket, SocketKind::STREAM);
+    return slot != nullptr ? slot->error : SocketError::INVALID;
+}
+
+uint32_t TCPIPStack::get_events(SocketId socket) const {
+    const SocketSlot* slot = sockets_.get(socket, SocketKind::STREAM);
+    if (slot == nullptr) {
+        slot = sockets_.get(socket, SocketKind::LISTENER);
+    }
+    return slot != nullptr ? readiness(*slot) : 0;
+}
+
+bool TCPIPStack::watch(SocketId socket, uint32_t events, uint64_t data) {
+    SocketSlot* slot = sockets_usable() ? sockets_.get(socket, SocketKind::STREAM) : nullptr;
+    if (slot == nullptr && sockets_usable()) {
+        slot = sockets_.get(socket, SocketKind::LISTENER);
+    }
+    if (slot == nullptr) {
+        return false;
+    }
+    slot->interest = events;
+    slot->data = data;
+    sockets_.notify(SocketTable::index_of(socket));
+    return true;
+}
+
+size_t TCPIPStack::wait_events(std::span<SocketEvent> events) {
+    if (!sockets_usable()) {
+        return 0;
+    }
+    return sockets_.collect(events, [this](const SocketSlot& slot) { return readiness(slot); });
+}
+
+uint32_t TCPIPStack::readiness(const SocketSlot& slot) const {
+    if (slot.kind == SocketKind::LISTENER) {
+        return slot.accept_queue.empty() ? 0 : SocketEvent::READABLE;
+    }
+    const TCPConnection* connection = slot.connection;
+    if (connection == nullptr) {
+        return SocketEvent::READABLE | SocketEvent::CLOSED;
+    }
+    TCPState state = connection->machine.get_state();
+    uint32_t events = 0;
+    if (connection->receive.is_open() && connection->receive.get_readable() > 0) {
+        events |= SocketEvent::READABLE;
+    }
+    if (peer_closed(state)) {
+        events |= SocketEvent::READABLE | SocketEvent::CLOSED;
+    }
+    if (can_send_data(state) && !connection->fin_queued && connection->sender->get_writable() > 0) {
+        events |= SocketEvent::WRITABLE;
+    }
+    return events;
+}
+
+void TCPIPStack::notify(const TCPConnection& connection) {
+    if (connection.socket != 0) {
+        sockets_.notify(connection.socket - 1);
+    }
+}
+
+TCPConnection* TCPIPStack::open_connection(RxContext& context, const FlowKey& key) {
+    TCPConnection* connection = context.connections.emplace(key).first;
+    connection->key = key;
+    for (size_t i = 0; i < connection->timers.size(); ++i) {
+        connection->timers[i].owner = connection;
+        connection->timers[i].kind = static_cast<uint32_t>(i);
+    }
+    // RFC 6528: a 4 us clock plus a keyed hash of the 4-tuple
+    FlowKey keyed = key;
+    keyed.local_address ^= static_cast<uint32_t>(iss_secret_);
+    keyed.remote_address ^= static_cast<uint32_t>(iss_secret_ >> 32);
+    connection->iss = static_cast<uint32_t>(context.now_ns / 4000) + static_cast<uint32_t>(hash_flow_key(keyed));
+    context.metrics.add(Metric::TCP_CONNECTIONS_OPENED);
+    TRACE(TraceEvent::CONNECTION_OPENED, hash_flow_key(key));
+    return connection;
+}
+
+void TCPIPStack::start_sender(TCPConnection& connection) {
+    SenderConfig sender = config_.sender;
+    sender.mss = std::min({sender.mss, uint32_t{connection.peer_mss}, pool_mss(pool_.get_config())});
+    sender.sack = connection.sack_permitted;
+    sender.timestamps = connection.timestamps;
+    connection.sender = std::make_unique<TCPSender>(connection.iss, sender);
+    connection.window_scale = connection.window_scaling ? window_scale_for(config_.receive_buffer_size) : 0;
+}
+
+void TCPIPStack::process_ack(RxContext& context, TCPConnection& connection, const CoalescedSegment& segment,
+                             const TCPOptions& options) {
+    TCPSender& sender = *connection.sender;
+    uint32_t ack = segment.tcp.get_ack_number();
+    // The sender knows nothing of our FIN's sequence number
+    if (connection.fin_sent && ack == connection.fin_sequence + 1) {
+        ack = connection.fin_sequence;
+    }
+    // The window on a SYN is never scaled (RFC 7323 2.2)
+    uint8_t scale = connection.window_scaling && !segment.has_flag(TCPSegment::SYN) ? connection.peer_window_scale : 0;
+    size_t writable = sender.get_writable();
+    sender.on_ack(ack, uint32_t{segment.window} << scale, segment.payload_length > 0, context.now_ns,
+                  context.segments, options);
+    send_segments(context, connection);
+    if (sender.get_writable() > writable) {
+        notify(connection);
+    }
+}
+
+// A connection reached ESTABLISHED. False if it has nowhere to go: its
+// listener closed during the handshake.
+bool TCPIPStack::establish(TCPConnection& connection) {
+    if (connection.socket == 0) {
+        return true;
+    }
+    uint32_t index = connection.socket - 1;
+    if (sockets_.at(index).accepted) {
+        notify(connection);
+        return true;
+    }
+    uint32_t listener = listeners_.empty() ? 0 : listeners_[connection.key.local_port];
+    if (listener == 0) {
+        return false;
+    }
+    // A listener opened since the SYN arrived never counted this one
+    SocketSlot& owner = sockets_.at(listener - 1);
+    if (owner.handshaking > 0) {
+        owner.handshaking--;
+    }
+    owner.accept_queue.push_back(sockets_.id_of(index));
+    sockets_.notify(listener - 1);
+    return true;
+}
+
+void TCPIPStack::queue_output(RxContext& context, TCPConnection& connection) {
+    if (!connection.in_output) {
+        connection.in_output = true;
+        context.output.push_back(&connection);
+    }
+}
+
+void TCPIPStack::flush_output(RxContext& context) {
+    for (TCPConnection* connection : context.output) {
+        connection->in_output = false;
+        output(context, *connection);
+    }
+    context.output.clear();
+}
+
+// Sends what the window allows, the FIN once the data before it is out,
+// and an ACK if nothing else carried one
+void TCPIPStack::output(RxContext& context, TCPConnection& connection) {
+    TCPSender* sender = connection.sender.get();
+    if (sender == nullptr) {
+        return;
+    }
+    // After our FIN no new data is written, but data before it may need
+    // sending again after a timeout
+    TCPState state = connection.machine.get_state();
+    sender->send(connection.fin_sent ? TCPState::ESTABLISHED : state, context.now_ns, context.segments);
+    
+    if (connection.fin_queued && !connection.fin_sent && can_send_data(state) &&
+        sender->get_flight() == sender->get_buffered()) {
+        connection.fin_sequence = sender->get_snd_nxt();
+        connection.fin_sent = true;
+        connection.machine.send_fin();
+        send_control(context, connection, TCPSegment::FIN | TCPSegment::ACK);
+    }
+    if (connection.ack_pending && context.segments.empty()) {
+        context.segments.emplace_back();
+        context.segments.back().set_sequence_number(next_sequence(connection));
+        context.segments.back().set_flags(TCPSegment::ACK);
+    }
+    send_segments(context, connection);
+    arm_retransmit(context, connection);
+}
+
+// SYN, SYN-ACK, FIN or RST, which the sender does not produce. A SYN or
+// FIN is timed here and sent again from on_retransmit_timer().
+void TCPIPStack::send_control(RxContext& context, TCPConnection& connection, uint8_t flags) {
+    TCPSegment segment;
+    segment.set_flags(flags);
+    if (flags & TCPSegment::SYN) {
+        segment.set_sequence_number(connection.iss);
+        // A SYN offers everything; a SYN-ACK agrees to what the peer offered
+        bool answer = (flags & TCPSegment::ACK) != 0;
+        TCPOptions options;
+        options.mss = static_cast<uint16_t>(std::min(config_.sender.mss, pool_mss(pool_.get_config())));
+        if (!answer || connection.window_scaling) {
+            options.has_window_scale = true;
+            options.window_scale = window_scale_for(config_.receive_buffer_size);
+        }
+        options.sack_permitted = !answer || connection.sack_permitted;
+        if (!answer || connection.timestamps) {
+            options.has_timestamps = true;
+            options.ts_value = timestamp_now(connection, context.now_ns);
+            options.ts_echo = answer ? connection.ts_recent : 0;
+        }
+        segment.set_options(options);
+    } else if (flags & TCPSegment::FIN) {
+        segment.set_sequence_number(connection.fin_sequence);
+    } else {
+        segment.set_sequence_number(next_sequence(connection));
+    }
+    context.segments.push_back(std::move(segment));
+    
+    if (flags & (TCPSegment::SYN | TCPSegment::FIN)) {
+        uint64_t rto = connection.sender != nullptr && (flags & TCPSegment::FIN) ? connection.sender->get_rtt().get_rto_ns()
+                                                                                : config_.sender.initial_rto_ns;
+        rto = std::min(rto << connection.retries, config_.sender.max_rto_ns);
+        connection.control_deadline_ns = context.now_ns + rto;
+    }
+    send_segments(context, connection);
+    arm_retransmit(context, connection);
+}
+
+// Fills in what the sender leaves to the connection (ports, ACK, window,
+// timestamps, SACK blocks on pure ACKs) and sends context.segments
+void TCPIPStack::send_segments(RxContext& context, TCPConnection& connection) {
+    if (context.segments.empty()) {
+        return;
+    }
+    TCPState state = connection.machine.get_state();
+    uint32_t ack = connection.receive.get_rcv_nxt() + (peer_closed(state) ? 1 : 0);
+    size_t window = connection.receive.is_open() ? connection.receive.get_window() : config_.receive_buffer_size;
+    
+    for (TCPSegment& segment : context.segments) {
+        uint8_t flags = segment.get_header().flags;
+        segment.set_source_port(connection.key.local_port);
+        segment.set_dest_port(connection.key.remote_port);
+        if (flags & TCPSegment::ACK) {
+            segment.set_ack_number(ack);
+        }
+        uint8_t scale = (flags & TCPSegment::SYN) ? 0 : connection.window_scale;
+        uint16_t advertised = static_cast<uint16_t>(std::min<size_t>(window >> scale, 65535));
+        segment.set_window_size(advertised);
+        connection.advertised_window = static_cast<uint32_t>(advertised) << scale;
+        
+        if (!(flags & TCPSegment::SYN) && segment.get_option_bytes().empty()) {
+            TCPOptions options;
+            if (connection.timestamps) {
+                options.has_timestamps = true;
+                options.ts_value = timestamp_now(connection, context.now_ns);
+                options.ts_echo = connection.ts_recent;
+            }
+            if (connection.sack_permitted && segment.get_payload().empty() && connection.receive.is_open()) {
+                options.set_sack_blocks(connection.receive.get_out_of_order(), connection.receive.get_rcv_nxt());
+            }
+            if (options.has_timestamps || options.sack_count > 0) {
+                segment.set_options(options);
+            }
+        }
+        send_frame(context, connection, segment);
+    }
+    context.segments.clear();
+    connection.ack_pending = false;
+    connection.ack_sent = ack;
+    context.timers.cancel(connection.timer(TCPTimer::DELAYED_ACK));
+}
+
+void TCPIPStack::send_frame(RxContext& context, TCPConnection& connection, const TCPSegment& segment) {
+    // A segment not sent is lost to the peer too: counted here, it is sent
+    // again when its retransmission timer runs out
+    PacketHandle buffer = pool_.alloc();
+    if (!buffer) {
+        context.metrics.add(Metric::TX_NO_BUFFER);
+        return;
+    }
+    const std::vector<uint8_t>& payload = segment.get_payload();
+    uint8_t* data = buffer.append(payload.size());
+    if (data == nullptr) {
+        context.metrics.add(Metric::TX_OVERSIZE);
+        return;
+    }
+    uint32_t sum = checksum_partial_copy(data, payload);
+    
+    std::array<uint8_t, 4> source = address_bytes(connection.key.local_address);
+    std::array<uint8_t, 4> destination = address_bytes(connection.key.remote_address);
+    IPv4Packet packet;
+    packet.set_protocol(IPv4Packet::PROTOCOL_TCP);
+    packet.set_ttl(64);
+    packet.set_identification(context.ip_identification++);
+    packet.set_source_ip(source);
+    packet.set_destination_ip(destination);
+    EthernetFrame frame;
+    frame.set_source_mac(config_.mac);
+    frame.set_destination_mac(connection.peer_mac);
+    frame.set_ethertype(EthernetFrame::ETHERTYPE_IPV4);
+    if (!segment.prepend_to(buffer, source, destination, sum) || !packet.prepend_to(buffer) ||
+        !frame.prepend_to(buffer)) {
+        context.metrics.add(Metric::TX_OVERSIZE);
+        return;
+    }
+    context.metrics.add(Metric::TCP_SEGMENTS_SENT);
+    if (connection.key.remote_address == connection.key.local_address) {
+        context.loopback.push_back(std::move(buffer));
+    } else {
+        transmit(std::move(buffer));
+    }
+}
+
+// One timer covers the sender's RTO and the SYN or FIN retransmission
+void TCPIPStack::arm_retransmit(RxContext& context, TCPConnection& connection) {
+    uint64_t deadline = connection.control_deadline_ns;
+    if (connection.sender != nullptr) {
+        deadline = std::min(deadline, connection.sender->get_retransmit_deadline());
+    }
+    Timer& timer = connection.timer(TCPTimer::RETRANSMIT);
+    if (deadline == UINT64_MAX) {
+        context.timers.cancel(timer);
+    } else {
+        context.timers.arm(timer, deadline);
+    }
+}
+
+void TCPIPStack::on_retransmit_timer(RxContext& context, TCPConnection& connection) {
+    context.metrics.add(Metric::TCP_RETRANSMIT_TIMEOUTS);
+    TCPSender* sender = connection.sender.get();
+    if (sender != nullptr && sender->get_retransmit_deadline() <= context.now_ns) {
+        if (sender->get_backoffs() >= config_.data_retries) {
+            abort_connection(context, connection, SocketError::TIMED_OUT);
+            return;
+        }
+        sender->on_retransmit_timeout(context.now_ns, context.segments);
+        send_segments(context, connection);
+    }
+    if (connection.control_deadline_ns <= context.now_ns) {
+        if (connection.retries >= config_.syn_retries) {
+            abort_connection(context, connection, SocketError::TIMED_OUT);
+            return;
+        }
+        connection.retries++;
+        switch (connection.machine.get_state()) {
+        case TCPState::SYN_SENT:
+            send_control(context, connection, TCPSegment::SYN);
+            break;
+        case TCPState::SYN_RECEIVED:
+            send_control(context, connection, TCPSegment::SYN | TCPSegment::ACK);
+            break;
+        default:
+            if (connection.fin_sent) {
+                send_control(context, connection, TCPSegment::FIN | TCPSegment::ACK);
+            } else {
+                connection.control_deadline_ns = UINT64_MAX;
+            }
+            break;
+        }
+    }
+    arm_retransmit(context, connection);
+}
+
+// Resets the connection, unless our SYN is all the peer has seen, and
+// closes it; connection is gone after
+void TCPIPStack::abort_connection(RxContext& context, TCPConnection& connection, SocketError reason) {
+    if (connection.machine.get_state() != TCPState::SYN_SENT) {
+        send_control(context, connection, TCPSegment::RST | TCPSegment::ACK);
+    }
+    close_connection(context, connection, reason);
 }
@@ -0,0 +1,123 @@
+#include "tcp/congestion_control.h"
+#include <algorithm>
+#include <cmath>
+
+// Initial window, RFC 6928
+static uint32_t initial_window(uint32_t mss) {
+    return std::min(10 * mss, std::max(2 * mss, 14600u));
+}
+
+CongestionControl::CongestionControl(uint32_t mss)
+    : mss_(std::max<uint32_t>(mss, 1)), cwnd_(initial_window(mss_)) {}
+
+void CongestionControl::on_recovery_exit(uint64_t) {
+    cwnd_ = ssthresh_;
+}
+
+uint32_t CongestionControl::slow_start(uint32_t acked) {
+    uint32_t increase = std::min(acked, mss_);
+    if (cwnd_ + increase < ssthresh_) {
+        cwnd_ += increase;
+        return 0;
+    }
+    uint32_t left = increase - (ssthresh_ - cwnd_);
+    cwnd_ = ssthresh_;
+    return left;
+}
+
+uint32_t CongestionControl::half_flight(uint32_t flight) const {
+    return std::max(flight / 2, 2 * mss_);
+}
+
+void NewRenoCongestionControl::on_ack(uint32_t acked, uint64_t, uint64_t) {
+    if (in_slow_start()) {
+        acked = slow_start(acked);
+    }
+    bytes_acked_ += acked;
+    if (bytes_acked_ >= cwnd_) {
+        bytes_acked_ -= cwnd_;
+        cwnd_ += mss_;
+    }
+}
+
+void NewRenoCongestionControl::on_fast_retransmit(uint32_t flight, uint64_t) {
+    ssthresh_ = half_flight(flight);
+    cwnd_ = ssthresh_;
+    bytes_acked_ = 0;
+}
+
+void NewRenoCongestionControl::on_timeout(uint32_t flight, uint64_t) {
+    ssthresh_ = half_flight(flight);
+    cwnd_ = mss_;
+    bytes_acked_ = 0;
+}
+
+void CubicCongestionControl::on_ack(uint32_t acked, uint64_t rtt_ns, uint64_t now_ns) {
+    if (in_slow_start()) {
+        acked = slow_start(acked);
+        if (acked == 0) {
+            return;
+        }
+    }
+
+    if (epoch_start_ns_ == 0) {
+        epoch_start_ns_ = std::max<uint64_t>(now_ns, 1);
+        cwnd_segments_ = static_cast<double>(cwnd_) / mss_;
+        if (cwnd_segments_ < w_max_) {
+            k_ = std::cbrt((w_max_ - cwnd_segments_) / C);
+        } else {
+            // Past the old limit (or there was none): probe from here
+            k_ = 0;
+            w_max_ = cwnd_segments_;
+        }
+        w_est_ = cwnd_segments_;
+    }
+
+    // Where the cubic curve will be one RTT from now, bounded to at most
+    // 1.5x growth per RTT
+    double t = static_cast<double>(now_ns - epoch_start_ns_ + rtt_ns) / 1e9;
+    double target = C * std::pow(t - k_, 3) + w_max_;
+    target = std::clamp(target, cwnd_segments_, 1.5 * cwnd_segments_);
+
+    double segments = static_cast<double>(acked) / mss_;
+    constexpr double ALPHA = 3 * (1 - BETA) / (1 + BETA);
+    w_est_ += ALPHA * segments / cwnd_segments_;
+
+    if (target < w_est_) {
+        cwnd_segments_ = std::max(cwnd_segments_, w_est_);
+    } else {
+        cwnd_segments_ += (target - cwnd_segments_) / cwnd_segments_ * segments;
+    }
+    cwnd_ = static_cast<uint32_t>(std::min(cwnd_segments_ * mss_, static_cast<double>(UINT32_MAX / 2)));
+    cwnd_ = std::max(cwnd_, mss_);
+}
+
+void CubicCongestionControl::reduce(uint32_t flight) {
+    double segments = static_cast<double>(cwnd_) / mss_;
+    // Fast convergence: losing below the last maximum means another flow
+    // wants the bandwidth, so give some of it up
+    w_max_ = segments < w_last_max_ ? segments * (1 + BETA) / 2 : segments;
+    w_last_max_ = segments;
+    ssthresh_ = std::max(static_cast<uint32_t>(flight * BETA), 2 * mss_);
+    epoch_start_ns_ = 0;
+}
+
+void CubicCongestionControl::on_fast_retransmit(uint32_t flight, uint64_t) {
+    reduce(flight);
+    cwnd_ = ssthresh_;
+}
+
+void CubicCongestionControl::on_timeout(uint32_t flight, uint64_t) {
+    reduce(flight);
+    cwnd_ = mss_;
+}
+
+std::unique_ptr<CongestionControl> make_congestion_control(CongestionAlgorithm algorithm, uint32_t mss) {
+    switch (algorithm) {
+        case CongestionAlgorithm::NEW_RENO:
+            return std::make_unique<NewRenoCongestionControl>(mss);
+        case CongestionAlgorithm::CUBIC:
+            return std::make_unique<CubicCongestionControl>(mss);
+    }
+    return nullptr;
+}
@@ -0,0 +1,69 @@
+#include "tcp/tcp_coalescer.h"
+#include "tcp/tcp_segment.h"
+#include <algorithm>
+#include <cstring>
+
+TCPCoalescer::TCPCoalescer(const GroConfig& config) : config_(config) {
+    config_.max_segments = std::clamp<size_t>(config_.max_segments, 1, CoalescedSegment::MAX_SEGMENTS);
+}
+
+FlowKey TCPCoalescer::flow_key(const IPv4View& ip, const TCPView& tcp) {
+    return {ip.get_destination_address(), ip.get_source_address(), tcp.get_dest_port(), tcp.get_source_port()};
+}
+
+bool TCPCoalescer::is_candidate(const TCPView& tcp) {
+    uint8_t flags = tcp.get_flags();
+    return (flags & ~TCPSegment::PSH) == TCPSegment::ACK && !tcp.get_payload().empty();
+}
+
+void TCPCoalescer::start(CoalescedSegment& segment, const IPv4View& ip, const TCPView& tcp) {
+    segment.ip = ip;
+    segment.tcp = tcp;
+    segment.flags = tcp.get_flags();
+    segment.window = tcp.get_window_size();
+    segment.payloads[0] = tcp.get_payload();
+    segment.payload_length = segment.payloads[0].size();
+    segment.count = 1;
+}
+
+size_t TCPCoalescer::find(const FlowKey& key) const {
+    for (size_t i = 0; i < held_count_; ++i) {
+        if (keys_[i] == key) {
+            return i;
+        }
+    }
+    return held_count_;
+}
+
+bool TCPCoalescer::can_append(const CoalescedSegment& held, const IPv4View& ip, const TCPView& tcp) const {
+    std::span<const uint8_t> options = tcp.get_options();
+    std::span<const uint8_t> held_options = held.tcp.get_options();
+    return is_candidate(tcp) &&
+           tcp.get_sequence_number() == held.get_end_sequence() &&
+           held.payload_length + tcp.get_payload().size() <= config_.max_bytes &&
+           tcp.get_ack_number() == held.tcp.get_ack_number() &&
+           ip.get_ttl() == held.ip.get_ttl() &&
+           ip.get_dscp_ecn() == held.ip.get_dscp_ecn() &&
+           options.size() == held_options.size() &&
+           std::memcmp(options.data(), held_options.data(), options.size()) == 0;
+}
+
+void TCPCoalescer::append(CoalescedSegment& held, const TCPView& tcp) {
+    held.flags = tcp.get_flags();
+    held.window = tcp.get_window_size();
+    held.payloads[held.count++] = tcp.get_payload();
+    held.payload_length += tcp.get_payload().size();
+}
+
+bool TCPCoalescer::is_full(const CoalescedSegment& held) const {
+    return held.count >= config_.max_segments || held.payload_length >= config_.max_bytes ||
+           held.has_flag(TCPSegment::PSH);
+}
+
+void TCPCoalescer::release(size_t slot) {
+    held_count_--;
+    if (slot != held_count_) {
+        held_[slot] = held_[held_count_];
+        keys_[slot] = keys_[held_count_];
+    }
+}
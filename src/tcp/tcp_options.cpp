@@ -0,0 +1,146 @@
+#include "tcp/tcp_options.h"
+#include "util/byte_order.h"
+#include <algorithm>
+
+void TCPOptions::set_sack_blocks(std::span<const SequenceRange> ranges, uint32_t most_recent) {
+    sack_count = 0;
+    size_t first = ranges.size();
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        if (seq_le(ranges[i].start, most_recent) && seq_lt(most_recent, ranges[i].end)) {
+            sack_blocks[sack_count++] = ranges[i];
+            first = i;
+            break;
+        }
+    }
+    for (size_t i = 0; i < ranges.size() && sack_count < MAX_SACK_BLOCKS; ++i) {
+        if (i != first) {
+            sack_blocks[sack_count++] = ranges[i];
+        }
+    }
+}
+
+static void parse_timestamps(const uint8_t* value, TCPOptions& options) {
+    options.has_timestamps = true;
+    options.ts_value = read_be32(value);
+    options.ts_echo = read_be32(value + 4);
+}
+
+bool parse_tcp_options(std::span<const uint8_t> data, TCPOptions& options) {
+    options = TCPOptions{};
+    const uint8_t* bytes = data.data();
+
+    // NOP NOP TIMESTAMPS: nearly every segment of an established Linux flow
+    if (data.size() == TCPOptions::TIMESTAMPS_SIZE && read_be32(bytes) == 0x0101080A) {
+        parse_timestamps(bytes + 4, options);
+        return true;
+    }
+    // MSS, SACK-OK + TIMESTAMPS, NOP + WSCALE: a Linux SYN or SYN-ACK
+    if (data.size() == 20 && read_be16(bytes) == 0x0204 && read_be32(bytes + 4) == 0x0402080A &&
+        read_be32(bytes + 16) >> 8 == 0x010303) {
+        options.mss = read_be16(bytes + 2);
+        options.sack_permitted = true;
+        parse_timestamps(bytes + 8, options);
+        options.has_window_scale = true;
+        options.window_scale = std::min(bytes[19], TCPOptions::MAX_WINDOW_SCALE);
+        return true;
+    }
+
+    size_t i = 0;
+    while (i < data.size()) {
+        auto kind = static_cast<TCPOptionKind>(bytes[i]);
+        if (kind == TCPOptionKind::END) {
+            break;
+        }
+        if (kind == TCPOptionKind::NOP) {
+            i++;
+            continue;
+        }
+        if (i + 1 >= data.size()) {
+            return false;
+        }
+        size_t length = bytes[i + 1];
+        if (length < 2 || i + length > data.size()) {
+            return false;
+        }
+        const uint8_t* value = bytes + i + 2;
+
+        // A known kind with the wrong length is skipped like an unknown one
+        switch (kind) {
+            case TCPOptionKind::MSS:
+                if (length == 4) {
+                    options.mss = read_be16(value);
+                }
+                break;
+            case TCPOptionKind::WINDOW_SCALE:
+                if (length == 3) {
+                    // RFC 7323 2.3: larger shifts are treated as 14
+                    options.has_window_scale = true;
+                    options.window_scale = std::min(value[0], TCPOptions::MAX_WINDOW_SCALE);
+                }
+                break;
+            case TCPOptionKind::SACK_PERMITTED:
+                options.sack_permitted = length == 2;
+                break;
+            case TCPOptionKind::SACK:
+                if ((length - 2) % 8 == 0) {
+                    size_t count = std::min((length - 2) / 8, TCPOptions::MAX_SACK_BLOCKS);
+                    for (size_t block = 0; block < count; ++block) {
+                        options.sack_blocks[block] = {read_be32(value + block * 8),
+                                                      read_be32(value + block * 8 + 4)};
+                    }
+                    options.sack_count = static_cast<uint8_t>(count);
+                }
+                break;
+            case TCPOptionKind::TIMESTAMPS:
+                if (length == 10) {
+                    parse_timestamps(value, options);
+                }
+                break;
+            default:
+                break;
+        }
+        i += length;
+    }
+    return true;
+}
+
+size_t write_tcp_options(const TCPOptions& options, std::span<uint8_t, TCPOptions::MAX_SIZE> out) {
+    uint8_t* p = out.data();
+    size_t length = 0;
+
+    if (options.mss != 0) {
+        write_be16(p, 0x0204);
+        write_be16(p + 2, options.mss);
+        length += 4;
+    }
+    if (options.has_timestamps) {
+        // SACK-OK takes the place of the two NOPs in front of the timestamps
+        write_be32(p + length, options.sack_permitted ? 0x0402080A : 0x0101080A);
+        write_be32(p + length + 4, options.ts_value);
+        write_be32(p + length + 8, options.ts_echo);
+        length += TCPOptions::TIMESTAMPS_SIZE;
+    } else if (options.sack_permitted) {
+        write_be32(p + length, 0x01010402);
+        length += 4;
+    }
+    if (options.has_window_scale) {
+        write_be32(p + length, 0x01030300 | std::min(options.window_scale, TCPOptions::MAX_WINDOW_SCALE));
+        length += 4;
+    }
+
+    size_t room = TCPOptions::MAX_SIZE - length;
+    size_t blocks = room >= 12 ? std::min<size_t>(options.sack_count, (room - 4) / 8) : 0;
+    if (blocks > 0) {
+        p[length] = static_cast<uint8_t>(TCPOptionKind::NOP);
+        p[length + 1] = static_cast<uint8_t>(TCPOptionKind::NOP);
+        p[length + 2] = static_cast<uint8_t>(TCPOptionKind::SACK);
+        p[length + 3] = static_cast<uint8_t>(2 + blocks * 8);
+        length += 4;
+        for (size_t block = 0; block < blocks; ++block) {
+            write_be32(p + length, options.sack_blocks[block].start);
+            write_be32(p + length + 4, options.sack_blocks[block].end);
+            length += 8;
+        }
+    }
+    return length;
+}
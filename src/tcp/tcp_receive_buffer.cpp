@@ -0,0 +1,135 @@
+#include "tcp/tcp_receive_buffer.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+void TCPReceiveBuffer::open(uint32_t initial_sequence, size_t capacity) {
+    capacity_ = std::bit_ceil(std::max<size_t>(capacity, 1));
+    mask_ = capacity_ - 1;
+    storage_ = std::make_unique<uint8_t[]>(capacity_);
+    read_position_ = 0;
+    readable_ = 0;
+    rcv_nxt_ = initial_sequence;
+    range_count_ = 0;
+}
+
+ReceiveOutcome TCPReceiveBuffer::receive(uint32_t sequence, std::span<const uint8_t> payload) {
+    // Offsets from rcv_nxt; 64-bit so a negative start plus a length cannot wrap
+    int64_t start = seq_diff(sequence, rcv_nxt_);
+    int64_t end = start + static_cast<int64_t>(payload.size());
+    int64_t window = static_cast<int64_t>(get_window());
+    if (!is_open() || end <= 0) {
+        return ReceiveOutcome::DUPLICATE;
+    }
+    if (start >= window) {
+        return ReceiveOutcome::OUT_OF_WINDOW;
+    }
+
+    // Trim the already-received front and the part past the window
+    if (start < 0) {
+        payload = payload.subspan(static_cast<size_t>(-start));
+        start = 0;
+    }
+    if (end > window) {
+        payload = payload.first(static_cast<size_t>(window - start));
+        end = window;
+    }
+    SequenceRange range{rcv_nxt_ + static_cast<uint32_t>(start), rcv_nxt_ + static_cast<uint32_t>(end)};
+
+    if (start == 0) {
+        write(0, payload);
+        advance(range.end);
+        return ReceiveOutcome::IN_ORDER;
+    }
+
+    for (size_t i = 0; i < range_count_; ++i) {
+        if (seq_le(ranges_[i].start, range.start) && seq_le(range.end, ranges_[i].end)) {
+            return ReceiveOutcome::DUPLICATE;
+        }
+    }
+    if (!insert_range(range)) {
+        return ReceiveOutcome::NO_ROOM;
+    }
+    write(static_cast<size_t>(start), payload);
+    return ReceiveOutcome::OUT_OF_ORDER;
+}
+
+// Copies data to offset bytes past rcv_nxt, splitting at the end of the ring
+void TCPReceiveBuffer::write(size_t offset, std::span<const uint8_t> data) {
+    size_t position = (read_position_ + readable_ + offset) & mask_;
+    size_t first = std::min(data.size(), capacity_ - position);
+    std::memcpy(storage_.get() + position, data.data(), first);
+    std::memcpy(storage_.get(), data.data() + first, data.size() - first);
+}
+
+// Merges range with every range it overlaps or touches, keeping the array
+// sorted. False if it touches none and the array is full.
+bool TCPReceiveBuffer::insert_range(SequenceRange range) {
+    size_t first = 0;
+    while (first < range_count_ && seq_lt(ranges_[first].end, range.start)) {
+        first++;
+    }
+    size_t last = first;
+    while (last < range_count_ && seq_le(ranges_[last].start, range.end)) {
+        range.start = seq_min(range.start, ranges_[last].start);
+        range.end = seq_max(range.end, ranges_[last].end);
+        last++;
+    }
+
+    if (first == last) {
+        if (range_count_ == MAX_OUT_OF_ORDER_RANGES) {
+            return false;
+        }
+        std::move_backward(ranges_.begin() + first, ranges_.begin() + range_count_,
+                           ranges_.begin() + range_count_ + 1);
+        range_count_++;
+    } else {
+        std::move(ranges_.begin() + last, ranges_.begin() + range_count_, ranges_.begin() + first + 1);
+        range_count_ -= last - first - 1;
+    }
+    ranges_[first] = range;
+    return true;
+}
+
+// Moves rcv_nxt to end, then past every queued range the new data reaches
+void TCPReceiveBuffer::advance(uint32_t end) {
+    size_t merged = 0;
+    while (merged < range_count_ && seq_le(ranges_[merged].start, end)) {
+        end = seq_max(end, ranges_[merged].end);
+        merged++;
+    }
+    if (merged > 0) {
+        std::move(ranges_.begin() + merged, ranges_.begin() + range_count_, ranges_.begin());
+        range_count_ -= merged;
+    }
+    readable_ += end - rcv_nxt_;
+    rcv_nxt_ = end;
+}
+
+std::span<const uint8_t> TCPReceiveBuffer::peek() const {
+    if (readable_ == 0) {
+        return {};
+    }
+    return {storage_.get() + read_position_, std::min(readable_, capacity_ - read_position_)};
+}
+
+void TCPReceiveBuffer::consume(size_t length) {
+    length = std::min(length, readable_);
+    read_position_ = (read_position_ + length) & mask_;
+    readable_ -= length;
+}
+
+size_t TCPReceiveBuffer::read(std::span<uint8_t> out) {
+    size_t copied = 0;
+    while (copied < out.size()) {
+        auto chunk = peek();
+        if (chunk.empty()) {
+            break;
+        }
+        size_t length = std::min(chunk.size(), out.size() - copied);
+        std::memcpy(out.data() + copied, chunk.data(), length);
+        consume(length);
+        copied += length;
+    }
+    return copied;
+}
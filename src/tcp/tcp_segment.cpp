@@ -1,8 +1,14 @@
 #include "tcp/tcp_segment.h"
 #include "ip/checksum.h"
+#include "ip/ipv4_packet.h"
+#include "buffer/packet_pool.h"
+#include "util/byte_order.h"
+#include "core/metrics.h"
+#include "core/trace.h"
+#include <algorithm>
 #include <cstring>
-#include <iostream>
 #include <cstddef>
+#include <utility>
 
 void TCPSegment::set_source_port(uint16_t port) {
     header_.source_port = port;
@@ -32,58 +38,103 @@ void TCPSegment::set_payload(const std::vector<uint8_t>& payload) {
     payload_ = payload;
 }
 
+void TCPSegment::set_payload(std::vector<uint8_t>&& payload) {
+    payload_ = std::move(payload);
+}
+
+void TCPSegment::set_options(const TCPOptions& options) {
+    options_length_ = static_cast<uint8_t>(write_tcp_options(options, options_));
+    header_.data_offset = static_cast<uint8_t>(get_header_length() / 4);
+}
+
+void TCPSegment::rewrite_source_port(uint16_t port) {
+    header_.checksum = checksum_update16(header_.checksum, header_.source_port, port);
+    header_.source_port = port;
+}
+
+void TCPSegment::rewrite_dest_port(uint16_t port) {
+    header_.checksum = checksum_update16(header_.checksum, header_.dest_port, port);
+    header_.dest_port = port;
+}
+
+void TCPSegment::rewrite_pseudo_header_address(const std::array<uint8_t, 4>& old_ip,
+                                               const std::array<uint8_t, 4>& new_ip) {
+    header_.checksum = checksum_update32(header_.checksum, read_be32(old_ip.data()),
+                                         read_be32(new_ip.data()));
+}
+
+void TCPSegment::write_header(uint8_t* out, uint16_t checksum) const {
+    write_be16(out, header_.source_port);
+    write_be16(out + 2, header_.dest_port);
+    write_be32(out + 4, header_.sequence_number);
+    write_be32(out + 8, header_.acknowledgment_number);
+    
+    // Data Offset (in 32-bit words) and Reserved
+    out[12] = static_cast<uint8_t>(get_header_length() / 4 << 4);
+    out[13] = header_.flags;
+    
+    write_be16(out + 14, header_.window_size);
+    write_be16(out + 16, checksum);
+    write_be16(out + 18, header_.urgent_pointer);
+    std::memcpy(out + HEADER_SIZE, options_.data(), options_length_);
+}
+
 std::vector<uint8_t> TCPSegment::serialize() const {
-    std::vector<uint8_t> segment;
-    size_t header_size = 20; // TCP header without options
-    segment.reserve(header_size + payload_.size());
-    
-    // Source Port
-    segment.push_back(static_cast<uint8_t>((header_.source_port >> 8) & 0xFF));
-    segment.push_back(static_cast<uint8_t>(header_.source_port & 0xFF));
-    
-    // Destination Port
-    segment.push_back(static_cast<uint8_t>((header_.dest_port >> 8) & 0xFF));
-    segment.push_back(static_cast<uint8_t>(header_.dest_port & 0xFF));
-    
-    // Sequence Number
-    segment.push_back(static_cast<uint8_t>((header_.sequence_number >> 24) & 0xFF));
-    segment.push_back(static_cast<uint8_t>((header_.sequence_number >> 16) & 0xFF));
-    segment.push_back(static_cast<uint8_t>((header_.sequence_number >> 8) & 0xFF));
-    segment.push_back(static_cast<uint8_t>(header_.sequence_number & 0xFF));
-    
-    // Acknowledgment Number
-    segment.push_back(static_cast<uint8_t>((header_.acknowledgment_number >> 24) & 0xFF));
-    segment.push_back(static_cast<uint8_t>((header_.acknowledgment_number >> 16) & 0xFF));
-    segment.push_back(static_cast<uint8_t>((header_.acknowledgment_number >> 8) & 0xFF));
-    segment.push_back(static_cast<uint8_t>(header_.acknowledgment_number & 0xFF));
+    std::vector<uint8_t> segment(get_header_length() + payload_.size());
     
-    // Data Offset and Reserved (Data Offset = 5 for 20 byte header)
-    segment.push_back(0x50); // Data Offset = 5, Reserved = 0
+    // Checksum as stored; zero unless received or patched
+    write_header(segment.data(), header_.checksum);
+    std::copy(payload_.begin(), payload_.end(), segment.begin() + get_header_length());
     
-    // Flags
-    segment.push_back(header_.flags);
-    
-    // Window Size
-    segment.push_back(static_cast<uint8_t>((header_.window_size >> 8) & 0xFF));
-    segment.push_back(static_cast<uint8_t>(header_.window_size & 0xFF));
-    
-    // Checksum (will be calculated later, set to 0 for now)
-    segment.push_back(0);
-    segment.push_back(0);
-    
-    // Urgent Pointer
-    segment.push_back(static_cast<uint8_t>((header_.urgent_pointer >> 8) & 0xFF));
-    segment.push_back(static_cast<uint8_t>(header_.urgent_pointer & 0xFF));
+    return segment;
+}
+
+std::vector<uint8_t> TCPSegment::serialize(const std::array<uint8_t, 4>& source_ip,
+                                           const std::array<uint8_t, 4>& dest_ip) const {
+    std::vector<uint8_t> segment(get_header_length() + payload_.size());
     
-    // Payload
-    segment.insert(segment.end(), payload_.begin(), payload_.end());
+    // Sum the payload while copying it, then fold in the header fields
+    uint32_t payload_sum = checksum_partial_copy(segment.data() + get_header_length(), payload_);
+    ChecksumAccumulator accumulator = header_checksum_accumulator(source_ip, dest_ip, payload_.size());
+    accumulator.add_partial(payload_sum, payload_.size());
     
+    write_header(segment.data(), accumulator.finish());
     return segment;
 }
 
+bool TCPSegment::write_header_to(std::span<uint8_t> out, const std::array<uint8_t, 4>& source_ip,
+                                 const std::array<uint8_t, 4>& dest_ip,
+                                 size_t payload_length, uint32_t payload_sum) const {
+    if (out.size() < get_header_length() || payload_length > IPv4Packet::MAX_PAYLOAD - get_header_length()) {
+        return false;
+    }
+    ChecksumAccumulator accumulator = header_checksum_accumulator(source_ip, dest_ip, payload_length);
+    accumulator.add_partial(payload_sum, payload_length);
+    write_header(out.data(), accumulator.finish());
+    return true;
+}
+
+bool TCPSegment::prepend_to(PacketHandle& packet, const std::array<uint8_t, 4>& source_ip,
+                            const std::array<uint8_t, 4>& dest_ip) const {
+    return prepend_to(packet, source_ip, dest_ip, checksum_partial(packet.span()));
+}
+
+bool TCPSegment::prepend_to(PacketHandle& packet, const std::array<uint8_t, 4>& source_ip,
+                            const std::array<uint8_t, 4>& dest_ip, uint32_t payload_sum) const {
+    size_t payload_length = packet.size();
+    size_t header_length = get_header_length();
+    if (payload_length > IPv4Packet::MAX_PAYLOAD - header_length) {
+        return false;
+    }
+    uint8_t* header = packet.prepend(header_length);
+    return header != nullptr &&
+           write_header_to({header, header_length}, source_ip, dest_ip, payload_length, payload_sum);
+}
+
 bool TCPSegment::deserialize(const std::vector<uint8_t>& data) {
     if (data.size() < 20) {
-        std::cerr << "TCP segment too small: " << data.size() << " bytes" << std::endl;
+        count_metric(Metric::TCP_MALFORMED);
+        TRACE(TraceEvent::DESERIALIZE_TOO_SHORT, 0, 4, data.size());
         return false;
     }
     
@@ -120,8 +171,15 @@ bool TCPSegment::deserialize(const std::vector<uint8_t>& data) {
     // Urgent Pointer
     header_.urgent_pointer = (static_cast<uint16_t>(data[18]) << 8) | data[19];
     
-    // Payload
+    // Options, kept as received; a data offset that is out of range leaves none
     size_t header_size = header_.data_offset * 4;
+    options_length_ = 0;
+    if (header_size > HEADER_SIZE && header_size <= data.size()) {
+        options_length_ = static_cast<uint8_t>(header_size - HEADER_SIZE);
+        std::copy(data.begin() + HEADER_SIZE, data.begin() + header_size, options_.begin());
+    }
+    
+    // Payload
     if (data.size() > header_size) {
         payload_.assign(data.begin() + header_size, data.end());
     } else {
@@ -131,42 +189,33 @@ bool TCPSegment::deserialize(const std::vector<uint8_t>& data) {
     return true;
 }
 
+ChecksumAccumulator TCPSegment::header_checksum_accumulator(const std::array<uint8_t, 4>& source_ip,
+                                                           const std::array<uint8_t, 4>& dest_ip,
+                                                           size_t payload_length) const {
+    ChecksumAccumulator accumulator;
+    
+    // Pseudo header: addresses, zero byte + protocol, TCP length
+    accumulator.add(source_ip);
+    accumulator.add(dest_ip);
+    accumulator.add16(IPv4Packet::PROTOCOL_TCP);
+    accumulator.add16(static_cast<uint16_t>(get_header_length() + payload_length));
+    
+    // Header fields as serialize() writes them, checksum field as zero
+    accumulator.add16(header_.source_port);
+    accumulator.add16(header_.dest_port);
+    accumulator.add32(header_.sequence_number);
+    accumulator.add32(header_.acknowledgment_number);
+    accumulator.add16(static_cast<uint16_t>(get_header_length() / 4 << 12 | header_.flags));
+    accumulator.add16(header_.window_size);
+    accumulator.add16(header_.urgent_pointer);
+    accumulator.add(get_option_bytes());
+    
+    return accumulator;
+}
+
 uint16_t TCPSegment::calculate_checksum(const std::array<uint8_t, 4>& source_ip, 
                                        const std::array<uint8_t, 4>& dest_ip) const {
-    std::vector<uint8_t> pseudo_header;
-    
-    // Pseudo Header for TCP checksum calculation
-    // Source IP
-    for (auto byte : source_ip) {
-        pseudo_header.push_back(byte);
-    }
-    
-    // Destination IP
-    for (auto byte : dest_ip) {
-        pseudo_header.push_back(byte);
-    }
-    
-    // Zero byte and Protocol
-    pseudo_header.push_back(0);
-    pseudo_header.push_back(6); // TCP protocol
-    
-    // TCP Length
-    uint16_t tcp_length = 20 + payload_.size();
-    pseudo_header.push_back(static_cast<uint8_t>((tcp_length >> 8) & 0xFF));
-    pseudo_header.push_back(static_cast<uint8_t>(tcp_length & 0xFF));
-    
-    // Get TCP segment without checksum
-    auto tcp_data = serialize();
-    
-    // Set checksum field to zero in the TCP data
-    tcp_data[16] = 0;
-    tcp_data[17] = 0;
-    
-    // Combine pseudo header and TCP data
-    std::vector<uint8_t> checksum_data;
-    checksum_data.reserve(pseudo_header.size() + tcp_data.size());
-    checksum_data.insert(checksum_data.end(), pseudo_header.begin(), pseudo_header.end());
-    checksum_data.insert(checksum_data.end(), tcp_data.begin(), tcp_data.end());
-    
-    return calculate_checksum(checksum_data);
+    ChecksumAccumulator accumulator = header_checksum_accumulator(source_ip, dest_ip, payload_.size());
+    accumulator.add(payload_);
+    return accumulator.finish();
 }
@@ -0,0 +1,101 @@
+#include "tcp/tcp_segmenter.h"
+#include "ip/checksum.h"
+#include "util/byte_order.h"
+#include <algorithm>
+#include <cstring>
+
+// Field offsets within the IPv4 and TCP headers
+static constexpr size_t IP_TOTAL_LENGTH = 2;
+static constexpr size_t IP_IDENTIFICATION = 4;
+static constexpr size_t IP_CHECKSUM = 10;
+static constexpr size_t TCP_SEQUENCE = 4;
+static constexpr size_t TCP_OFFSET_FLAGS = 12;
+static constexpr size_t TCP_CHECKSUM = 16;
+
+TCPSegmenter::TCPSegmenter(const EthernetFrame& frame, const IPv4Packet& packet, const TCPSegment& segment,
+                           uint16_t mss)
+    : header_length_(EthernetFrame::HEADER_SIZE + IPv4Packet::HEADER_SIZE + segment.get_header_length()),
+      tcp_offset_(EthernetFrame::HEADER_SIZE + IPv4Packet::HEADER_SIZE),
+      mss_(mss),
+      sequence_(segment.get_header().sequence_number),
+      identification_(packet.get_header().identification) {
+    uint8_t* ip = headers_.data() + EthernetFrame::HEADER_SIZE;
+    uint8_t* tcp = headers_.data() + tcp_offset_;
+    std::span<uint8_t> all(headers_);
+    frame.write_header_to(all);
+    packet.write_header_to(all.subspan(EthernetFrame::HEADER_SIZE), 0);
+    segment.write_header_to(all.subspan(tcp_offset_), packet.get_header().source_ip,
+                            packet.get_header().dest_ip, 0, 0);
+
+    uint8_t flags = segment.get_header().flags;
+    uint16_t offset = static_cast<uint16_t>(segment.get_header_length() / 4 << 12);
+    flags_word_ = offset | static_cast<uint8_t>(flags & ~(TCPSegment::PSH | TCPSegment::FIN));
+    last_flags_word_ = offset | flags;
+
+    // Zero the per-frame fields and sum what is left
+    write_be16(ip + IP_TOTAL_LENGTH, 0);
+    write_be16(ip + IP_IDENTIFICATION, 0);
+    write_be16(ip + IP_CHECKSUM, 0);
+    ip_sum_ = checksum_partial({ip, IPv4Packet::HEADER_SIZE});
+
+    write_be32(tcp + TCP_SEQUENCE, 0);
+    write_be16(tcp + TCP_OFFSET_FLAGS, 0);
+    write_be16(tcp + TCP_CHECKSUM, 0);
+    ChecksumAccumulator tcp_sum;
+    tcp_sum.add(packet.get_header().source_ip);
+    tcp_sum.add(packet.get_header().dest_ip);
+    tcp_sum.add16(IPv4Packet::PROTOCOL_TCP);
+    tcp_sum.add({tcp, segment.get_header_length()});
+    tcp_sum_ = tcp_sum.get_partial();
+}
+
+size_t TCPSegmenter::segment(std::span<const uint8_t> payload, PacketPool& pool, std::vector<PacketHandle>& out) {
+    if (mss_ == 0) {
+        return 0;
+    }
+    std::array<PacketHandle, BURST> buffers;
+    size_t sent = 0;
+    while (sent < payload.size()) {
+        size_t frames = std::min<size_t>((payload.size() - sent + mss_ - 1) / mss_, BURST);
+        size_t allocated = pool.alloc_burst(buffers.data(), frames);
+        for (size_t i = 0; i < allocated; ++i) {
+            size_t length = std::min<size_t>(mss_, payload.size() - sent);
+            if (buffers[i].tailroom() < header_length_ + length) {
+                return sent;
+            }
+            uint8_t* frame = buffers[i].append(header_length_ + length);
+            write_frame(frame, payload.subspan(sent, length), sent + length == payload.size());
+            out.push_back(std::move(buffers[i]));
+            sent += length;
+        }
+        if (allocated < frames) {
+            break;
+        }
+    }
+    return sent;
+}
+
+void TCPSegmenter::write_frame(uint8_t* frame, std::span<const uint8_t> payload, bool last) {
+    std::memcpy(frame, headers_.data(), header_length_);
+    uint8_t* ip = frame + EthernetFrame::HEADER_SIZE;
+    uint8_t* tcp = frame + tcp_offset_;
+    size_t tcp_length = header_length_ - tcp_offset_ + payload.size();
+    uint16_t total_length = static_cast<uint16_t>(IPv4Packet::HEADER_SIZE + tcp_length);
+    uint16_t flags_word = last ? last_flags_word_ : flags_word_;
+
+    write_be16(ip + IP_TOTAL_LENGTH, total_length);
+    write_be16(ip + IP_IDENTIFICATION, identification_);
+    write_be16(ip + IP_CHECKSUM, checksum_finish(ip_sum_ + total_length + identification_));
+
+    // The payload sits at an even offset of the TCP stream, so its sum
+    // simply adds to the header's
+    uint32_t sum = tcp_sum_ + static_cast<uint32_t>(tcp_length) + (sequence_ >> 16) + (sequence_ & 0xFFFF) +
+                   flags_word;
+    sum = checksum_partial_copy(tcp + (header_length_ - tcp_offset_), payload, sum);
+    write_be32(tcp + TCP_SEQUENCE, sequence_);
+    write_be16(tcp + TCP_OFFSET_FLAGS, flags_word);
+    write_be16(tcp + TCP_CHECKSUM, checksum_finish(sum));
+
+    sequence_ += static_cast<uint32_t>(payload.size());
+    identification_++;
+}
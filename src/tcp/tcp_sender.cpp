@@ -0,0 +1,376 @@
+#include "tcp/tcp_sender.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <utility>
+
+RttEstimator::RttEstimator(uint64_t initial_rto_ns, uint64_t min_rto_ns, uint64_t max_rto_ns,
+                           uint64_t granularity_ns)
+    : min_rto_ns_(min_rto_ns), max_rto_ns_(max_rto_ns), granularity_ns_(granularity_ns),
+      rto_ns_(std::clamp(initial_rto_ns, min_rto_ns, max_rto_ns)) {}
+
+void RttEstimator::sample(uint64_t rtt_ns) {
+    rtt_ns = std::max<uint64_t>(rtt_ns, 1);
+    if (srtt_ns_ == 0) {
+        srtt_ns_ = rtt_ns;
+        rttvar_ns_ = rtt_ns / 2;
+    } else {
+        // RTTVAR first, from the old SRTT; alpha = 1/8, beta = 1/4
+        uint64_t error = srtt_ns_ > rtt_ns ? srtt_ns_ - rtt_ns : rtt_ns - srtt_ns_;
+        rttvar_ns_ = (3 * rttvar_ns_ + error) / 4;
+        srtt_ns_ = (7 * srtt_ns_ + rtt_ns) / 8;
+    }
+    uint64_t rto = srtt_ns_ + std::max(granularity_ns_, 4 * rttvar_ns_);
+    rto_ns_ = std::clamp(rto, min_rto_ns_, max_rto_ns_);
+}
+
+void RttEstimator::backoff() {
+    rto_ns_ = std::min(rto_ns_ * 2, max_rto_ns_);
+}
+
+// The timestamp clock ticks in milliseconds
+static constexpr uint64_t TS_TICK_NS = 1'000'000;
+
+static uint32_t segment_size(const SenderConfig& config) {
+    uint32_t options = config.timestamps ? TCPOptions::TIMESTAMPS_SIZE : 0;
+    return config.mss > options ? config.mss - options : 1;
+}
+
+TCPSender::TCPSender(uint32_t iss, const SenderConfig& config)
+    : config_(config),
+      segment_size_(segment_size(config)),
+      congestion_(make_congestion_control(config.congestion, segment_size_)),
+      rtt_(config.initial_rto_ns, config.min_rto_ns, config.max_rto_ns, config.clock_granularity_ns),
+      capacity_(std::bit_ceil(std::max<size_t>(config.send_buffer_size, 1))),
+      mask_(capacity_ - 1),
+      snd_una_(iss + 1),
+      snd_nxt_(iss + 1),
+      snd_max_(iss + 1),
+      recover_(iss + 1),
+      ts_offset_(iss) {
+    storage_ = std::make_unique<uint8_t[]>(capacity_);
+}
+
+size_t TCPSender::write(std::span<const uint8_t> data) {
+    size_t length = std::min(data.size(), get_writable());
+    size_t position = (head_ + buffered_) & mask_;
+    size_t first = std::min(length, capacity_ - position);
+    std::memcpy(storage_.get() + position, data.data(), first);
+    std::memcpy(storage_.get(), data.data() + first, length - first);
+    buffered_ += length;
+    return length;
+}
+
+void TCPSender::send(TCPState state, uint64_t now_ns, std::vector<TCPSegment>& out) {
+    if (!can_send_data(state)) {
+        return;
+    }
+    // In SACK recovery the pipe, not everything past SND.UNA, is in flight
+    bool use_pipe = in_recovery_ && config_.sack;
+    uint32_t cwnd = congestion_->get_cwnd() + inflation_;
+    for (;;) {
+        uint32_t offset = snd_nxt_ - snd_una_;
+        uint32_t in_flight = use_pipe ? pipe_ : offset;
+        if (offset >= buffered_ || offset >= peer_window_ || in_flight >= cwnd) {
+            break;
+        }
+        uint32_t unsent = static_cast<uint32_t>(buffered_ - offset);
+        uint32_t length = std::min({segment_size_, unsent, peer_window_ - offset, cwnd - in_flight});
+        // Silly window avoidance: while data is in flight, wait for room
+        // for a full segment rather than send the sliver the window allows
+        if (length < segment_size_ && length < unsent && offset > 0) {
+            break;
+        }
+
+        // Below snd_max this is the go-back-N resend after a timeout
+        bool resend = seq_lt(snd_nxt_, snd_max_);
+        transmit(snd_nxt_, length, now_ns, out);
+        retransmit_queue_.push_back({snd_nxt_, length, now_ns, resend});
+        stats_.retransmits += resend;
+        snd_nxt_ += length;
+        snd_max_ = seq_max(snd_max_, snd_nxt_);
+        if (use_pipe) {
+            pipe_ += length;
+        }
+        if (retransmit_deadline_ns_ == UINT64_MAX) {
+            restart_timer(now_ns);
+        }
+    }
+
+    // A closed window with data waiting: the timer becomes the persist timer
+    if (peer_window_ == 0 && buffered_ > get_flight() && retransmit_deadline_ns_ == UINT64_MAX) {
+        restart_timer(now_ns);
+    }
+}
+
+void TCPSender::on_ack(uint32_t ack, uint32_t window, bool has_payload, uint64_t now_ns,
+                       std::vector<TCPSegment>& out, const TCPOptions& options) {
+    if (config_.timestamps && options.has_timestamps && seq_ge(options.ts_value, ts_recent_)) {
+        ts_recent_ = options.ts_value;
+    }
+    if (seq_gt(ack, snd_max_) || seq_lt(ack, snd_una_)) {
+        return;
+    }
+    if (config_.sack) {
+        update_scoreboard(options.get_sack_blocks());
+    }
+
+    if (ack == snd_una_) {
+        // RFC 5681: no data, no window change, and something outstanding
+        bool duplicate = !has_payload && window == peer_window_ && window != 0 && snd_max_ != snd_una_;
+        peer_window_ = window;
+        if (window == 0) {
+            // The peer answered a probe; it is alive with nowhere to put data
+            backoffs_ = 0;
+        }
+        if (duplicate) {
+            on_duplicate_ack(now_ns, out);
+        }
+        return;
+    }
+
+    uint32_t acked = ack - snd_una_;
+    // Only a window that was in use may grow (RFC 7661); otherwise a
+    // receiver-limited transfer would inflate cwnd without bound
+    bool cwnd_limited = snd_max_ - snd_una_ + segment_size_ > congestion_->get_cwnd();
+    acknowledge(ack, now_ns, options);
+    peer_window_ = window;
+    dup_acks_ = 0;
+
+    if (!in_recovery_) {
+        if (cwnd_limited) {
+            congestion_->on_ack(acked, rtt_.get_srtt_ns(), now_ns);
+        }
+    } else if (seq_ge(ack, recover_)) {
+        in_recovery_ = false;
+        inflation_ = 0;
+        congestion_->on_recovery_exit(now_ns);
+    } else if (config_.sack) {
+        retransmit_lost(now_ns, out);
+    } else {
+        // Partial ACK: the next hole was lost too. Resend it at once rather
+        // than wait for three more duplicates, and deflate by what left the
+        // network (RFC 6582 3.2 step 5).
+        if (!retransmit_queue_.empty()) {
+            resend(retransmit_queue_.front(), now_ns, out);
+        }
+        inflation_ = (inflation_ > acked ? inflation_ - acked : 0) + segment_size_;
+    }
+
+    if (snd_una_ == snd_max_) {
+        retransmit_deadline_ns_ = UINT64_MAX;
+    } else {
+        restart_timer(now_ns);
+    }
+}
+
+// Releases acknowledged data and queue entries and takes an RTT sample:
+// from the echoed timestamp if there is one, otherwise from the newest
+// segment covered that was only sent once (Karn)
+void TCPSender::acknowledge(uint32_t ack, uint64_t now_ns, const TCPOptions& options) {
+    uint32_t acked = ack - snd_una_;
+    head_ = (head_ + acked) & mask_;
+    buffered_ -= acked;
+    snd_una_ = ack;
+    snd_nxt_ = seq_max(snd_nxt_, snd_una_);
+    backoffs_ = 0;
+
+    bool sampled = false;
+    uint64_t rtt_ns = 0;
+    while (!retransmit_queue_.empty()) {
+        SentSegment& front = retransmit_queue_.front();
+        if (seq_gt(front.sequence + front.length, ack)) {
+            if (seq_lt(front.sequence, ack)) {
+                uint32_t trimmed = ack - front.sequence;
+                if (front.sacked) {
+                    sacked_bytes_ -= trimmed;
+                }
+                front.length -= trimmed;
+                front.sequence = ack;
+            }
+            break;
+        }
+        if (front.sacked) {
+            sacked_bytes_ -= front.length;
+        }
+        if (!front.retransmitted) {
+            sampled = true;
+            rtt_ns = now_ns - front.sent_ns;
+        }
+        retransmit_queue_.pop_front();
+    }
+
+    if (config_.timestamps && options.has_timestamps && options.ts_echo != 0) {
+        uint32_t now_ts = static_cast<uint32_t>(now_ns / TS_TICK_NS) + ts_offset_;
+        rtt_.sample(uint64_t{now_ts - options.ts_echo} * TS_TICK_NS);
+    } else if (sampled) {
+        rtt_.sample(rtt_ns);
+    }
+}
+
+// Marks the queue entries the SACK blocks cover. Blocks at or below
+// SND.UNA (D-SACK) or past anything sent are ignored.
+void TCPSender::update_scoreboard(std::span<const SequenceRange> blocks) {
+    for (const SequenceRange& block : blocks) {
+        if (!seq_lt(block.start, block.end) || seq_le(block.end, snd_una_) || seq_gt(block.end, snd_max_)) {
+            continue;
+        }
+        auto segment = std::lower_bound(retransmit_queue_.begin(), retransmit_queue_.end(), block.start,
+                                        [](const SentSegment& sent, uint32_t sequence) {
+                                            return seq_lt(sent.sequence, sequence);
+                                        });
+        for (; segment != retransmit_queue_.end() && seq_le(segment->sequence + segment->length, block.end);
+             ++segment) {
+            if (!segment->sacked) {
+                segment->sacked = true;
+                sacked_bytes_ += segment->length;
+            }
+        }
+    }
+}
+
+// RFC 6675 SetPipe() and NextSeg() in two passes over the queue: from the
+// top down, a segment with more than (DupThresh - 1) * SMSS SACKed above
+// it is lost; then lost segments not yet resent go out while the pipe is
+// below cwnd
+void TCPSender::retransmit_lost(uint64_t now_ns, std::vector<TCPSegment>& out) {
+    uint32_t lost_threshold = (config_.dup_ack_threshold - 1) * segment_size_;
+    uint32_t sacked_above = 0;
+    uint32_t pipe = 0;
+    for (auto segment = retransmit_queue_.rbegin(); segment != retransmit_queue_.rend(); ++segment) {
+        if (segment->sacked) {
+            sacked_above += segment->length;
+            continue;
+        }
+        segment->lost = segment->lost || sacked_above > lost_threshold;
+        pipe += segment->lost ? 0 : segment->length;
+        pipe += segment->resent ? segment->length : 0;
+    }
+
+    uint32_t cwnd = congestion_->get_cwnd();
+    for (SentSegment& segment : retransmit_queue_) {
+        if (pipe >= cwnd) {
+            break;
+        }
+        if (segment.lost && !segment.sacked && !segment.resent) {
+            resend(segment, now_ns, out);
+            pipe += segment.length;
+        }
+    }
+    pipe_ = pipe;
+}
+
+void TCPSender::on_duplicate_ack(uint64_t now_ns, std::vector<TCPSegment>& out) {
+    stats_.dup_acks++;
+    if (in_recovery_) {
+        if (config_.sack) {
+            retransmit_lost(now_ns, out);
+        } else {
+            // Another segment has left the network
+            inflation_ += segment_size_;
+        }
+        return;
+    }
+
+    // Three duplicates, or with SACK as much data past the hole (which
+    // also catches a loss when ACKs are lost or thinned)
+    dup_acks_++;
+    bool lost = dup_acks_ >= config_.dup_ack_threshold ||
+                (config_.sack && sacked_bytes_ > (config_.dup_ack_threshold - 1) * segment_size_);
+    // Duplicates of a window sent before the last loss event do not start
+    // another recovery (RFC 6582 3.2 step 2)
+    if (!lost || seq_lt(snd_una_, recover_) || retransmit_queue_.empty()) {
+        return;
+    }
+
+    in_recovery_ = true;
+    recover_ = snd_max_;
+    stats_.fast_retransmits++;
+    congestion_->on_fast_retransmit(snd_max_ - snd_una_, now_ns);
+    // The first hole goes out whatever the pipe (RFC 6675 5 step 4.3)
+    retransmit_queue_.front().lost = true;
+    resend(retransmit_queue_.front(), now_ns, out);
+    if (config_.sack) {
+        retransmit_lost(now_ns, out);
+    } else {
+        inflation_ = config_.dup_ack_threshold * segment_size_;
+    }
+}
+
+void TCPSender::on_retransmit_timeout(uint64_t now_ns, std::vector<TCPSegment>& out) {
+    retransmit_deadline_ns_ = UINT64_MAX;
+
+    if (peer_window_ == 0 && buffered_ > 0) {
+        // Persist: probe the closed window with one byte; not a loss
+        retransmit_queue_.clear();
+        sacked_bytes_ = 0;
+        transmit(snd_una_, 1, now_ns, out);
+        retransmit_queue_.push_back({snd_una_, 1, now_ns, true});
+        snd_nxt_ = snd_una_ + 1;
+        snd_max_ = seq_max(snd_max_, snd_nxt_);
+        backoffs_++;
+        rtt_.backoff();
+        restart_timer(now_ns);
+        return;
+    }
+    if (snd_una_ == snd_max_) {
+        return;
+    }
+
+    stats_.timeouts++;
+    backoffs_++;
+    congestion_->on_timeout(snd_max_ - snd_una_, now_ns);
+    rtt_.backoff();
+    in_recovery_ = false;
+    inflation_ = 0;
+    dup_acks_ = 0;
+    recover_ = snd_max_;
+
+    // Go back N: resend the first segment now and the rest as the window
+    // reopens, since anything past the first loss may be gone too
+    retransmit_queue_.clear();
+    sacked_bytes_ = 0;
+    uint32_t length = std::min(segment_size_, snd_max_ - snd_una_);
+    transmit(snd_una_, length, now_ns, out);
+    retransmit_queue_.push_back({snd_una_, length, now_ns, true});
+    stats_.retransmits++;
+    snd_nxt_ = snd_una_ + length;
+    restart_timer(now_ns);
+}
+
+void TCPSender::resend(SentSegment& segment, uint64_t now_ns, std::vector<TCPSegment>& out) {
+    segment.retransmitted = true;
+    segment.resent = true;
+    segment.sent_ns = now_ns;
+    transmit(segment.sequence, segment.length, now_ns, out);
+    stats_.retransmits++;
+}
+
+// Copies [sequence, sequence + length) out of the ring into a segment
+void TCPSender::transmit(uint32_t sequence, uint32_t length, uint64_t now_ns, std::vector<TCPSegment>& out) {
+    std::vector<uint8_t> payload(length);
+    size_t position = (head_ + (sequence - snd_una_)) & mask_;
+    size_t first = std::min<size_t>(length, capacity_ - position);
+    std::memcpy(payload.data(), storage_.get() + position, first);
+    std::memcpy(payload.data() + first, storage_.get(), length - first);
+
+    TCPSegment& segment = out.emplace_back();
+    segment.set_sequence_number(sequence);
+    bool last = sequence + length == snd_una_ + buffered_;
+    segment.set_flags(TCPSegment::ACK | (last ? TCPSegment::PSH : 0));
+    segment.set_payload(std::move(payload));
+    if (config_.timestamps) {
+        TCPOptions options;
+        options.has_timestamps = true;
+        options.ts_value = static_cast<uint32_t>(now_ns / TS_TICK_NS) + ts_offset_;
+        options.ts_echo = ts_recent_;
+        segment.set_options(options);
+    }
+
+    stats_.segments_sent++;
+    stats_.bytes_sent += length;
+}
+
+void TCPSender::restart_timer(uint64_t now_ns) {
+    retransmit_deadline_ns_ = now_ns + rtt_.get_rto_ns();
+}
@@ -0,0 +1,59 @@
+#include "tcp/tcp_socket.h"
+
+const char* socket_error_name(SocketError error) {
+    switch (error) {
+    case SocketError::NONE: return "none";
+    case SocketError::WOULD_BLOCK: return "would_block";
+    case SocketError::INVALID: return "invalid";
+    case SocketError::CLOSED: return "closed";
+    case SocketError::RESET: return "reset";
+    case SocketError::TIMED_OUT: return "timed_out";
+    }
+    return "unknown";
+}
+
+SocketId SocketTable::allocate(SocketKind kind) {
+    uint32_t index;
+    if (!free_.empty()) {
+        index = free_.back();
+        free_.pop_back();
+    } else {
+        index = static_cast<uint32_t>(slots_.size());
+        slots_.emplace_back();
+    }
+    slots_[index].kind = kind;
+    return id_of(index);
+}
+
+// The slot may still be on the ready list, so queued is kept; the next
+// collect() drops it, or reports it for whoever owns it by then
+void SocketTable::free(uint32_t index) {
+    SocketSlot& slot = slots_[index];
+    bool queued = slot.queued;
+    uint32_t generation = slot.generation + 1;
+    slot = SocketSlot();
+    slot.generation = generation;
+    slot.queued = queued;
+    free_.push_back(index);
+}
+
+SocketSlot* SocketTable::get(SocketId id, SocketKind kind) {
+    uint32_t index = index_of(id);
+    if (id == 0 || index >= slots_.size()) {
+        return nullptr;
+    }
+    SocketSlot& slot = slots_[index];
+    if (slot.kind != kind || slot.generation != static_cast<uint32_t>(id >> 32)) {
+        return nullptr;
+    }
+    return &slot;
+}
+
+void SocketTable::notify(uint32_t index) {
+    SocketSlot& slot = slots_[index];
+    if (slot.interest == 0 || slot.queued) {
+        return;
+    }
+    slot.queued = true;
+    ready_.push_back(index);
+}
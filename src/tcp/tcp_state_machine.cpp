@@ -1,115 +1,35 @@
 #include "tcp/tcp_state_machine.h"
 #include <iostream>
 
-TCPStateMachine::TCPStateMachine() : current_state_(TCPState::CLOSED) {}
+static const char* const STATE_NAMES[] = {
+    "CLOSED", "LISTEN", "SYN_SENT", "SYN_RECEIVED", "ESTABLISHED",
+    "FIN_WAIT_1", "FIN_WAIT_2", "CLOSE_WAIT", "CLOSING", "LAST_ACK", "TIME_WAIT"
+};
 
-void TCPStateMachine::handle_syn() {
-    std::cout << "State " << get_state_name() << ": Handling SYN" << std::endl;
-    
-    switch (current_state_) {
-        case TCPState::LISTEN:
-            transition_to(TCPState::SYN_RECEIVED);
-            std::cout << "  -> Sent SYN-ACK" << std::endl;
-            break;
-        default:
-            std::cout << "  -> Unexpected SYN in state: " << get_state_name() << std::endl;
-            break;
-    }
-}
-
-void TCPStateMachine::handle_syn_ack() {
-    std::cout << "State " << get_state_name() << ": Handling SYN-ACK" << std::endl;
-    
-    switch (current_state_) {
-        case TCPState::SYN_SENT:
-            transition_to(TCPState::ESTABLISHED);
-            std::cout << "  -> Sent ACK, connection established" << std::endl;
-            break;
-        default:
-            std::cout << "  -> Unexpected SYN-ACK in state: " << get_state_name() << std::endl;
-            break;
-    }
-}
+static const char* const EVENT_NAMES[] = {
+    "OPEN_PASSIVE", "CLOSE", "SEND_SYN", "SEND_ACK", "SEND_FIN",
+    "RECV_SYN", "RECV_SYN_ACK", "RECV_ACK", "RECV_FIN", "RECV_RST", "TIME_WAIT_EXPIRED"
+};
 
-void TCPStateMachine::handle_ack() {
-    std::cout << "State " << get_state_name() << ": Handling ACK" << std::endl;
-    
-    switch (current_state_) {
-        case TCPState::SYN_RECEIVED:
-            transition_to(TCPState::ESTABLISHED);
-            std::cout << "  -> Connection established" << std::endl;
-            break;
-        default:
-            std::cout << "  -> ACK processed in state: " << get_state_name() << std::endl;
-            break;
-    }
-}
+static_assert(sizeof(STATE_NAMES) / sizeof(STATE_NAMES[0]) == TCP_STATE_COUNT);
+static_assert(sizeof(EVENT_NAMES) / sizeof(EVENT_NAMES[0]) == TCP_EVENT_COUNT);
 
-void TCPStateMachine::handle_fin() {
-    std::cout << "State " << get_state_name() << ": Handling FIN" << std::endl;
-    
-    switch (current_state_) {
-        case TCPState::ESTABLISHED:
-            transition_to(TCPState::CLOSE_WAIT);
-            std::cout << "  -> Sent ACK for FIN" << std::endl;
-            break;
-        case TCPState::FIN_WAIT_1:
-            transition_to(TCPState::CLOSING);
-            std::cout << "  -> Simultaneous close" << std::endl;
-            break;
-        case TCPState::FIN_WAIT_2:
-            transition_to(TCPState::TIME_WAIT);
-            std::cout << "  -> Connection closing" << std::endl;
-            break;
-        default:
-            std::cout << "  -> Unexpected FIN in state: " << get_state_name() << std::endl;
-            break;
-    }
+const char* tcp_state_name(TCPState state) {
+    return STATE_NAMES[static_cast<size_t>(state)];
 }
 
-void TCPStateMachine::handle_rst() {
-    std::cout << "State " << get_state_name() << ": Handling RST" << std::endl;
-    transition_to(TCPState::CLOSED);
-    std::cout << "  -> Connection reset" << std::endl;
+const char* tcp_event_name(TCPEvent event) {
+    return EVENT_NAMES[static_cast<size_t>(event)];
 }
 
-void TCPStateMachine::send_syn() {
-    if (current_state_ == TCPState::CLOSED) {
-        transition_to(TCPState::SYN_SENT);
-        std::cout << "State " << get_state_name() << ": Sent SYN" << std::endl;
+void StreamStateLogging::on_transition(TCPState from, TCPEvent event, TCPState to) {
+    std::cout << "State " << tcp_state_name(from) << ": " << tcp_event_name(event);
+    if (from != to) {
+        std::cout << " -> " << tcp_state_name(to);
     }
+    std::cout << '\n';
 }
 
-void TCPStateMachine::send_ack() {
-    std::cout << "State " << get_state_name() << ": Sent ACK" << std::endl;
-}
-
-void TCPStateMachine::send_fin() {
-    switch (current_state_) {
-        case TCPState::ESTABLISHED:
-            transition_to(TCPState::FIN_WAIT_1);
-            std::cout << "State " << get_state_name() << ": Sent FIN" << std::endl;
-            break;
-        case TCPState::CLOSE_WAIT:
-            transition_to(TCPState::LAST_ACK);
-            std::cout << "State " << get_state_name() << ": Sent FIN" << std::endl;
-            break;
-        default:
-            std::cout << "  -> Cannot send FIN in state: " << get_state_name() << std::endl;
-            break;
-    }
-}
-
-const char* TCPStateMachine::get_state_name() const {
-    static const char* names[] = {
-        "CLOSED", "LISTEN", "SYN_SENT", "SYN_RECEIVED", "ESTABLISHED",
-        "FIN_WAIT_1", "FIN_WAIT_2", "CLOSE_WAIT", "CLOSING", "LAST_ACK", "TIME_WAIT"
-    };
-    return names[static_cast<int>(current_state_)];
-}
-
-void TCPStateMachine::transition_to(TCPState new_state) {
-    std::cout << "TCP State transition: " << get_state_name() << " -> " 
-              << names[static_cast<int>(new_state)] << std::endl;
-    current_state_ = new_state;
+void StreamStateLogging::on_rejected(TCPState state, TCPEvent event) {
+    std::cout << "State " << tcp_state_name(state) << ": unexpected " << tcp_event_name(event) << '\n';
 }
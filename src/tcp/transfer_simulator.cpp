@@ -0,0 +1,168 @@
+#include "tcp/transfer_simulator.h"
+#include "core/timer_wheel.h"
+#include "tcp/tcp_receive_buffer.h"
+#include "tcp/tcp_state_machine.h"
+#include "tcp/tcp_view.h"
+#include <algorithm>
+#include <array>
+#include <vector>
+
+static constexpr std::array<uint8_t, 4> CLIENT_IP = {10, 0, 0, 1};
+static constexpr std::array<uint8_t, 4> SERVER_IP = {10, 0, 0, 2};
+static constexpr uint32_t CLIENT_ADDRESS = 0x0A000001;
+static constexpr uint32_t SERVER_ADDRESS = 0x0A000002;
+static constexpr uint16_t CLIENT_PORT = 40000;
+static constexpr uint16_t SERVER_PORT = 5001;
+static constexpr uint32_t CLIENT_ISS = 0xFFFF0000; // wraps early in the transfer
+static constexpr uint32_t SERVER_ISS = 1000;
+
+// Byte i of the stream; not periodic at 256 so misplaced data shows up
+static uint8_t stream_byte(size_t i) {
+    return static_cast<uint8_t>(i ^ (i >> 8) ^ (i >> 16));
+}
+
+TransferResult simulate_transfer(const TransferConfig& config) {
+    TransferResult result;
+    LossyLink forward(config.forward);
+    LossyLink reverse(config.reverse);
+    TimerWheel wheel(0, config.sender.clock_granularity_ns);
+    Timer retransmit_timer;
+
+    // Handshake as if the SYN and SYN-ACK got through
+    TCPStateMachine client;
+    TCPStateMachine server;
+    client.send_syn();
+    server.listen();
+    server.handle_syn();
+    client.handle_syn_ack();
+    server.handle_ack();
+
+    TCPSender sender(CLIENT_ISS, config.sender);
+    TCPReceiveBuffer receiver;
+    receiver.open(CLIENT_ISS + 1, config.receive_window);
+    // The window field carries window >> scale, and the sender shifts back
+    uint8_t scale = std::min(config.window_scale, TCPOptions::MAX_WINDOW_SCALE);
+    size_t advertised = std::min<size_t>(config.receive_window, size_t{65535} << scale);
+    uint32_t ts_recent = 0;
+
+    std::vector<TCPSegment> out;
+    std::vector<uint8_t> packet;
+    std::vector<uint8_t> chunk(64 * 1024);
+    size_t written = 0;
+    size_t received = 0;
+    uint64_t now = 0;
+
+    auto flush = [&]() {
+        for (TCPSegment& segment : out) {
+            segment.set_source_port(CLIENT_PORT);
+            segment.set_dest_port(SERVER_PORT);
+            segment.set_ack_number(SERVER_ISS + 1);
+            segment.set_window_size(65535);
+            forward.send(segment.serialize(CLIENT_IP, SERVER_IP), now);
+        }
+        out.clear();
+        uint64_t deadline = sender.get_retransmit_deadline();
+        if (deadline == UINT64_MAX) {
+            wheel.cancel(retransmit_timer);
+        } else {
+            wheel.arm(retransmit_timer, deadline);
+        }
+    };
+
+    // The SYN-ACK carries the peer's first window
+    sender.on_ack(CLIENT_ISS + 1, static_cast<uint32_t>(advertised >> scale << scale), false, now, out);
+
+    while (received < config.bytes && now <= config.time_limit_ns) {
+        while (written < config.bytes && sender.get_writable() > 0) {
+            size_t length = std::min({chunk.size(), config.bytes - written, sender.get_writable()});
+            for (size_t i = 0; i < length; ++i) {
+                chunk[i] = stream_byte(written + i);
+            }
+            written += sender.write({chunk.data(), length});
+        }
+        sender.send(client.get_state(), now, out);
+        flush();
+
+        // Receiver: take data, check it, ACK every segment
+        while (forward.receive(now, packet)) {
+            TCPView view;
+            if (!view.parse(packet) || !view.has_valid_checksum(CLIENT_ADDRESS, SERVER_ADDRESS)) {
+                result.intact = false;
+                continue;
+            }
+            TCPOptions options;
+            if (view.decode_options(options) && options.has_timestamps) {
+                ts_recent = options.ts_value;
+            }
+            receiver.receive(view.get_sequence_number(), view.get_payload());
+            for (auto readable = receiver.peek(); !readable.empty(); readable = receiver.peek()) {
+                for (size_t i = 0; i < readable.size(); ++i) {
+                    result.intact &= readable[i] == stream_byte(received + i);
+                }
+                received += readable.size();
+                receiver.consume(readable.size());
+            }
+
+            TCPSegment ack;
+            ack.set_source_port(SERVER_PORT);
+            ack.set_dest_port(CLIENT_PORT);
+            ack.set_sequence_number(SERVER_ISS + 1);
+            ack.set_ack_number(receiver.get_rcv_nxt());
+            ack.set_flags(TCPSegment::ACK);
+            ack.set_window_size(static_cast<uint16_t>(std::min(receiver.get_window(), advertised) >> scale));
+            TCPOptions ack_options;
+            if (config.sender.timestamps) {
+                ack_options.has_timestamps = true;
+                ack_options.ts_value = static_cast<uint32_t>(now / 1'000'000) + SERVER_ISS;
+                ack_options.ts_echo = ts_recent;
+            }
+            if (config.sender.sack) {
+                ack_options.set_sack_blocks(receiver.get_out_of_order(), view.get_sequence_number());
+            }
+            ack.set_options(ack_options);
+            reverse.send(ack.serialize(SERVER_IP, CLIENT_IP), now);
+        }
+
+        // Sender: ACKs, then the timer
+        while (reverse.receive(now, packet)) {
+            TCPView view;
+            if (!view.parse(packet) || !view.has_valid_checksum(SERVER_ADDRESS, CLIENT_ADDRESS)) {
+                result.intact = false;
+                continue;
+            }
+            TCPOptions options;
+            if (!view.decode_options(options)) {
+                options = TCPOptions{};
+            }
+            uint32_t window = uint32_t{view.get_window_size()} << scale;
+            sender.on_ack(view.get_ack_number(), window, !view.get_payload().empty(), now, out, options);
+        }
+        wheel.advance(now, [&](Timer&) { sender.on_retransmit_timeout(now, out); });
+        sender.send(client.get_state(), now, out);
+        flush();
+
+        // Jump to whatever happens next: an arrival or the timer's tick
+        uint64_t next = std::min(forward.get_next_arrival(), reverse.get_next_arrival());
+        uint64_t deadline = sender.get_retransmit_deadline();
+        if (deadline != UINT64_MAX) {
+            uint64_t tick = wheel.get_tick_ns();
+            uint64_t fires = std::max((deadline + tick - 1) / tick, now / tick + 1) * tick;
+            next = std::min(next, fires);
+        }
+        if (received >= config.bytes || next == UINT64_MAX) {
+            break;
+        }
+        now = next;
+    }
+
+    result.completed = received >= config.bytes;
+    result.elapsed_ns = now;
+    if (now != 0) {
+        result.goodput_bps = static_cast<double>(received) * 8e9 / static_cast<double>(now);
+    }
+    result.final_cwnd = sender.get_congestion().get_cwnd();
+    result.sender = sender.get_stats();
+    result.forward = forward.get_stats();
+    result.reverse = reverse.get_stats();
+    return result;
+}
@@ -0,0 +1,191 @@
+#include <gtest/gtest.h>
+#include "link/capture_file.h"
+#include "stack.h"
+#include "test_frames.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static std::vector<uint8_t> make_frame(uint16_t ethertype, uint8_t protocol, size_t tcp_bytes) {
+    return build_frame({.source_port = 1000, .dest_port = 2000, .tcp_bytes = tcp_bytes, .protocol = protocol,
+                        .ethertype = ethertype});
+}
+
+static std::vector<uint8_t> make_pcapng(const std::vector<std::vector<uint8_t>>& frames) {
+    std::vector<uint8_t> out;
+    
+    // Section header block
+    put32(out, 0x0A0D0D0A);
+    put32(out, 28);
+    put32(out, 0x1A2B3C4D);
+    put16(out, 1);
+    put16(out, 0);
+    put32(out, 0xFFFFFFFF);
+    put32(out, 0xFFFFFFFF);
+    put32(out, 28);
+    
+    // Interface description block with if_tsresol = 10^-9
+    put32(out, 1);
+    put32(out, 32);
+    put16(out, CaptureFile::LINKTYPE_ETHERNET);
+    put16(out, 0);
+    put32(out, 65535);
+    put16(out, 9);
+    put16(out, 1);
+    out.insert(out.end(), {9, 0, 0, 0});
+    put32(out, 0); // opt_endofopt
+    put32(out, 32);
+    
+    for (size_t i = 0; i < frames.size(); ++i) {
+        uint32_t padded = static_cast<uint32_t>((frames[i].size() + 3) & ~size_t(3));
+        uint32_t length = 32 + padded;
+        uint64_t timestamp = 5000000000ULL + i;
+        
+        put32(out, 6);
+        put32(out, length);
+        put32(out, 0);
+        put32(out, static_cast<uint32_t>(timestamp >> 32));
+        put32(out, static_cast<uint32_t>(timestamp));
+        put32(out, static_cast<uint32_t>(frames[i].size()));
+        put32(out, static_cast<uint32_t>(frames[i].size()));
+        out.insert(out.end(), frames[i].begin(), frames[i].end());
+        out.insert(out.end(), padded - frames[i].size(), 0);
+        put32(out, length);
+    }
+    return out;
+}
+
+TEST(CaptureFileTest, ReadsPcapWithoutCopying) {
+    std::vector<std::vector<uint8_t>> frames = {{1, 2, 3}, {4, 5, 6, 7, 8}};
+    std::string path = write_file("classic.pcap", make_pcap(frames));
+    
+    CaptureFile file;
+    ASSERT_TRUE(file.open(path));
+    EXPECT_FALSE(file.is_pcapng());
+    
+    CapturedPacket packet;
+    ASSERT_TRUE(file.next(packet));
+    EXPECT_EQ(packet.timestamp_ns, 100000000000ULL);
+    EXPECT_EQ(std::vector<uint8_t>(packet.data.begin(), packet.data.end()), frames[0]);
+    ASSERT_TRUE(file.next(packet));
+    EXPECT_EQ(packet.timestamp_ns, 100000001000ULL);
+    EXPECT_EQ(packet.data.size(), 5u);
+    EXPECT_FALSE(file.next(packet));
+    EXPECT_FALSE(file.is_truncated());
+    
+    file.rewind();
+    ASSERT_TRUE(file.next(packet));
+    EXPECT_EQ(packet.data.size(), 3u);
+    std::remove(path.c_str());
+}
+
+TEST(CaptureFileTest, ReadsPcapngEnhancedPackets) {
+    std::vector<std::vector<uint8_t>> frames = {{9, 9, 9, 9, 9}, {1}};
+    std::string path = write_file("capture.pcapng", make_pcapng(frames));
+    
+    CaptureFile file;
+    ASSERT_TRUE(file.open(path));
+    EXPECT_TRUE(file.is_pcapng());
+    
+    CapturedPacket packet;
+    ASSERT_TRUE(file.next(packet));
+    EXPECT_EQ(packet.timestamp_ns, 5000000000ULL);
+    EXPECT_EQ(packet.link_type, CaptureFile::LINKTYPE_ETHERNET);
+    EXPECT_EQ(std::vector<uint8_t>(packet.data.begin(), packet.data.end()), frames[0]);
+    ASSERT_TRUE(file.next(packet));
+    EXPECT_EQ(packet.timestamp_ns, 5000000001ULL);
+    EXPECT_FALSE(file.next(packet));
+    std::remove(path.c_str());
+}
+
+TEST(CaptureFileTest, DetectsTruncatedRecords) {
+    auto bytes = make_pcap({{1, 2, 3, 4, 5, 6}});
+    bytes.resize(bytes.size() - 2);
+    std::string path = write_file("truncated.pcap", bytes);
+    
+    CaptureFile file;
+    ASSERT_TRUE(file.open(path));
+    CapturedPacket packet;
+    EXPECT_FALSE(file.next(packet));
+    EXPECT_TRUE(file.is_truncated());
+    std::remove(path.c_str());
+}
+
+TEST(CaptureFileTest, ReplayReportsDropReasons) {
+    std::vector<std::vector<uint8_t>> frames = {
+        make_frame(EthernetFrame::ETHERTYPE_IPV4, IPv4Packet::PROTOCOL_TCP, 20),
+        make_frame(EthernetFrame::ETHERTYPE_IPV4, IPv4Packet::PROTOCOL_TCP, 12),
+        make_frame(EthernetFrame::ETHERTYPE_IPV4, IPv4Packet::PROTOCOL_UDP, 20),
+        make_frame(EthernetFrame::ETHERTYPE_ARP, IPv4Packet::PROTOCOL_TCP, 20),
+        {1, 2, 3},
+    };
+    std::string path = write_file("replay.pcapng", make_pcapng(frames));
+    
+    TCPIPStack stack("replay");
+    ReplayConfig config;
+    config.loops = 2;
+    ReplayReport report;
+    ASSERT_TRUE(stack.replay(path, config, report));
+    
+    EXPECT_EQ(report.packets, 10u);
+    EXPECT_EQ(report.drops.tcp_malformed, 2u);
+    EXPECT_EQ(report.drops.ip_unknown_protocol, 2u);
+    EXPECT_EQ(report.drops.eth_unknown_type, 2u);
+    EXPECT_EQ(report.drops.eth_too_short, 2u);
+    EXPECT_GT(report.packets_per_second, 0.0);
+    std::remove(path.c_str());
+}
+
+TEST(CaptureFileTest, OriginalTimingPacesReplay) {
+    std::vector<uint8_t> bytes = make_pcap({{1}, {2}});
+    // Second packet 20 ms after the first
+    size_t second_record = 24 + 16 + 1;
+    uint32_t fraction = 20000000;
+    std::memcpy(&bytes[second_record + 4], &fraction, 4);
+    std::string path = write_file("paced.pcap", bytes);
+    
+    TCPIPStack stack("replay");
+    ReplayConfig config;
+    config.timing = ReplayTiming::ORIGINAL;
+    ReplayReport report;
+    ASSERT_TRUE(stack.replay(path, config, report));
+    EXPECT_GE(report.elapsed_seconds, 0.019);
+    
+    config.timing = ReplayTiming::SCALED;
+    config.speed = 4.0;
+    ASSERT_TRUE(stack.replay(path, config, report));
+    EXPECT_GE(report.elapsed_seconds, 0.004);
+    EXPECT_LT(report.elapsed_seconds, 0.019);
+    std::remove(path.c_str());
+}
+
+TEST(CaptureFileTest, WorkersProcessEveryReplayedPacket) {
+    std::vector<std::vector<uint8_t>> frames;
+    for (int i = 0; i < 64; ++i) {
+        frames.push_back(build_frame({.source_ip = {10, 0, 0, static_cast<uint8_t>(i)},
+                                      .source_port = static_cast<uint16_t>(1000 + i), .ttl = 0}));
+    }
+    frames.push_back(make_frame(EthernetFrame::ETHERTYPE_IPV4, IPv4Packet::PROTOCOL_TCP, 12));
+    std::string path = write_file("workers.pcap", make_pcap(frames));
+    
+    StackConfig stack_config;
+    stack_config.worker_count = 4;
+    TCPIPStack stack("replay", stack_config);
+    ReplayConfig config;
+    config.loops = 3;
+    ReplayReport report;
+    ASSERT_TRUE(stack.replay(path, config, report));
+    
+    StackStats stats = stack.get_stats();
+    ASSERT_EQ(stats.worker_packets.size(), 4u);
+    uint64_t processed = 0;
+    for (uint64_t count : stats.worker_packets) {
+        EXPECT_GT(count, 0u);
+        processed += count;
+    }
+    EXPECT_EQ(processed, report.packets);
+    EXPECT_EQ(report.packets, 65u * 3);
+    EXPECT_EQ(report.drops.tcp_malformed, 3u);
+    EXPECT_EQ(report.drops.queue_full, 0u);
+    std::remove(path.c_str());
+}
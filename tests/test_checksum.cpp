@@ -1,5 +1,9 @@
 #include <gtest/gtest.h>
 #include "ip/checksum.h"
+#include <random>
+#include <span>
+#include "ip/ipv4_packet.h"
+#include "util/byte_order.h"
 
 TEST(ChecksumTest, BasicCalculation) {
     std::vector<uint8_t> data = {0x45, 0x00, 0x00, 0x73, 0x00, 0x00, 0x40, 0x00, 
@@ -15,3 +19,127 @@ TEST(ChecksumTest, ZeroData) {
     uint16_t checksum = calculate_checksum(data);
     EXPECT_EQ(checksum, 0xFFFF);
 }
+
+// Straightforward one-word-per-iteration RFC 1071 implementation the
+// optimized kernels must match bit for bit
+static uint16_t reference_checksum(const uint8_t* data, size_t length) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i + 1 < length; i += 2) {
+        sum += (static_cast<uint16_t>(data[i]) << 8) | data[i + 1];
+    }
+    if (length % 2 != 0) {
+        sum += static_cast<uint16_t>(data[length - 1]) << 8;
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return static_cast<uint16_t>(~sum);
+}
+
+static std::vector<uint8_t> random_bytes(std::mt19937& rng, size_t length) {
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::vector<uint8_t> data(length);
+    for (auto& b : data) {
+        b = static_cast<uint8_t>(byte(rng));
+    }
+    return data;
+}
+
+TEST(ChecksumTest, RFC1071Example) {
+    std::vector<uint8_t> data = {0x00, 0x01, 0xf2, 0x03, 0xf4, 0xf5, 0xf6, 0xf7};
+    // The example's one's complement sum is 0xddf2
+    EXPECT_EQ(calculate_checksum(data), static_cast<uint16_t>(~0xddf2));
+}
+
+TEST(ChecksumTest, AllKernelsMatchReferenceOnRandomInputs) {
+    const ChecksumKernel kernels[] = {
+        ChecksumKernel::PORTABLE, ChecksumKernel::SSE2, ChecksumKernel::AVX2
+    };
+    ChecksumKernel original = get_checksum_kernel();
+    std::mt19937 rng(1071);
+    std::uniform_int_distribution<size_t> length_dist(0, 9000);
+    
+    for (auto kernel : kernels) {
+        if (!set_checksum_kernel(kernel)) {
+            continue;
+        }
+        SCOPED_TRACE(checksum_kernel_name(kernel));
+        
+        for (int iteration = 0; iteration < 500; ++iteration) {
+            auto data = random_bytes(rng, length_dist(rng) + 3);
+            // Exercise unaligned starts as well
+            size_t offset = iteration % 3;
+            std::span<const uint8_t> view(data.data() + offset, data.size() - offset);
+            ASSERT_EQ(calculate_checksum(view), reference_checksum(view.data(), view.size()))
+                << "length " << view.size();
+        }
+        
+        // Long runs of 0xFF stress carry propagation
+        std::vector<uint8_t> ones(65537, 0xFF);
+        EXPECT_EQ(calculate_checksum(ones), reference_checksum(ones.data(), ones.size()));
+    }
+    
+    set_checksum_kernel(original);
+}
+
+TEST(ChecksumTest, ScatterGatherMatchesContiguous) {
+    std::mt19937 rng(1624);
+    
+    for (int iteration = 0; iteration < 300; ++iteration) {
+        auto data = random_bytes(rng, 1 + rng() % 3000);
+        size_t cut1 = rng() % data.size();
+        size_t cut2 = cut1 + rng() % (data.size() - cut1);
+        std::span<const uint8_t> all(data);
+        
+        uint16_t expected = reference_checksum(data.data(), data.size());
+        EXPECT_EQ(calculate_checksum({all.first(cut1), all.subspan(cut1, cut2 - cut1), all.subspan(cut2)}),
+                  expected);
+    }
+}
+
+TEST(ChecksumTest, PartialSumsCompose) {
+    std::mt19937 rng(793);
+    auto data = random_bytes(rng, 1500);
+    std::span<const uint8_t> all(data);
+    
+    uint32_t sum = checksum_partial(all.first(20));
+    sum = checksum_partial(all.subspan(20), sum);
+    EXPECT_EQ(checksum_finish(sum), reference_checksum(data.data(), data.size()));
+}
+
+TEST(ChecksumTest, IncrementalUpdateMatchesRecompute) {
+    std::mt19937 rng(1624);
+    
+    for (int iteration = 0; iteration < 200; ++iteration) {
+        auto data = random_bytes(rng, 40);
+        uint16_t checksum = calculate_checksum(data);
+        
+        size_t offset = 2 * (rng() % 10);
+        uint32_t old_value = read_be32(&data[offset]);
+        uint32_t new_value = static_cast<uint32_t>(rng());
+        write_be32(&data[offset], new_value);
+        
+        EXPECT_EQ(checksum_update32(checksum, old_value, new_value), calculate_checksum(data));
+    }
+}
+
+TEST(ChecksumTest, IPv4PacketRewritesKeepChecksumValid) {
+    IPv4Packet original;
+    original.set_source_ip({192, 168, 1, 10});
+    original.set_destination_ip({10, 0, 0, 1});
+    original.set_protocol(IPv4Packet::PROTOCOL_TCP);
+    original.set_ttl(64);
+    original.set_payload({1, 2, 3, 4});
+    
+    IPv4Packet packet;
+    ASSERT_TRUE(packet.deserialize(original.serialize()));
+    ASSERT_TRUE(packet.decrement_ttl());
+    packet.rewrite_source_ip({203, 0, 113, 7});
+    packet.rewrite_destination_ip({198, 51, 100, 2});
+    
+    EXPECT_EQ(packet.get_header().ttl, 63);
+    EXPECT_EQ(packet.get_header().header_checksum, packet.calculate_checksum());
+    
+    packet.set_ttl(1);
+    EXPECT_FALSE(packet.decrement_ttl());
+}
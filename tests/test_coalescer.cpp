@@ -0,0 +1,181 @@
+#include <gtest/gtest.h>
+#include "ip/ipv4_packet.h"
+#include "tcp/tcp_coalescer.h"
+#include "tcp/tcp_options.h"
+#include "tcp/tcp_segment.h"
+#include <vector>
+
+struct Delivered {
+    uint32_t sequence;
+    uint8_t flags;
+    size_t count;
+    size_t payload_length;
+};
+
+// Raw IPv4 datagrams; the views handed to the coalescer point into them
+class CoalescerTest : public ::testing::Test {
+protected:
+    std::vector<std::vector<uint8_t>> datagrams;
+    std::vector<Delivered> delivered;
+
+    std::vector<uint8_t> make(uint32_t sequence, uint8_t flags, size_t payload_length, uint8_t client = 2,
+                              uint32_t ack = 1, uint32_t ts_value = 0) {
+        TCPSegment segment;
+        segment.set_source_port(40000);
+        segment.set_dest_port(80);
+        segment.set_sequence_number(sequence);
+        segment.set_ack_number(ack);
+        segment.set_flags(flags);
+        segment.set_window_size(1024);
+        if (ts_value != 0) {
+            TCPOptions options;
+            options.has_timestamps = true;
+            options.ts_value = ts_value;
+            segment.set_options(options);
+        }
+        segment.set_payload(std::vector<uint8_t>(payload_length, 0xAB));
+
+        IPv4Packet packet;
+        packet.set_protocol(IPv4Packet::PROTOCOL_TCP);
+        packet.set_source_ip({10, 0, 0, client});
+        packet.set_destination_ip({10, 0, 1, 1});
+        packet.set_payload(segment.serialize());
+        return packet.serialize();
+    }
+
+    void add(TCPCoalescer& gro, std::vector<uint8_t> datagram, bool may_hold = true) {
+        datagrams.push_back(std::move(datagram));
+        IPv4View ip;
+        TCPView tcp;
+        ASSERT_TRUE(ip.parse(datagrams.back()));
+        ASSERT_TRUE(tcp.parse(ip.get_payload()));
+        gro.add(ip, tcp, may_hold, [&](const CoalescedSegment& segment) { record(segment); });
+    }
+
+    void flush(TCPCoalescer& gro) {
+        gro.flush([&](const CoalescedSegment& segment) { record(segment); });
+    }
+
+    void record(const CoalescedSegment& segment) {
+        size_t total = 0;
+        for (std::span<const uint8_t> payload : segment.get_payloads()) {
+            total += payload.size();
+        }
+        EXPECT_EQ(total, segment.payload_length);
+        delivered.push_back({segment.tcp.get_sequence_number(), segment.flags, segment.count, segment.payload_length});
+    }
+
+    void SetUp() override { datagrams.reserve(256); }
+};
+
+TEST_F(CoalescerTest, ContiguousSegmentsMergeUntilTheBurstEnds) {
+    TCPCoalescer gro;
+    for (uint32_t i = 0; i < 4; ++i) {
+        add(gro, make(1000 + i * 100, TCPSegment::ACK, 100));
+    }
+    EXPECT_TRUE(delivered.empty());
+    EXPECT_EQ(gro.get_held(), 1u);
+
+    flush(gro);
+    ASSERT_EQ(delivered.size(), 1u);
+    EXPECT_EQ(delivered[0].sequence, 1000u);
+    EXPECT_EQ(delivered[0].count, 4u);
+    EXPECT_EQ(delivered[0].payload_length, 400u);
+    EXPECT_EQ(gro.get_held(), 0u);
+}
+
+TEST_F(CoalescerTest, GapsAndHeaderChangesStartANewSegment) {
+    TCPCoalescer gro;
+    add(gro, make(1000, TCPSegment::ACK, 100));
+    add(gro, make(1200, TCPSegment::ACK, 100));             // a hole before it
+    add(gro, make(1300, TCPSegment::ACK, 100, 2, 2));       // another ACK number
+    add(gro, make(1400, TCPSegment::ACK, 100, 2, 2, 7));    // options appear
+    add(gro, make(1500, TCPSegment::ACK, 100, 2, 2, 8));    // a newer timestamp
+    add(gro, make(1600, TCPSegment::ACK, 100, 2, 2, 8));
+    flush(gro);
+
+    ASSERT_EQ(delivered.size(), 5u);
+    EXPECT_EQ(delivered[0].sequence, 1000u);
+    EXPECT_EQ(delivered[1].sequence, 1200u);
+    EXPECT_EQ(delivered[2].sequence, 1300u);
+    EXPECT_EQ(delivered[3].sequence, 1400u);
+    EXPECT_EQ(delivered[4].sequence, 1500u);
+    EXPECT_EQ(delivered[4].count, 2u);
+}
+
+TEST_F(CoalescerTest, PshAndCapsDeliverAtOnce) {
+    TCPCoalescer gro;
+    add(gro, make(1000, TCPSegment::ACK, 100));
+    add(gro, make(1100, TCPSegment::ACK | TCPSegment::PSH, 100));
+    ASSERT_EQ(delivered.size(), 1u);
+    EXPECT_EQ(delivered[0].count, 2u);
+    EXPECT_TRUE(delivered[0].flags & TCPSegment::PSH);
+    EXPECT_EQ(gro.get_held(), 0u);
+
+    GroConfig config;
+    config.max_segments = 3;
+    config.max_bytes = 250;
+    TCPCoalescer capped(config);
+    delivered.clear();
+    for (uint32_t i = 0; i < 6; ++i) {
+        add(capped, make(2000 + i * 100, TCPSegment::ACK, 100));
+    }
+    flush(capped);
+    // The byte cap keeps a third segment out; appending is refused, not split
+    ASSERT_EQ(delivered.size(), 3u);
+    for (const Delivered& segment : delivered) {
+        EXPECT_EQ(segment.count, 2u);
+    }
+
+    config.max_bytes = 65535;
+    TCPCoalescer counted(config);
+    delivered.clear();
+    for (uint32_t i = 0; i < 7; ++i) {
+        add(counted, make(3000 + i * 100, TCPSegment::ACK, 100));
+    }
+    ASSERT_EQ(delivered.size(), 2u);
+    EXPECT_EQ(delivered[0].count, 3u);
+    EXPECT_EQ(delivered[1].count, 3u);
+    EXPECT_EQ(counted.get_held(), 1u);
+}
+
+TEST_F(CoalescerTest, OtherSegmentsKeepTheirOrderWithinAFlow) {
+    TCPCoalescer gro;
+    add(gro, make(1000, TCPSegment::ACK, 100));
+    add(gro, make(1100, TCPSegment::ACK, 100));
+    add(gro, make(1200, TCPSegment::ACK | TCPSegment::FIN, 0));
+    ASSERT_EQ(delivered.size(), 2u);
+    EXPECT_EQ(delivered[0].count, 2u);
+    EXPECT_EQ(delivered[1].sequence, 1200u);
+    EXPECT_TRUE(delivered[1].flags & TCPSegment::FIN);
+
+    // Not holding flushes the flow first, then goes straight through
+    delivered.clear();
+    add(gro, make(5000, TCPSegment::ACK, 100));
+    add(gro, make(5100, TCPSegment::ACK, 100), false);
+    ASSERT_EQ(delivered.size(), 2u);
+    EXPECT_EQ(delivered[0].sequence, 5000u);
+    EXPECT_EQ(delivered[1].sequence, 5100u);
+    EXPECT_EQ(gro.get_held(), 0u);
+}
+
+TEST_F(CoalescerTest, FlowsBeyondTheTableAreEvicted) {
+    TCPCoalescer gro;
+    for (uint8_t client = 0; client < TCPCoalescer::MAX_FLOWS + 2; ++client) {
+        add(gro, make(1000, TCPSegment::ACK, 100, client));
+    }
+    EXPECT_EQ(gro.get_held(), TCPCoalescer::MAX_FLOWS);
+    EXPECT_EQ(delivered.size(), 2u);
+
+    // Every segment is still delivered exactly once
+    for (uint8_t client = 0; client < TCPCoalescer::MAX_FLOWS + 2; ++client) {
+        add(gro, make(1100, TCPSegment::ACK, 100, client));
+    }
+    flush(gro);
+    size_t segments = 0;
+    for (const Delivered& segment : delivered) {
+        segments += segment.count;
+    }
+    EXPECT_EQ(segments, 2u * (TCPCoalescer::MAX_FLOWS + 2));
+    EXPECT_LT(delivered.size(), segments);
+}
@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <unordered_map>
+#include "tcp/connection_table.h"
+
+static FlowKey make_key(uint32_t n) {
+    return FlowKey{0x0A000001, 0xC0A80000 + (n >> 16), 80, static_cast<uint16_t>(n)};
+}
+
+TEST(ConnectionTableTest, InsertFindErase) {
+    ConnectionTable<int> table(16);
+    FlowKey key = make_key(1);
+    
+    EXPECT_EQ(table.find(key), nullptr);
+    auto [value, inserted] = table.emplace(key, 42);
+    EXPECT_TRUE(inserted);
+    EXPECT_EQ(*value, 42);
+    
+    auto [again, inserted_again] = table.emplace(key, 7);
+    EXPECT_FALSE(inserted_again);
+    EXPECT_EQ(again, value);
+    EXPECT_EQ(*table.find(key), 42);
+    
+    EXPECT_TRUE(table.erase(key));
+    EXPECT_FALSE(table.erase(key));
+    EXPECT_EQ(table.find(key), nullptr);
+    EXPECT_TRUE(table.empty());
+}
+
+TEST(ConnectionTableTest, LastFlowCacheAnswersRepeatedLookups) {
+    ConnectionTable<int> table;
+    table.emplace(make_key(1), 1);
+    table.emplace(make_key(2), 2);
+    
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_EQ(*table.find(make_key(2)), 2);
+    }
+    EXPECT_EQ(table.get_stats().lookups, 10u);
+    EXPECT_EQ(table.get_stats().cache_hits, 10u);
+    
+    // Erasing the cached flow must not leave a dangling answer
+    table.erase(make_key(2));
+    EXPECT_EQ(table.find(make_key(2)), nullptr);
+    EXPECT_EQ(*table.find(make_key(1)), 1);
+}
+
+TEST(ConnectionTableTest, ResizesIncrementallyWithStableValues) {
+    ConnectionTable<uint32_t> table(16);
+    std::vector<uint32_t*> values;
+    bool saw_resize_in_progress = false;
+    
+    for (uint32_t i = 0; i < 20000; ++i) {
+        values.push_back(table.emplace(make_key(i), i).first);
+        if (table.is_resizing()) {
+            saw_resize_in_progress = true;
+            // Everything stays reachable while entries are split across tables
+            ASSERT_EQ(table.find(make_key(i / 2)), values[i / 2]);
+        }
+    }
+    EXPECT_TRUE(saw_resize_in_progress);
+    EXPECT_GT(table.get_stats().resizes, 5u);
+    
+    table.finish_resize();
+    EXPECT_FALSE(table.is_resizing());
+    for (uint32_t i = 0; i < 20000; ++i) {
+        ASSERT_EQ(table.find(make_key(i)), values[i]);
+        ASSERT_EQ(*values[i], i);
+    }
+}
+
+TEST(ConnectionTableTest, MatchesReferenceMapUnderRandomChurn) {
+    ConnectionTable<uint64_t> table(16);
+    std::unordered_map<uint32_t, uint64_t> reference;
+    std::mt19937 rng(7);
+    
+    for (int step = 0; step < 200000; ++step) {
+        uint32_t n = rng() % 5000;
+        FlowKey key = make_key(n);
+        switch (rng() % 3) {
+            case 0: {
+                bool inserted = table.emplace(key, step).second;
+                EXPECT_EQ(inserted, reference.emplace(n, step).second);
+                break;
+            }
+            case 1:
+                EXPECT_EQ(table.erase(key), reference.erase(n) == 1);
+                break;
+            default: {
+                uint64_t* value = table.find(key);
+                auto it = reference.find(n);
+                ASSERT_EQ(value != nullptr, it != reference.end());
+                if (value != nullptr) {
+                    EXPECT_EQ(*value, it->second);
+                }
+                break;
+            }
+        }
+        ASSERT_EQ(table.size(), reference.size());
+    }
+    
+    size_t visited = 0;
+    table.for_each([&](const FlowKey& key, uint64_t& value) {
+        auto it = reference.find((key.remote_address - 0xC0A80000) << 16 | key.remote_port);
+        ASSERT_NE(it, reference.end());
+        EXPECT_EQ(value, it->second);
+        visited++;
+    });
+    EXPECT_EQ(visited, reference.size());
+}
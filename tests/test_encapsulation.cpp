@@ -0,0 +1,204 @@
+#include <gtest/gtest.h>
+#include "buffer/packet_pool.h"
+#include "ethernet/ethernet_frame.h"
+#include "ethernet/ethernet_view.h"
+#include "ip/checksum.h"
+#include "ip/ipv4_packet.h"
+#include "ip/ipv4_view.h"
+#include "tcp/tcp_segment.h"
+#include "tcp/tcp_segmenter.h"
+#include "tcp/tcp_view.h"
+
+static const std::array<uint8_t, 4> SOURCE_IP = {192, 168, 1, 10};
+static const std::array<uint8_t, 4> DEST_IP = {10, 0, 0, 1};
+
+struct Headers {
+    TCPSegment segment;
+    IPv4Packet packet;
+    EthernetFrame frame;
+};
+
+static Headers make_headers() {
+    Headers headers;
+    headers.segment.set_source_port(40000);
+    headers.segment.set_dest_port(80);
+    headers.segment.set_sequence_number(0x01020304);
+    headers.segment.set_ack_number(0xA0B0C0D0);
+    headers.segment.set_flags(TCPSegment::PSH | TCPSegment::ACK);
+    headers.segment.set_window_size(1024);
+    headers.packet.set_source_ip(SOURCE_IP);
+    headers.packet.set_destination_ip(DEST_IP);
+    headers.packet.set_protocol(IPv4Packet::PROTOCOL_TCP);
+    headers.packet.set_ttl(64);
+    headers.frame.set_destination_mac({0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF});
+    headers.frame.set_source_mac({0x11, 0x22, 0x33, 0x44, 0x55, 0x66});
+    headers.frame.set_ethertype(EthernetFrame::ETHERTYPE_IPV4);
+    return headers;
+}
+
+// The copying path: every layer serializes into a new vector
+static std::vector<uint8_t> serialize_frame(Headers headers, const std::vector<uint8_t>& payload) {
+    headers.segment.set_payload(payload);
+    headers.packet.set_payload(headers.segment.serialize(SOURCE_IP, DEST_IP));
+    headers.frame.set_payload(headers.packet.serialize());
+    return headers.frame.serialize();
+}
+
+static std::vector<uint8_t> odd_payload() {
+    std::vector<uint8_t> payload(333);
+    for (size_t i = 0; i < payload.size(); ++i) {
+        payload[i] = static_cast<uint8_t>(i * 13 + 1);
+    }
+    return payload;
+}
+
+TEST(EncapsulationTest, PrependMatchesSerialize) {
+    PacketPool pool;
+    Headers headers = make_headers();
+    auto payload = odd_payload();
+    
+    // Payload copied once, summed on the way in
+    PacketHandle packet = pool.alloc();
+    ASSERT_TRUE(packet);
+    uint32_t sum = checksum_partial_copy(packet.append(payload.size()), payload);
+    ASSERT_TRUE(headers.segment.prepend_to(packet, SOURCE_IP, DEST_IP, sum));
+    ASSERT_TRUE(headers.packet.prepend_to(packet));
+    ASSERT_TRUE(headers.frame.prepend_to(packet));
+    
+    auto expected = serialize_frame(headers, payload);
+    EXPECT_EQ(std::vector<uint8_t>(packet.span().begin(), packet.span().end()), expected);
+    
+    EthernetView eth;
+    IPv4View ip;
+    TCPView tcp;
+    ASSERT_TRUE(eth.parse(packet.span()));
+    ASSERT_TRUE(ip.parse(eth.get_payload()));
+    EXPECT_TRUE(ip.has_valid_checksum());
+    ASSERT_TRUE(tcp.parse(ip.get_payload()));
+    EXPECT_TRUE(tcp.has_valid_checksum(ip.get_source_address(), ip.get_destination_address()));
+}
+
+TEST(EncapsulationTest, PrependSumsPayloadWhenNoSumIsGiven) {
+    PacketPool pool;
+    Headers headers = make_headers();
+    auto payload = odd_payload();
+    
+    PacketHandle packet = pool.alloc();
+    std::copy(payload.begin(), payload.end(), packet.append(payload.size()));
+    ASSERT_TRUE(headers.segment.prepend_to(packet, SOURCE_IP, DEST_IP));
+    ASSERT_TRUE(headers.packet.prepend_to(packet));
+    ASSERT_TRUE(headers.frame.prepend_to(packet));
+    
+    auto expected = serialize_frame(headers, payload);
+    EXPECT_EQ(std::vector<uint8_t>(packet.span().begin(), packet.span().end()), expected);
+}
+
+TEST(EncapsulationTest, FailsWithoutHeadroom) {
+    PacketPoolConfig config;
+    config.buffer_count = 4;
+    config.headroom = TCPSegment::HEADER_SIZE + IPv4Packet::HEADER_SIZE;
+    PacketPool pool(config);
+    Headers headers = make_headers();
+    
+    PacketHandle packet = pool.alloc();
+    ASSERT_TRUE(headers.segment.prepend_to(packet, SOURCE_IP, DEST_IP));
+    ASSERT_TRUE(headers.packet.prepend_to(packet));
+    EXPECT_FALSE(headers.frame.prepend_to(packet));
+    EXPECT_EQ(packet.size(), TCPSegment::HEADER_SIZE + IPv4Packet::HEADER_SIZE);
+}
+
+TEST(EncapsulationTest, WriteHeaderChecksSpaceAndLength) {
+    Headers headers = make_headers();
+    std::array<uint8_t, 64> out{};
+    
+    EXPECT_FALSE(headers.frame.write_header_to(std::span<uint8_t>(out).first(13)));
+    EXPECT_TRUE(headers.frame.write_header_to(out));
+    EXPECT_FALSE(headers.packet.write_header_to(std::span<uint8_t>(out).first(19), 0));
+    EXPECT_FALSE(headers.packet.write_header_to(out, IPv4Packet::MAX_PAYLOAD + 1));
+    ASSERT_TRUE(headers.packet.write_header_to(out, 100));
+    
+    EXPECT_EQ((out[2] << 8) | out[3], 120);  // total length includes the header
+    EXPECT_EQ(calculate_checksum(std::span<const uint8_t>(out.data(), IPv4Packet::HEADER_SIZE)), 0);
+    EXPECT_FALSE(headers.segment.write_header_to(std::span<uint8_t>(out).first(19), SOURCE_IP, DEST_IP, 0, 0));
+}
+
+TEST(EncapsulationTest, SegmenterMatchesSerializingEachSegment) {
+    PacketPool pool;
+    Headers headers = make_headers();
+    TCPOptions options;
+    options.has_timestamps = true;
+    options.ts_value = 123456;
+    options.ts_echo = 654321;
+    headers.segment.set_options(options);
+    headers.segment.set_flags(TCPSegment::ACK | TCPSegment::PSH | TCPSegment::FIN);
+    headers.packet.set_identification(0xFFFE);
+    std::vector<uint8_t> payload(10'001);
+    for (size_t i = 0; i < payload.size(); ++i) {
+        payload[i] = static_cast<uint8_t>(i * 7 + i / 256);
+    }
+    
+    constexpr uint16_t MSS = 1448;
+    TCPSegmenter segmenter(headers.frame, headers.packet, headers.segment, MSS);
+    std::vector<PacketHandle> frames;
+    ASSERT_EQ(segmenter.segment(payload, pool, frames), payload.size());
+    ASSERT_EQ(frames.size(), 7u);
+    EXPECT_EQ(segmenter.get_sequence_number(), 0x01020304u + payload.size());
+    EXPECT_EQ(segmenter.get_identification(), 5);
+    
+    // Each frame is what serializing that slice on its own would give, with
+    // the sequence number and ID advanced and PSH and FIN on the last only
+    for (size_t i = 0; i < frames.size(); ++i) {
+        size_t offset = i * MSS;
+        size_t length = std::min<size_t>(MSS, payload.size() - offset);
+        bool last = i + 1 == frames.size();
+        Headers expected = headers;
+        expected.segment.set_sequence_number(0x01020304 + static_cast<uint32_t>(offset));
+        expected.segment.set_flags(last ? TCPSegment::ACK | TCPSegment::PSH | TCPSegment::FIN : TCPSegment::ACK);
+        expected.packet.set_identification(static_cast<uint16_t>(0xFFFE + i));
+        std::vector<uint8_t> slice(payload.begin() + offset, payload.begin() + offset + length);
+        
+        EXPECT_EQ(std::vector<uint8_t>(frames[i].span().begin(), frames[i].span().end()),
+                  serialize_frame(expected, slice)) << "frame " << i;
+        
+        EthernetView eth;
+        IPv4View ip;
+        TCPView tcp;
+        ASSERT_TRUE(eth.parse(frames[i].span()));
+        ASSERT_TRUE(ip.parse(eth.get_payload()));
+        EXPECT_TRUE(ip.has_valid_checksum());
+        ASSERT_TRUE(tcp.parse(ip.get_payload()));
+        EXPECT_TRUE(tcp.has_valid_checksum(ip.get_source_address(), ip.get_destination_address()));
+        EXPECT_EQ(tcp.get_payload().size(), length);
+    }
+}
+
+TEST(EncapsulationTest, SegmenterContinuesWhereThePoolRanOut) {
+    PacketPoolConfig config;
+    config.buffer_count = 4;
+    config.cache_size = 0;
+    PacketPool pool(config);
+    Headers headers = make_headers();
+    std::vector<uint8_t> payload(10 * 1000, 0x5A);
+    
+    TCPSegmenter segmenter(headers.frame, headers.packet, headers.segment, 1000);
+    std::vector<PacketHandle> frames;
+    EXPECT_EQ(segmenter.segment(payload, pool, frames), 4000u);
+    EXPECT_EQ(frames.size(), 4u);
+    EXPECT_EQ(segmenter.get_sequence_number(), 0x01020304u + 4000);
+    
+    // The fourth frame was not the last of the payload, so has no PSH
+    TCPView tcp;
+    ASSERT_TRUE(tcp.parse(frames[3].span().subspan(EthernetFrame::HEADER_SIZE + IPv4Packet::HEADER_SIZE)));
+    EXPECT_EQ(tcp.get_flags(), TCPSegment::ACK);
+    
+    frames.clear();
+    EXPECT_EQ(segmenter.segment(std::span<const uint8_t>(payload).subspan(4000), pool, frames), 4000u);
+    ASSERT_TRUE(tcp.parse(frames[0].span().subspan(EthernetFrame::HEADER_SIZE + IPv4Packet::HEADER_SIZE)));
+    EXPECT_EQ(tcp.get_sequence_number(), 0x01020304u + 4000);
+    
+    // A frame larger than a pool buffer is never cut short
+    frames.clear();
+    TCPSegmenter jumbo(headers.frame, headers.packet, headers.segment, 9000);
+    EXPECT_EQ(jumbo.segment(payload, pool, frames), 0u);
+    EXPECT_TRUE(frames.empty());
+}
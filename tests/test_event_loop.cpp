@@ -0,0 +1,170 @@
+#include <gtest/gtest.h>
+#include "coro/event_loop.h"
+#include "coro/task.h"
+#include "stack.h"
+#include <vector>
+
+static constexpr uint32_t HOST = 0x0A000001;
+
+static StackConfig loopback_config() {
+    StackConfig config;
+    config.address = HOST;
+    return config;
+}
+
+static Task echo(AsyncConnection connection) {
+    std::vector<uint8_t> buffer(4096);
+    while (true) {
+        IoResult read = co_await connection.read(buffer);
+        if (read.bytes == 0) {
+            break;
+        }
+        std::span<const uint8_t> pending(buffer.data(), read.bytes);
+        while (!pending.empty()) {
+            IoResult written = co_await connection.write(pending);
+            if (written.error != SocketError::NONE) {
+                co_return;
+            }
+            pending = pending.subspan(written.bytes);
+        }
+    }
+}
+
+static Task serve(AsyncListener& listener, size_t connections) {
+    for (size_t i = 0; i < connections; ++i) {
+        AsyncConnection connection = co_await listener.accept();
+        if (!connection.is_open()) {
+            co_return;
+        }
+        echo(std::move(connection));
+    }
+}
+
+struct ClientResult {
+    bool connected = false;
+    std::vector<uint8_t> received;
+    bool done = false;
+};
+
+static Task client(EventLoop& loop, uint16_t port, std::vector<uint8_t> data, ClientResult& result) {
+    AsyncConnection connection = co_await loop.connect(HOST, port);
+    result.connected = connection.is_open();
+    std::span<const uint8_t> pending(data);
+    std::vector<uint8_t> buffer(1500);
+    while (connection.is_open() && result.received.size() < data.size()) {
+        if (!pending.empty()) {
+            IoResult written = co_await connection.write(pending.subspan(0, std::min<size_t>(pending.size(), 3000)));
+            pending = pending.subspan(written.bytes);
+        }
+        IoResult read = co_await connection.read(buffer);
+        if (read.bytes == 0) {
+            break;
+        }
+        result.received.insert(result.received.end(), buffer.begin(), buffer.begin() + read.bytes);
+    }
+    result.done = true;
+}
+
+TEST(EventLoopTest, ConnectionsEchoOverLoopback) {
+    TCPIPStack stack("loop", loopback_config());
+    EventLoop loop(stack);
+    AsyncListener listener = loop.listen(7);
+    ASSERT_TRUE(listener.is_open());
+
+    constexpr size_t CLIENTS = 8;
+    serve(listener, CLIENTS);
+    std::vector<ClientResult> results(CLIENTS);
+    std::vector<std::vector<uint8_t>> sent(CLIENTS);
+    for (size_t i = 0; i < CLIENTS; ++i) {
+        for (size_t j = 0; j < 50'000 + i * 1000; ++j) {
+            sent[i].push_back(static_cast<uint8_t>(i * 31 + j * 7));
+        }
+        client(loop, 7, sent[i], results[i]);
+    }
+
+    for (size_t turn = 0; turn < 100'000; ++turn) {
+        loop.run_once();
+        bool done = true;
+        for (const ClientResult& result : results) {
+            done = done && result.done;
+        }
+        if (done) {
+            break;
+        }
+    }
+    for (size_t i = 0; i < CLIENTS; ++i) {
+        EXPECT_TRUE(results[i].connected);
+        ASSERT_TRUE(results[i].done);
+        EXPECT_EQ(results[i].received, sent[i]);
+    }
+
+    // The clients closed: the servers read the end of the stream and close
+    // too, and nothing waits any more
+    loop.run(1000);
+    EXPECT_EQ(loop.get_waiting(), 0u);
+    EXPECT_GT(loop.get_stats().resumed, 0u);
+    EXPECT_EQ(stack.get_metrics().get(Metric::TCP_LISTEN_OVERFLOWS), 0u);
+}
+
+TEST(EventLoopTest, ClosingASocketWakesItsWaiter) {
+    TCPIPStack stack("loop", loopback_config());
+    EventLoop loop(stack);
+    AsyncListener listener = loop.listen(7);
+    bool woken = false;
+    bool open = true;
+    auto accept_one = [](AsyncListener& listener, bool& woken, bool& open) -> Task {
+        AsyncConnection connection = co_await listener.accept();
+        open = connection.is_open();
+        woken = true;
+    };
+    accept_one(listener, woken, open);
+    loop.run_once();
+    EXPECT_FALSE(woken);
+    EXPECT_EQ(loop.get_waiting(), 1u);
+
+    listener.close();
+    loop.run_once();
+    EXPECT_TRUE(woken);
+    EXPECT_FALSE(open);
+    EXPECT_EQ(loop.get_waiting(), 0u);
+}
+
+struct Flag {
+    bool& destroyed;
+    ~Flag() { destroyed = true; }
+};
+
+TEST(EventLoopTest, WaitingCoroutinesAreDestroyedWithTheLoop) {
+    TCPIPStack stack("loop", loopback_config());
+    bool destroyed = false;
+    {
+        EventLoop loop(stack);
+        AsyncListener listener = loop.listen(7);
+        auto wait_forever = [](AsyncListener& listener, bool& destroyed) -> Task {
+            Flag flag{destroyed};
+            co_await listener.accept();
+        };
+        wait_forever(listener, destroyed);
+        loop.run_once();
+        EXPECT_FALSE(destroyed);
+    }
+    EXPECT_TRUE(destroyed);
+}
+
+TEST(EventLoopTest, FramesAreReused) {
+    FramePoolStats before = FramePool::get_stats();
+    for (int i = 0; i < 100; ++i) {
+        [](int value) -> Task {
+            volatile int kept = value;
+            (void)kept;
+            co_return;
+        }(i);
+    }
+    FramePoolStats after = FramePool::get_stats();
+    EXPECT_EQ(after.allocations - before.allocations, 100u);
+    EXPECT_GE(after.reused - before.reused, 99u);
+
+    void* large = FramePool::allocate(FramePool::MAX_POOLED + 1);
+    FramePool::release(large, FramePool::MAX_POOLED + 1);
+    EXPECT_EQ(FramePool::get_stats().oversize - after.oversize, 1u);
+}
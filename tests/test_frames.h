@@ -0,0 +1,133 @@
+#pragma once
+#include <gtest/gtest.h>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "ethernet/ethernet_frame.h"
+#include "ip/checksum.h"
+#include "ip/ipv4_packet.h"
+#include "link/capture_file.h"
+#include "tcp/tcp_segment.h"
+#include "util/byte_order.h"
+
+// Builds the Ethernet/IPv4/TCP frames the tests feed to views, hashes and
+// stacks. Fields left alone give a bare segment from 10.0.0.2:40000 to
+// 10.0.1.1:80, the address tests give the stack.
+struct TestFrame {
+    std::array<uint8_t, 4> source_ip = {10, 0, 0, 2};
+    std::array<uint8_t, 4> destination_ip = {10, 0, 1, 1};
+    uint16_t source_port = 40000;
+    uint16_t dest_port = 80;
+    uint32_t sequence = 0;
+    uint32_t ack = 0;
+    uint8_t flags = 0;
+    uint16_t window = 0;
+    std::vector<uint8_t> payload;
+    TCPOptions options;
+    bool tcp_checksum = false;          // fill in the TCP checksum, which is left zero otherwise
+    size_t tcp_bytes = 0;               // cut or pad the TCP bytes to this length, unless 0
+    uint8_t ttl = 64;
+    uint8_t protocol = IPv4Packet::PROTOCOL_TCP;
+    uint16_t ethertype = EthernetFrame::ETHERTYPE_IPV4;
+    std::array<uint8_t, 6> source_mac{};
+    std::array<uint8_t, 6> destination_mac{};
+};
+
+inline std::vector<uint8_t> build_frame(const TestFrame& spec) {
+    TCPSegment segment;
+    segment.set_source_port(spec.source_port);
+    segment.set_dest_port(spec.dest_port);
+    segment.set_sequence_number(spec.sequence);
+    segment.set_ack_number(spec.ack);
+    segment.set_flags(spec.flags);
+    segment.set_window_size(spec.window);
+    segment.set_options(spec.options);
+    segment.set_payload(spec.payload);
+    std::vector<uint8_t> tcp = spec.tcp_checksum ? segment.serialize(spec.source_ip, spec.destination_ip)
+                                                 : segment.serialize();
+    if (spec.tcp_bytes != 0) {
+        tcp.resize(spec.tcp_bytes);
+    }
+
+    IPv4Packet packet;
+    packet.set_protocol(spec.protocol);
+    packet.set_ttl(spec.ttl);
+    packet.set_source_ip(spec.source_ip);
+    packet.set_destination_ip(spec.destination_ip);
+    packet.set_payload(tcp);
+
+    EthernetFrame frame;
+    frame.set_source_mac(spec.source_mac);
+    frame.set_destination_mac(spec.destination_mac);
+    frame.set_ethertype(spec.ethertype);
+    frame.set_payload(packet.serialize());
+    return frame.serialize();
+}
+
+// Splits a frame's IPv4 payload into two fragments at first_length bytes
+inline std::vector<std::vector<uint8_t>> fragment_frame(const std::vector<uint8_t>& frame, size_t first_length) {
+    constexpr size_t IP_OFFSET = 14;
+    constexpr size_t PAYLOAD_OFFSET = IP_OFFSET + 20;
+    std::vector<std::vector<uint8_t>> fragments;
+    for (bool first : {true, false}) {
+        std::vector<uint8_t> out(frame.begin(), frame.begin() + PAYLOAD_OFFSET);
+        if (first) {
+            out.insert(out.end(), frame.begin() + PAYLOAD_OFFSET, frame.begin() + PAYLOAD_OFFSET + first_length);
+        } else {
+            out.insert(out.end(), frame.begin() + PAYLOAD_OFFSET + first_length, frame.end());
+        }
+        uint8_t* ip = out.data() + IP_OFFSET;
+        write_be16(ip + 2, static_cast<uint16_t>(out.size() - IP_OFFSET));
+        write_be16(ip + 4, 0x1234);
+        write_be16(ip + 6, static_cast<uint16_t>(first ? 0x2000 : first_length / 8));
+        write_be16(ip + 10, 0);
+        write_be16(ip + 10, calculate_checksum(std::span<const uint8_t>(ip, 20)));
+        fragments.push_back(std::move(out));
+    }
+    return fragments;
+}
+
+// Pcap files for TCPIPStack::replay() and CaptureFile
+inline void put32(std::vector<uint8_t>& out, uint32_t value) {
+    uint8_t bytes[4];
+    std::memcpy(bytes, &value, 4);
+    out.insert(out.end(), bytes, bytes + 4);
+}
+
+inline void put16(std::vector<uint8_t>& out, uint16_t value) {
+    uint8_t bytes[2];
+    std::memcpy(bytes, &value, 2);
+    out.insert(out.end(), bytes, bytes + 2);
+}
+
+inline std::string write_file(const std::string& name, const std::vector<uint8_t>& bytes) {
+    std::string path = testing::TempDir() + name;
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    return path;
+}
+
+// Classic pcap with nanosecond timestamps, written in host byte order
+inline std::vector<uint8_t> make_pcap(const std::vector<std::vector<uint8_t>>& frames) {
+    std::vector<uint8_t> out;
+    put32(out, 0xA1B23C4D);
+    put16(out, 2);
+    put16(out, 4);
+    put32(out, 0);
+    put32(out, 0);
+    put32(out, 65535);
+    put32(out, CaptureFile::LINKTYPE_ETHERNET);
+    
+    for (size_t i = 0; i < frames.size(); ++i) {
+        put32(out, 100);
+        put32(out, static_cast<uint32_t>(i * 1000));
+        put32(out, static_cast<uint32_t>(frames[i].size()));
+        put32(out, static_cast<uint32_t>(frames[i].size()));
+        out.insert(out.end(), frames[i].begin(), frames[i].end());
+    }
+    return out;
+}
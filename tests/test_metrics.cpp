@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "core/metrics.h"
+#include "ethernet/ethernet_frame.h"
+
+TEST(MetricsTest, BlocksAreCacheLineAligned) {
+    EXPECT_EQ(alignof(MetricCounters), 64u);
+    EXPECT_EQ(sizeof(MetricCounters) % 64, 0u);
+}
+
+TEST(MetricsTest, SnapshotSumsPerThreadBlocks) {
+    std::vector<MetricCounters> blocks(4);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < blocks.size(); ++t) {
+        threads.emplace_back([&block = blocks[t]] {
+            for (int i = 0; i < 10000; ++i) {
+                block.add(Metric::RX_PACKETS);
+                block.add(Metric::RX_BYTES, 60);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    MetricsSnapshot snapshot;
+    for (const auto& block : blocks) {
+        snapshot.add(block);
+    }
+    EXPECT_EQ(snapshot.get(Metric::RX_PACKETS), 40000u);
+    EXPECT_EQ(snapshot.get(Metric::RX_BYTES), 2400000u);
+    EXPECT_EQ(snapshot.get(Metric::TCP_BAD_STATE), 0u);
+}
+
+TEST(MetricsTest, SinceGivesTheDelta) {
+    MetricCounters counters;
+    counters.add(Metric::TCP_SEGMENTS, 5);
+    MetricsSnapshot before;
+    before.add(counters);
+    counters.add(Metric::TCP_SEGMENTS, 3);
+    MetricsSnapshot after;
+    after.add(counters);
+    
+    EXPECT_EQ(after.since(before).get(Metric::TCP_SEGMENTS), 3u);
+}
+
+TEST(MetricsTest, WritesTextAndPrometheus) {
+    MetricsSnapshot snapshot;
+    snapshot.add(Metric::IP_BAD_CHECKSUM, 7);
+    
+    std::ostringstream text;
+    snapshot.write_text(text);
+    EXPECT_NE(text.str().find("ip_bad_checksum         7\n"), std::string::npos);
+    EXPECT_NE(text.str().find("rx_packets              0\n"), std::string::npos);
+    
+    std::ostringstream prometheus;
+    snapshot.write_prometheus(prometheus);
+    EXPECT_NE(prometheus.str().find("# TYPE tcp_stack_ip_bad_checksum_total counter\n"), std::string::npos);
+    EXPECT_NE(prometheus.str().find("\ntcp_stack_ip_bad_checksum_total 7\n"), std::string::npos);
+}
+
+TEST(MetricsTest, ProcessCountersSurviveThreadExit) {
+    uint64_t before = get_process_metrics().get(Metric::ETH_TOO_SHORT);
+    std::thread parser([] {
+        EthernetFrame frame;
+        EXPECT_FALSE(frame.deserialize(std::vector<uint8_t>(10)));
+        EXPECT_FALSE(frame.deserialize(std::vector<uint8_t>(3)));
+    });
+    parser.join();
+    EXPECT_EQ(get_process_metrics().get(Metric::ETH_TOO_SHORT) - before, 2u);
+}
+
+// Counts from its destructor, which runs after the metrics slot's when the
+// object was created before the thread's first count
+struct CountsOnThreadExit {
+    ~CountsOnThreadExit() { count_metric(Metric::ETH_TOO_SHORT, 1000); }
+};
+
+TEST(MetricsTest, CountsAfterTheThreadExitsAreDropped) {
+    uint64_t before = get_process_metrics().get(Metric::ETH_TOO_SHORT);
+    std::thread counter([] {
+        static thread_local CountsOnThreadExit late;
+        (void)late;
+        count_metric(Metric::ETH_TOO_SHORT);
+    });
+    counter.join();
+    EXPECT_EQ(get_process_metrics().get(Metric::ETH_TOO_SHORT) - before, 1u);
+}
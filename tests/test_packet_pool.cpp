@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+#include "buffer/packet_pool.h"
+#include <cstring>
+#include <thread>
+#include <vector>
+
+static PacketPoolConfig small_pool(size_t buffers, size_t cache_size = 4) {
+    PacketPoolConfig config;
+    config.buffer_count = buffers;
+    config.buffer_size = 256;
+    config.headroom = 64;
+    config.cache_size = cache_size;
+    return config;
+}
+
+TEST(PacketPoolTest, HeadroomAndTailroom) {
+    PacketPool pool(small_pool(4));
+    PacketHandle packet = pool.alloc();
+    ASSERT_TRUE(packet);
+    EXPECT_EQ(packet.size(), 0u);
+    EXPECT_EQ(packet.headroom(), 64u);
+    EXPECT_EQ(packet.tailroom(), 192u);
+    
+    uint8_t* body = packet.append(100);
+    ASSERT_NE(body, nullptr);
+    std::memset(body, 0xAB, 100);
+    
+    uint8_t* header = packet.prepend(14);
+    ASSERT_NE(header, nullptr);
+    EXPECT_EQ(header + 14, body);
+    EXPECT_EQ(packet.size(), 114u);
+    EXPECT_EQ(packet.headroom(), 50u);
+    
+    EXPECT_EQ(packet.prepend(51), nullptr);
+    EXPECT_EQ(packet.append(93), nullptr);
+    EXPECT_TRUE(packet.adjust(14));
+    EXPECT_EQ(packet.data(), body);
+    EXPECT_TRUE(packet.trim(100));
+    EXPECT_EQ(packet.size(), 0u);
+    EXPECT_FALSE(packet.trim(1));
+}
+
+TEST(PacketPoolTest, LastReleaseReturnsBuffer) {
+    PacketPool pool(small_pool(1, 0));
+    PacketHandle first = pool.alloc();
+    ASSERT_TRUE(first);
+    
+    PacketHandle shared = first;
+    EXPECT_EQ(first.get_refcount(), 2u);
+    first.release();
+    EXPECT_FALSE(pool.alloc());
+    
+    shared.release();
+    EXPECT_TRUE(pool.alloc());
+}
+
+TEST(PacketPoolTest, ExhaustionIsBoundedAndCounted) {
+    PacketPool pool(small_pool(8));
+    std::vector<PacketHandle> held(8);
+    EXPECT_EQ(pool.alloc_burst(held.data(), held.size()), 8u);
+    
+    EXPECT_FALSE(pool.alloc());
+    EXPECT_FALSE(pool.alloc());
+    EXPECT_EQ(pool.get_stats().exhausted, 2u);
+    
+    held.clear();
+    std::vector<PacketHandle> again(8);
+    EXPECT_EQ(pool.alloc_burst(again.data(), again.size()), 8u);
+}
+
+TEST(PacketPoolTest, BuffersFreedOnOtherThreadsAreReused) {
+    PacketPool pool(small_pool(64, 8));
+    
+    for (int round = 0; round < 50; ++round) {
+        std::vector<PacketHandle> batch(64);
+        ASSERT_EQ(pool.alloc_burst(batch.data(), batch.size()), 64u) << "round " << round;
+        
+        // Release everything from a different thread, whose cache spills back
+        std::thread releaser([batch = std::move(batch)]() mutable {
+            batch.clear();
+        });
+        releaser.join();
+    }
+    EXPECT_EQ(pool.get_stats().exhausted, 0u);
+}
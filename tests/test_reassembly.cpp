@@ -0,0 +1,170 @@
+#include <gtest/gtest.h>
+#include "ip/ipv4_reassembler.h"
+#include "ip/ipv4_view.h"
+#include "ip/ipv4_packet.h"
+#include "ip/checksum.h"
+#include "util/byte_order.h"
+#include <numeric>
+#include <vector>
+
+// Payload byte i of every test datagram is i & 0xFF, so any misplaced
+// fragment shows up in the reassembled bytes
+static std::vector<uint8_t> make_fragment(uint16_t id, size_t offset, size_t length, bool more,
+                                          uint32_t source = 0x0A000002) {
+    std::vector<uint8_t> packet(20 + length);
+    packet[0] = 0x45;
+    write_be16(packet.data() + 2, static_cast<uint16_t>(packet.size()));
+    write_be16(packet.data() + 4, id);
+    write_be16(packet.data() + 6, static_cast<uint16_t>((more ? IPv4View::FLAG_MF : 0) | (offset / 8)));
+    packet[8] = 64;
+    packet[9] = IPv4Packet::PROTOCOL_UDP;
+    write_be32(packet.data() + 12, source);
+    write_be32(packet.data() + 16, 0x0A000101);
+    write_be16(packet.data() + 10, calculate_checksum(std::span<const uint8_t>(packet.data(), 20)));
+    for (size_t i = 0; i < length; ++i) {
+        packet[20 + i] = static_cast<uint8_t>((offset + i) & 0xFF);
+    }
+    return packet;
+}
+
+class ReassemblyTest : public ::testing::Test {
+protected:
+    PacketPool pool{PacketPoolConfig{.buffer_count = 256, .cache_size = 0}};
+
+    ReassemblyResult add(IPv4Reassembler& reassembler, const std::vector<uint8_t>& packet, uint64_t now_ns = 0) {
+        IPv4View view;
+        EXPECT_TRUE(view.parse(packet));
+        return reassembler.add(view, now_ns, datagram);
+    }
+
+    std::span<const uint8_t> datagram;
+};
+
+static void expect_datagram(std::span<const uint8_t> datagram, size_t payload_length) {
+    IPv4View view;
+    ASSERT_TRUE(view.parse(datagram));
+    EXPECT_FALSE(view.is_fragment());
+    EXPECT_TRUE(view.has_valid_checksum());
+    EXPECT_EQ(view.get_total_length(), 20 + payload_length);
+    auto payload = view.get_payload();
+    ASSERT_EQ(payload.size(), payload_length);
+    for (size_t i = 0; i < payload_length; ++i) {
+        ASSERT_EQ(payload[i], static_cast<uint8_t>(i & 0xFF)) << "at " << i;
+    }
+}
+
+TEST_F(ReassemblyTest, InOrderAndOutOfOrderComplete) {
+    IPv4Reassembler reassembler(pool);
+    EXPECT_EQ(add(reassembler, make_fragment(1, 0, 1480, true)), ReassemblyResult::PENDING);
+    EXPECT_EQ(add(reassembler, make_fragment(1, 1480, 1480, true)), ReassemblyResult::PENDING);
+    EXPECT_EQ(add(reassembler, make_fragment(1, 2960, 100, false)), ReassemblyResult::COMPLETE);
+    expect_datagram(datagram, 3060);
+
+    // Last first, header last
+    EXPECT_EQ(add(reassembler, make_fragment(2, 2960, 100, false)), ReassemblyResult::PENDING);
+    EXPECT_EQ(add(reassembler, make_fragment(2, 1480, 1480, true)), ReassemblyResult::PENDING);
+    EXPECT_EQ(add(reassembler, make_fragment(2, 0, 1480, true)), ReassemblyResult::COMPLETE);
+    expect_datagram(datagram, 3060);
+
+    ReassemblyStats stats = reassembler.get_stats();
+    EXPECT_EQ(stats.fragments, 6u);
+    EXPECT_EQ(stats.completed, 2u);
+    EXPECT_EQ(stats.pending_datagrams, 0u);
+    EXPECT_EQ(stats.buffered_bytes, 0u);
+    EXPECT_EQ(pool.get_stats().free_buffers, pool.get_stats().capacity);
+}
+
+TEST_F(ReassemblyTest, InterleavedDatagramsStaySeparate) {
+    IPv4Reassembler reassembler(pool);
+    EXPECT_EQ(add(reassembler, make_fragment(7, 0, 800, true, 1)), ReassemblyResult::PENDING);
+    EXPECT_EQ(add(reassembler, make_fragment(7, 0, 800, true, 2)), ReassemblyResult::PENDING);
+    EXPECT_EQ(add(reassembler, make_fragment(7, 800, 10, false, 2)), ReassemblyResult::COMPLETE);
+    expect_datagram(datagram, 810);
+    EXPECT_EQ(reassembler.get_stats().pending_datagrams, 1u);
+}
+
+TEST_F(ReassemblyTest, DuplicatesAreIgnoredAndOverlapsDropTheDatagram) {
+    IPv4Reassembler reassembler(pool);
+    EXPECT_EQ(add(reassembler, make_fragment(1, 0, 800, true)), ReassemblyResult::PENDING);
+    EXPECT_EQ(add(reassembler, make_fragment(1, 0, 800, true)), ReassemblyResult::PENDING);
+    EXPECT_EQ(add(reassembler, make_fragment(1, 800, 16, false)), ReassemblyResult::COMPLETE);
+
+    EXPECT_EQ(add(reassembler, make_fragment(2, 0, 800, true)), ReassemblyResult::PENDING);
+    EXPECT_EQ(add(reassembler, make_fragment(2, 792, 16, false)), ReassemblyResult::DROPPED);
+    // The rest of a dropped datagram starts over and never completes on its own
+    EXPECT_EQ(add(reassembler, make_fragment(2, 800, 16, false)), ReassemblyResult::PENDING);
+
+    ReassemblyStats stats = reassembler.get_stats();
+    EXPECT_EQ(stats.duplicates, 1u);
+    EXPECT_EQ(stats.overlaps, 1u);
+    EXPECT_EQ(stats.completed, 1u);
+    EXPECT_EQ(stats.pending_datagrams, 1u);
+}
+
+TEST_F(ReassemblyTest, InvalidFragmentsAreRejected) {
+    IPv4Reassembler reassembler(pool);
+    // A non-final fragment must be a multiple of 8 bytes
+    EXPECT_EQ(add(reassembler, make_fragment(1, 0, 801, true)), ReassemblyResult::DROPPED);
+    // Past the 65535-byte limit
+    EXPECT_EQ(add(reassembler, make_fragment(2, 65528, 100, false)), ReassemblyResult::DROPPED);
+    // A second, different end
+    EXPECT_EQ(add(reassembler, make_fragment(3, 800, 16, false)), ReassemblyResult::PENDING);
+    EXPECT_EQ(add(reassembler, make_fragment(3, 800, 24, false)), ReassemblyResult::DROPPED);
+
+    ReassemblyStats stats = reassembler.get_stats();
+    EXPECT_EQ(stats.invalid, 3u);
+    EXPECT_EQ(stats.pending_datagrams, 0u);
+}
+
+TEST_F(ReassemblyTest, IncompleteDatagramsTimeOut) {
+    ReassemblyConfig config;
+    config.timeout_ns = 1000;
+    IPv4Reassembler reassembler(pool, config);
+    add(reassembler, make_fragment(1, 0, 800, true), 0);
+    add(reassembler, make_fragment(2, 0, 800, true), 500);
+
+    EXPECT_EQ(reassembler.expire(999), 0u);
+    EXPECT_EQ(reassembler.expire(1000), 1u);
+    EXPECT_EQ(reassembler.get_stats().pending_datagrams, 1u);
+    EXPECT_EQ(reassembler.expire(1500), 1u);
+
+    ReassemblyStats stats = reassembler.get_stats();
+    EXPECT_EQ(stats.timeouts, 2u);
+    EXPECT_EQ(stats.buffered_bytes, 0u);
+    EXPECT_EQ(pool.get_stats().free_buffers, pool.get_stats().capacity);
+}
+
+TEST_F(ReassemblyTest, FloodStaysWithinLimits) {
+    ReassemblyConfig config;
+    config.max_datagrams = 16;
+    config.max_fragments = 32;
+    config.max_buffered_bytes = 16 * 1024;
+    IPv4Reassembler reassembler(pool, config);
+
+    // Never-completing first fragments from many sources
+    for (uint32_t i = 0; i < 5000; ++i) {
+        add(reassembler, make_fragment(static_cast<uint16_t>(i), 0, 1000, true, i));
+        ReassemblyStats stats = reassembler.get_stats();
+        ASSERT_LE(stats.pending_datagrams, config.max_datagrams);
+        ASSERT_LE(stats.buffered_bytes, config.max_buffered_bytes);
+    }
+    EXPECT_GT(reassembler.get_stats().evicted, 0u);
+    EXPECT_LE(pool.get_stats().capacity - pool.get_stats().free_buffers, config.max_fragments);
+
+    // A legitimate datagram still gets through
+    EXPECT_EQ(add(reassembler, make_fragment(9, 0, 1000, true)), ReassemblyResult::PENDING);
+    EXPECT_EQ(add(reassembler, make_fragment(9, 1000, 40, false)), ReassemblyResult::COMPLETE);
+    expect_datagram(datagram, 1040);
+}
+
+TEST_F(ReassemblyTest, PerDatagramFragmentCap) {
+    ReassemblyConfig config;
+    config.max_fragments_per_datagram = 4;
+    IPv4Reassembler reassembler(pool, config);
+    for (size_t i = 0; i < 4; ++i) {
+        EXPECT_EQ(add(reassembler, make_fragment(1, i * 8, 8, true)), ReassemblyResult::PENDING);
+    }
+    EXPECT_EQ(add(reassembler, make_fragment(1, 32, 8, false)), ReassemblyResult::DROPPED);
+    EXPECT_EQ(reassembler.get_stats().invalid, 1u);
+    EXPECT_EQ(reassembler.get_stats().pending_datagrams, 0u);
+}
@@ -0,0 +1,182 @@
+#include <gtest/gtest.h>
+#include "tcp/tcp_receive_buffer.h"
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+// Byte i of the stream is i & 0xFF, so misplaced data shows up on read
+static std::vector<uint8_t> stream_bytes(size_t offset, size_t length) {
+    std::vector<uint8_t> bytes(length);
+    for (size_t i = 0; i < length; ++i) {
+        bytes[i] = static_cast<uint8_t>((offset + i) & 0xFF);
+    }
+    return bytes;
+}
+
+static void expect_stream(TCPReceiveBuffer& buffer, size_t offset, size_t length) {
+    std::vector<uint8_t> out(length);
+    ASSERT_EQ(buffer.read(out), length);
+    EXPECT_EQ(out, stream_bytes(offset, length));
+}
+
+class ReceiveBufferTest : public ::testing::Test {
+protected:
+    static constexpr uint32_t ISN = 1000;
+
+    TCPReceiveBuffer buffer;
+
+    ReceiveOutcome receive(size_t offset, size_t length) {
+        return buffer.receive(ISN + static_cast<uint32_t>(offset), stream_bytes(offset, length));
+    }
+};
+
+TEST_F(ReceiveBufferTest, CapacityRoundsUpToPowerOfTwo) {
+    EXPECT_FALSE(buffer.is_open());
+    buffer.open(ISN, 3000);
+    EXPECT_TRUE(buffer.is_open());
+    EXPECT_EQ(buffer.get_capacity(), 4096u);
+    EXPECT_EQ(buffer.get_window(), 4096u);
+    EXPECT_EQ(buffer.get_rcv_nxt(), ISN);
+}
+
+TEST_F(ReceiveBufferTest, InOrderDataIsReadableInPlace) {
+    buffer.open(ISN, 4096);
+    EXPECT_EQ(receive(0, 100), ReceiveOutcome::IN_ORDER);
+    EXPECT_EQ(receive(100, 50), ReceiveOutcome::IN_ORDER);
+    EXPECT_EQ(buffer.get_rcv_nxt(), ISN + 150);
+    EXPECT_EQ(buffer.get_window(), 4096u - 150);
+
+    auto readable = buffer.peek();
+    ASSERT_EQ(readable.size(), 150u);
+    EXPECT_TRUE(std::equal(readable.begin(), readable.end(), stream_bytes(0, 150).begin()));
+    buffer.consume(150);
+    EXPECT_EQ(buffer.get_window(), 4096u);
+}
+
+TEST_F(ReceiveBufferTest, OutOfOrderDataFillsTheHole) {
+    buffer.open(ISN, 4096);
+    EXPECT_EQ(receive(200, 100), ReceiveOutcome::OUT_OF_ORDER);
+    EXPECT_EQ(receive(100, 100), ReceiveOutcome::OUT_OF_ORDER);
+    EXPECT_EQ(receive(400, 100), ReceiveOutcome::OUT_OF_ORDER);
+    ASSERT_EQ(buffer.get_out_of_order().size(), 2u);
+    EXPECT_EQ(buffer.get_out_of_order()[0], (SequenceRange{ISN + 100, ISN + 300}));
+    EXPECT_EQ(buffer.get_out_of_order()[1], (SequenceRange{ISN + 400, ISN + 500}));
+    EXPECT_EQ(buffer.get_readable(), 0u);
+
+    EXPECT_EQ(receive(0, 100), ReceiveOutcome::IN_ORDER);
+    EXPECT_EQ(buffer.get_rcv_nxt(), ISN + 300);
+    EXPECT_EQ(buffer.get_out_of_order().size(), 1u);
+    EXPECT_EQ(receive(300, 100), ReceiveOutcome::IN_ORDER);
+    EXPECT_EQ(buffer.get_rcv_nxt(), ISN + 500);
+    EXPECT_TRUE(buffer.get_out_of_order().empty());
+    expect_stream(buffer, 0, 500);
+}
+
+TEST_F(ReceiveBufferTest, OverlapsAreTrimmedAndMerged) {
+    buffer.open(ISN, 4096);
+    EXPECT_EQ(receive(0, 100), ReceiveOutcome::IN_ORDER);
+    // Starts inside data already received
+    EXPECT_EQ(receive(50, 100), ReceiveOutcome::IN_ORDER);
+    EXPECT_EQ(buffer.get_rcv_nxt(), ISN + 150);
+
+    // Bridges two queued ranges
+    EXPECT_EQ(receive(200, 50), ReceiveOutcome::OUT_OF_ORDER);
+    EXPECT_EQ(receive(300, 50), ReceiveOutcome::OUT_OF_ORDER);
+    EXPECT_EQ(receive(220, 100), ReceiveOutcome::OUT_OF_ORDER);
+    ASSERT_EQ(buffer.get_out_of_order().size(), 1u);
+    EXPECT_EQ(buffer.get_out_of_order()[0], (SequenceRange{ISN + 200, ISN + 350}));
+
+    // Reaches into the queued range
+    EXPECT_EQ(receive(140, 80), ReceiveOutcome::IN_ORDER);
+    EXPECT_EQ(buffer.get_rcv_nxt(), ISN + 350);
+    expect_stream(buffer, 0, 350);
+}
+
+TEST_F(ReceiveBufferTest, RetransmittedDuplicatesAreRecognised) {
+    buffer.open(ISN, 4096);
+    EXPECT_EQ(receive(0, 100), ReceiveOutcome::IN_ORDER);
+    EXPECT_EQ(receive(0, 100), ReceiveOutcome::DUPLICATE);
+    EXPECT_EQ(receive(20, 30), ReceiveOutcome::DUPLICATE);
+    EXPECT_EQ(receive(300, 100), ReceiveOutcome::OUT_OF_ORDER);
+    EXPECT_EQ(receive(300, 100), ReceiveOutcome::DUPLICATE);
+    EXPECT_EQ(receive(320, 10), ReceiveOutcome::DUPLICATE);
+    EXPECT_EQ(buffer.get_rcv_nxt(), ISN + 100);
+    EXPECT_EQ(buffer.get_readable(), 100u);
+}
+
+TEST_F(ReceiveBufferTest, DataPastTheWindowIsTrimmedOrRefused) {
+    buffer.open(ISN, 1024);
+    EXPECT_EQ(receive(1024, 10), ReceiveOutcome::OUT_OF_WINDOW);
+    EXPECT_EQ(receive(1000, 100), ReceiveOutcome::OUT_OF_ORDER);
+    EXPECT_EQ(buffer.get_out_of_order()[0], (SequenceRange{ISN + 1000, ISN + 1024}));
+
+    EXPECT_EQ(receive(0, 1000), ReceiveOutcome::IN_ORDER);
+    EXPECT_EQ(buffer.get_window(), 0u);
+    EXPECT_EQ(receive(1024, 1), ReceiveOutcome::OUT_OF_WINDOW);
+
+    // Reading reopens the window
+    expect_stream(buffer, 0, 512);
+    EXPECT_EQ(receive(1024, 100), ReceiveOutcome::IN_ORDER);
+    expect_stream(buffer, 512, 612);
+}
+
+TEST_F(ReceiveBufferTest, SequenceNumbersWrapAround) {
+    uint32_t isn = 0xFFFFFF00;
+    buffer.open(isn, 4096);
+    auto at = [&](size_t offset, size_t length) {
+        return buffer.receive(isn + static_cast<uint32_t>(offset), stream_bytes(offset, length));
+    };
+    EXPECT_EQ(at(0x200, 0x100), ReceiveOutcome::OUT_OF_ORDER);
+    EXPECT_EQ(at(0x80, 0x100), ReceiveOutcome::OUT_OF_ORDER);
+    EXPECT_EQ(buffer.get_out_of_order()[0], (SequenceRange{0xFFFFFF80, 0x00000080}));
+    EXPECT_EQ(at(0, 0x80), ReceiveOutcome::IN_ORDER);
+    EXPECT_EQ(at(0x180, 0x80), ReceiveOutcome::IN_ORDER);
+    EXPECT_EQ(buffer.get_rcv_nxt(), isn + 0x300);
+    EXPECT_EQ(at(0x10, 0x10), ReceiveOutcome::DUPLICATE);
+    expect_stream(buffer, 0, 0x300);
+}
+
+TEST_F(ReceiveBufferTest, RingWrapsUnderTheReader) {
+    buffer.open(ISN, 1024);
+    size_t offset = 0;
+    for (int round = 0; round < 20; ++round) {
+        // Second half first, so out-of-order writes also cross the ring's end
+        EXPECT_EQ(receive(offset + 300, 300), ReceiveOutcome::OUT_OF_ORDER);
+        EXPECT_EQ(receive(offset, 300), ReceiveOutcome::IN_ORDER);
+        expect_stream(buffer, offset, 600);
+        offset += 600;
+    }
+}
+
+TEST_F(ReceiveBufferTest, HolesBeyondTheRangeLimitAreRefused) {
+    buffer.open(ISN, 65536);
+    for (size_t i = 0; i < TCPReceiveBuffer::MAX_OUT_OF_ORDER_RANGES; ++i) {
+        EXPECT_EQ(receive(100 + i * 200, 100), ReceiveOutcome::OUT_OF_ORDER);
+    }
+    size_t beyond = 100 + TCPReceiveBuffer::MAX_OUT_OF_ORDER_RANGES * 200;
+    EXPECT_EQ(receive(beyond, 100), ReceiveOutcome::NO_ROOM);
+    // Extending an existing range still works
+    EXPECT_EQ(receive(200, 100), ReceiveOutcome::OUT_OF_ORDER);
+    EXPECT_EQ(buffer.get_out_of_order().size(), TCPReceiveBuffer::MAX_OUT_OF_ORDER_RANGES - 1);
+}
+
+TEST_F(ReceiveBufferTest, ShuffledSegmentsReassembleTheStream) {
+    buffer.open(ISN, 65536);
+    std::vector<size_t> order(40);
+    std::iota(order.begin(), order.end(), 0);
+    std::mt19937 rng(7);
+    std::shuffle(order.begin(), order.end(), rng);
+
+    for (size_t i = 0; i < order.size(); ++i) {
+        size_t segment = order[i];
+        ReceiveOutcome outcome = receive(segment * 1000, 1000);
+        ASSERT_NE(outcome, ReceiveOutcome::OUT_OF_WINDOW);
+        if (outcome == ReceiveOutcome::NO_ROOM) {
+            // Sender retransmits after the hole fills
+            order.push_back(segment);
+        }
+    }
+    EXPECT_EQ(buffer.get_rcv_nxt(), ISN + 40000);
+    expect_stream(buffer, 0, 40000);
+}
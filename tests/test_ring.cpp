@@ -0,0 +1,155 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include "core/ring.h"
+#include "buffer/packet_pool.h"
+
+TEST(RingTest, CapacityRoundsUpToPowerOfTwo) {
+    SpscRing<int> spsc(100);
+    MpscRing<int> mpsc(5);
+    
+    EXPECT_EQ(spsc.capacity(), 128u);
+    EXPECT_EQ(mpsc.capacity(), 8u);
+}
+
+TEST(RingTest, SpscKeepsOrderAcrossWraparound) {
+    SpscRing<int> ring(8);
+    int next_in = 0;
+    int next_out = 0;
+    
+    for (int round = 0; round < 100; ++round) {
+        int in[5];
+        for (int& value : in) {
+            value = next_in++;
+        }
+        ASSERT_EQ(ring.enqueue_burst(in, 5), 5u);
+        
+        int out[5];
+        ASSERT_EQ(ring.dequeue_burst(out, 5), 5u);
+        for (int value : out) {
+            EXPECT_EQ(value, next_out++);
+        }
+    }
+    EXPECT_TRUE(ring.empty());
+}
+
+TEST(RingTest, FullRingAcceptsPartialBurstAndCountsRefusals) {
+    SpscRing<int> spsc(4);
+    MpscRing<int> mpsc(4);
+    int items[6] = {0, 1, 2, 3, 4, 5};
+    
+    EXPECT_EQ(spsc.enqueue_burst(items, 6), 4u);
+    EXPECT_EQ(mpsc.enqueue_burst(items, 6), 4u);
+    EXPECT_FALSE(spsc.enqueue(7));
+    EXPECT_FALSE(mpsc.enqueue(7));
+    
+    EXPECT_EQ(spsc.get_stats().enqueued, 4u);
+    EXPECT_EQ(spsc.get_stats().full, 3u);
+    EXPECT_EQ(mpsc.get_stats().enqueued, 4u);
+    EXPECT_EQ(mpsc.get_stats().full, 3u);
+    
+    int out[8];
+    EXPECT_EQ(mpsc.dequeue_burst(out, 8), 4u);
+    EXPECT_EQ(out[3], 3);
+    EXPECT_EQ(mpsc.get_stats().dequeued, 4u);
+}
+
+TEST(RingTest, MovesPacketHandlesWithoutTouchingRefcounts) {
+    PacketPoolConfig config;
+    config.buffer_count = 4;
+    PacketPool pool(config);
+    SpscRing<PacketHandle> ring(4);
+    
+    PacketHandle packet = pool.alloc();
+    PacketHandle copy = packet;
+    ASSERT_TRUE(ring.enqueue(std::move(packet)));
+    EXPECT_FALSE(packet);
+    EXPECT_EQ(copy.get_refcount(), 2u);
+    
+    PacketHandle out;
+    ASSERT_TRUE(ring.dequeue(out));
+    EXPECT_EQ(out.get_refcount(), 2u);
+    out.release();
+    EXPECT_EQ(copy.get_refcount(), 1u);
+}
+
+TEST(RingTest, SpscTransfersEverythingBetweenThreads) {
+    SpscRing<uint64_t> ring(64);
+    constexpr uint64_t COUNT = 200000;
+    
+    std::thread producer([&ring] {
+        uint64_t burst[16];
+        uint64_t next = 0;
+        while (next < COUNT) {
+            size_t n = 0;
+            while (n < 16 && next + n < COUNT) {
+                burst[n] = next + n;
+                ++n;
+            }
+            size_t accepted = ring.enqueue_burst(burst, n);
+            if (accepted == 0) {
+                std::this_thread::yield();
+            }
+            next += accepted;
+        }
+    });
+    
+    uint64_t expected = 0;
+    uint64_t out[16];
+    while (expected < COUNT) {
+        size_t n = ring.dequeue_burst(out, 16);
+        if (n == 0) {
+            std::this_thread::yield();
+        }
+        for (size_t i = 0; i < n; ++i) {
+            ASSERT_EQ(out[i], expected++);
+        }
+    }
+    producer.join();
+}
+
+TEST(RingTest, MpscDeliversEachProducersItemsOnceAndInOrder) {
+    MpscRing<uint64_t> ring(128);
+    constexpr uint64_t PRODUCERS = 4;
+    constexpr uint64_t PER_PRODUCER = 50000;
+    
+    std::vector<std::thread> producers;
+    for (uint64_t p = 0; p < PRODUCERS; ++p) {
+        producers.emplace_back([&ring, p] {
+            uint64_t burst[8];
+            uint64_t next = 0;
+            while (next < PER_PRODUCER) {
+                size_t n = 0;
+                while (n < 8 && next + n < PER_PRODUCER) {
+                    burst[n] = (p << 32) | (next + n);
+                    ++n;
+                }
+                size_t accepted = ring.enqueue_burst(burst, n);
+                if (accepted == 0) {
+                    std::this_thread::yield();
+                }
+                next += accepted;
+            }
+        });
+    }
+    
+    std::vector<uint64_t> next(PRODUCERS, 0);
+    uint64_t received = 0;
+    uint64_t out[32];
+    while (received < PRODUCERS * PER_PRODUCER) {
+        size_t n = ring.dequeue_burst(out, 32);
+        if (n == 0) {
+            std::this_thread::yield();
+        }
+        for (size_t i = 0; i < n; ++i) {
+            uint64_t producer = out[i] >> 32;
+            ASSERT_LT(producer, PRODUCERS);
+            ASSERT_EQ(out[i] & 0xFFFFFFFF, next[producer]++);
+        }
+        received += n;
+    }
+    for (auto& thread : producers) {
+        thread.join();
+    }
+    EXPECT_TRUE(ring.empty());
+}
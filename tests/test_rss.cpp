@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+#include "core/rss.h"
+#include "stack.h"
+#include "test_frames.h"
+
+// Verification suite key from the Microsoft RSS specification
+static const std::array<uint8_t, RssHasher::KEY_SIZE> MICROSOFT_KEY = {
+    0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2, 0x41, 0x67,
+    0x25, 0x3d, 0x43, 0xa3, 0x8f, 0xb0, 0xd0, 0xca, 0x2b, 0xcb,
+    0xae, 0x7b, 0x30, 0xb4, 0x77, 0xcb, 0x2d, 0xa3, 0x80, 0x30,
+    0xf2, 0x0c, 0x6a, 0x42, 0xb7, 0x3b, 0xbe, 0xac, 0x01, 0xfa
+};
+
+static uint32_t ip(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+    return (static_cast<uint32_t>(a) << 24) | (b << 16) | (c << 8) | d;
+}
+
+TEST(RssTest, MatchesSpecificationVectors) {
+    RssHasher hasher(MICROSOFT_KEY);
+    
+    // 66.9.149.187:2794 -> 161.142.100.80:1766
+    EXPECT_EQ(hasher.hash_ipv4(ip(66, 9, 149, 187), ip(161, 142, 100, 80)), 0x323e8fc2u);
+    EXPECT_EQ(hasher.hash_ipv4_tcp(ip(66, 9, 149, 187), ip(161, 142, 100, 80), 2794, 1766), 0x51ccc178u);
+    
+    // 199.92.111.2:14230 -> 65.69.140.83:4739
+    EXPECT_EQ(hasher.hash_ipv4_tcp(ip(199, 92, 111, 2), ip(65, 69, 140, 83), 14230, 4739), 0xc626b0eau);
+}
+
+TEST(RssTest, TableLookupMatchesGenericHash) {
+    RssHasher hasher(MICROSOFT_KEY);
+    std::array<uint8_t, 12> input = {24, 19, 198, 95, 12, 22, 207, 1, 0x12, 0x34, 0xAB, 0xCD};
+    
+    EXPECT_EQ(hasher.hash(input), hasher.hash_ipv4_tcp(ip(24, 19, 198, 95), ip(12, 22, 207, 1), 0x1234, 0xABCD));
+}
+
+TEST(RssTest, SymmetricKeyHashesBothDirectionsAlike) {
+    RssHasher hasher;
+    
+    for (uint32_t i = 0; i < 1000; ++i) {
+        uint32_t a = 0x0A000000 + i * 7919;
+        uint32_t b = 0xC0A80000 + i * 104729;
+        uint16_t pa = static_cast<uint16_t>(1024 + i * 31);
+        uint16_t pb = static_cast<uint16_t>(80 + i);
+        EXPECT_EQ(hasher.hash_ipv4_tcp(a, b, pa, pb), hasher.hash_ipv4_tcp(b, a, pb, pa));
+    }
+}
+
+static std::vector<uint8_t> make_frame(const std::array<uint8_t, 4>& source, const std::array<uint8_t, 4>& destination,
+                                       uint16_t source_port, uint16_t dest_port) {
+    return build_frame({.source_ip = source, .destination_ip = destination, .source_port = source_port,
+                        .dest_port = dest_port});
+}
+
+TEST(RssTest, StackSteersBothDirectionsToOneWorker) {
+    StackConfig config;
+    config.worker_count = 4;
+    TCPIPStack stack("steering", config);
+    
+    std::vector<size_t> per_worker(config.worker_count);
+    for (uint16_t i = 0; i < 256; ++i) {
+        std::array<uint8_t, 4> client = {192, 168, static_cast<uint8_t>(i / 16), static_cast<uint8_t>(i)};
+        std::array<uint8_t, 4> server = {10, 0, 0, 1};
+        auto outbound = make_frame(client, server, static_cast<uint16_t>(40000 + i), 443);
+        auto inbound = make_frame(server, client, 443, static_cast<uint16_t>(40000 + i));
+        
+        size_t worker = stack.select_worker(outbound);
+        ASSERT_LT(worker, config.worker_count);
+        EXPECT_EQ(worker, stack.select_worker(inbound));
+        per_worker[worker]++;
+    }
+    
+    // Flows spread over every worker
+    for (size_t count : per_worker) {
+        EXPECT_GT(count, 0u);
+    }
+}
@@ -0,0 +1,490 @@
+#include <gtest/gtest.h>
+#include "tcp/congestion_control.h"
+#include "tcp/tcp_sender.h"
+#include "tcp/transfer_simulator.h"
+#include <cmath>
+#include <vector>
+
+static constexpr uint64_t MS = 1'000'000;
+
+TEST(RttEstimatorTest, FollowsRfc6298) {
+    RttEstimator rtt(1000 * MS, 200 * MS, 60'000 * MS, 1 * MS);
+    EXPECT_FALSE(rtt.has_sample());
+    EXPECT_EQ(rtt.get_rto_ns(), 1000 * MS);
+
+    // First sample: SRTT = R, RTTVAR = R/2, RTO = SRTT + 4 RTTVAR
+    rtt.sample(100 * MS);
+    EXPECT_EQ(rtt.get_srtt_ns(), 100 * MS);
+    EXPECT_EQ(rtt.get_rttvar_ns(), 50 * MS);
+    EXPECT_EQ(rtt.get_rto_ns(), 300 * MS);
+
+    rtt.sample(200 * MS);
+    EXPECT_EQ(rtt.get_rttvar_ns(), 62'500'000u);
+    EXPECT_EQ(rtt.get_srtt_ns(), 112'500'000u);
+    EXPECT_EQ(rtt.get_rto_ns(), 362'500'000u);
+
+    rtt.backoff();
+    EXPECT_EQ(rtt.get_rto_ns(), 725 * MS);
+    for (int i = 0; i < 10; ++i) {
+        rtt.backoff();
+    }
+    EXPECT_EQ(rtt.get_rto_ns(), 60'000 * MS);
+
+    // A steady short RTT settles at the floor
+    for (int i = 0; i < 50; ++i) {
+        rtt.sample(1 * MS);
+    }
+    EXPECT_EQ(rtt.get_rto_ns(), 200 * MS);
+}
+
+TEST(CongestionControlTest, NewRenoSlowStartAvoidanceAndLoss) {
+    NewRenoCongestionControl reno(1000);
+    EXPECT_EQ(reno.get_cwnd(), 10'000u);
+    EXPECT_TRUE(reno.in_slow_start());
+
+    for (int i = 0; i < 5; ++i) {
+        reno.on_ack(1000, 0, 0);
+    }
+    EXPECT_EQ(reno.get_cwnd(), 15'000u);
+
+    reno.on_fast_retransmit(20'000, 0);
+    EXPECT_EQ(reno.get_ssthresh(), 10'000u);
+    EXPECT_EQ(reno.get_cwnd(), 10'000u);
+    EXPECT_FALSE(reno.in_slow_start());
+
+    // One MSS per window of ACKed data
+    for (int i = 0; i < 10; ++i) {
+        reno.on_ack(1000, 0, 0);
+    }
+    EXPECT_EQ(reno.get_cwnd(), 11'000u);
+
+    reno.on_timeout(11'000, 0);
+    EXPECT_EQ(reno.get_ssthresh(), 5'500u);
+    EXPECT_EQ(reno.get_cwnd(), 1'000u);
+    EXPECT_TRUE(reno.in_slow_start());
+}
+
+TEST(CongestionControlTest, CubicFollowsTheCubicCurve) {
+    constexpr uint32_t MSS = 1000;
+    CubicCongestionControl cubic(MSS);
+    while (cubic.get_cwnd() < 100 * MSS) {
+        cubic.on_ack(MSS, 0, 0);
+    }
+    cubic.on_fast_retransmit(100 * MSS, 0);
+    EXPECT_EQ(cubic.get_cwnd(), 70 * MSS);
+    EXPECT_EQ(cubic.get_ssthresh(), 70 * MSS);
+
+    // ACK a window per RTT; each RTT the window should reach where the
+    // curve W(t) = C (t - K)^3 + W_max will be one RTT later
+    constexpr uint64_t RTT = 100 * MS;
+    std::vector<double> windows;
+    for (uint64_t now = 1; windows.size() < 80; now += RTT) {
+        uint32_t window = cubic.get_cwnd();
+        for (uint32_t acked = 0; acked < window; acked += MSS) {
+            cubic.on_ack(MSS, RTT, now);
+        }
+        windows.push_back(static_cast<double>(cubic.get_cwnd()) / MSS);
+    }
+    double k = std::cbrt(30 / CubicCongestionControl::C);
+    EXPECT_NEAR(cubic.get_k(), k, 1e-9);
+    EXPECT_DOUBLE_EQ(cubic.get_w_max(), 100.0);
+    for (size_t i = 0; i < windows.size(); ++i) {
+        double t = static_cast<double>((i + 1) * RTT) / 1e9;
+        double expected = CubicCongestionControl::C * std::pow(t - k, 3) + 100;
+        EXPECT_NEAR(windows[i], expected, 2.0) << "after " << i + 1 << " RTTs";
+    }
+
+    // Concave up to W_max, flat around K, then convex
+    size_t at_k = static_cast<size_t>(k * 1e9 / RTT);
+    EXPECT_LT(windows[at_k] - windows[at_k - 1], windows[1] - windows[0]);
+    EXPECT_GT(windows.back() - windows[windows.size() - 2], windows[at_k] - windows[at_k - 1]);
+}
+
+TEST(CongestionControlTest, CubicFastConvergence) {
+    constexpr uint32_t MSS = 1000;
+    CubicCongestionControl cubic(MSS);
+    while (cubic.get_cwnd() < 100 * MSS) {
+        cubic.on_ack(MSS, 0, 0);
+    }
+    cubic.on_fast_retransmit(100 * MSS, 0);
+    EXPECT_DOUBLE_EQ(cubic.get_w_max(), 100.0);
+
+    // Losing again below the last maximum sets W_max below the loss window
+    cubic.on_fast_retransmit(70 * MSS, 0);
+    EXPECT_DOUBLE_EQ(cubic.get_w_max(), 70 * (1 + CubicCongestionControl::BETA) / 2);
+    EXPECT_EQ(cubic.get_cwnd(), 49 * MSS);
+
+    cubic.on_timeout(49 * MSS, 0);
+    EXPECT_EQ(cubic.get_cwnd(), MSS);
+}
+
+TEST(CongestionControlTest, FactoryBuildsEachAlgorithm) {
+    EXPECT_STREQ(make_congestion_control(CongestionAlgorithm::NEW_RENO, 1460)->get_name(), "newreno");
+    EXPECT_STREQ(make_congestion_control(CongestionAlgorithm::CUBIC, 1460)->get_name(), "cubic");
+}
+
+class SenderTest : public ::testing::Test {
+protected:
+    static constexpr uint32_t ISS = 0xFFFFF000; // data wraps past zero
+    static constexpr uint32_t MSS = 1000;
+
+    SenderConfig config() {
+        SenderConfig config;
+        config.mss = MSS;
+        config.send_buffer_size = 64 * 1024;
+        config.congestion = CongestionAlgorithm::NEW_RENO;
+        return config;
+    }
+
+    TCPSender sender{ISS, config()};
+    std::vector<TCPSegment> out;
+
+    // Sequence number of stream offset n
+    static uint32_t at(uint32_t offset) { return ISS + 1 + offset; }
+
+    void SetUp() override {
+        std::vector<uint8_t> data(20'000);
+        for (size_t i = 0; i < data.size(); ++i) {
+            data[i] = static_cast<uint8_t>(i / MSS);
+        }
+        ASSERT_EQ(sender.write(data), data.size());
+        sender.on_ack(at(0), 65535, false, 0, out);
+        sender.send(TCPState::ESTABLISHED, 0, out);
+    }
+
+    void ack(uint32_t offset, uint64_t now_ns) {
+        out.clear();
+        sender.on_ack(at(offset), 65535, false, now_ns, out);
+    }
+};
+
+TEST_F(SenderTest, SendsTheInitialWindowFromTheBuffer) {
+    ASSERT_EQ(out.size(), 10u);
+    for (size_t i = 0; i < out.size(); ++i) {
+        EXPECT_EQ(out[i].get_header().sequence_number, at(static_cast<uint32_t>(i * MSS)));
+        ASSERT_EQ(out[i].get_payload().size(), MSS);
+        EXPECT_EQ(out[i].get_payload()[0], i);
+    }
+    EXPECT_EQ(sender.get_flight(), 10 * MSS);
+    EXPECT_EQ(sender.get_retransmit_deadline(), 1000 * MS);
+
+    // Nothing more until the window opens, and nothing in the wrong state
+    out.clear();
+    sender.send(TCPState::ESTABLISHED, 0, out);
+    EXPECT_TRUE(out.empty());
+
+    TCPSender closed(ISS, config());
+    std::vector<uint8_t> data(100);
+    closed.write(data);
+    closed.on_ack(at(0), 65535, false, 0, out);
+    closed.send(TCPState::SYN_SENT, 0, out);
+    EXPECT_TRUE(out.empty());
+}
+
+TEST_F(SenderTest, AcksReleaseDataAndSampleTheRtt) {
+    ack(2 * MSS, 40 * MS);
+    EXPECT_EQ(sender.get_snd_una(), at(2 * MSS));
+    EXPECT_EQ(sender.get_buffered(), 18'000u);
+    EXPECT_EQ(sender.get_rtt().get_srtt_ns(), 40 * MS);
+    EXPECT_EQ(sender.get_congestion().get_cwnd(), 11 * MSS);
+    EXPECT_EQ(sender.get_retransmit_deadline(), 40 * MS + sender.get_rtt().get_rto_ns());
+
+    // Window opened by three segments' worth: two freed, one grown
+    sender.send(TCPState::ESTABLISHED, 40 * MS, out);
+    EXPECT_EQ(out.size(), 3u);
+
+    // Acknowledging everything stops the timer
+    ack(13 * MSS, 80 * MS);
+    EXPECT_EQ(sender.get_flight(), 0u);
+    EXPECT_EQ(sender.get_retransmit_deadline(), UINT64_MAX);
+}
+
+TEST_F(SenderTest, ThirdDuplicateAckRetransmitsAndRecovers) {
+    ack(1 * MSS, 40 * MS);
+    ack(1 * MSS, 41 * MS);
+    ack(1 * MSS, 42 * MS);
+    EXPECT_TRUE(out.empty());
+    EXPECT_FALSE(sender.in_recovery());
+
+    ack(1 * MSS, 43 * MS);
+    ASSERT_EQ(out.size(), 1u);
+    EXPECT_EQ(out[0].get_header().sequence_number, at(MSS));
+    EXPECT_EQ(out[0].get_payload()[0], 1);
+    EXPECT_TRUE(sender.in_recovery());
+    EXPECT_EQ(sender.get_stats().fast_retransmits, 1u);
+    EXPECT_EQ(sender.get_congestion().get_ssthresh(), 4'500u);
+
+    // Further duplicates inflate the window enough to send new data
+    for (int i = 0; i < 6; ++i) {
+        ack(1 * MSS, 44 * MS);
+    }
+    out.clear();
+    sender.send(TCPState::ESTABLISHED, 44 * MS, out);
+    EXPECT_FALSE(out.empty());
+
+    // An ACK for everything sent before the loss ends recovery
+    uint32_t recovered = sender.get_snd_nxt() - at(0);
+    ack(recovered, 80 * MS);
+    EXPECT_FALSE(sender.in_recovery());
+    EXPECT_EQ(sender.get_congestion().get_cwnd(), sender.get_congestion().get_ssthresh());
+}
+
+TEST_F(SenderTest, PartialAckRetransmitsTheNextHole) {
+    for (int i = 0; i < 4; ++i) {
+        ack(1 * MSS, 40 * MS);
+    }
+    ASSERT_TRUE(sender.in_recovery());
+
+    // The retransmission filled the first hole, but segment 4 was lost too
+    ack(4 * MSS, 80 * MS);
+    ASSERT_EQ(out.size(), 1u);
+    EXPECT_EQ(out[0].get_header().sequence_number, at(4 * MSS));
+    EXPECT_TRUE(sender.in_recovery());
+
+    ack(10 * MSS, 120 * MS);
+    EXPECT_FALSE(sender.in_recovery());
+    EXPECT_EQ(sender.get_stats().fast_retransmits, 1u);
+    EXPECT_EQ(sender.get_stats().retransmits, 2u);
+}
+
+TEST_F(SenderTest, TimeoutGoesBackNAndBacksOff) {
+    out.clear();
+    sender.on_retransmit_timeout(1000 * MS, out);
+    ASSERT_EQ(out.size(), 1u);
+    EXPECT_EQ(out[0].get_header().sequence_number, at(0));
+    EXPECT_EQ(sender.get_stats().timeouts, 1u);
+    EXPECT_EQ(sender.get_congestion().get_cwnd(), MSS);
+    EXPECT_EQ(sender.get_congestion().get_ssthresh(), 5 * MSS);
+    EXPECT_EQ(sender.get_rtt().get_rto_ns(), 2000 * MS);
+    EXPECT_EQ(sender.get_retransmit_deadline(), 3000 * MS);
+    EXPECT_EQ(sender.get_snd_nxt(), at(MSS));
+
+    // Karn: the ACK of a retransmission gives no RTT sample. Slow start
+    // resends what followed.
+    ack(1 * MSS, 1100 * MS);
+    EXPECT_FALSE(sender.get_rtt().has_sample());
+    sender.send(TCPState::ESTABLISHED, 1100 * MS, out);
+    ASSERT_EQ(out.size(), 2u);
+    EXPECT_EQ(out[0].get_header().sequence_number, at(MSS));
+    EXPECT_EQ(out[1].get_header().sequence_number, at(2 * MSS));
+    EXPECT_EQ(sender.get_stats().retransmits, 3u);
+
+    // Duplicates for data sent before the timeout start no fast retransmit
+    for (int i = 0; i < 4; ++i) {
+        ack(1 * MSS, 1110 * MS);
+    }
+    EXPECT_FALSE(sender.in_recovery());
+}
+
+TEST_F(SenderTest, ZeroWindowIsProbed) {
+    ack(10 * MSS, 40 * MS);
+    out.clear();
+    sender.on_ack(at(10 * MSS), 0, false, 41 * MS, out);
+    sender.send(TCPState::ESTABLISHED, 41 * MS, out);
+    EXPECT_TRUE(out.empty());
+    ASSERT_NE(sender.get_retransmit_deadline(), UINT64_MAX);
+
+    uint64_t now = sender.get_retransmit_deadline();
+    sender.on_retransmit_timeout(now, out);
+    ASSERT_EQ(out.size(), 1u);
+    EXPECT_EQ(out[0].get_payload().size(), 1u);
+    EXPECT_EQ(sender.get_stats().timeouts, 0u);
+    EXPECT_EQ(sender.get_congestion().get_cwnd(), 11 * MSS);
+
+    // The window reopens and the probe byte is acknowledged
+    out.clear();
+    sender.on_ack(at(10 * MSS + 1), 65535, false, now + 40 * MS, out);
+    sender.send(TCPState::ESTABLISHED, now + 40 * MS, out);
+    EXPECT_EQ(out.size(), 10u);
+}
+
+// The same ten segments in flight, with SACK negotiated
+class SackSenderTest : public ::testing::Test {
+protected:
+    static constexpr uint32_t ISS = 0xFFFFF000;
+    static constexpr uint32_t MSS = 1000;
+
+    SenderConfig config() {
+        SenderConfig config;
+        config.mss = MSS;
+        config.send_buffer_size = 64 * 1024;
+        config.congestion = CongestionAlgorithm::NEW_RENO;
+        config.sack = true;
+        return config;
+    }
+
+    TCPSender sender{ISS, config()};
+    std::vector<TCPSegment> out;
+
+    static uint32_t at(uint32_t offset) { return ISS + 1 + offset; }
+
+    void SetUp() override {
+        std::vector<uint8_t> data(20'000);
+        ASSERT_EQ(sender.write(data), data.size());
+        sender.on_ack(at(0), 65535, false, 0, out);
+        sender.send(TCPState::ESTABLISHED, 0, out);
+        ack(1 * MSS, {}, 40 * MS);
+    }
+
+    // An ACK carrying SACK blocks given as stream offsets
+    void ack(uint32_t offset, std::vector<std::pair<uint32_t, uint32_t>> blocks, uint64_t now_ns) {
+        TCPOptions options;
+        for (auto [start, end] : blocks) {
+            options.sack_blocks[options.sack_count++] = {at(start), at(end)};
+        }
+        out.clear();
+        sender.on_ack(at(offset), 65535, false, now_ns, out, options);
+    }
+};
+
+TEST_F(SackSenderTest, SackedDataPastTheHoleStartsRecovery) {
+    ack(1 * MSS, {{2 * MSS, 3 * MSS}}, 41 * MS);
+    EXPECT_EQ(sender.get_sacked_bytes(), 1 * MSS);
+    EXPECT_FALSE(sender.in_recovery());
+
+    // Blocks below SND.UNA or past SND.MAX are ignored
+    ack(1 * MSS, {{0, 1 * MSS}, {20 * MSS, 21 * MSS}}, 42 * MS);
+    EXPECT_EQ(sender.get_sacked_bytes(), 1 * MSS);
+    EXPECT_FALSE(sender.in_recovery());
+
+    // Three segments SACKed past the hole is a loss after two duplicates
+    ack(1 * MSS, {{2 * MSS, 5 * MSS}}, 43 * MS);
+    EXPECT_TRUE(sender.in_recovery());
+    EXPECT_EQ(sender.get_sacked_bytes(), 3 * MSS);
+    ASSERT_EQ(out.size(), 1u);
+    EXPECT_EQ(out[0].get_header().sequence_number, at(MSS));
+
+    // Acknowledged SACKed data leaves the scoreboard
+    ack(3 * MSS, {{3 * MSS, 5 * MSS}}, 60 * MS);
+    EXPECT_EQ(sender.get_sacked_bytes(), 2 * MSS);
+}
+
+TEST_F(SackSenderTest, EveryHoleIsResentInOneRecovery) {
+    ack(1 * MSS, {{2 * MSS, 3 * MSS}, {4 * MSS, 8 * MSS}}, 41 * MS);
+    EXPECT_TRUE(sender.in_recovery());
+    EXPECT_EQ(sender.get_congestion().get_ssthresh(), 4'500u);
+    ASSERT_EQ(out.size(), 2u);
+    EXPECT_EQ(out[0].get_header().sequence_number, at(1 * MSS));
+    EXPECT_EQ(out[1].get_header().sequence_number, at(3 * MSS));
+    EXPECT_EQ(sender.get_stats().retransmits, 2u);
+
+    // Further duplicates resend nothing twice, and new data goes out as
+    // the pipe drains below cwnd
+    ack(1 * MSS, {{2 * MSS, 3 * MSS}, {4 * MSS, 9 * MSS}}, 42 * MS);
+    EXPECT_TRUE(out.empty());
+    sender.send(TCPState::ESTABLISHED, 42 * MS, out);
+    EXPECT_FALSE(out.empty());
+    EXPECT_EQ(sender.get_stats().retransmits, 2u);
+
+    uint32_t recovered = sender.get_snd_nxt() - at(0);
+    ack(recovered, {}, 80 * MS);
+    EXPECT_FALSE(sender.in_recovery());
+    EXPECT_EQ(sender.get_sacked_bytes(), 0u);
+}
+
+TEST(TimestampSenderTest, EchoedTimestampsSampleRetransmissions) {
+    constexpr uint32_t ISS = 5000;
+    SenderConfig config;
+    config.mss = 1000;
+    config.timestamps = true;
+    TCPSender sender(ISS, config);
+    EXPECT_EQ(sender.get_segment_size(), 988u);
+
+    std::vector<uint8_t> data(5000);
+    sender.write(data);
+    std::vector<TCPSegment> out;
+    TCPOptions peer;
+    peer.has_timestamps = true;
+    peer.ts_value = 555;
+    sender.on_ack(ISS + 1, 65535, false, 0, out, peer);
+    sender.send(TCPState::ESTABLISHED, 0, out);
+    ASSERT_EQ(out.size(), 6u);
+    EXPECT_EQ(out[0].get_payload().size(), 988u);
+    EXPECT_EQ(out[0].get_header_length(), 32u);
+    TCPOptions sent;
+    ASSERT_TRUE(out[0].decode_options(sent));
+    EXPECT_TRUE(sent.has_timestamps);
+    EXPECT_EQ(sent.ts_echo, 555u);
+
+    // The resend after a timeout carries a new TSval; the echo of it times
+    // the retransmission, which Karn's rule alone could not
+    out.clear();
+    sender.on_retransmit_timeout(1000 * MS, out);
+    ASSERT_EQ(out.size(), 1u);
+    ASSERT_TRUE(out[0].decode_options(sent));
+    peer.ts_value = 556;
+    peer.ts_echo = sent.ts_value;
+    out.clear();
+    sender.on_ack(ISS + 1 + 988, 65535, false, 1050 * MS, out, peer);
+    ASSERT_TRUE(sender.get_rtt().has_sample());
+    EXPECT_EQ(sender.get_rtt().get_srtt_ns(), 50 * MS);
+}
+
+static TransferConfig lossy_transfer(CongestionAlgorithm algorithm, double loss) {
+    TransferConfig config;
+    config.bytes = 1 << 20;
+    config.sender.congestion = algorithm;
+    config.forward.loss = loss;
+    config.forward.seed = 11;
+    config.reverse.loss = loss;
+    config.reverse.seed = 12;
+    return config;
+}
+
+TEST(TransferTest, LosslessTransferFillsTheLink) {
+    for (auto algorithm : {CongestionAlgorithm::NEW_RENO, CongestionAlgorithm::CUBIC}) {
+        TransferResult result = simulate_transfer(lossy_transfer(algorithm, 0));
+        EXPECT_TRUE(result.completed);
+        EXPECT_TRUE(result.intact);
+        EXPECT_EQ(result.sender.retransmits, 0u);
+        // 20 Mbit/s less header overhead and the first few RTTs of slow start
+        EXPECT_GT(result.goodput_bps, 15e6);
+        EXPECT_LT(result.goodput_bps, 20e6);
+        // The receive window was the limit, so cwnd stopped growing near it
+        EXPECT_LT(result.final_cwnd, 2 * 65535u);
+    }
+}
+
+TEST(TransferTest, LossyTransferArrivesIntact) {
+    for (auto algorithm : {CongestionAlgorithm::NEW_RENO, CongestionAlgorithm::CUBIC}) {
+        TransferResult result = simulate_transfer(lossy_transfer(algorithm, 0.03));
+        EXPECT_TRUE(result.completed);
+        EXPECT_TRUE(result.intact);
+        EXPECT_GT(result.forward.lost, 0u);
+        EXPECT_GT(result.sender.fast_retransmits, 0u);
+        EXPECT_GE(result.sender.retransmits, result.forward.lost);
+    }
+}
+
+TEST(TransferTest, ScaledWindowAndSackFillALongFatLink) {
+    // 100 Mbit/s at 80 ms needs a megabyte in flight, past a 16-bit window
+    TransferConfig config;
+    config.bytes = 16 << 20;
+    config.sender.send_buffer_size = 4 << 20;
+    config.forward.rate_bps = 100'000'000;
+    config.forward.delay_ns = 40'000'000;
+    config.forward.queue_bytes = 1 << 20;
+    config.reverse = config.forward;
+    TransferResult unscaled = simulate_transfer(config);
+    EXPECT_TRUE(unscaled.completed);
+    EXPECT_LT(unscaled.goodput_bps, 65536 * 8 / 0.08);
+
+    config.window_scale = 5;
+    config.receive_window = 2 << 20;
+    config.sender.sack = true;
+    config.sender.timestamps = true;
+    TransferResult scaled = simulate_transfer(config);
+    EXPECT_TRUE(scaled.completed);
+    EXPECT_TRUE(scaled.intact);
+    EXPECT_GT(scaled.final_cwnd, 65535u);
+    EXPECT_GT(scaled.goodput_bps, 3 * unscaled.goodput_bps);
+
+    // The same with SACK and timestamps on at 3% loss
+    TransferConfig lossy = lossy_transfer(CongestionAlgorithm::CUBIC, 0.03);
+    lossy.sender.sack = true;
+    lossy.sender.timestamps = true;
+    TransferResult result = simulate_transfer(lossy);
+    EXPECT_TRUE(result.completed);
+    EXPECT_TRUE(result.intact);
+    EXPECT_GT(result.sender.fast_retransmits, 0u);
+}
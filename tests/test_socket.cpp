@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include "tcp/tcp_socket.h"
+#include <array>
+#include <map>
+
+// Readiness the table asks for, keyed by slot index
+class SocketTableTest : public ::testing::Test {
+protected:
+    SocketTable table;
+    std::map<uint32_t, uint32_t> ready;
+    std::array<SocketEvent, 8> events{};
+
+    size_t collect() {
+        return table.collect(events, [&](const SocketSlot& slot) {
+            for (const auto& [index, flags] : ready) {
+                if (&table.at(index) == &slot) {
+                    return flags;
+                }
+            }
+            return 0u;
+        });
+    }
+};
+
+TEST_F(SocketTableTest, StaleHandlesAreRefusedAfterReuse) {
+    SocketId first = table.allocate(SocketKind::STREAM);
+    ASSERT_NE(first, 0u);
+    EXPECT_NE(table.get(first, SocketKind::STREAM), nullptr);
+    EXPECT_EQ(table.get(first, SocketKind::LISTENER), nullptr);
+    EXPECT_EQ(table.get(0, SocketKind::STREAM), nullptr);
+
+    table.free(SocketTable::index_of(first));
+    SocketId second = table.allocate(SocketKind::STREAM);
+    EXPECT_EQ(SocketTable::index_of(second), SocketTable::index_of(first));
+    EXPECT_NE(second, first);
+    EXPECT_EQ(table.get(first, SocketKind::STREAM), nullptr);
+    EXPECT_NE(table.get(second, SocketKind::STREAM), nullptr);
+    EXPECT_EQ(table.get_open(), 1u);
+}
+
+TEST_F(SocketTableTest, LevelTriggeredSocketsStayReadyUntilTheyAreNot) {
+    SocketId id = table.allocate(SocketKind::STREAM);
+    uint32_t index = SocketTable::index_of(id);
+    table.notify(index);
+    EXPECT_EQ(table.get_ready(), 0u);   // nothing watched
+
+    table.at(index).interest = SocketEvent::READABLE;
+    table.at(index).data = 42;
+    table.notify(index);
+    table.notify(index);
+    EXPECT_EQ(table.get_ready(), 1u);
+
+    ready[index] = SocketEvent::READABLE | SocketEvent::WRITABLE;
+    for (int wait = 0; wait < 3; ++wait) {
+        ASSERT_EQ(collect(), 1u);
+        EXPECT_EQ(events[0].socket, id);
+        EXPECT_EQ(events[0].events, SocketEvent::READABLE);    // only what is watched
+        EXPECT_EQ(events[0].data, 42u);
+    }
+
+    ready[index] = 0;
+    EXPECT_EQ(collect(), 0u);
+    EXPECT_EQ(table.get_ready(), 0u);
+}
+
+TEST_F(SocketTableTest, EdgeTriggeredSocketsAreReportedOncePerNotify) {
+    uint32_t index = SocketTable::index_of(table.allocate(SocketKind::STREAM));
+    table.at(index).interest = SocketEvent::READABLE | SocketEvent::EDGE;
+    ready[index] = SocketEvent::READABLE;
+
+    table.notify(index);
+    EXPECT_EQ(collect(), 1u);
+    EXPECT_EQ(collect(), 0u);
+    table.notify(index);
+    EXPECT_EQ(collect(), 1u);
+}
+
+TEST_F(SocketTableTest, FreedSocketsLeaveTheReadyList) {
+    std::array<uint32_t, 3> indexes{};
+    for (uint32_t& index : indexes) {
+        index = SocketTable::index_of(table.allocate(SocketKind::STREAM));
+        table.at(index).interest = SocketEvent::READABLE;
+        ready[index] = SocketEvent::READABLE;
+        table.notify(index);
+    }
+    table.free(indexes[1]);
+
+    // The slot's next owner is reported only once it watches and is notified
+    SocketId reused = table.allocate(SocketKind::LISTENER);
+    EXPECT_EQ(SocketTable::index_of(reused), indexes[1]);
+    EXPECT_EQ(collect(), 2u);
+    EXPECT_EQ(table.get_ready(), 2u);
+
+    table.at(indexes[1]).interest = SocketEvent::READABLE;
+    table.notify(indexes[1]);
+    EXPECT_EQ(collect(), 3u);
+}
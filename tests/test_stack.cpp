@@ -0,0 +1,651 @@
+#include <gtest/gtest.h>
+#include "link/virtual_wire.h"
+#include "stack.h"
+#include "test_frames.h"
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static std::vector<uint8_t> make_tcp_frame(uint8_t client, uint16_t dest_port, uint8_t flags) {
+    return build_frame({.source_ip = {10, 0, 0, client}, .dest_port = dest_port, .flags = flags});
+}
+
+TEST(StackTest, SegmentsAreDemultiplexedToConnections) {
+    std::vector<std::vector<uint8_t>> frames = {
+        make_tcp_frame(1, 80, TCPSegment::SYN),
+        make_tcp_frame(2, 80, TCPSegment::SYN),
+        make_tcp_frame(1, 80, TCPSegment::ACK),
+        make_tcp_frame(3, 81, TCPSegment::SYN),  // nobody listening
+        make_tcp_frame(4, 80, TCPSegment::ACK),  // no connection
+        build_frame({.source_ip = {10, 0, 0, 2}, .sequence = 1, .flags = TCPSegment::RST}),
+    };
+    std::string path = write_file("demux.pcap", make_pcap(frames));
+    
+    for (size_t workers : {0, 2}) {
+        StackConfig stack_config;
+        stack_config.worker_count = workers;
+        TCPIPStack stack("replay", stack_config);
+        ASSERT_TRUE(stack.listen(80));
+        ReplayReport report;
+        ASSERT_TRUE(stack.replay(path, ReplayConfig(), report));
+        
+        EXPECT_EQ(stack.get_stats().connections, 1u);
+        EXPECT_EQ(report.drops.tcp_no_connection, 2u);
+    }
+    std::remove(path.c_str());
+}
+
+TEST(StackTest, ChecksumFailuresAreCounted) {
+    auto good = make_tcp_frame(1, 80, TCPSegment::SYN);
+    auto bad_ip = good;
+    bad_ip[14 + 8] ^= 0x01;  // TTL
+    
+    // Same frame with a correct TCP checksum
+    auto checked = build_frame({.flags = TCPSegment::SYN, .tcp_checksum = true});
+    std::string path = write_file("checksums.pcap", make_pcap({good, bad_ip, checked}));
+    for (bool verify : {false, true}) {
+        StackConfig stack_config;
+        stack_config.verify_tcp_checksum = verify;
+        TCPIPStack stack("replay", stack_config);
+        ReplayReport report;
+        ASSERT_TRUE(stack.replay(path, ReplayConfig(), report));
+        
+        EXPECT_EQ(report.metrics.get(Metric::IP_BAD_CHECKSUM), 1u);
+        EXPECT_EQ(report.metrics.get(Metric::IP_PACKETS), 2u);
+        EXPECT_EQ(report.drops.tcp_bad_checksum, verify ? 1u : 0u);
+        EXPECT_EQ(report.metrics.get(Metric::TCP_SEGMENTS), verify ? 1u : 2u);
+        EXPECT_EQ(stack.get_metrics().get(Metric::RX_PACKETS), 3u);
+    }
+    std::remove(path.c_str());
+}
+
+TEST(StackTest, FragmentedSegmentsAreReassembled) {
+    auto fragments = fragment_frame(build_frame({.flags = TCPSegment::SYN, .tcp_checksum = true}), 8);
+    std::string path = write_file("fragments.pcap", make_pcap({fragments[1], fragments[0]}));
+    for (size_t workers : {0, 2}) {
+        StackConfig stack_config;
+        stack_config.verify_tcp_checksum = true;
+        stack_config.worker_count = workers;
+        TCPIPStack stack("replay", stack_config);
+        ASSERT_TRUE(stack.listen(80));
+        ReplayReport report;
+        ASSERT_TRUE(stack.replay(path, ReplayConfig(), report));
+        
+        EXPECT_EQ(report.metrics.get(Metric::IP_FRAGMENTS), 2u);
+        EXPECT_EQ(report.metrics.get(Metric::IP_REASSEMBLED), 1u);
+        EXPECT_EQ(report.metrics.get(Metric::TCP_BAD_CHECKSUM), 0u);
+        EXPECT_EQ(report.metrics.get(Metric::TCP_SEGMENTS), 1u);
+        EXPECT_EQ(report.metrics.get(Metric::TCP_CONNECTIONS_OPENED), 1u);
+    }
+    std::remove(path.c_str());
+}
+
+static std::vector<uint8_t> make_data_frame(uint32_t sequence, uint8_t flags, size_t payload_length) {
+    return build_frame({.sequence = sequence, .flags = flags, .payload = std::vector<uint8_t>(payload_length, 0xAB)});
+}
+
+TEST(StackTest, PayloadIsSequencedPerConnection) {
+    std::vector<std::vector<uint8_t>> frames = {
+        make_data_frame(5000, TCPSegment::SYN, 0),
+        make_data_frame(5001, TCPSegment::ACK, 0),
+        make_data_frame(5101, TCPSegment::ACK, 100),  // ahead of a hole
+        make_data_frame(5001, TCPSegment::ACK, 100),  // fills it
+        make_data_frame(5001, TCPSegment::ACK, 100),  // retransmission
+        make_data_frame(5201, TCPSegment::ACK, 50),
+    };
+    std::string path = write_file("sequencing.pcap", make_pcap(frames));
+    
+    TCPIPStack stack("replay");
+    ASSERT_TRUE(stack.listen(80));
+    ReplayReport report;
+    ASSERT_TRUE(stack.replay(path, ReplayConfig(), report));
+    
+    EXPECT_EQ(report.metrics.get(Metric::TCP_BYTES_RECEIVED), 250u);
+    EXPECT_EQ(report.metrics.get(Metric::TCP_OUT_OF_ORDER), 1u);
+    EXPECT_EQ(report.metrics.get(Metric::TCP_DUPLICATE), 1u);
+    EXPECT_EQ(report.metrics.get(Metric::TCP_OUT_OF_WINDOW), 0u);
+    std::remove(path.c_str());
+}
+
+TEST(StackTest, FragmentedDataReachesItsConnectionOnAnyWorker) {
+    // A fragment hashes without the ports, so with workers some of these
+    // flows' fragments land away from their connection
+    std::vector<std::vector<uint8_t>> frames;
+    for (uint8_t client = 1; client <= 8; ++client) {
+        TestFrame segment = {.source_ip = {10, 0, 0, client}, .source_port = static_cast<uint16_t>(40000 + client),
+                             .sequence = 5000, .flags = TCPSegment::SYN};
+        frames.push_back(build_frame(segment));
+        segment.sequence = 5001;
+        segment.flags = TCPSegment::ACK;
+        frames.push_back(build_frame(segment));
+        segment.payload.assign(100, 0xAB);
+        for (auto& fragment : fragment_frame(build_frame(segment), 24)) {
+            frames.push_back(std::move(fragment));
+        }
+    }
+    std::string path = write_file("fragmented_data.pcap", make_pcap(frames));
+    
+    for (size_t workers : {0, 2}) {
+        StackConfig stack_config;
+        stack_config.worker_count = workers;
+        TCPIPStack stack("replay", stack_config);
+        ASSERT_TRUE(stack.listen(80));
+        ReplayReport report;
+        ASSERT_TRUE(stack.replay(path, ReplayConfig(), report));
+        
+        EXPECT_EQ(report.metrics.get(Metric::IP_REASSEMBLED), 8u);
+        EXPECT_EQ(report.metrics.get(Metric::IP_PACKETS), 32u);
+        EXPECT_EQ(report.metrics.get(Metric::TCP_BYTES_RECEIVED), 800u);
+        EXPECT_EQ(report.drops.tcp_no_connection, 0u);
+        EXPECT_EQ(stack.get_stats().connections, 8u);
+    }
+    std::remove(path.c_str());
+}
+
+TEST(StackTest, GroMergesSegmentsWithoutChangingWhatIsReceived) {
+    std::vector<std::vector<uint8_t>> frames = {
+        make_data_frame(5000, TCPSegment::SYN, 0),
+        make_data_frame(5001, TCPSegment::ACK, 0),
+    };
+    for (uint32_t i = 0; i < 20; ++i) {
+        frames.push_back(make_data_frame(5001 + i * 100, TCPSegment::ACK, 100));
+    }
+    frames.push_back(make_data_frame(5001, TCPSegment::ACK, 100));  // retransmission
+    std::string path = write_file("gro.pcap", make_pcap(frames));
+    
+    for (bool enabled : {false, true}) {
+        StackConfig stack_config;
+        stack_config.gro.enabled = enabled;
+        TCPIPStack stack("replay", stack_config);
+        ASSERT_TRUE(stack.listen(80));
+        ReplayReport report;
+        ASSERT_TRUE(stack.replay(path, ReplayConfig(), report));
+        
+        EXPECT_EQ(report.metrics.get(Metric::TCP_SEGMENTS), 23u);
+        EXPECT_EQ(report.metrics.get(Metric::TCP_BYTES_RECEIVED), 2000u);
+        EXPECT_EQ(report.metrics.get(Metric::TCP_DUPLICATE), 1u);
+        // All 23 frames fit in one burst, so only the first data segment is
+        // not merged into the one before it
+        EXPECT_EQ(report.metrics.get(Metric::TCP_GRO_MERGED), enabled ? 19u : 0u);
+    }
+    std::remove(path.c_str());
+}
+
+static uint64_t test_clock_ns = 0;
+static uint64_t test_clock() { return test_clock_ns; }
+
+TEST(StackTest, TimersRunOnTheStackClock) {
+    auto fragments = fragment_frame(make_tcp_frame(3, 80, TCPSegment::SYN), 8);
+    std::string path = write_file("timers.pcap", make_pcap({
+        make_data_frame(5000, TCPSegment::SYN, 0),
+        fragments[0],   // never completed
+    }));
+    
+    test_clock_ns = 1'000'000'000;
+    StackConfig stack_config;
+    stack_config.clock = test_clock;
+    stack_config.keepalive_idle_ns = 60'000'000'000ULL;
+    TCPIPStack stack("replay", stack_config);
+    ASSERT_TRUE(stack.listen(80));
+    ReplayReport report;
+    ASSERT_TRUE(stack.replay(path, ReplayConfig(), report));
+    EXPECT_EQ(stack.get_stats().connections, 1u);
+    
+    // Reassembly gives up after 30 s, keepalive after 60 s of silence
+    test_clock_ns += 30'000'000'000ULL;
+    EXPECT_EQ(stack.poll_timers(), 1u);
+    EXPECT_EQ(stack.get_metrics().get(Metric::IP_REASSEMBLY_TIMEOUTS), 1u);
+    EXPECT_EQ(stack.get_stats().connections, 1u);
+    
+    test_clock_ns += 30'000'000'000ULL;
+    EXPECT_EQ(stack.poll_timers(), 1u);
+    EXPECT_EQ(stack.get_metrics().get(Metric::TCP_KEEPALIVE_TIMEOUTS), 1u);
+    EXPECT_EQ(stack.get_stats().connections, 0u);
+    std::remove(path.c_str());
+}
+
+TEST(StackTest, ListeningSocketsAnswerSynsUpToTheBacklog) {
+    std::string path = write_file("listen.pcap", make_pcap({
+        make_tcp_frame(1, 80, TCPSegment::SYN),
+        make_tcp_frame(2, 80, TCPSegment::SYN),
+        make_tcp_frame(3, 80, TCPSegment::SYN),     // over the backlog
+        make_tcp_frame(1, 80, TCPSegment::ACK),     // does not acknowledge the SYN-ACK
+    }));
+    
+    StackConfig stack_config;
+    stack_config.address = 0x0A000101;
+    TCPIPStack stack("replay", stack_config);
+    SocketId listener = stack.listen_socket(80, 2);
+    ASSERT_NE(listener, 0u);
+    EXPECT_EQ(stack.listen_socket(80), 0u);
+    EXPECT_FALSE(stack.listen(80));
+    ASSERT_TRUE(stack.watch(listener, SocketEvent::READABLE));
+    ReplayReport report;
+    ASSERT_TRUE(stack.replay(path, ReplayConfig(), report));
+    
+    EXPECT_EQ(report.metrics.get(Metric::TCP_SEGMENTS_SENT), 2u);   // SYN-ACKs
+    EXPECT_EQ(report.metrics.get(Metric::TCP_LISTEN_OVERFLOWS), 1u);
+    EXPECT_EQ(report.drops.tcp_bad_state, 1u);
+    EXPECT_EQ(stack.get_stats().connections, 2u);
+    
+    // Neither handshake completed
+    std::array<SocketEvent, 4> events{};
+    EXPECT_EQ(stack.wait_events(events), 0u);
+    EXPECT_EQ(stack.accept(listener), 0u);
+    EXPECT_TRUE(stack.close(listener));
+    EXPECT_FALSE(stack.close(listener));
+    std::remove(path.c_str());
+}
+
+// A VirtualWire from a stack at 10.0.1.1 to the test, which plays the peer
+// at 10.0.0.2: it reads what the stack sends and answers with built frames
+struct WiredPeer {
+    static constexpr uint32_t PEER_ISN = 7000;
+
+    VirtualWire wire;
+    PacketPool pool;
+    TCPIPStack stack;
+    size_t largest_payload = 0;
+    TCPOptions last_options;            // of the last segment received
+
+    explicit WiredPeer(const StackConfig& config = host()) : stack(wire.get_a(), config) {}
+
+    static StackConfig host() {
+        StackConfig config;
+        config.address = 0x0A000101;
+        return config;
+    }
+
+    // Headers of the segments the stack has sent since the last call
+    std::vector<TCPHeader> receive() {
+        stack.poll();
+        std::vector<TCPHeader> segments;
+        PacketHandle burst[16];
+        size_t count;
+        while ((count = wire.get_b().rx_burst(pool, burst, 16)) > 0) {
+            for (size_t i = 0; i < count; ++i) {
+                EthernetFrame frame;
+                IPv4Packet packet;
+                TCPSegment segment;
+                std::vector<uint8_t> bytes(burst[i].data(), burst[i].data() + burst[i].size());
+                if (frame.deserialize(bytes) && packet.deserialize(frame.get_payload()) &&
+                    segment.deserialize(packet.get_payload())) {
+                    segments.push_back(segment.get_header());
+                    largest_payload = std::max(largest_payload, segment.get_payload().size());
+                    last_options = TCPOptions();
+                    segment.decode_options(last_options);
+                }
+                burst[i].release();
+            }
+        }
+        return segments;
+    }
+
+    void send(TestFrame spec) {
+        spec.source_port = 80;
+        spec.window = 65535;
+        send_bytes(build_frame(spec));
+    }
+    
+    void send_bytes(const std::vector<uint8_t>& bytes) {
+        PacketHandle frame = pool.alloc();
+        std::copy(bytes.begin(), bytes.end(), frame.append(bytes.size()));
+        wire.get_b().tx_burst(&frame, 1);
+        stack.poll();
+    }
+
+    // Connects to port 80 and answers the SYN with options; returns the
+    // socket, with the stack's ISN in iss
+    SocketId connect(FlowKey& key, uint32_t& iss, const TCPOptions& options = {}) {
+        SocketId socket = stack.connect(0x0A000002, 80);
+        std::vector<TCPHeader> syn = receive();
+        if (socket == 0 || syn.size() != 1 || !stack.get_flow(socket, key)) {
+            return 0;
+        }
+        iss = syn[0].sequence_number;
+        send({.dest_port = key.local_port, .sequence = PEER_ISN, .ack = iss + 1,
+              .flags = TCPSegment::SYN | TCPSegment::ACK, .options = options});
+        return socket;
+    }
+};
+
+TEST(StackTest, ARetransmittedSynAckIsAcknowledgedAgain) {
+    WiredPeer peer;
+    FlowKey key;
+    uint32_t iss = 0;
+    SocketId socket = peer.connect(key, iss);
+    ASSERT_NE(socket, 0u);
+    // The handshake's ACK is lost on the way, so the SYN-ACK comes again
+    ASSERT_EQ(peer.receive().size(), 1u);
+    EXPECT_NE(peer.stack.get_events(socket) & SocketEvent::WRITABLE, 0u);
+    peer.send({.dest_port = key.local_port, .sequence = WiredPeer::PEER_ISN, .ack = iss + 1,
+               .flags = TCPSegment::SYN | TCPSegment::ACK});
+    
+    std::vector<TCPHeader> ack = peer.receive();
+    ASSERT_EQ(ack.size(), 1u);
+    EXPECT_EQ(ack[0].flags, TCPSegment::ACK);
+    EXPECT_EQ(ack[0].sequence_number, iss + 1);
+    EXPECT_EQ(ack[0].acknowledgment_number, WiredPeer::PEER_ISN + 1);
+    EXPECT_EQ(peer.stack.get_error(socket), SocketError::NONE);
+    EXPECT_EQ(peer.stack.get_metrics().get(Metric::TCP_BAD_STATE), 0u);
+}
+
+TEST(StackTest, ResetRefusesAConnect) {
+    WiredPeer peer;
+    TCPIPStack& stack = peer.stack;
+    SocketId socket = stack.connect(0x0A000002, 80);
+    ASSERT_NE(socket, 0u);
+    FlowKey key;
+    ASSERT_TRUE(stack.get_flow(socket, key));
+    EXPECT_EQ(key.remote_port, 80);
+    EXPECT_GE(key.local_port, 49152);
+    std::vector<TCPHeader> syn = peer.receive();
+    ASSERT_EQ(syn.size(), 1u);
+    EXPECT_EQ(stack.get_metrics().get(Metric::TCP_SEGMENTS_SENT), 1u);
+    
+    ASSERT_TRUE(stack.watch(socket, SocketEvent::READABLE | SocketEvent::WRITABLE | SocketEvent::CLOSED, 7));
+    std::array<SocketEvent, 4> events{};
+    EXPECT_EQ(stack.wait_events(events), 0u);
+    std::array<uint8_t, 16> buffer{};
+    EXPECT_EQ(stack.recv(socket, buffer).error, SocketError::WOULD_BLOCK);
+    EXPECT_EQ(stack.send(socket, buffer).error, SocketError::WOULD_BLOCK);
+    
+    peer.send({.dest_port = key.local_port, .ack = syn[0].sequence_number + 1,
+               .flags = TCPSegment::RST | TCPSegment::ACK});
+    
+    EXPECT_EQ(stack.get_error(socket), SocketError::RESET);
+    ASSERT_EQ(stack.wait_events(events), 1u);
+    EXPECT_EQ(events[0].socket, socket);
+    EXPECT_EQ(events[0].events, SocketEvent::READABLE | SocketEvent::CLOSED);
+    EXPECT_EQ(events[0].data, 7u);
+    EXPECT_EQ(stack.recv(socket, buffer).error, SocketError::RESET);
+    EXPECT_EQ(stack.send(socket, buffer).error, SocketError::RESET);
+    EXPECT_FALSE(stack.get_flow(socket, key));
+    EXPECT_EQ(stack.get_stats().connections, 0u);
+    
+    EXPECT_TRUE(stack.close(socket));
+    EXPECT_EQ(stack.get_error(socket), SocketError::INVALID);
+    EXPECT_EQ(stack.wait_events(events), 0u);
+}
+
+TEST(StackTest, ResetInSynSentMustAcknowledgeTheSyn) {
+    WiredPeer peer;
+    SocketId socket = peer.stack.connect(0x0A000002, 80);
+    FlowKey key;
+    ASSERT_TRUE(peer.stack.get_flow(socket, key));
+    std::vector<TCPHeader> syn = peer.receive();
+    ASSERT_EQ(syn.size(), 1u);
+    uint32_t iss = syn[0].sequence_number;
+    
+    // Without an ACK, or acknowledging something else, a reset is ignored
+    peer.send({.dest_port = key.local_port, .flags = TCPSegment::RST});
+    peer.send({.dest_port = key.local_port, .ack = iss + 2, .flags = TCPSegment::RST | TCPSegment::ACK});
+    peer.send({.dest_port = key.local_port, .ack = iss, .flags = TCPSegment::RST | TCPSegment::ACK});
+    EXPECT_EQ(peer.stack.get_error(socket), SocketError::NONE);
+    EXPECT_EQ(peer.stack.get_metrics().get(Metric::TCP_RESETS_IGNORED), 3u);
+    EXPECT_TRUE(peer.receive().empty());
+    
+    peer.send({.dest_port = key.local_port, .ack = iss + 1, .flags = TCPSegment::RST | TCPSegment::ACK});
+    EXPECT_EQ(peer.stack.get_error(socket), SocketError::RESET);
+}
+
+TEST(StackTest, ResetInsideTheWindowGetsAChallengeAck) {
+    WiredPeer peer;
+    FlowKey key;
+    uint32_t iss = 0;
+    SocketId socket = peer.connect(key, iss);
+    ASSERT_NE(socket, 0u);
+    ASSERT_EQ(peer.receive().size(), 1u);  // the handshake's ACK
+    
+    // In the window but not at RCV.NXT: the stack answers with an ACK that
+    // a peer which really lost its connection resets exactly
+    uint32_t rcv_nxt = WiredPeer::PEER_ISN + 1;
+    peer.send({.dest_port = key.local_port, .sequence = rcv_nxt + 1000, .flags = TCPSegment::RST});
+    EXPECT_EQ(peer.stack.get_error(socket), SocketError::NONE);
+    std::vector<TCPHeader> challenge = peer.receive();
+    ASSERT_EQ(challenge.size(), 1u);
+    EXPECT_EQ(challenge[0].flags, TCPSegment::ACK);
+    EXPECT_EQ(challenge[0].sequence_number, iss + 1);
+    EXPECT_EQ(challenge[0].acknowledgment_number, rcv_nxt);
+    EXPECT_EQ(peer.stack.get_metrics().get(Metric::TCP_CHALLENGE_ACKS), 1u);
+    
+    peer.send({.dest_port = key.local_port, .sequence = rcv_nxt, .flags = TCPSegment::RST});
+    EXPECT_EQ(peer.stack.get_error(socket), SocketError::RESET);
+    EXPECT_TRUE(peer.receive().empty());
+}
+
+TEST(StackTest, ResetOutsideTheWindowIsIgnored) {
+    WiredPeer peer;
+    FlowKey key;
+    uint32_t iss = 0;
+    SocketId socket = peer.connect(key, iss);
+    ASSERT_NE(socket, 0u);
+    ASSERT_EQ(peer.receive().size(), 1u);
+    
+    uint32_t rcv_nxt = WiredPeer::PEER_ISN + 1;
+    peer.send({.dest_port = key.local_port, .sequence = rcv_nxt - 1, .flags = TCPSegment::RST});
+    peer.send({.dest_port = key.local_port, .sequence = rcv_nxt + 65536, .flags = TCPSegment::RST});
+    peer.send({.dest_port = key.local_port, .sequence = rcv_nxt + 1'000'000, .flags = TCPSegment::RST});
+    EXPECT_EQ(peer.stack.get_error(socket), SocketError::NONE);
+    EXPECT_TRUE(peer.receive().empty());
+    MetricsSnapshot metrics = peer.stack.get_metrics();
+    EXPECT_EQ(metrics.get(Metric::TCP_RESETS_IGNORED), 3u);
+    EXPECT_EQ(metrics.get(Metric::TCP_CHALLENGE_ACKS), 0u);
+    EXPECT_EQ(peer.stack.get_stats().connections, 1u);
+}
+
+TEST(StackTest, OnlyTheOpeningSynSetsTheOptions) {
+    StackConfig config = WiredPeer::host();
+    config.receive_buffer_size = 1 << 20;   // a window scale of 5
+    config.delayed_ack_ns = 0;
+    WiredPeer peer(config);
+    TCPOptions offer;
+    offer.mss = 1460;
+    offer.has_window_scale = true;
+    offer.window_scale = 7;
+    offer.sack_permitted = true;
+    offer.has_timestamps = true;
+    offer.ts_value = 100;
+    FlowKey key;
+    uint32_t iss = 0;
+    SocketId socket = peer.connect(key, iss, offer);
+    ASSERT_NE(socket, 0u);
+    std::vector<TCPHeader> ack = peer.receive();
+    ASSERT_EQ(ack.size(), 1u);
+    EXPECT_EQ(ack[0].window_size, (1u << 20) >> 5);
+    EXPECT_TRUE(peer.last_options.has_timestamps);
+    EXPECT_EQ(peer.last_options.ts_echo, 100u);
+    
+    // A SYN without options on the established flow is refused and changes
+    // nothing: data after it is still acknowledged with scaling and
+    // timestamps, echoing the data's TSval
+    uint32_t rcv_nxt = WiredPeer::PEER_ISN + 1;
+    peer.send({.dest_port = key.local_port, .sequence = rcv_nxt - 1, .flags = TCPSegment::SYN});
+    EXPECT_EQ(peer.stack.get_metrics().get(Metric::TCP_BAD_STATE), 1u);
+    TCPOptions stamped;
+    stamped.has_timestamps = true;
+    stamped.ts_value = 200;
+    peer.send({.dest_port = key.local_port, .sequence = rcv_nxt, .ack = iss + 1, .flags = TCPSegment::ACK,
+               .payload = std::vector<uint8_t>(100, 0x5A), .options = stamped});
+    ack = peer.receive();
+    ASSERT_EQ(ack.size(), 1u);
+    EXPECT_EQ(ack[0].acknowledgment_number, rcv_nxt + 100);
+    EXPECT_EQ(ack[0].window_size, ((1u << 20) - 100) >> 5);
+    EXPECT_TRUE(peer.last_options.has_timestamps);
+    EXPECT_EQ(peer.last_options.ts_echo, 200u);
+}
+
+TEST(StackTest, SegmentsFitAPoolBufferOrCountAsDropped) {
+    // 512 byte buffers leave 290 bytes for payload behind a full set of
+    // headers; eight of them cannot hold a first flight of ten segments
+    StackConfig config = WiredPeer::host();
+    config.pool.buffer_size = 512;
+    config.pool.buffer_count = 8;
+    config.pool.cache_size = 0;
+    config.sender.mss = 1460;
+    WiredPeer peer(config);
+    FlowKey key;
+    uint32_t iss = 0;
+    SocketId socket = peer.connect(key, iss);
+    ASSERT_NE(socket, 0u);
+    peer.receive();
+    
+    std::vector<uint8_t> data(8192, 0x5A);
+    EXPECT_GT(peer.stack.send(socket, data).bytes, 0u);
+    std::vector<TCPHeader> sent = peer.receive();
+    ASSERT_FALSE(sent.empty());
+    EXPECT_EQ(peer.largest_payload, 290u);
+    
+    MetricsSnapshot metrics = peer.stack.get_metrics();
+    EXPECT_GT(metrics.get(Metric::TX_NO_BUFFER), 0u);
+    EXPECT_EQ(metrics.get(Metric::TX_OVERSIZE), 0u);
+    EXPECT_EQ(metrics.get(Metric::RX_NO_BUFFER), 0u);
+    EXPECT_EQ(peer.stack.get_stats().tx_dropped, metrics.get(Metric::TX_NO_BUFFER));
+}
+
+TEST(StackTest, ConnectGivesUpAfterSynRetries) {
+    test_clock_ns = 1'000'000'000;
+    StackConfig stack_config;
+    stack_config.clock = test_clock;
+    stack_config.address = 0x0A000101;
+    stack_config.syn_retries = 3;
+    TCPIPStack stack("replay", stack_config);
+    SocketId socket = stack.connect(0x0A000001, 80);
+    ASSERT_NE(socket, 0u);
+    
+    // The SYN goes again after 1, 2 and 4 s; 8 s after the last, it is over
+    for (uint64_t rto = 1'000'000'000; rto <= 8'000'000'000ULL; rto *= 2) {
+        EXPECT_EQ(stack.get_error(socket), SocketError::NONE);
+        test_clock_ns += rto + 10'000'000;
+        EXPECT_EQ(stack.poll_timers(), 1u);
+    }
+    MetricsSnapshot metrics = stack.get_metrics();
+    EXPECT_EQ(metrics.get(Metric::TCP_SEGMENTS_SENT), 4u);
+    EXPECT_EQ(metrics.get(Metric::TCP_RETRANSMIT_TIMEOUTS), 4u);
+    EXPECT_EQ(stack.get_error(socket), SocketError::TIMED_OUT);
+    EXPECT_EQ(stack.get_stats().connections, 0u);
+}
+
+TEST(StackTest, UnacknowledgedDataGivesUpAfterDataRetries) {
+    test_clock_ns = 1'000'000'000;
+    StackConfig config = WiredPeer::host();
+    config.clock = test_clock;
+    config.data_retries = 3;
+    WiredPeer peer(config);
+    FlowKey key;
+    uint32_t iss = 0;
+    SocketId socket = peer.connect(key, iss);
+    ASSERT_NE(socket, 0u);
+    peer.receive();
+    std::vector<uint8_t> data(100, 0x5A);
+    EXPECT_EQ(peer.stack.send(socket, data).bytes, 100u);
+    ASSERT_EQ(peer.receive().size(), 1u);
+    
+    // The peer has gone quiet: three resends, then a reset
+    for (int timeout = 0; timeout < 3; ++timeout) {
+        test_clock_ns += 61'000'000'000ULL;
+        std::vector<TCPHeader> resent = peer.receive();
+        ASSERT_EQ(resent.size(), 1u);
+        EXPECT_EQ(resent[0].sequence_number, iss + 1);
+        EXPECT_EQ(peer.stack.get_error(socket), SocketError::NONE);
+    }
+    test_clock_ns += 61'000'000'000ULL;
+    std::vector<TCPHeader> reset = peer.receive();
+    ASSERT_EQ(reset.size(), 1u);
+    EXPECT_NE(reset[0].flags & TCPSegment::RST, 0);
+    EXPECT_EQ(peer.stack.get_error(socket), SocketError::TIMED_OUT);
+    EXPECT_EQ(peer.stack.get_stats().connections, 0u);
+}
+
+TEST(StackTest, KeepaliveResetsAnIdleEndpoint) {
+    test_clock_ns = 1'000'000'000;
+    StackConfig config = WiredPeer::host();
+    config.clock = test_clock;
+    config.keepalive_idle_ns = 60'000'000'000ULL;
+    WiredPeer peer(config);
+    FlowKey key;
+    uint32_t iss = 0;
+    SocketId socket = peer.connect(key, iss);
+    ASSERT_NE(socket, 0u);
+    peer.receive();
+    
+    test_clock_ns += 61'000'000'000ULL;
+    std::vector<TCPHeader> reset = peer.receive();
+    ASSERT_EQ(reset.size(), 1u);
+    EXPECT_EQ(reset[0].flags, TCPSegment::RST | TCPSegment::ACK);
+    EXPECT_EQ(peer.stack.get_metrics().get(Metric::TCP_KEEPALIVE_TIMEOUTS), 1u);
+    EXPECT_EQ(peer.stack.get_error(socket), SocketError::TIMED_OUT);
+}
+
+TEST(StackTest, HeldFragmentsLeaveTheReceivePoolAlone) {
+    StackConfig config = WiredPeer::host();
+    config.pool.buffer_count = 8;
+    config.pool.cache_size = 0;
+    WiredPeer peer(config);
+    // First halves of twice as many datagrams as the pool has buffers
+    for (uint8_t client = 1; client <= 16; ++client) {
+        peer.send_bytes(fragment_frame(build_frame({.source_ip = {10, 0, 0, client}, .flags = TCPSegment::SYN}), 8)[0]);
+    }
+    MetricsSnapshot metrics = peer.stack.get_metrics();
+    EXPECT_EQ(metrics.get(Metric::IP_FRAGMENTS), 16u);
+    EXPECT_EQ(metrics.get(Metric::IP_REASSEMBLY_DROPS), 0u);
+    EXPECT_EQ(metrics.get(Metric::RX_NO_BUFFER), 0u);
+    
+    // Every buffer is still there for a handshake
+    FlowKey key;
+    uint32_t iss = 0;
+    ASSERT_NE(peer.connect(key, iss), 0u);
+    EXPECT_EQ(peer.receive().size(), 1u);
+}
+
+TEST(StackTest, AcknowledgementsOfInOrderDataAreDelayed) {
+    test_clock_ns = 1'000'000'000;
+    StackConfig config = WiredPeer::host();
+    config.clock = test_clock;
+    WiredPeer peer(config);
+    FlowKey key;
+    uint32_t iss = 0;
+    SocketId socket = peer.connect(key, iss);
+    ASSERT_NE(socket, 0u);
+    ASSERT_EQ(peer.receive().size(), 1u);
+    uint32_t rcv_nxt = WiredPeer::PEER_ISN + 1;
+    
+    // One small segment waits for the timer
+    peer.send({.dest_port = key.local_port, .sequence = rcv_nxt, .ack = iss + 1, .flags = TCPSegment::ACK,
+               .payload = std::vector<uint8_t>(100, 0x5A)});
+    rcv_nxt += 100;
+    EXPECT_TRUE(peer.receive().empty());
+    test_clock_ns += config.delayed_ack_ns;
+    std::vector<TCPHeader> ack = peer.receive();
+    ASSERT_EQ(ack.size(), 1u);
+    EXPECT_EQ(ack[0].acknowledgment_number, rcv_nxt);
+    
+    // Data going back carries the ACK, and no bare one follows
+    peer.send({.dest_port = key.local_port, .sequence = rcv_nxt, .ack = iss + 1, .flags = TCPSegment::ACK,
+               .payload = std::vector<uint8_t>(100, 0x5A)});
+    rcv_nxt += 100;
+    std::vector<uint8_t> reply(10, 0x33);
+    EXPECT_EQ(peer.stack.send(socket, reply).bytes, 10u);
+    ack = peer.receive();
+    ASSERT_EQ(ack.size(), 1u);
+    EXPECT_EQ(ack[0].acknowledgment_number, rcv_nxt);
+    test_clock_ns += config.delayed_ack_ns;
+    EXPECT_TRUE(peer.receive().empty());
+    
+    // Two full-sized segments, or one out of order, are acknowledged at once
+    for (int i = 0; i < 2; ++i) {
+        peer.send({.dest_port = key.local_port, .sequence = rcv_nxt, .ack = iss + 11, .flags = TCPSegment::ACK,
+                   .payload = std::vector<uint8_t>(1460, 0x5A)});
+        rcv_nxt += 1460;
+    }
+    ack = peer.receive();
+    ASSERT_FALSE(ack.empty());
+    EXPECT_EQ(ack.back().acknowledgment_number, rcv_nxt);
+    peer.send({.dest_port = key.local_port, .sequence = rcv_nxt + 100, .ack = iss + 11, .flags = TCPSegment::ACK,
+               .payload = std::vector<uint8_t>(100, 0x5A)});
+    ack = peer.receive();
+    ASSERT_EQ(ack.size(), 1u);
+    EXPECT_EQ(ack[0].acknowledgment_number, rcv_nxt);
+}
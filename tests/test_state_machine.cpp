@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include "tcp/tcp_state_machine.h"
+
+static_assert(TCP_TRANSITIONS[static_cast<size_t>(TCPState::LISTEN)][static_cast<size_t>(TCPEvent::RECV_SYN)] ==
+              static_cast<uint8_t>(TCPState::SYN_RECEIVED));
+
+TEST(StateMachineTest, ActiveOpenAndClose) {
+    TCPStateMachine sm;
+    EXPECT_TRUE(sm.send_syn());
+    EXPECT_TRUE(sm.handle_syn_ack());
+    EXPECT_EQ(sm.get_state(), TCPState::ESTABLISHED);
+    
+    EXPECT_TRUE(sm.send_fin());
+    EXPECT_EQ(sm.get_state(), TCPState::FIN_WAIT_1);
+    EXPECT_TRUE(sm.handle_ack());
+    EXPECT_EQ(sm.get_state(), TCPState::FIN_WAIT_2);
+    EXPECT_TRUE(sm.handle_fin());
+    EXPECT_EQ(sm.get_state(), TCPState::TIME_WAIT);
+    EXPECT_TRUE(sm.handle_time_wait_expired());
+    EXPECT_EQ(sm.get_state(), TCPState::CLOSED);
+}
+
+TEST(StateMachineTest, PassiveOpenAndClose) {
+    TCPStateMachine sm;
+    EXPECT_TRUE(sm.listen());
+    EXPECT_TRUE(sm.handle_syn());
+    EXPECT_EQ(sm.get_state(), TCPState::SYN_RECEIVED);
+    EXPECT_TRUE(sm.handle_ack());
+    EXPECT_EQ(sm.get_state(), TCPState::ESTABLISHED);
+    
+    EXPECT_TRUE(sm.handle_fin());
+    EXPECT_EQ(sm.get_state(), TCPState::CLOSE_WAIT);
+    EXPECT_TRUE(sm.send_fin());
+    EXPECT_EQ(sm.get_state(), TCPState::LAST_ACK);
+    EXPECT_TRUE(sm.handle_ack());
+    EXPECT_EQ(sm.get_state(), TCPState::CLOSED);
+}
+
+TEST(StateMachineTest, SimultaneousClose) {
+    TCPStateMachine sm;
+    sm.send_syn();
+    sm.handle_syn_ack();
+    sm.send_fin();
+    
+    EXPECT_TRUE(sm.handle_fin());
+    EXPECT_EQ(sm.get_state(), TCPState::CLOSING);
+    EXPECT_TRUE(sm.handle_ack());
+    EXPECT_EQ(sm.get_state(), TCPState::TIME_WAIT);
+}
+
+TEST(StateMachineTest, SimultaneousOpen) {
+    TCPStateMachine sm;
+    sm.send_syn();
+    
+    // The peer's SYN crosses ours, then its SYN-ACK arrives
+    EXPECT_TRUE(sm.handle_syn());
+    EXPECT_EQ(sm.get_state(), TCPState::SYN_RECEIVED);
+    EXPECT_TRUE(sm.handle_syn_ack());
+    EXPECT_EQ(sm.get_state(), TCPState::ESTABLISHED);
+}
+
+TEST(StateMachineTest, RetransmittedFinKeepsTheState) {
+    TCPStateMachine sm;
+    sm.send_syn();
+    sm.handle_syn_ack();
+    sm.handle_fin();
+    EXPECT_TRUE(sm.handle_fin());
+    EXPECT_EQ(sm.get_state(), TCPState::CLOSE_WAIT);
+    sm.send_fin();
+    EXPECT_TRUE(sm.handle_fin());
+    EXPECT_EQ(sm.get_state(), TCPState::LAST_ACK);
+    
+    TCPStateMachine closing;
+    closing.send_syn();
+    closing.handle_syn_ack();
+    closing.send_fin();
+    closing.handle_fin();
+    EXPECT_TRUE(closing.handle_fin());
+    EXPECT_EQ(closing.get_state(), TCPState::CLOSING);
+}
+
+TEST(StateMachineTest, InvalidEventsLeaveStateUnchanged) {
+    TCPStateMachine sm;
+    EXPECT_FALSE(sm.handle_syn_ack());
+    EXPECT_FALSE(sm.handle_fin());
+    EXPECT_FALSE(sm.send_fin());
+    EXPECT_EQ(sm.get_state(), TCPState::CLOSED);
+    
+    sm.send_syn();
+    EXPECT_FALSE(sm.handle_fin());
+    EXPECT_EQ(sm.get_state(), TCPState::SYN_SENT);
+}
+
+TEST(StateMachineTest, ResetClosesSynchronizedConnections) {
+    TCPStateMachine sm;
+    sm.listen();
+    sm.handle_syn();
+    sm.handle_ack();
+    
+    EXPECT_TRUE(sm.handle_rst());
+    EXPECT_EQ(sm.get_state(), TCPState::CLOSED);
+    EXPECT_STREQ(sm.get_state_name(), "CLOSED");
+}
+
+TEST(StateMachineTest, OneBytePerConnection) {
+    EXPECT_EQ(sizeof(TCPStateMachine), 1u);
+    EXPECT_EQ(sizeof(VerboseTCPStateMachine), 1u);
+}
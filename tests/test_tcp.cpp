@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 #include "tcp/tcp_segment.h"
+#include "ip/checksum.h"
+#include "tcp/tcp_view.h"
 
 TEST(TCPSegmentTest, SYNFlag) {
     TCPSegment segment;
@@ -13,3 +15,105 @@ TEST(TCPSegmentTest, SYNFlag) {
     EXPECT_TRUE(success);
     EXPECT_EQ(parsed.get_header().flags & TCPSegment::SYN, TCPSegment::SYN);
 }
+
+// Checksum the way the original implementation did: pseudo-header and the
+// serialized segment concatenated into one buffer
+static uint16_t concatenated_checksum(const TCPSegment& segment,
+                                      const std::array<uint8_t, 4>& source_ip,
+                                      const std::array<uint8_t, 4>& dest_ip) {
+    auto tcp_data = segment.serialize();
+    tcp_data[16] = 0;
+    tcp_data[17] = 0;
+    
+    std::vector<uint8_t> data(source_ip.begin(), source_ip.end());
+    data.insert(data.end(), dest_ip.begin(), dest_ip.end());
+    data.push_back(0);
+    data.push_back(6);
+    data.push_back(static_cast<uint8_t>(tcp_data.size() >> 8));
+    data.push_back(static_cast<uint8_t>(tcp_data.size() & 0xFF));
+    data.insert(data.end(), tcp_data.begin(), tcp_data.end());
+    return calculate_checksum(data);
+}
+
+TEST(TCPSegmentTest, StreamingChecksumMatchesConcatenated) {
+    std::array<uint8_t, 4> src = {192, 168, 1, 10};
+    std::array<uint8_t, 4> dst = {10, 0, 0, 1};
+    
+    for (size_t length : {0, 1, 5, 64, 1459, 1460}) {
+        TCPSegment segment;
+        segment.set_source_port(40000);
+        segment.set_dest_port(443);
+        segment.set_sequence_number(0xDEADBEEF);
+        segment.set_ack_number(12345);
+        segment.set_flags(TCPSegment::ACK | TCPSegment::PSH);
+        segment.set_window_size(29200);
+        std::vector<uint8_t> payload(length);
+        for (size_t i = 0; i < length; ++i) {
+            payload[i] = static_cast<uint8_t>(i * 7 + 3);
+        }
+        segment.set_payload(payload);
+        
+        EXPECT_EQ(segment.calculate_checksum(src, dst), concatenated_checksum(segment, src, dst))
+            << "payload length " << length;
+    }
+}
+
+TEST(TCPSegmentTest, SerializeWithAddressesFillsChecksum) {
+    std::array<uint8_t, 4> src = {172, 16, 0, 1};
+    std::array<uint8_t, 4> dst = {172, 16, 0, 2};
+    
+    TCPSegment segment;
+    segment.set_source_port(1234);
+    segment.set_dest_port(80);
+    segment.set_flags(TCPSegment::SYN);
+    segment.set_payload({'a', 'b', 'c'});
+    
+    auto bytes = segment.serialize(src, dst);
+    TCPSegment parsed;
+    ASSERT_TRUE(parsed.deserialize(bytes));
+    EXPECT_EQ(parsed.get_header().checksum, segment.calculate_checksum(src, dst));
+    EXPECT_EQ(std::vector<uint8_t>(bytes.begin() + 20, bytes.end()), segment.get_payload());
+}
+
+TEST(TCPSegmentTest, OptionsGoBetweenHeaderAndPayload) {
+    std::array<uint8_t, 4> src = {10, 0, 0, 1};
+    std::array<uint8_t, 4> dst = {10, 0, 0, 2};
+    
+    TCPOptions options;
+    options.mss = 1460;
+    options.sack_permitted = true;
+    options.has_timestamps = true;
+    options.ts_value = 77;
+    options.has_window_scale = true;
+    options.window_scale = 7;
+    
+    TCPSegment segment;
+    segment.set_source_port(40000);
+    segment.set_dest_port(5001);
+    segment.set_flags(TCPSegment::SYN);
+    segment.set_options(options);
+    segment.set_payload({'x', 'y'});
+    EXPECT_EQ(segment.get_header_length(), 40u);
+    
+    auto bytes = segment.serialize(src, dst);
+    ASSERT_EQ(bytes.size(), 42u);
+    EXPECT_EQ(bytes[12] >> 4, 10);
+    EXPECT_EQ(segment.calculate_checksum(src, dst), concatenated_checksum(segment, src, dst));
+    
+    TCPView view;
+    ASSERT_TRUE(view.parse(bytes));
+    EXPECT_TRUE(view.has_valid_checksum(0x0A000001, 0x0A000002));
+    EXPECT_EQ(view.get_payload().size(), 2u);
+    TCPOptions decoded;
+    ASSERT_TRUE(view.decode_options(decoded));
+    EXPECT_EQ(decoded.mss, 1460);
+    EXPECT_EQ(decoded.window_scale, 7);
+    EXPECT_EQ(decoded.ts_value, 77u);
+    
+    TCPSegment parsed;
+    ASSERT_TRUE(parsed.deserialize(bytes));
+    EXPECT_EQ(parsed.get_header_length(), 40u);
+    EXPECT_EQ(parsed.get_payload(), segment.get_payload());
+    ASSERT_TRUE(parsed.decode_options(decoded));
+    EXPECT_TRUE(decoded.sack_permitted);
+}
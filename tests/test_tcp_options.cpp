@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+#include "tcp/tcp_options.h"
+#include <vector>
+
+static std::vector<uint8_t> encode(const TCPOptions& options) {
+    std::array<uint8_t, TCPOptions::MAX_SIZE> buffer{};
+    size_t length = write_tcp_options(options, buffer);
+    return {buffer.begin(), buffer.begin() + length};
+}
+
+TEST(TCPOptionsTest, SynOptionsUseTheLinuxLayout) {
+    TCPOptions options;
+    options.mss = 1460;
+    options.sack_permitted = true;
+    options.has_timestamps = true;
+    options.ts_value = 0x01020304;
+    options.ts_echo = 0;
+    options.has_window_scale = true;
+    options.window_scale = 7;
+
+    std::vector<uint8_t> expected = {0x02, 0x04, 0x05, 0xB4, 0x04, 0x02, 0x08, 0x0A, 0x01, 0x02,
+                                     0x03, 0x04, 0x00, 0x00, 0x00, 0x00, 0x01, 0x03, 0x03, 0x07};
+    std::vector<uint8_t> bytes = encode(options);
+    EXPECT_EQ(bytes, expected);
+
+    TCPOptions parsed;
+    ASSERT_TRUE(parse_tcp_options(bytes, parsed));
+    EXPECT_EQ(parsed.mss, 1460);
+    EXPECT_TRUE(parsed.sack_permitted);
+    EXPECT_TRUE(parsed.has_timestamps);
+    EXPECT_EQ(parsed.ts_value, 0x01020304u);
+    EXPECT_EQ(parsed.ts_echo, 0u);
+    EXPECT_TRUE(parsed.has_window_scale);
+    EXPECT_EQ(parsed.window_scale, 7);
+}
+
+TEST(TCPOptionsTest, EveryCombinationRoundTrips) {
+    for (unsigned mask = 0; mask < 32; ++mask) {
+        TCPOptions options;
+        options.mss = mask & 1 ? 8960 : 0;
+        options.has_window_scale = mask & 2;
+        options.window_scale = mask & 2 ? 9 : 0;
+        options.sack_permitted = mask & 4;
+        options.has_timestamps = mask & 8;
+        options.ts_value = mask & 8 ? 0xCAFEF00D : 0;
+        options.ts_echo = mask & 8 ? 0x12345678 : 0;
+        if (mask & 16) {
+            std::array<SequenceRange, 2> ranges = {{{0xFFFFFF00, 0x100}, {0x1000, 0x2000}}};
+            options.set_sack_blocks(ranges, 0x1800);
+        }
+
+        std::vector<uint8_t> bytes = encode(options);
+        EXPECT_EQ(bytes.size() % 4, 0u) << "mask " << mask;
+        TCPOptions parsed;
+        ASSERT_TRUE(parse_tcp_options(bytes, parsed)) << "mask " << mask;
+        EXPECT_EQ(parsed.mss, options.mss);
+        EXPECT_EQ(parsed.has_window_scale, options.has_window_scale);
+        EXPECT_EQ(parsed.window_scale, options.window_scale);
+        EXPECT_EQ(parsed.sack_permitted, options.sack_permitted);
+        EXPECT_EQ(parsed.has_timestamps, options.has_timestamps);
+        EXPECT_EQ(parsed.ts_value, options.ts_value);
+        EXPECT_EQ(parsed.ts_echo, options.ts_echo);
+        ASSERT_EQ(parsed.sack_count, options.sack_count);
+        for (size_t i = 0; i < parsed.sack_count; ++i) {
+            EXPECT_EQ(parsed.sack_blocks[i].start, options.sack_blocks[i].start);
+            EXPECT_EQ(parsed.sack_blocks[i].end, options.sack_blocks[i].end);
+        }
+    }
+}
+
+TEST(TCPOptionsTest, ParsesTimestampsAloneAndOtherLayouts) {
+    // The established-flow fast path
+    std::vector<uint8_t> timestamps = {0x01, 0x01, 0x08, 0x0A, 0, 0, 0, 1, 0, 0, 0, 2};
+    TCPOptions parsed;
+    ASSERT_TRUE(parse_tcp_options(timestamps, parsed));
+    EXPECT_TRUE(parsed.has_timestamps);
+    EXPECT_EQ(parsed.ts_value, 1u);
+    EXPECT_EQ(parsed.ts_echo, 2u);
+
+    // Another stack's order, padded with END, walks the options
+    std::vector<uint8_t> other = {0x03, 0x03, 0x02, 0x01, 0x02, 0x04, 0x02, 0x18, 0x04, 0x02, 0x00, 0x00};
+    ASSERT_TRUE(parse_tcp_options(other, parsed));
+    EXPECT_EQ(parsed.mss, 536);
+    EXPECT_TRUE(parsed.has_window_scale);
+    EXPECT_EQ(parsed.window_scale, 2);
+    EXPECT_TRUE(parsed.sack_permitted);
+    EXPECT_FALSE(parsed.has_timestamps);
+
+    // Nothing after END is read
+    std::vector<uint8_t> ended = {0x00, 0x02, 0x04, 0x05, 0xB4};
+    ASSERT_TRUE(parse_tcp_options(ended, parsed));
+    EXPECT_EQ(parsed.mss, 0);
+}
+
+TEST(TCPOptionsTest, MalformedOptionsAreRejectedOrSkipped) {
+    TCPOptions parsed;
+    // A length below 2 or past the end
+    EXPECT_FALSE(parse_tcp_options(std::vector<uint8_t>{0x02, 0x01, 0x05, 0xB4}, parsed));
+    EXPECT_FALSE(parse_tcp_options(std::vector<uint8_t>{0x02, 0x04, 0x05}, parsed));
+    EXPECT_FALSE(parse_tcp_options(std::vector<uint8_t>{0x01, 0x01, 0x08}, parsed));
+    EXPECT_FALSE(parse_tcp_options(std::vector<uint8_t>{0x08, 0x0A, 0, 0, 0, 1}, parsed));
+
+    // A known kind with the wrong length, and an unknown kind, are skipped
+    std::vector<uint8_t> skipped = {0x02, 0x06, 0, 0, 0, 0, 0x1E, 0x04, 0xAA, 0xBB, 0x03, 0x03, 0x05, 0x01};
+    ASSERT_TRUE(parse_tcp_options(skipped, parsed));
+    EXPECT_EQ(parsed.mss, 0);
+    EXPECT_TRUE(parsed.has_window_scale);
+    EXPECT_EQ(parsed.window_scale, 5);
+
+    // SACK blocks must be whole
+    std::vector<uint8_t> partial = {0x05, 0x06, 0, 0, 0, 1, 0x01, 0x01};
+    ASSERT_TRUE(parse_tcp_options(partial, parsed));
+    EXPECT_EQ(parsed.sack_count, 0);
+}
+
+TEST(TCPOptionsTest, WindowScaleIsClampedTo14) {
+    TCPOptions parsed;
+    ASSERT_TRUE(parse_tcp_options(std::vector<uint8_t>{0x01, 0x03, 0x03, 0x0F}, parsed));
+    EXPECT_EQ(parsed.window_scale, TCPOptions::MAX_WINDOW_SCALE);
+
+    TCPOptions options;
+    options.has_window_scale = true;
+    options.window_scale = 20;
+    ASSERT_TRUE(parse_tcp_options(encode(options), parsed));
+    EXPECT_EQ(parsed.window_scale, TCPOptions::MAX_WINDOW_SCALE);
+}
+
+TEST(TCPOptionsTest, SackBlocksFitAroundTimestamps) {
+    std::array<SequenceRange, 4> ranges = {{{100, 200}, {300, 400}, {500, 600}, {700, 800}}};
+    TCPOptions options;
+    options.set_sack_blocks(ranges, 550);
+    ASSERT_EQ(options.sack_count, 4);
+    // The block holding the segment that triggered the ACK comes first
+    EXPECT_EQ(options.sack_blocks[0].start, 500u);
+    EXPECT_EQ(options.sack_blocks[1].start, 100u);
+    EXPECT_EQ(options.sack_blocks[2].start, 300u);
+    EXPECT_EQ(options.sack_blocks[3].start, 700u);
+
+    EXPECT_EQ(encode(options).size(), 36u);
+    options.has_timestamps = true;
+    std::vector<uint8_t> bytes = encode(options);
+    EXPECT_EQ(bytes.size(), 40u);
+    TCPOptions parsed;
+    ASSERT_TRUE(parse_tcp_options(bytes, parsed));
+    EXPECT_EQ(parsed.sack_count, 3);
+    EXPECT_EQ(parsed.sack_blocks[0].start, 500u);
+}
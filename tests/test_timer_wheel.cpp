@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+#include "core/timer_wheel.h"
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+static constexpr uint64_t MS = 1'000'000;
+
+TEST(TimerWheelTest, FiresAtTheDeadlineNeverEarly) {
+    TimerWheel wheel;
+    Timer timer;
+    wheel.arm(timer, 5 * MS);
+    EXPECT_TRUE(timer.is_armed());
+
+    size_t fired = 0;
+    auto count = [&](Timer&) { fired++; };
+    EXPECT_EQ(wheel.advance(5 * MS - 1, count), 0u);
+    EXPECT_EQ(wheel.advance(5 * MS, count), 1u);
+    EXPECT_EQ(fired, 1u);
+    EXPECT_FALSE(timer.is_armed());
+    EXPECT_EQ(wheel.get_armed(), 0u);
+
+    // A deadline that has already passed fires at the next tick
+    wheel.arm(timer, 1 * MS);
+    EXPECT_EQ(wheel.advance(5 * MS, count), 0u);
+    EXPECT_EQ(wheel.advance(6 * MS, count), 1u);
+}
+
+TEST(TimerWheelTest, RearmAndCancel) {
+    TimerWheel wheel;
+    Timer timer;
+    size_t fired = 0;
+    auto count = [&](Timer&) { fired++; };
+
+    wheel.arm(timer, 10 * MS);
+    wheel.arm(timer, 20 * MS);
+    EXPECT_EQ(wheel.get_armed(), 1u);
+    wheel.advance(15 * MS, count);
+    EXPECT_EQ(fired, 0u);
+
+    wheel.cancel(timer);
+    wheel.cancel(timer);
+    EXPECT_EQ(wheel.get_armed(), 0u);
+    wheel.advance(100 * MS, count);
+    EXPECT_EQ(fired, 0u);
+}
+
+TEST(TimerWheelTest, DistantDeadlinesCascadeDownInOrder) {
+    TimerWheel wheel;
+    // One per level and across level boundaries, armed out of order
+    std::vector<uint64_t> deadlines = {
+        3'600'000 * MS * 24 * 40, 1 * MS, 255 * MS, 256 * MS, 257 * MS, 70'000 * MS,
+        65'536 * MS, 5 * 3'600'000 * MS, 16'777'216 * MS, 300 * MS};
+    std::vector<Timer> timers(deadlines.size());
+    for (size_t i = 0; i < timers.size(); ++i) {
+        timers[i].kind = static_cast<uint32_t>(i);
+        wheel.arm(timers[i], deadlines[i]);
+    }
+
+    std::vector<uint64_t> fired_at;
+    uint64_t now = 0;
+    while (fired_at.size() < deadlines.size()) {
+        // Coarse steps, each of which must fire exactly what became due
+        now += 977 * MS;
+        wheel.advance(now, [&](Timer& timer) {
+            uint64_t deadline = deadlines[timer.kind];
+            EXPECT_LE(deadline, now);
+            EXPECT_GT(deadline + 977 * MS, now);
+            fired_at.push_back(deadline);
+        });
+    }
+    EXPECT_TRUE(std::is_sorted(fired_at.begin(), fired_at.end()));
+    EXPECT_GT(wheel.get_stats().cascaded, 0u);
+}
+
+TEST(TimerWheelTest, CallbacksMayRearmAndCancel) {
+    TimerWheel wheel;
+    Timer periodic;
+    Timer victim;
+    periodic.kind = 1;
+    wheel.arm(periodic, 100 * MS);
+    wheel.arm(victim, 200 * MS);
+
+    size_t periodic_fires = 0;
+    size_t victim_fires = 0;
+    uint64_t now = 10'000 * MS;
+    wheel.advance(now, [&](Timer& timer) {
+        if (timer.kind == 1) {
+            periodic_fires++;
+            wheel.cancel(victim);
+            wheel.arm(timer, periodic_fires * 100 * MS + 100 * MS);
+        } else {
+            victim_fires++;
+        }
+    });
+    EXPECT_EQ(periodic_fires, 100u);
+    EXPECT_EQ(victim_fires, 0u);
+    EXPECT_FALSE(victim.is_armed());
+    EXPECT_TRUE(periodic.is_armed());
+}
+
+TEST(TimerWheelTest, MillionsOfTimersArmCancelAndExpire) {
+    constexpr size_t COUNT = 1 << 20;
+    auto timers = std::make_unique<Timer[]>(COUNT);
+    TimerWheel wheel;
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<uint64_t> deadline(1, 3'600'000 * MS);
+
+    for (size_t i = 0; i < COUNT; ++i) {
+        wheel.arm(timers[i], deadline(rng));
+    }
+    // Re-arm a quarter, as RTO timers are on every ACK, and cancel a quarter
+    for (size_t i = 0; i < COUNT / 4; ++i) {
+        wheel.arm(timers[i], deadline(rng));
+        wheel.cancel(timers[COUNT - 1 - i]);
+    }
+    EXPECT_EQ(wheel.get_armed(), COUNT - COUNT / 4);
+
+    size_t fired = 0;
+    for (uint64_t now = 0; now <= 3'600'000 * MS; now += 60'000 * MS) {
+        fired += wheel.advance(now, [](Timer&) {});
+    }
+    EXPECT_EQ(fired, COUNT - COUNT / 4);
+    EXPECT_EQ(wheel.get_armed(), 0u);
+}
+
+TEST(TimerWheelTest, TickAndOriginAreRespected) {
+    TimerWheel wheel(1'000 * MS, 10 * MS);
+    Timer timer;
+    wheel.arm(timer, 1'015 * MS);
+    size_t fired = 0;
+    // Rounded up to the 1020 ms tick
+    wheel.advance(1'019 * MS, [&](Timer&) { fired++; });
+    EXPECT_EQ(fired, 0u);
+    wheel.advance(1'020 * MS, [&](Timer&) { fired++; });
+    EXPECT_EQ(fired, 1u);
+}
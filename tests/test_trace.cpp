@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "core/trace.h"
+
+static std::string trace_path(const char* name) {
+    return ::testing::TempDir() + name;
+}
+
+TEST(TraceTest, RecordsFromEveryThreadReachTheFile) {
+    std::string path = trace_path("threads.trace");
+    TRACE(TraceEvent::RX_BURST, 1, 1);  // tracing off: not recorded
+    ASSERT_TRUE(Tracer::start(path));
+    EXPECT_FALSE(Tracer::start(path));
+    
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < 3; ++t) {
+        threads.emplace_back([t] {
+            for (uint32_t i = 0; i < 1000; ++i) {
+                TRACE(TraceEvent::RX_BURST, 100 + t, i, t);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    Tracer::stop();
+    TRACE(TraceEvent::RX_BURST, 2, 2);  // after stop: not recorded
+    
+    TraceReader reader;
+    ASSERT_TRUE(reader.open(path));
+    std::vector<uint32_t> next(3, 0);
+    size_t syncs = 0;
+    for (const auto& record : reader.get_records()) {
+        if (record.event == static_cast<uint16_t>(TraceEvent::CLOCK_SYNC)) {
+            syncs++;
+            continue;
+        }
+        ASSERT_EQ(record.event, static_cast<uint16_t>(TraceEvent::RX_BURST));
+        ASSERT_GE(record.connection, 100u);
+        uint64_t t = record.arg1;
+        ASSERT_LT(t, 3u);
+        EXPECT_EQ(record.connection, 100 + t);
+        // Each thread's records come back in order
+        EXPECT_EQ(record.arg0, next[t]++);
+    }
+    EXPECT_EQ(next, std::vector<uint32_t>(3, 1000));
+    EXPECT_GE(syncs, 2u);
+    
+    const auto& records = reader.get_records();
+    EXPECT_GE(reader.to_nanoseconds(records.back().timestamp), reader.to_nanoseconds(records.front().timestamp));
+    std::remove(path.c_str());
+}
+
+TEST(TraceTest, FullRingDropsAreReported) {
+    std::string path = trace_path("dropped.trace");
+    TraceConfig config;
+    config.ring_size = 16;
+    config.drain_interval_us = 100000;
+    ASSERT_TRUE(Tracer::start(path, config));
+    
+    // A fresh thread registers a buffer with the small ring
+    std::thread writer([] {
+        for (uint32_t i = 0; i < 10000; ++i) {
+            TRACE(TraceEvent::TCP_TRANSITION, 7, i);
+        }
+    });
+    writer.join();
+    Tracer::stop();
+    
+    TraceReader reader;
+    ASSERT_TRUE(reader.open(path));
+    uint64_t kept = 0;
+    uint64_t lost = 0;
+    for (const auto& record : reader.get_records()) {
+        if (record.event == static_cast<uint16_t>(TraceEvent::TCP_TRANSITION)) {
+            kept++;
+        } else if (record.event == static_cast<uint16_t>(TraceEvent::RECORDS_DROPPED)) {
+            lost += record.arg1;
+        }
+    }
+    EXPECT_GT(lost, 0u);
+    EXPECT_EQ(kept + lost, 10000u);
+    std::remove(path.c_str());
+}
+
+// Traces from its destructor, which runs after the trace slot's when the
+// object was created before the thread's first record
+struct TracesOnThreadExit {
+    ~TracesOnThreadExit() { TRACE(TraceEvent::RX_BURST, 999); }
+};
+
+TEST(TraceTest, RecordsAfterTheThreadRetiresAreDropped) {
+    std::string path = trace_path("exit.trace");
+    ASSERT_TRUE(Tracer::start(path));
+    std::thread thread([] {
+        static thread_local TracesOnThreadExit late;
+        (void)late;
+        TRACE(TraceEvent::RX_BURST, 1);
+    });
+    thread.join();
+    Tracer::stop();
+    
+    TraceReader reader;
+    ASSERT_TRUE(reader.open(path));
+    size_t recorded = 0;
+    for (const auto& record : reader.get_records()) {
+        if (record.event == static_cast<uint16_t>(TraceEvent::RX_BURST)) {
+            EXPECT_EQ(record.connection, 1u);
+            recorded++;
+        }
+    }
+    EXPECT_EQ(recorded, 1u);
+    std::remove(path.c_str());
+}
+
+TEST(TraceTest, RejectsFilesThatAreNotTraces) {
+    std::string path = trace_path("garbage.trace");
+    FILE* file = std::fopen(path.c_str(), "wb");
+    std::fputs("not a trace", file);
+    std::fclose(file);
+    
+    TraceReader reader;
+    EXPECT_FALSE(reader.open(path));
+    std::remove(path.c_str());
+}
@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+#include "ethernet/ethernet_frame.h"
+#include "ethernet/ethernet_view.h"
+#include "ip/ipv4_packet.h"
+#include "ip/ipv4_view.h"
+#include "tcp/tcp_segment.h"
+#include "tcp/tcp_view.h"
+#include "test_frames.h"
+
+static std::vector<uint8_t> build_tcp_frame(const std::vector<uint8_t>& payload) {
+    return build_frame({.source_ip = {192, 168, 1, 10}, .destination_ip = {10, 0, 0, 1}, .sequence = 0x01020304,
+                        .ack = 0xA0B0C0D0, .flags = TCPSegment::PSH | TCPSegment::ACK, .window = 1024,
+                        .payload = payload, .source_mac = {0x11, 0x22, 0x33, 0x44, 0x55, 0x66},
+                        .destination_mac = {0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF}});
+}
+
+TEST(ViewTest, ParsesAllLayersWithoutCopying) {
+    std::vector<uint8_t> payload = {'H', 'e', 'l', 'l', 'o'};
+    auto frame = build_tcp_frame(payload);
+
+    EthernetView eth;
+    ASSERT_TRUE(eth.parse(frame));
+    EXPECT_EQ(eth.get_ethertype(), EthernetFrame::ETHERTYPE_IPV4);
+    EXPECT_EQ(eth.get_source_mac()[0], 0x11);
+    EXPECT_EQ(eth.get_payload().data(), frame.data() + 14);
+
+    IPv4View ip;
+    ASSERT_TRUE(ip.parse(eth.get_payload()));
+    EXPECT_EQ(ip.get_protocol(), IPv4Packet::PROTOCOL_TCP);
+    EXPECT_EQ(ip.get_ttl(), 64);
+    EXPECT_EQ(ip.get_source_address(), 0xC0A8010Au);
+    EXPECT_EQ(ip.get_total_length(), 20 + 20 + payload.size());
+    EXPECT_FALSE(ip.is_fragment());
+
+    TCPView tcp;
+    ASSERT_TRUE(tcp.parse(ip.get_payload()));
+    EXPECT_EQ(tcp.get_source_port(), 40000);
+    EXPECT_EQ(tcp.get_dest_port(), 80);
+    EXPECT_EQ(tcp.get_sequence_number(), 0x01020304u);
+    EXPECT_EQ(tcp.get_ack_number(), 0xA0B0C0D0u);
+    EXPECT_TRUE(tcp.has_flag(TCPSegment::ACK));
+    EXPECT_FALSE(tcp.has_flag(TCPSegment::SYN));
+
+    auto tcp_payload = tcp.get_payload();
+    ASSERT_EQ(tcp_payload.size(), payload.size());
+    EXPECT_EQ(tcp_payload.data(), frame.data() + 14 + 20 + 20);
+    EXPECT_TRUE(std::equal(tcp_payload.begin(), tcp_payload.end(), payload.begin()));
+}
+
+TEST(ViewTest, IPv4PayloadExcludesLinkPadding) {
+    auto frame = build_tcp_frame({});
+    frame.resize(60, 0); // minimum Ethernet frame size
+
+    EthernetView eth;
+    ASSERT_TRUE(eth.parse(frame));
+    IPv4View ip;
+    ASSERT_TRUE(ip.parse(eth.get_payload()));
+    EXPECT_EQ(ip.get_payload().size(), 20u);
+}
+
+TEST(ViewTest, RejectsTruncatedHeaders) {
+    auto frame = build_tcp_frame({1, 2, 3});
+
+    EthernetView eth;
+    EXPECT_FALSE(eth.parse(std::span<const uint8_t>(frame.data(), 13)));
+
+    IPv4View ip;
+    EXPECT_FALSE(ip.parse(std::span<const uint8_t>(frame.data() + 14, 19)));
+    // total_length says 63 bytes but only 40 were captured
+    EXPECT_FALSE(ip.parse(std::span<const uint8_t>(frame.data() + 14, 40)));
+
+    std::vector<uint8_t> tcp_bytes(frame.begin() + 34, frame.end());
+    tcp_bytes[12] = 0xF0; // data offset of 60 bytes
+    TCPView tcp;
+    EXPECT_FALSE(tcp.parse(tcp_bytes));
+}
+
+TEST(ViewTest, MutableViewsPatchChecksumsInPlace) {
+    std::vector<uint8_t> payload = {'N', 'A', 'T', '!', '?'};
+    auto frame = build_tcp_frame(payload);
+    std::span<uint8_t> ip_bytes(frame.data() + 14, frame.size() - 14);
+    std::span<uint8_t> tcp_bytes = ip_bytes.subspan(20);
+
+    // Fill in a valid TCP checksum to start from
+    TCPSegment segment;
+    ASSERT_TRUE(segment.deserialize(std::vector<uint8_t>(tcp_bytes.begin(), tcp_bytes.end())));
+    write_be16(tcp_bytes.data() + 16, segment.calculate_checksum({192, 168, 1, 10}, {10, 0, 0, 1}));
+
+    IPv4MutableView ip;
+    ASSERT_TRUE(ip.parse(ip_bytes));
+    TCPMutableView tcp;
+    ASSERT_TRUE(tcp.parse(tcp_bytes));
+
+    uint32_t old_source = ip.get_source_address();
+    ASSERT_TRUE(ip.decrement_ttl());
+    ip.set_source_ip({203, 0, 113, 7});
+    tcp.rewrite_pseudo_header_address(old_source, ip.get_source_address());
+    tcp.set_source_port(61000);
+
+    EXPECT_EQ(ip.get_ttl(), 63);
+    EXPECT_EQ(tcp.get_source_port(), 61000);
+    // A valid header checksums to zero including its checksum field
+    EXPECT_EQ(calculate_checksum(ip.get_header_bytes()), 0);
+
+    std::array<uint8_t, 12> pseudo_header = {203, 0, 113, 7, 10, 0, 0, 1, 0, IPv4Packet::PROTOCOL_TCP};
+    write_be16(pseudo_header.data() + 10, static_cast<uint16_t>(tcp_bytes.size()));
+    std::span<const uint8_t> segment_bytes(tcp_bytes);
+    EXPECT_EQ(calculate_checksum({std::span<const uint8_t>(pseudo_header), segment_bytes}), 0);
+}
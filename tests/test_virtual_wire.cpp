@@ -0,0 +1,324 @@
+#include <gtest/gtest.h>
+#include "link/virtual_wire.h"
+#include "stack.h"
+#include <algorithm>
+#include <vector>
+
+static uint64_t wire_clock_ns = 0;
+static uint64_t wire_clock() { return wire_clock_ns; }
+
+static PacketHandle make_frame(PacketPool& pool, size_t size, uint8_t tag) {
+    PacketHandle frame = pool.alloc();
+    uint8_t* data = frame.append(size);
+    data[0] = tag;
+    return frame;
+}
+
+// Sends one frame per tag through a, then collects what b receives
+static std::vector<uint8_t> receive_all(VirtualPort& b, PacketPool& pool) {
+    std::vector<uint8_t> tags;
+    PacketHandle burst[16];
+    size_t count;
+    while ((count = b.rx_burst(pool, burst, 16)) > 0) {
+        for (size_t i = 0; i < count; ++i) {
+            tags.push_back(burst[i].data()[0]);
+            burst[i].release();
+        }
+    }
+    return tags;
+}
+
+TEST(VirtualWireTest, FramesArriveAfterSerializationAndLatency) {
+    wire_clock_ns = 1'000'000;
+    VirtualWireConfig config;
+    config.clock = wire_clock;
+    config.a_to_b.rate_bps = 8'000'000;     // a byte per microsecond
+    config.a_to_b.latency_ns = 50'000;
+    VirtualWire wire(config);
+    PacketPool pool;
+
+    PacketHandle frames[2] = {make_frame(pool, 100, 1), make_frame(pool, 100, 2)};
+    EXPECT_EQ(wire.get_a().tx_burst(frames, 2), 2u);
+    // The first is on the wire for 100 us, the second queues behind it
+    wire_clock_ns += 149'000;
+    EXPECT_TRUE(receive_all(wire.get_b(), pool).empty());
+    EXPECT_EQ(wire.get_b().get_next_arrival(), 1'150'000u);
+    wire_clock_ns += 1'000;
+    EXPECT_EQ(receive_all(wire.get_b(), pool), std::vector<uint8_t>({1}));
+    wire_clock_ns += 100'000;
+    EXPECT_EQ(receive_all(wire.get_b(), pool), std::vector<uint8_t>({2}));
+    // Nothing comes back the other way
+    EXPECT_TRUE(receive_all(wire.get_a(), pool).empty());
+
+    WireStats stats = wire.get_a().get_stats();
+    EXPECT_EQ(stats.sent, 2u);
+    EXPECT_EQ(stats.delivered, 2u);
+    EXPECT_EQ(stats.bytes_delivered, 200u);
+    EXPECT_EQ(wire.get_b().get_stats().sent, 0u);
+}
+
+TEST(VirtualWireTest, TheQueueAndTheRingBoundWhatIsInFlight) {
+    wire_clock_ns = 0;
+    VirtualWireConfig config;
+    config.clock = wire_clock;
+    config.ring_size = 8;
+    config.a_to_b.rate_bps = 8'000'000;
+    config.a_to_b.queue_bytes = 1000;
+    VirtualWire wire(config);
+    PacketPool pool;
+
+    // 400 bytes each: the queue holds two, counting the one on the wire
+    std::vector<PacketHandle> frames;
+    for (uint8_t i = 0; i < 5; ++i) {
+        frames.push_back(make_frame(pool, 400, i));
+    }
+    EXPECT_EQ(wire.get_a().tx_burst(frames.data(), frames.size()), 5u);
+    EXPECT_EQ(wire.get_a().get_stats().queue_drops, 3u);
+
+    // Without a rate limit, the receiver taking nothing fills the ring
+    VirtualWireConfig fast;
+    fast.clock = wire_clock;
+    fast.ring_size = 8;
+    VirtualWire unlimited(fast);
+    std::vector<PacketHandle> many;
+    for (uint8_t i = 0; i < 10; ++i) {
+        many.push_back(make_frame(pool, 64, i));
+    }
+    EXPECT_EQ(unlimited.get_a().tx_burst(many.data(), many.size()), 10u);
+    EXPECT_EQ(unlimited.get_a().get_stats().overflows, 2u);
+    EXPECT_EQ(receive_all(unlimited.get_b(), pool).size(), 8u);
+}
+
+TEST(VirtualWireTest, JitterKeepsOrderAndReorderingPassesHeldFrames) {
+    wire_clock_ns = 0;
+    VirtualWireConfig config;
+    config.clock = wire_clock;
+    config.a_to_b.latency_ns = 100'000;
+    config.a_to_b.jitter_ns = 50'000;
+    config.a_to_b.seed = 7;
+    VirtualWire jittery(config);
+    config.a_to_b.jitter_ns = 0;
+    config.a_to_b.reorder = 0.2;
+    config.a_to_b.reorder_ns = 10'000'000;
+    VirtualWire reordering(config);
+    PacketPool pool;
+
+    for (uint8_t i = 0; i < 100; ++i) {
+        PacketHandle frame = make_frame(pool, 64, i);
+        jittery.get_a().tx_burst(&frame, 1);
+        reordering.get_a().tx_burst(&frame, 1);
+        wire_clock_ns += 1'000;
+    }
+    wire_clock_ns += 20'000'000;
+    std::vector<uint8_t> in_order = receive_all(jittery.get_b(), pool);
+    ASSERT_EQ(in_order.size(), 100u);
+    for (size_t i = 0; i < in_order.size(); ++i) {
+        EXPECT_EQ(in_order[i], i);
+    }
+
+    // Held frames come after every frame that was not
+    std::vector<uint8_t> shuffled = receive_all(reordering.get_b(), pool);
+    uint64_t held = reordering.get_a().get_stats().reordered;
+    ASSERT_EQ(shuffled.size(), 100u);
+    EXPECT_GT(held, 5u);
+    EXPECT_LT(held, 40u);
+    EXPECT_TRUE(std::is_sorted(shuffled.begin(), shuffled.end() - static_cast<ptrdiff_t>(held)));
+    EXPECT_TRUE(std::is_sorted(shuffled.end() - static_cast<ptrdiff_t>(held), shuffled.end()));
+    EXPECT_FALSE(std::is_sorted(shuffled.begin(), shuffled.end()));
+}
+
+TEST(VirtualWireTest, LossFollowsTheSeed) {
+    wire_clock_ns = 0;
+    VirtualWireConfig config;
+    config.clock = wire_clock;
+    config.a_to_b.loss = 0.1;
+    PacketPool pool;
+    std::vector<std::vector<uint8_t>> runs;
+    for (int run = 0; run < 2; ++run) {
+        VirtualWire wire(config);
+        for (int i = 0; i < 1000; ++i) {
+            PacketHandle frame = make_frame(pool, 64, static_cast<uint8_t>(i));
+            wire.get_a().tx_burst(&frame, 1);
+            if (i % 8 == 7) {
+                std::vector<uint8_t> tags = receive_all(wire.get_b(), pool);
+                runs.resize(run + 1);
+                runs[run].insert(runs[run].end(), tags.begin(), tags.end());
+            }
+        }
+        WireStats stats = wire.get_a().get_stats();
+        EXPECT_GT(stats.lost, 50u);
+        EXPECT_LT(stats.lost, 150u);
+        EXPECT_EQ(stats.lost + stats.delivered, 1000u);
+    }
+    EXPECT_EQ(runs[0], runs[1]);
+}
+
+TEST(VirtualWireTest, AClosedPortRefusesFramesBothWays) {
+    VirtualWire wire;
+    PacketPool pool;
+    PacketHandle frame = make_frame(pool, 64, 1);
+    wire.get_b().close();
+    EXPECT_FALSE(wire.get_b().is_open());
+    EXPECT_EQ(wire.get_a().tx_burst(&frame, 1), 0u);
+    EXPECT_EQ(wire.get_b().tx_burst(&frame, 1), 0u);
+}
+
+// Two stacks joined by a wire, on the test clock
+
+static constexpr uint32_t CLIENT = 0x0A000001;
+static constexpr uint32_t SERVER = 0x0A000002;
+static constexpr uint16_t PORT = 5001;
+
+struct WiredStacks {
+    VirtualWire wire;
+    TCPIPStack client;
+    TCPIPStack server;
+
+    static StackConfig host(uint32_t address, uint8_t id, uint8_t peer) {
+        StackConfig config;
+        config.clock = wire_clock;
+        config.address = address;
+        config.mac = {0x02, 0, 0, 0, 0, id};
+        config.gateway_mac = {0x02, 0, 0, 0, 0, peer};
+        config.iss_secret = 0x5EED;
+        return config;
+    }
+
+    explicit WiredStacks(const VirtualWireConfig& config)
+        : wire(config), client(wire.get_a(), host(CLIENT, 1, 2)), server(wire.get_b(), host(SERVER, 2, 1)) {}
+
+    void turn(uint64_t step_ns) {
+        wire_clock_ns += step_ns;
+        client.poll();
+        server.poll();
+    }
+};
+
+static VirtualWireConfig link_config(double loss = 0, double reorder = 0) {
+    VirtualWireConfig config;
+    config.clock = wire_clock;
+    for (WireLinkConfig* link : {&config.a_to_b, &config.b_to_a}) {
+        link->rate_bps = 100'000'000;
+        link->latency_ns = 1'000'000;
+        link->loss = loss;
+        link->reorder = reorder;
+    }
+    config.b_to_a.seed = 2;
+    return config;
+}
+
+static uint8_t stream_byte(size_t i) {
+    return static_cast<uint8_t>(i ^ (i >> 8) ^ (i >> 16));
+}
+
+struct TransferOutcome {
+    bool intact = false;
+    uint64_t elapsed_ns = 0;
+    MetricsSnapshot client;
+    WireStats forward;
+};
+
+// Sends bytes from client to server and closes; the server checks them
+static TransferOutcome transfer(const VirtualWireConfig& config, size_t bytes) {
+    wire_clock_ns = 1'000'000'000;
+    WiredStacks stacks(config);
+    SocketId listener = stacks.server.listen_socket(PORT);
+    SocketId client = stacks.client.connect(SERVER, PORT);
+    SocketId server = 0;
+    std::vector<uint8_t> chunk(16384);
+    std::vector<uint8_t> buffer(16384);
+    size_t sent = 0;
+    size_t received = 0;
+    bool intact = true;
+    bool finished = false;
+    uint64_t start = wire_clock_ns;
+
+    for (size_t turn = 0; turn < 2'000'000 && !finished; ++turn) {
+        stacks.turn(10'000);
+        if (server == 0) {
+            server = stacks.server.accept(listener);
+        }
+        while (sent < bytes && (stacks.client.get_events(client) & SocketEvent::WRITABLE)) {
+            size_t length = std::min(chunk.size(), bytes - sent);
+            for (size_t i = 0; i < length; ++i) {
+                chunk[i] = stream_byte(sent + i);
+            }
+            IoResult written = stacks.client.send(client, std::span<const uint8_t>(chunk.data(), length));
+            sent += written.bytes;
+            if (sent == bytes) {
+                stacks.client.close(client);
+            }
+        }
+        while (server != 0) {
+            IoResult read = stacks.server.recv(server, buffer);
+            if (read.error == SocketError::WOULD_BLOCK) {
+                break;
+            }
+            if (read.bytes == 0) {
+                finished = true;
+                break;
+            }
+            for (size_t i = 0; i < read.bytes; ++i) {
+                intact = intact && buffer[i] == stream_byte(received + i);
+            }
+            received += read.bytes;
+        }
+    }
+    TransferOutcome outcome;
+    outcome.intact = finished && intact && received == bytes;
+    outcome.elapsed_ns = wire_clock_ns - start;
+    outcome.client = stacks.client.get_metrics();
+    outcome.forward = stacks.wire.get_a().get_stats();
+    return outcome;
+}
+
+TEST(VirtualWireTest, StacksTransferOverACleanWire) {
+    TransferOutcome outcome = transfer(link_config(), 4 << 20);
+    EXPECT_TRUE(outcome.intact);
+    EXPECT_EQ(outcome.client.get(Metric::TCP_RETRANSMIT_TIMEOUTS), 0u);
+    EXPECT_EQ(outcome.forward.lost + outcome.forward.queue_drops + outcome.forward.overflows, 0u);
+    // 4 MiB at 100 Mbit/s is 0.34 s of serialization alone
+    EXPECT_GT(outcome.elapsed_ns, 340'000'000u);
+    EXPECT_LT(outcome.elapsed_ns, 1'000'000'000u);
+}
+
+TEST(VirtualWireTest, StacksRecoverFromLossAndReordering) {
+    TransferOutcome outcome = transfer(link_config(0.01, 0.01), 2 << 20);
+    EXPECT_TRUE(outcome.intact);
+    EXPECT_GT(outcome.forward.lost, 0u);
+    EXPECT_GT(outcome.forward.reordered, 0u);
+}
+
+TEST(VirtualWireTest, RunsRepeatExactly) {
+    TransferOutcome first = transfer(link_config(0.02), 1 << 20);
+    TransferOutcome second = transfer(link_config(0.02), 1 << 20);
+    EXPECT_TRUE(first.intact);
+    EXPECT_EQ(first.elapsed_ns, second.elapsed_ns);
+    EXPECT_EQ(first.forward.delivered, second.forward.delivered);
+    EXPECT_EQ(first.client.get(Metric::TCP_SEGMENTS_SENT), second.client.get(Metric::TCP_SEGMENTS_SENT));
+}
+
+TEST(VirtualWireTest, HandshakeTakesOneRoundTrip) {
+    wire_clock_ns = 1'000'000'000;
+    WiredStacks stacks(link_config());
+    SocketId listener = stacks.server.listen_socket(PORT);
+    SocketId client = stacks.client.connect(SERVER, PORT);
+    uint64_t start = wire_clock_ns;
+    while (!(stacks.client.get_events(client) & SocketEvent::WRITABLE) && wire_clock_ns - start < 100'000'000) {
+        stacks.turn(10'000);
+    }
+    // SYN and SYN-ACK each cross 1 ms of wire
+    EXPECT_GE(wire_clock_ns - start, 2'000'000u);
+    EXPECT_LE(wire_clock_ns - start, 2'100'000u);
+    stacks.turn(1'100'000);
+    SocketId accepted = stacks.server.accept(listener);
+    ASSERT_NE(accepted, 0u);
+    FlowKey key;
+    ASSERT_TRUE(stacks.server.get_flow(accepted, key));
+    EXPECT_EQ(key.remote_address, CLIENT);
+
+    // A stack on its own device reads no savefiles and leaves it open
+    EXPECT_FALSE(stacks.server.process_savefile("missing.pcap"));
+    EXPECT_TRUE(stacks.server.open());
+    EXPECT_TRUE(stacks.wire.get_b().is_open());
+}
@@ -0,0 +1,110 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "stack.h"
+#include "core/trace.h"
+
+static void print_usage(const char* program) {
+    std::cout << "Usage: " << program << " <capture.pcap|pcapng> [options]\n"
+              << "  --original        replay with the capture's original timing\n"
+              << "  --speed <factor>  replay with timing scaled by factor\n"
+              << "  --fast            replay as fast as possible (default)\n"
+              << "  --loops <n>       passes over the file (default 1)\n"
+              << "  --burst <n>       packets per RX burst (default 32)\n"
+              << "  --workers <n>     worker threads fed by RSS steering (default 0)\n"
+              << "  --listen <port>   accept connections on a port (repeatable)\n"
+              << "  --trace <file>    record a binary event trace (see trace_decode)\n"
+              << "  --verify-tcp      check TCP checksums\n"
+              << "  --prometheus      print counters in Prometheus text format" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    
+    std::string path = argv[1];
+    ReplayConfig replay_config;
+    StackConfig stack_config;
+    std::vector<uint16_t> listen_ports;
+    std::string trace_path;
+    bool prometheus = false;
+    
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--original") {
+            replay_config.timing = ReplayTiming::ORIGINAL;
+        } else if (arg == "--fast") {
+            replay_config.timing = ReplayTiming::AS_FAST_AS_POSSIBLE;
+        } else if (arg == "--speed" && has_value) {
+            replay_config.timing = ReplayTiming::SCALED;
+            replay_config.speed = std::atof(argv[++i]);
+        } else if (arg == "--loops" && has_value) {
+            replay_config.loops = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--burst" && has_value) {
+            stack_config.rx_burst_size = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--workers" && has_value) {
+            stack_config.worker_count = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--listen" && has_value) {
+            listen_ports.push_back(static_cast<uint16_t>(std::strtoul(argv[++i], nullptr, 10)));
+        } else if (arg == "--trace" && has_value) {
+            trace_path = argv[++i];
+        } else if (arg == "--verify-tcp") {
+            stack_config.verify_tcp_checksum = true;
+        } else if (arg == "--prometheus") {
+            prometheus = true;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    
+    if (!trace_path.empty() && !Tracer::start(trace_path)) {
+        std::cerr << "Couldn't create trace file " << trace_path << std::endl;
+        return 1;
+    }
+    
+    TCPIPStack stack("replay", stack_config);
+    for (uint16_t port : listen_ports) {
+        stack.listen(port);
+    }
+    ReplayReport report;
+    bool replayed = stack.replay(path, replay_config, report);
+    Tracer::stop();
+    if (!replayed) {
+        return 1;
+    }
+    
+    std::printf("packets:       %llu\n", static_cast<unsigned long long>(report.packets));
+    std::printf("bytes:         %llu\n", static_cast<unsigned long long>(report.bytes));
+    std::printf("elapsed:       %.6f s\n", report.elapsed_seconds);
+    std::printf("packets/s:     %.0f\n", report.packets_per_second);
+    std::printf("bytes/s:       %.0f (%.3f Gbit/s)\n", report.bytes_per_second,
+                report.bytes_per_second * 8 / 1e9);
+    if (report.skipped > 0) {
+        std::printf("skipped:       %llu (non-Ethernet link type)\n",
+                    static_cast<unsigned long long>(report.skipped));
+    }
+    if (report.file_truncated) {
+        std::printf("warning:       capture file is truncated or corrupt\n");
+    }
+    
+    StackStats stats = stack.get_stats();
+    for (size_t i = 0; i < stats.worker_packets.size(); ++i) {
+        std::printf("worker[%zu]:     %llu packets\n", i,
+                    static_cast<unsigned long long>(stats.worker_packets[i]));
+    }
+    
+    std::printf("counters:\n");
+    if (prometheus) {
+        report.metrics.write_prometheus(std::cout);
+    } else {
+        report.metrics.write_text(std::cout);
+    }
+    return 0;
+}
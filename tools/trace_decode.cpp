@@ -0,0 +1,81 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "core/trace.h"
+#include "tcp/tcp_state_machine.h"
+
+static void print_usage(const char* program) {
+    std::printf("Usage: %s <trace file> [--summary]\n"
+                "  --summary  print record counts per event instead of every record\n", program);
+}
+
+static void print_record(const TraceReader& reader, const TraceRecord& record) {
+    auto event = static_cast<TraceEvent>(record.event);
+    std::printf("%14.3f us  T%-3u %-22s", reader.to_nanoseconds(record.timestamp) / 1000.0,
+                record.thread, trace_event_name(event));
+    if (record.connection != 0) {
+        std::printf(" flow=%016llx", static_cast<unsigned long long>(record.connection));
+    }
+    
+    switch (event) {
+        case TraceEvent::TCP_TRANSITION:
+            std::printf(" %s --%s--> %s", tcp_state_name(static_cast<TCPState>(record.arg0 & 0xFF)),
+                        tcp_event_name(static_cast<TCPEvent>((record.arg0 >> 8) & 0xFF)),
+                        tcp_state_name(static_cast<TCPState>((record.arg0 >> 16) & 0xFF)));
+            break;
+        case TraceEvent::TCP_BAD_STATE:
+            std::printf(" %s in %s", tcp_event_name(static_cast<TCPEvent>((record.arg0 >> 8) & 0xFF)),
+                        tcp_state_name(static_cast<TCPState>(record.arg0 & 0xFF)));
+            break;
+        case TraceEvent::CLOCK_SYNC:
+            break;
+        default:
+            std::printf(" arg0=%u arg1=%llu", record.arg0, static_cast<unsigned long long>(record.arg1));
+            break;
+    }
+    std::printf("\n");
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    bool summary = argc > 2 && std::strcmp(argv[2], "--summary") == 0;
+    
+    TraceReader reader;
+    if (!reader.open(argv[1])) {
+        std::fprintf(stderr, "Not a readable trace file: %s\n", argv[1]);
+        return 1;
+    }
+    
+    const auto& records = reader.get_records();
+    if (!summary) {
+        for (const auto& record : records) {
+            print_record(reader, record);
+        }
+        return 0;
+    }
+    
+    uint64_t counts[static_cast<size_t>(TraceEvent::COUNT)] = {};
+    uint64_t dropped = 0;
+    for (const auto& record : records) {
+        if (record.event < static_cast<uint16_t>(TraceEvent::COUNT)) {
+            counts[record.event]++;
+        }
+        if (record.event == static_cast<uint16_t>(TraceEvent::RECORDS_DROPPED)) {
+            dropped += record.arg1;
+        }
+    }
+    for (size_t i = 0; i < static_cast<size_t>(TraceEvent::COUNT); ++i) {
+        if (counts[i] > 0) {
+            std::printf("%-22s %llu\n", trace_event_name(static_cast<TraceEvent>(i)),
+                        static_cast<unsigned long long>(counts[i]));
+        }
+    }
+    if (!records.empty()) {
+        std::printf("span                   %.3f ms\n", reader.to_nanoseconds(records.back().timestamp) / 1e6);
+    }
+    std::printf("records lost           %llu\n", static_cast<unsigned long long>(dropped));
+    return 0;
+}